@@ -8,9 +8,15 @@ public class CoopGame : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 	
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "NavigationSystem" , "OnlineSubsystem" , "OnlineSubsystemUtils" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "NavigationSystem" , "AIModule" , "OnlineSubsystem" , "OnlineSubsystemUtils" });
 
-		PrivateDependencyModuleNames.AddRange(new string[] {  });
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json", "Sockets", "AssetRegistry" });
+
+		// Server cooks are told apart by their target platform (FSAssetStreamer::FCosmeticReferenceScope)
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.Add("TargetPlatform");
+		}
 
         DynamicallyLoadedModuleNames.Add("OnlineSubsystemSteam");
 
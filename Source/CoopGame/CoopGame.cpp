@@ -2,5 +2,97 @@
 
 #include "CoopGame.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Engine/World.h"
+#include "SPerfCounters.h"
+#include "SDeterminism.h"
+#include "STelemetry.h"
+#include "SAssetStreamer.h"
+#include "SCosmeticPolicy.h"
+#include "SNetAccounting.h"
+#include "SMemoryTracker.h"
+#include "SMetrics.h"
+#include "SHitchDetector.h"
+#include "STickBudget.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, CoopGame, "CoopGame" );
+DEFINE_LOG_CATEGORY(LogCoopGame);
+DEFINE_LOG_CATEGORY(LogCoopDamage);
+
+
+class FCoopGameModule : public FDefaultGameModuleImpl
+{
+public:
+
+	virtual void StartupModule() override
+	{
+		FSDeterminism::Initialize();
+
+		FSTelemetry::Get().Start();
+
+		FSNetAccounting::Get().Initialize();
+
+		FSMemoryTracker::Get().Initialize();
+
+		FSTickBudget::Get().Initialize();
+
+		// Frame boundaries for our own gameplay timings
+		BeginFrameHandle = FCoreDelegates::OnBeginFrame.AddRaw(&FSPerfCounters::Get(), &FSPerfCounters::BeginFrame);
+		EndFrameHandle = FCoreDelegates::OnEndFrame.AddRaw(&FSPerfCounters::Get(), &FSPerfCounters::EndFrame);
+
+		// The net drivers flush in the world's TickFlush, which follows its actor tick with only the async trace wait in
+		// between. PostTickFlush comes right after it, before FX, GC and the rest of the frame
+		PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddLambda([](UWorld*, ELevelTick, float)
+		{
+			FSPerfCounters::Get().BeginReplication();
+		});
+		PostWorldInitHandle = FWorldDelegates::OnPostWorldInitialization.AddLambda([](UWorld* World, const UWorld::InitializationValues)
+		{
+			World->OnPostTickFlush().AddLambda([](float)
+			{
+				FSPerfCounters::Get().EndReplication();
+			});
+		});
+
+		FSMetrics::Get().Initialize();
+
+		FSHitchDetector::Get().Initialize();
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FCoreDelegates::OnBeginFrame.Remove(BeginFrameHandle);
+		FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+		FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+		FWorldDelegates::OnPostWorldInitialization.Remove(PostWorldInitHandle);
+
+		FSHitchDetector::Get().Shutdown();
+
+		FSMetrics::Get().Shutdown();
+
+		FSCosmeticPolicy::Get().LogReport();
+
+		FSNetAccounting::Get().Shutdown();
+
+		FSMemoryTracker::Get().Shutdown();
+
+		FSTickBudget::Get().Shutdown();
+
+		FSAssetStreamer::Get().Shutdown();
+
+		FSTelemetry::Get().Stop();
+
+		FSDeterminism::Shutdown();
+	}
+
+private:
+
+	FDelegateHandle BeginFrameHandle;
+
+	FDelegateHandle EndFrameHandle;
+
+	FDelegateHandle PostActorTickHandle;
+
+	FDelegateHandle PostWorldInitHandle;
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FCoopGameModule, CoopGame, "CoopGame" );
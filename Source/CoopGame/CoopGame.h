@@ -10,4 +10,23 @@
 #define SURFACE_FLESHDEFAULT		SurfaceType1
 #define SURFACE_FLESHVULNERABLE		SurfaceType2
 
-#define COLLISION_WEAPON			ECC_GameTraceChannel1
\ No newline at end of file
+#define COLLISION_WEAPON			ECC_GameTraceChannel1
+
+DECLARE_LOG_CATEGORY_EXTERN(LogCoopGame, Log, All);
+
+// Per hit health logging is compiled out unless the build sets COOP_DAMAGE_LOGGING, telemetry records every hit anyway
+#ifndef COOP_DAMAGE_LOGGING
+#define COOP_DAMAGE_LOGGING 0
+#endif
+
+#if COOP_DAMAGE_LOGGING
+DECLARE_LOG_CATEGORY_EXTERN(LogCoopDamage, Verbose, All);
+#else
+DECLARE_LOG_CATEGORY_EXTERN(LogCoopDamage, Log, Warning);
+#endif
+
+// Emitters, sounds, dynamic materials, camera shakes and FOV blends only matter to someone looking at the screen,
+// the dedicated server target (CoopGameServer) compiles them out
+#ifndef COOP_WITH_COSMETICS
+#define COOP_WITH_COSMETICS (!UE_SERVER)
+#endif
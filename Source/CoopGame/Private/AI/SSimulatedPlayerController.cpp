@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SSimulatedPlayerController.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "SHealthComponent.h"
+#include "EngineUtils.h"
+#include "Engine/TargetPoint.h"
+#include "TimerManager.h"
+#include "NavigationSystem/Public/NavigationSystem.h"
+
+
+ASSimulatedPlayerController::ASSimulatedPlayerController()
+{
+	// Count as a player for the game mode and the scoreboard
+	bWantsPlayerState = true;
+
+	Policy = ESimulatedPlayerPolicy::Hunt;
+	DecisionInterval = 0.25f;
+	EngageRange = 2500.0f;
+	KeepAwayDistance = 400.0f;
+	WanderRadius = 1500.0f;
+	PatrolTag = "SimPatrol";
+
+	PatrolIndex = 0;
+	bIsFiring = false;
+}
+
+
+void ASSimulatedPlayerController::SetPolicy(ESimulatedPlayerPolicy NewPolicy)
+{
+	Policy = NewPolicy;
+}
+
+
+void ASSimulatedPlayerController::SetRandomSeed(int32 Seed)
+{
+	RandomStream.Initialize(Seed);
+}
+
+
+void ASSimulatedPlayerController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	if (Policy == ESimulatedPlayerPolicy::Patrol && PatrolPoints.Num() == 0)
+	{
+		for (TActorIterator<ATargetPoint> It(GetWorld()); It; ++It)
+		{
+			if (It->ActorHasTag(PatrolTag))
+			{
+				PatrolPoints.Add(It->GetActorLocation());
+			}
+		}
+
+		// Iteration order isn't stable between runs, the route is
+		PatrolPoints.Sort([](const FVector& A, const FVector& B) { return A.X < B.X || (A.X == B.X && A.Y < B.Y); });
+	}
+
+	// Stagger the decisions of the simulated players so they don't all think in the same frame
+	const float FirstDelay = RandomStream.FRandRange(0.0f, DecisionInterval);
+	GetWorldTimerManager().SetTimer(TimerHandle_Decide, this, &ASSimulatedPlayerController::Decide, DecisionInterval, true, FirstDelay);
+}
+
+
+void ASSimulatedPlayerController::OnUnPossess()
+{
+	SetFiring(false);
+
+	GetWorldTimerManager().ClearTimer(TimerHandle_Decide);
+
+	Super::OnUnPossess();
+}
+
+
+ASCharacter* ASSimulatedPlayerController::GetSimulatedCharacter() const
+{
+	return Cast<ASCharacter>(GetPawn());
+}
+
+
+void ASSimulatedPlayerController::Decide()
+{
+	ASCharacter* MyCharacter = GetSimulatedCharacter();
+	if (MyCharacter == nullptr)
+	{
+		return;
+	}
+
+	// Reload when the clip runs dry, like a player would
+	ASWeapon* Weapon = MyCharacter->GetCurrentWeapon();
+	if (Weapon && Weapon->CurrentAmmo <= 0)
+	{
+		SetFiring(false);
+		Weapon->StartReload();
+	}
+
+	float Distance = 0.0f;
+	AActor* Target = FindNearestEnemy(Distance);
+	if (Target)
+	{
+		Engage(Target, Distance);
+	}
+	else
+	{
+		ClearFocus(EAIFocusPriority::Gameplay);
+		SetFiring(false);
+		MoveWithoutTarget();
+	}
+}
+
+
+AActor* ASSimulatedPlayerController::FindNearestEnemy(float& OutDistance) const
+{
+	APawn* MyPawn = GetPawn();
+
+	AActor* BestTarget = nullptr;
+	OutDistance = FLT_MAX;
+
+	for (FConstPawnIterator It = GetWorld()->GetPawnIterator(); It; ++It)
+	{
+		APawn* TestPawn = It->Get();
+		if (TestPawn == nullptr || TestPawn == MyPawn || USHealthComponent::IsFriendly(TestPawn, MyPawn))
+		{
+			continue;
+		}
+
+		USHealthComponent* HealthComp = Cast<USHealthComponent>(TestPawn->GetComponentByClass(USHealthComponent::StaticClass()));
+		if (HealthComp && HealthComp->GetHealth() > 0.0f)
+		{
+			float Distance = (TestPawn->GetActorLocation() - MyPawn->GetActorLocation()).Size();
+			if (Distance < OutDistance)
+			{
+				BestTarget = TestPawn;
+				OutDistance = Distance;
+			}
+		}
+	}
+
+	return BestTarget;
+}
+
+
+void ASSimulatedPlayerController::Engage(AActor* Target, float Distance)
+{
+	APawn* MyPawn = GetPawn();
+
+	// Aim: the focus drives our control rotation, which is what the weapon traces along
+	SetFocus(Target, EAIFocusPriority::Gameplay);
+
+	const bool bInRange = Distance <= EngageRange;
+	SetFiring(bInRange && LineOfSightTo(Target));
+
+	if (Distance < KeepAwayDistance)
+	{
+		// Back off, slightly sideways so we don't run in a straight line
+		FVector Away = MyPawn->GetActorLocation() - Target->GetActorLocation();
+		Away.Z = 0.0f;
+		Away = Away.GetSafeNormal().RotateAngleAxis(RandomStream.FRandRange(-45.0f, 45.0f), FVector::UpVector);
+
+		MoveToLocation(MyPawn->GetActorLocation() + Away * KeepAwayDistance, 50.0f, false);
+	}
+	else if (Policy == ESimulatedPlayerPolicy::Hunt && !bInRange)
+	{
+		MoveToActor(Target, EngageRange * 0.5f, false);
+	}
+	else if (Policy == ESimulatedPlayerPolicy::Patrol && !bInRange)
+	{
+		MoveWithoutTarget();
+	}
+}
+
+
+void ASSimulatedPlayerController::MoveWithoutTarget()
+{
+	// Keep going with the current move
+	if (GetMoveStatus() == EPathFollowingStatus::Moving)
+	{
+		return;
+	}
+
+	APawn* MyPawn = GetPawn();
+
+	if (Policy == ESimulatedPlayerPolicy::HoldPosition)
+	{
+		return;
+	}
+
+	if (Policy == ESimulatedPlayerPolicy::Patrol && PatrolPoints.Num() > 0)
+	{
+		MoveToLocation(PatrolPoints[PatrolIndex], 100.0f);
+		PatrolIndex = (PatrolIndex + 1) % PatrolPoints.Num();
+		return;
+	}
+
+	// Wander to a random spot nearby. Pick it from our own stream so runs with the same seed move the same
+	const FVector Offset(RandomStream.FRandRange(-WanderRadius, WanderRadius), RandomStream.FRandRange(-WanderRadius, WanderRadius), 0.0f);
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	FNavLocation NavLocation;
+	if (NavSys && NavSys->ProjectPointToNavigation(MyPawn->GetActorLocation() + Offset, NavLocation))
+	{
+		MoveToLocation(NavLocation.Location, 100.0f);
+	}
+}
+
+
+void ASSimulatedPlayerController::SetFiring(bool bNewFiring)
+{
+	if (bIsFiring == bNewFiring)
+	{
+		return;
+	}
+
+	bIsFiring = bNewFiring;
+
+	ASCharacter* MyCharacter = GetSimulatedCharacter();
+	if (MyCharacter)
+	{
+		if (bIsFiring)
+		{
+			MyCharacter->StartFire();
+		}
+		else
+		{
+			MyCharacter->StopFire();
+		}
+	}
+}
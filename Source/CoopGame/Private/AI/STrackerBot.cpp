@@ -11,6 +11,14 @@
 #include "SCharacter.h"
 #include "Components/SphereComponent.h"
 #include "Sound/SoundCue.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "SPerfCounters.h"
+#include "SAssetStreamer.h"
+#include "SCosmeticPolicy.h"
+#include "SMemoryTracker.h"
+#include "STickBudget.h"
+#include "CoopGame.h"
 
 static int32 DebugTrackerBotDrawing = 0;
 FAutoConsoleVariableRef CVARDebugTrackerBotDrawing(
@@ -20,6 +28,13 @@ FAutoConsoleVariableRef CVARDebugTrackerBotDrawing(
 	ECVF_Cheat);
 
 
+namespace
+{
+	// Longest gap between ticks one push makes up for, past that the bot just moves slower
+	const float MaxFramesPerPush = 16.0f;
+}
+
+
 // Sets default values
 ASTrackerBot::ASTrackerBot()
 {
@@ -49,6 +64,8 @@ ASTrackerBot::ASTrackerBot()
 	ExplosionRadius = 350;
 
 	SelfDamageInterval = 0.25f;
+
+	DamageScale = 1.0f;
 }
 
 // Called when the game starts or when spawned
@@ -65,20 +82,38 @@ void ASTrackerBot::BeginPlay()
 		FTimerHandle TimerHandle_CheckPowerLevel;
 		GetWorldTimerManager().SetTimer(TimerHandle_CheckPowerLevel, this, &ASTrackerBot::OnCheckNearbyBots, 1.0f, true);
 	}
+
+	FSMemoryTracker::Get().TrackActor(this, ECoopMemCategory::Bots);
+
+	FSTickBudget::Get().Register(this, ECoopTickClass::TrackerBots);
 }
 
 
-void ASTrackerBot::HandleTakeDamage(USHealthComponent* OwningHealthComp, float Health, float HealthDelta, const class UDamageType* DamageType, class AController* InstigatedBy, AActor* DamageCauser)
+UMaterialInstanceDynamic* ASTrackerBot::GetMaterialInstance()
 {
 	if (MatInst == nullptr)
 	{
+		COOP_LLM_SCOPE(ECoopMemCategory::Bots);
+
 		MatInst = MeshComp->CreateAndSetMaterialInstanceDynamicFromMaterial(0, MeshComp->GetMaterial(0));
+		FSMemoryTracker::Get().TrackObject(MatInst, ECoopMemCategory::Bots, ECoopMemKind::Material);
 	}
 
-	if (MatInst)
+	return MatInst;
+}
+
+
+void ASTrackerBot::HandleTakeDamage(USHealthComponent* OwningHealthComp, float Health, float HealthDelta, const class UDamageType* DamageType, class AController* InstigatedBy, AActor* DamageCauser)
+{
+#if COOP_WITH_COSMETICS
+	if (FSCosmeticPolicy::Get().ShouldPlay(this, ECoopCosmetic::Effect, TEXT("ASTrackerBot::DamageFlash")))
 	{
-		MatInst->SetScalarParameterValue("LastTimeDamageTaken", GetWorld()->TimeSeconds);
+		if (GetMaterialInstance())
+		{
+			MatInst->SetScalarParameterValue("LastTimeDamageTaken", GetWorld()->TimeSeconds);
+		}
 	}
+#endif
 
 	// Explode on hitpoints == 0
 	if (Health <= 0.0f)
@@ -90,6 +125,8 @@ void ASTrackerBot::HandleTakeDamage(USHealthComponent* OwningHealthComp, float H
 
 FVector ASTrackerBot::GetNextPathPoint()
 {
+	COOP_SCOPE_STAT(TrackerBotPath);
+
 	AActor* BestTarget = nullptr;
 	float NearestTargetDistance = FLT_MAX;
 
@@ -116,7 +153,11 @@ FVector ASTrackerBot::GetNextPathPoint()
 
 	if (BestTarget)
 	{
+		COOP_COUNT(PathQueries, 1);
+
+		COOP_LLM_SCOPE(ECoopMemCategory::NavPaths);
 		UNavigationPath* NavPath = UNavigationSystemV1::FindPathToActorSynchronously(this, GetActorLocation(), BestTarget);
+		FSMemoryTracker::Get().TrackObject(NavPath, ECoopMemCategory::NavPaths, ECoopMemKind::Object);
 
 		GetWorldTimerManager().ClearTimer(TimerHandle_RefreshPath);
 		GetWorldTimerManager().SetTimer(TimerHandle_RefreshPath, this, &ASTrackerBot::RefreshPath , 5.0f, false);
@@ -142,9 +183,25 @@ void ASTrackerBot::SelfDestruct()
 
 	bExploded = true;
 
-	UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplosionEffect, GetActorLocation());
+	COOP_SCOPE_STAT(TrackerBotSelfDestruct);
+	COOP_COUNT(SelfDestructs, 1);
+
+#if COOP_WITH_COSMETICS
+	FSAssetStreamer& Streamer = FSAssetStreamer::Get();
+	FSCosmeticPolicy& Cosmetics = FSCosmeticPolicy::Get();
 
-	UGameplayStatics::PlaySoundAtLocation(this, ExplodeSound, GetActorLocation());
+	if (Cosmetics.ShouldPlay(this, ECoopCosmetic::Effect, TEXT("ASTrackerBot::ExplosionEffect")))
+	{
+		COOP_LLM_SCOPE(ECoopMemCategory::FX);
+		UParticleSystemComponent* ExplosionComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), Streamer.GetIfLoaded(ExplosionEffect, TEXT("ASTrackerBot::ExplosionEffect")), GetActorLocation());
+		FSMemoryTracker::Get().TrackObject(ExplosionComp, ECoopMemCategory::FX, ECoopMemKind::Component);
+	}
+
+	if (Cosmetics.ShouldPlay(this, ECoopCosmetic::Sound, TEXT("ASTrackerBot::ExplodeSound")))
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, Streamer.GetIfLoaded(ExplodeSound, TEXT("ASTrackerBot::ExplodeSound")), GetActorLocation());
+	}
+#endif
 
 	MeshComp->SetVisibility(false, true);
 	MeshComp->SetCollisionEnabled(ECollisionEnabled::NoCollision);
@@ -155,7 +212,7 @@ void ASTrackerBot::SelfDestruct()
 		IgnoredActors.Add(this);
 
 		// Increase damage based on the power level (challenge code)
-		float ActualDamage = ExplosionDamage + (ExplosionDamage * PowerLevel);
+		float ActualDamage = (ExplosionDamage + (ExplosionDamage * PowerLevel)) * DamageScale;
 
 		// Apply Damage!
 		UGameplayStatics::ApplyRadialDamage(this, ActualDamage, GetActorLocation(), ExplosionRadius, nullptr, IgnoredActors, this, GetInstigatorController(), true);
@@ -180,6 +237,11 @@ void ASTrackerBot::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	COOP_SCOPE_TIME(TrackerBots);
+	COOP_SCOPE_STAT(TrackerBotTick);
+
+	FSTickBudget::Get().CountTick(ECoopTickClass::TrackerBots);
+
 	if (Role == ROLE_Authority && !bExploded)
 	{
 		float DistanceToTarget = (GetActorLocation() - NextPathPoint).Size();
@@ -199,7 +261,10 @@ void ASTrackerBot::Tick(float DeltaTime)
 			FVector ForceDirection = NextPathPoint - GetActorLocation();
 			ForceDirection.Normalize();
 
-			ForceDirection *= MovementForce;
+			// The force only lasts one physics step, far bots tick less often and push for all the frames in between
+			const float FramesSinceLastTick = FMath::Clamp(DeltaTime / FMath::Max(GetWorld()->GetDeltaSeconds(), KINDA_SMALL_NUMBER), 1.0f, MaxFramesPerPush);
+
+			ForceDirection *= MovementForce * FramesSinceLastTick;
 
 			MeshComp->AddForce(ForceDirection, NAME_None, bUseVelocityChange);
 
@@ -236,15 +301,47 @@ void ASTrackerBot::NotifyActorBeginOverlap(AActor* OtherActor)
 
 			bStartedSelfDestruction = true;
 
-			UGameplayStatics::SpawnSoundAttached(SelfDestructSound, RootComponent);
+#if COOP_WITH_COSMETICS
+			if (FSCosmeticPolicy::Get().ShouldPlay(this, ECoopCosmetic::Sound, TEXT("ASTrackerBot::SelfDestructSound")))
+			{
+				UGameplayStatics::SpawnSoundAttached(FSAssetStreamer::Get().GetIfLoaded(SelfDestructSound, TEXT("ASTrackerBot::SelfDestructSound")), RootComponent);
+			}
+#endif
 		}
 	}
 }
 
+void ASTrackerBot::SetDamageScale(float Scale)
+{
+	DamageScale = Scale;
+}
+
+
+void ASTrackerBot::GetCosmeticAssets(TArray<FSoftObjectPath>& OutAssets) const
+{
+#if COOP_WITH_COSMETICS
+	OutAssets.Add(ExplosionEffect.ToSoftObjectPath());
+	OutAssets.Add(SelfDestructSound.ToSoftObjectPath());
+	OutAssets.Add(ExplodeSound.ToSoftObjectPath());
+#endif
+}
+
+
+void ASTrackerBot::Serialize(FArchive& Ar)
+{
+	// Every soft reference of the bot is cosmetic
+	FSAssetStreamer::FCosmeticReferenceScope CosmeticScope(Ar);
+
+	Super::Serialize(Ar);
+}
+
 // CHALLENGE CODE
 
 void ASTrackerBot::OnCheckNearbyBots()
 {
+	COOP_SCOPE_TIME(TrackerBots);
+	COOP_SCOPE_STAT(TrackerBotNearbyBots);
+
 	// distance to check for nearby bots
 	const float Radius = 600;
 
@@ -260,6 +357,7 @@ void ASTrackerBot::OnCheckNearbyBots()
 
 	TArray<FOverlapResult> Overlaps;
 	GetWorld()->OverlapMultiByObjectType(Overlaps, GetActorLocation(), FQuat::Identity, QueryParams, CollShape);
+	COOP_COUNT(NearbyBotOverlaps, Overlaps.Num());
 
 	if (DebugTrackerBotDrawing)
 	{
@@ -284,22 +382,23 @@ void ASTrackerBot::OnCheckNearbyBots()
 	// Clamp between min=0 and max=4
 	PowerLevel = FMath::Clamp(NrOfBots, 0, MaxPowerLevel);
 
-	// Update the material color
-	if (MatInst == nullptr)
+#if COOP_WITH_COSMETICS
+	// Update the material color, a bot out of view catches up on the next check once it is seen again
+	if (FSCosmeticPolicy::Get().ShouldPlay(this, ECoopCosmetic::Effect, TEXT("ASTrackerBot::PowerLevelColor")))
 	{
-		MatInst = MeshComp->CreateAndSetMaterialInstanceDynamicFromMaterial(0, MeshComp->GetMaterial(0));
-	}
-	if (MatInst)
-	{
-		// Convert to a float between 0 and 1 just like an 'Alpha' value of a texture. Now the material can be set up without having to know the max power level 
-		// which can be tweaked many times by gameplay decisions (would mean we need to keep 2 places up to date)
-		float Alpha = PowerLevel / (float)MaxPowerLevel;
-		// Note: (float)MaxPowerLevel converts the int32 to a float, 
-		//	otherwise the following happens when dealing when dividing integers: 1 / 4 = 0 ('PowerLevel' int / 'MaxPowerLevel' int = 0 int)
-		//	this is a common programming problem and can be fixed by 'casting' the int (MaxPowerLevel) to a float before dividing.
-
-		MatInst->SetScalarParameterValue("PowerLevelAlpha", Alpha);
+		if (GetMaterialInstance())
+		{
+			// Convert to a float between 0 and 1 just like an 'Alpha' value of a texture. Now the material can be set up without having to know the max power level 
+			// which can be tweaked many times by gameplay decisions (would mean we need to keep 2 places up to date)
+			float Alpha = PowerLevel / (float)MaxPowerLevel;
+			// Note: (float)MaxPowerLevel converts the int32 to a float, 
+			//	otherwise the following happens when dealing when dividing integers: 1 / 4 = 0 ('PowerLevel' int / 'MaxPowerLevel' int = 0 int)
+			//	this is a common programming problem and can be fixed by 'casting' the int (MaxPowerLevel) to a float before dividing.
+
+			MatInst->SetScalarParameterValue("PowerLevelAlpha", Alpha);
+		}
 	}
+#endif
 
 	if (DebugTrackerBotDrawing)
 	{
@@ -310,6 +409,8 @@ void ASTrackerBot::OnCheckNearbyBots()
 
 void ASTrackerBot::RefreshPath()
 {
+	COOP_SCOPE_TIME(TrackerBots);
+
 	NextPathPoint = GetNextPathPoint();
 }
 
@@ -2,7 +2,12 @@
 
 #include "SExplosiveBarrel.h"
 #include "SHealthComponent.h"
+#include "SAssetStreamer.h"
+#include "SCosmeticPolicy.h"
+#include "SMemoryTracker.h"
+#include "CoopGame.h"
 #include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystemComponent.h"
 #include "PhysicsEngine/RadialForceComponent.h"
 #include "Net/UnrealNetwork.h"
 
@@ -12,6 +17,7 @@ ASExplosiveBarrel::ASExplosiveBarrel()
 {
 	HealthComp = CreateDefaultSubobject<USHealthComponent>(TEXT("HealthComp"));
 	HealthComp->OnHealthChanged.AddDynamic(this, &ASExplosiveBarrel::OnHealthChanged);
+	HealthComp->bReplicateStateOnly = true;
 
 	MeshComp = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("MeshComp"));
 	MeshComp->SetSimulatePhysics(true);
@@ -33,6 +39,29 @@ ASExplosiveBarrel::ASExplosiveBarrel()
 }
 
 
+void ASExplosiveBarrel::BeginPlay()
+{
+	Super::BeginPlay();
+
+#if COOP_WITH_COSMETICS
+	// Every barrel of the class shares the group, so only the first one requests it
+	TArray<FSoftObjectPath> CosmeticAssets;
+	CosmeticAssets.Add(ExplosionEffect.ToSoftObjectPath());
+	CosmeticAssets.Add(ExplodedMaterial.ToSoftObjectPath());
+	FSAssetStreamer::Get().Preload(GetClass()->GetFName(), CosmeticAssets, true, nullptr);
+#endif
+}
+
+
+void ASExplosiveBarrel::Serialize(FArchive& Ar)
+{
+	// Every soft reference of the barrel is cosmetic
+	FSAssetStreamer::FCosmeticReferenceScope CosmeticScope(Ar);
+
+	Super::Serialize(Ar);
+}
+
+
 void ASExplosiveBarrel::OnHealthChanged(USHealthComponent* OwningHealthComp, float Health, float HealthDelta, const class UDamageType* DamageType,
 	class AController* InstigatedBy, AActor* DamageCauser)
 {
@@ -62,10 +91,27 @@ void ASExplosiveBarrel::OnHealthChanged(USHealthComponent* OwningHealthComp, flo
 
 void ASExplosiveBarrel::OnRep_Exploded()
 {
+#if COOP_WITH_COSMETICS
+	FSAssetStreamer& Streamer = FSAssetStreamer::Get();
+	FSCosmeticPolicy& Cosmetics = FSCosmeticPolicy::Get();
+
 	// Play FX and change self material to black
-	UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplosionEffect, GetActorLocation());
-	// Override material on mesh with blackened version
-	MeshComp->SetMaterial(0, ExplodedMaterial);
+	if (Cosmetics.ShouldPlay(this, ECoopCosmetic::Effect, TEXT("ASExplosiveBarrel::ExplosionEffect")))
+	{
+		COOP_LLM_SCOPE(ECoopMemCategory::FX);
+		UParticleSystemComponent* ExplosionComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), Streamer.GetIfLoaded(ExplosionEffect, TEXT("ASExplosiveBarrel::ExplosionEffect")), GetActorLocation());
+		FSMemoryTracker::Get().TrackObject(ExplosionComp, ECoopMemCategory::FX, ECoopMemKind::Component);
+	}
+	// Override material on mesh with blackened version, it stays that way so even a barrel out of view gets it
+	if (Cosmetics.ShouldPlay(this, ECoopCosmetic::State, TEXT("ASExplosiveBarrel::ExplodedMaterial")))
+	{
+		UMaterialInterface* LoadedExplodedMaterial = Streamer.GetIfLoaded(ExplodedMaterial, TEXT("ASExplosiveBarrel::ExplodedMaterial"));
+		if (LoadedExplodedMaterial)
+		{
+			MeshComp->SetMaterial(0, LoadedExplodedMaterial);
+		}
+	}
+#endif
 }
 
 
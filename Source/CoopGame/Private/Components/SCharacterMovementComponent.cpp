@@ -0,0 +1,243 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SCharacterMovementComponent.h"
+#include "CoopGame.h"
+#include "STelemetry.h"
+#include "SGameState.h"
+#include "SStatusEffectComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+
+
+namespace
+{
+	// Custom flags of the compressed move
+	const uint8 FlagSprint = FSavedMove_Character::FLAG_Custom_0;
+	const uint8 FlagAim = FSavedMove_Character::FLAG_Custom_1;
+
+	// Mouse and stick input wobbles a little every frame, stock only combines moves with practically identical acceleration
+	const float CombineAccelDotThreshold = 0.99f;
+	const float CombineMaxSpeedThreshold = 20.0f;
+}
+
+
+USCharacterMovementComponent::USCharacterMovementComponent()
+{
+	SprintSpeedMultiplier = 1.6f;
+	AimSpeedMultiplier = 1.0f;
+
+	bWantsToSprint = false;
+	bWantsToAim = false;
+
+	NrOfCheckedMoves = 0;
+	NrOfCorrections = 0;
+	MaxCorrectionError = 0.0f;
+}
+
+
+float USCharacterMovementComponent::GetMaxSpeed() const
+{
+	float MaxSpeed = Super::GetMaxSpeed();
+
+	if (MovementMode == MOVE_Walking && !IsCrouching())
+	{
+		if (bWantsToAim)
+		{
+			MaxSpeed *= AimSpeedMultiplier;
+		}
+		else if (bWantsToSprint)
+		{
+			MaxSpeed *= SprintSpeedMultiplier;
+		}
+
+		// Powerups go through the replicated effect list instead of MaxWalkSpeed, which only the server would see
+		const ASGameState* GS = GetWorld()->GetGameState<ASGameState>();
+		if (GS && GS->GetStatusEffects())
+		{
+			MaxSpeed *= GS->GetStatusEffects()->GetSpeedMultiplier(CharacterOwner);
+		}
+	}
+
+	return MaxSpeed;
+}
+
+
+FNetworkPredictionData_Client* USCharacterMovementComponent::GetPredictionData_Client() const
+{
+	if (ClientPredictionData == nullptr)
+	{
+		USCharacterMovementComponent* MutableThis = const_cast<USCharacterMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new FSNetworkPredictionData_Client_Character(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+
+void USCharacterMovementComponent::SetWantsToSprint(bool bNewWantsToSprint)
+{
+	bWantsToSprint = bNewWantsToSprint;
+}
+
+
+void USCharacterMovementComponent::SetWantsToAim(bool bNewWantsToAim)
+{
+	bWantsToAim = bNewWantsToAim;
+}
+
+
+bool USCharacterMovementComponent::WantsToAim() const
+{
+	return bWantsToAim;
+}
+
+
+bool USCharacterMovementComponent::IsSprinting() const
+{
+	return bWantsToSprint && !bWantsToAim && !IsCrouching() && IsMovingOnGround() && Velocity.SizeSquared2D() > KINDA_SMALL_NUMBER;
+}
+
+
+int32 USCharacterMovementComponent::GetNumCheckedMoves() const
+{
+	return NrOfCheckedMoves;
+}
+
+
+int32 USCharacterMovementComponent::GetNumCorrections() const
+{
+	return NrOfCorrections;
+}
+
+
+void USCharacterMovementComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (NrOfCheckedMoves > 0)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Movement: %s had %d corrections in %d moves (%.2f%%), largest error %.1f"),
+			*GetNameSafe(CharacterOwner), NrOfCorrections, NrOfCheckedMoves, 100.0f * NrOfCorrections / NrOfCheckedMoves, MaxCorrectionError);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+
+void USCharacterMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	bWantsToSprint = (Flags & FlagSprint) != 0;
+	bWantsToAim = (Flags & FlagAim) != 0;
+}
+
+
+bool USCharacterMovementComponent::ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientLoc,
+	const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+	const bool bNeedsCorrection = Super::ServerCheckClientError(ClientTimeStamp, DeltaTime, Accel, ClientLoc, RelativeClientLocation,
+		ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+
+	NrOfCheckedMoves++;
+
+	if (bNeedsCorrection)
+	{
+		// World space, so it overstates the error a little on moving bases
+		const float Error = FVector::Dist(UpdatedComponent->GetComponentLocation(), ClientLoc);
+
+		NrOfCorrections++;
+		MaxCorrectionError = FMath::Max(MaxCorrectionError, Error);
+
+		COOP_TELEMETRY(Correction, CharacterOwner, nullptr, Error, NrOfCorrections);
+	}
+
+	return bNeedsCorrection;
+}
+
+
+FSSavedMove_Character::FSSavedMove_Character()
+{
+	AccelDotThresholdCombine = CombineAccelDotThreshold;
+	MaxSpeedThresholdCombine = CombineMaxSpeedThreshold;
+
+	bSavedWantsToSprint = false;
+	bSavedWantsToAim = false;
+}
+
+
+void FSSavedMove_Character::Clear()
+{
+	Super::Clear();
+
+	bSavedWantsToSprint = false;
+	bSavedWantsToAim = false;
+}
+
+
+uint8 FSSavedMove_Character::GetCompressedFlags() const
+{
+	uint8 Flags = Super::GetCompressedFlags();
+
+	if (bSavedWantsToSprint)
+	{
+		Flags |= FlagSprint;
+	}
+	if (bSavedWantsToAim)
+	{
+		Flags |= FlagAim;
+	}
+
+	return Flags;
+}
+
+
+bool FSSavedMove_Character::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
+{
+	const FSSavedMove_Character* NewSMove = static_cast<const FSSavedMove_Character*>(NewMove.Get());
+
+	// A combined move has one set of flags, so the speed change has to start a new one
+	if (bSavedWantsToSprint != NewSMove->bSavedWantsToSprint || bSavedWantsToAim != NewSMove->bSavedWantsToAim)
+	{
+		return false;
+	}
+
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+
+void FSSavedMove_Character::SetMoveFor(ACharacter* Character, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
+{
+	Super::SetMoveFor(Character, InDeltaTime, NewAccel, ClientData);
+
+	const USCharacterMovementComponent* MoveComp = Cast<USCharacterMovementComponent>(Character->GetCharacterMovement());
+	if (MoveComp)
+	{
+		bSavedWantsToSprint = MoveComp->bWantsToSprint;
+		bSavedWantsToAim = MoveComp->bWantsToAim;
+	}
+}
+
+
+void FSSavedMove_Character::PrepMoveFor(ACharacter* Character)
+{
+	Super::PrepMoveFor(Character);
+
+	// Replaying moves after a correction has to use the speed they were made with
+	USCharacterMovementComponent* MoveComp = Cast<USCharacterMovementComponent>(Character->GetCharacterMovement());
+	if (MoveComp)
+	{
+		MoveComp->bWantsToSprint = bSavedWantsToSprint;
+		MoveComp->bWantsToAim = bSavedWantsToAim;
+	}
+}
+
+
+FSNetworkPredictionData_Client_Character::FSNetworkPredictionData_Client_Character(const UCharacterMovementComponent& ClientMovement)
+	: Super(ClientMovement)
+{
+}
+
+
+FSavedMovePtr FSNetworkPredictionData_Client_Character::AllocateNewMove()
+{
+	return FSavedMovePtr(new FSSavedMove_Character());
+}
@@ -1,8 +1,18 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "SHealthComponent.h"
+#include "CoopGame.h"
 #include "SGameMode.h"
 #include "Net/UnrealNetwork.h"
+#include "SPerfCounters.h"
+#include "STelemetry.h"
+
+
+namespace
+{
+	// Steps per hit point of the health replicated to the owner
+	const float HealthQuantization = 10.0f;
+}
 
 
 // Sets default values for this component's properties
@@ -13,6 +23,22 @@ USHealthComponent::USHealthComponent()
 
 	TeamNum = 255;
 
+	NrOfHealthBuckets = 20;
+	bReplicateStateOnly = false;
+	CriticalHealthFraction = 0.25f;
+	QuantizedHealth = 0;
+	HealthBucket = 0;
+	bReceivedReplicatedHealth = false;
+
+	bBroadcastEveryHit = false;
+	PendingHealthDelta = 0.0f;
+	bHealthChangePending = false;
+
+	// Sends coalesced health changes after the frame's gameplay (actor ticks, physics and timers) ran
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+
 	SetIsReplicated(true);
 }
 
@@ -32,26 +58,107 @@ void USHealthComponent::BeginPlay()
 		}
 	}
 
-	Health = DefaultHealth;
+	if (!bReceivedReplicatedHealth)
+	{
+		Health = DefaultHealth;
+	}
+
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		UpdateReplicatedHealth();
+	}
+}
+
+
+void USHealthComponent::OnRep_QuantizedHealth()
+{
+	SetReplicatedHealth(QuantizedHealth / HealthQuantization);
+}
+
+
+void USHealthComponent::OnRep_HealthBucket()
+{
+	float NewHealth = 0.0f;
+
+	if (bReplicateStateOnly)
+	{
+		// Somewhere inside the range of the state, so GetHealthState gives the same answer as on the server
+		switch ((EHealthState)HealthBucket)
+		{
+		case EHealthState::Healthy:		NewHealth = DefaultHealth; break;
+		case EHealthState::Damaged:		NewHealth = DefaultHealth * (1.0f + CriticalHealthFraction) * 0.5f; break;
+		case EHealthState::Critical:	NewHealth = DefaultHealth * CriticalHealthFraction * 0.5f; break;
+		default:						NewHealth = 0.0f; break;
+		}
+	}
+	else
+	{
+		NewHealth = DefaultHealth * HealthBucket / NrOfHealthBuckets;
+	}
+
+	SetReplicatedHealth(NewHealth);
 }
 
 
-void USHealthComponent::OnRep_Health(float OldHealth)
+void USHealthComponent::SetReplicatedHealth(float NewHealth)
 {
-	float Damage = Health - OldHealth;
+	bReceivedReplicatedHealth = true;
+
+	const float OldHealth = Health;
+	Health = NewHealth;
+
+	// The initial replication usually matches what BeginPlay set, nothing happened
+	if (Health != OldHealth)
+	{
+		float Damage = Health - OldHealth;
+
+		OnHealthChanged.Broadcast(this, Health, Damage, nullptr, nullptr, nullptr);
+	}
+}
+
+
+void USHealthComponent::UpdateReplicatedHealth()
+{
+	const uint16 NewQuantizedHealth = (uint16)FMath::Clamp(FMath::RoundToInt(Health * HealthQuantization), 0, (int32)MAX_uint16);
+
+	uint8 NewHealthBucket = 0;
+	if (bReplicateStateOnly)
+	{
+		NewHealthBucket = (uint8)GetHealthState();
+	}
+	else if (Health > 0.0f && DefaultHealth > 0.0f)
+	{
+		// Rounded up, so only dead is 0
+		NewHealthBucket = (uint8)FMath::Clamp(FMath::CeilToInt(Health / DefaultHealth * NrOfHealthBuckets), 1, (int32)NrOfHealthBuckets);
+	}
 
-	OnHealthChanged.Broadcast(this, Health, Damage, nullptr, nullptr, nullptr);
+	if (NewQuantizedHealth == QuantizedHealth && NewHealthBucket == HealthBucket)
+	{
+		return;
+	}
+
+	QuantizedHealth = NewQuantizedHealth;
+	HealthBucket = NewHealthBucket;
+
+	// Without a push model to mark the properties dirty, ask for the owner to be considered this frame instead of
+	// waiting for its next regular net update
+	GetOwner()->ForceNetUpdate();
 }
 
 
 void USHealthComponent::HandleTakeAnyDamage(AActor* DamagedActor, float Damage, const class UDamageType* DamageType, class AController* InstigatedBy,
 	AActor* DamageCauser)
 {
+	COOP_SCOPE_TIME(Health);
+	COOP_SCOPE_STAT(HealthDamage);
+
 	if (Damage <= 0.0f || bIsDead)
 	{
 		return;
 	}
 
+	COOP_COUNT(DamageEvents, 1);
+
 	if (DamageCauser != DamagedActor && IsFriendly(DamagedActor, DamageCauser))
 	{
 		//Uncomment if you want to disable friendly fire
@@ -61,14 +168,26 @@ void USHealthComponent::HandleTakeAnyDamage(AActor* DamagedActor, float Damage,
 	// Update health clamped
 	Health = FMath::Clamp(Health - Damage, 0.0f, DefaultHealth);
 
-	UE_LOG(LogTemp, Log, TEXT("Health Changed: %s"), *FString::SanitizeFloat(Health));
+	UE_LOG(LogCoopDamage, Verbose, TEXT("%s took %.1f damage, %.1f left"), *GetNameSafe(GetOwner()), Damage, Health);
 
 	bIsDead = Health <= 0.0f;
 
-	OnHealthChanged.Broadcast(this, Health, Damage, DamageType, InstigatedBy, DamageCauser);
+	UpdateReplicatedHealth();
+
+	COOP_TELEMETRY(Damage, DamageCauser, GetOwner(), Damage, FMath::RoundToInt(Health));
+
+	QueueHealthChanged(Damage, DamageType, InstigatedBy, DamageCauser);
 
+	// Death handling (ragdoll, unpossess, game over checks) can't wait for the end of the frame
 	if (bIsDead)
 	{
+		if (bHealthChangePending)
+		{
+			BroadcastPendingHealthChange();
+		}
+
+		COOP_TELEMETRY(Kill, DamageCauser, GetOwner(), 0.0f);
+
 		ASGameMode* GM = Cast<ASGameMode>(GetWorld()->GetAuthGameMode());
 		if (GM)
 		{
@@ -86,10 +205,85 @@ void USHealthComponent::Heal(float HealAmount)
 	}
 
 	Health = FMath::Clamp(Health + HealAmount, 0.0f, DefaultHealth);
+	UpdateReplicatedHealth();
+
+	UE_LOG(LogCoopDamage, Verbose, TEXT("%s healed %.1f, %.1f left"), *GetNameSafe(GetOwner()), HealAmount, Health);
+
+	QueueHealthChanged(-HealAmount, nullptr, nullptr, nullptr);
+}
+
+
+void USHealthComponent::QueueHealthChanged(float HealthDelta, const UDamageType* DamageType, AController* InstigatedBy, AActor* DamageCauser)
+{
+	if (bBroadcastEveryHit)
+	{
+		OnHealthChanged.Broadcast(this, Health, HealthDelta, DamageType, InstigatedBy, DamageCauser);
+		return;
+	}
 
-	UE_LOG(LogTemp, Log, TEXT("Health Changed: %s (+%s)"), *FString::SanitizeFloat(Health), *FString::SanitizeFloat(HealAmount));
+	PendingHealthDelta += HealthDelta;
+	PendingDamageType = DamageType;
+	PendingInstigatedBy = InstigatedBy;
+	PendingDamageCauser = DamageCauser;
 
-	OnHealthChanged.Broadcast(this, Health, -HealAmount, nullptr, nullptr, nullptr);
+	// Automatic fire into a horde hits the same component many times a frame, listeners only need to hear it once
+	if (!bHealthChangePending)
+	{
+		bHealthChangePending = true;
+		SetComponentTickEnabled(true);
+	}
+}
+
+
+void USHealthComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (bHealthChangePending)
+	{
+		BroadcastPendingHealthChange();
+	}
+
+	// A listener may have queued another change, that one goes out next frame
+	if (!bHealthChangePending)
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
+
+void USHealthComponent::BroadcastPendingHealthChange()
+{
+	const float HealthDelta = PendingHealthDelta;
+	const UDamageType* DamageType = PendingDamageType;
+	AController* InstigatedBy = PendingInstigatedBy;
+	AActor* DamageCauser = PendingDamageCauser;
+
+	// Reset first, listeners may deal damage themselves (eg. exploding bots)
+	bHealthChangePending = false;
+	PendingHealthDelta = 0.0f;
+	PendingDamageType = nullptr;
+	PendingInstigatedBy = nullptr;
+	PendingDamageCauser = nullptr;
+
+	OnHealthChanged.Broadcast(this, Health, HealthDelta, DamageType, InstigatedBy, DamageCauser);
+}
+
+
+void USHealthComponent::ScaleMaxHealth(float Scale)
+{
+	if (Scale <= 0.0f)
+	{
+		return;
+	}
+
+	DefaultHealth *= Scale;
+	Health *= Scale;
+
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		UpdateReplicatedHealth();
+	}
 }
 
 
@@ -120,9 +314,27 @@ float USHealthComponent::GetHealth() const
 }
 
 
+EHealthState USHealthComponent::GetHealthState() const
+{
+	if (Health <= 0.0f)
+	{
+		return EHealthState::Dead;
+	}
+
+	if (Health <= DefaultHealth * CriticalHealthFraction)
+	{
+		return EHealthState::Critical;
+	}
+
+	return Health < DefaultHealth ? EHealthState::Damaged : EHealthState::Healthy;
+}
+
+
 void USHealthComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(USHealthComponent, Health);
+	// Exact values matter only to the owner's HUD, everybody else gets a health bar's worth
+	DOREPLIFETIME_CONDITION(USHealthComponent, QuantizedHealth, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(USHealthComponent, HealthBucket, COND_SkipOwner);
 }
\ No newline at end of file
@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SLoadGovernorComponent.h"
+#include "SGameMode.h"
+#include "SHealthComponent.h"
+#include "STrackerBot.h"
+#include "CoopGame.h"
+#include "SPerfCounters.h"
+#include "STelemetry.h"
+#include "Engine/Engine.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+
+
+// Sets default values for this component's properties
+USLoadGovernorComponent::USLoadGovernorComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickInterval = 0.5f;
+
+	// Live bots, spawn interval, cosmetics, bot health, bot damage
+	Levels.Add(FSGovernorLevel(1.0f, 1.0f, 1.0f, 1.0f, 1.0f));
+	Levels.Add(FSGovernorLevel(0.85f, 1.25f, 0.75f, 1.1f, 1.1f));
+	Levels.Add(FSGovernorLevel(0.7f, 1.5f, 0.5f, 1.25f, 1.2f));
+	Levels.Add(FSGovernorLevel(0.55f, 2.0f, 0.35f, 1.45f, 1.35f));
+	Levels.Add(FSGovernorLevel(0.4f, 3.0f, 0.25f, 1.7f, 1.5f));
+
+	MaxLiveBots = 40;
+	TargetFrameMs = 0.0f;
+	BudgetFraction = 0.8f;
+	TargetNetSaturation = 0.9f;
+	RelaxPressure = 0.7f;
+	SamplesToThrottle = 2;
+	SamplesToRelax = 10;
+
+	ThrottleLevel = 0;
+	SamplesOverBudget = 0;
+	SamplesUnderBudget = 0;
+	LiveBots = 0;
+	LastSampleFrame = 0;
+	CosmeticAccumulator = 0.0f;
+}
+
+
+void USLoadGovernorComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	LastSampleFrame = FSPerfCounters::Get().GetFrameCounter();
+
+	if (Levels.Num() == 0)
+	{
+		Levels.AddDefaulted();
+	}
+}
+
+
+void USLoadGovernorComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	LiveBots = CountLiveBots();
+
+	const float GameThreadMs = SampleGameThreadMs();
+	const float NetSaturation = SampleNetSaturation();
+
+	// Whichever of cpu and bandwidth is closest to its limit decides
+	const float Pressure = FMath::Max(GameThreadMs / GetTargetFrameMs(), NetSaturation / TargetNetSaturation);
+
+	if (Pressure > 1.0f)
+	{
+		SamplesOverBudget++;
+		SamplesUnderBudget = 0;
+	}
+	else if (Pressure < RelaxPressure)
+	{
+		SamplesUnderBudget++;
+		SamplesOverBudget = 0;
+	}
+	else
+	{
+		// Inside the band, hold the level
+		SamplesOverBudget = 0;
+		SamplesUnderBudget = 0;
+	}
+
+	// Throttle quickly, relax slowly, so the level doesn't flap with every wave
+	if (SamplesOverBudget >= SamplesToThrottle && ThrottleLevel < Levels.Num() - 1)
+	{
+		SetThrottleLevel(ThrottleLevel + 1, Pressure, GameThreadMs, NetSaturation);
+	}
+	else if (SamplesUnderBudget >= SamplesToRelax && ThrottleLevel > 0)
+	{
+		SetThrottleLevel(ThrottleLevel - 1, Pressure, GameThreadMs, NetSaturation);
+	}
+}
+
+
+bool USLoadGovernorComponent::CanSpawnBot() const
+{
+	return LiveBots < GetLiveBotCap();
+}
+
+
+void USLoadGovernorComponent::OnBotSpawned(APawn* Bot)
+{
+	LiveBots++;
+
+	if (Bot == nullptr || ThrottleLevel == 0)
+	{
+		return;
+	}
+
+	const FSGovernorLevel& Level = Levels[ThrottleLevel];
+
+	USHealthComponent* HealthComp = Cast<USHealthComponent>(Bot->GetComponentByClass(USHealthComponent::StaticClass()));
+	if (HealthComp)
+	{
+		HealthComp->ScaleMaxHealth(Level.BotHealthScale);
+	}
+
+	ASTrackerBot* TrackerBot = Cast<ASTrackerBot>(Bot);
+	if (TrackerBot)
+	{
+		TrackerBot->SetDamageScale(Level.BotDamageScale);
+	}
+}
+
+
+float USLoadGovernorComponent::GetSpawnIntervalScale() const
+{
+	return Levels[ThrottleLevel].SpawnIntervalScale;
+}
+
+
+bool USLoadGovernorComponent::ShouldReplicateCosmetic()
+{
+	// Evenly spaced instead of random, 0.5 replicates every other update
+	CosmeticAccumulator += Levels[ThrottleLevel].CosmeticReplicationRatio;
+	if (CosmeticAccumulator >= 1.0f)
+	{
+		CosmeticAccumulator -= 1.0f;
+		return true;
+	}
+
+	return false;
+}
+
+
+int32 USLoadGovernorComponent::GetThrottleLevel() const
+{
+	return ThrottleLevel;
+}
+
+
+int32 USLoadGovernorComponent::GetLiveBotCap() const
+{
+	// Unthrottled means the waves spawn exactly what they did without the governor
+	if (ThrottleLevel == 0)
+	{
+		return MAX_int32;
+	}
+
+	return FMath::Max(FMath::RoundToInt(MaxLiveBots * Levels[ThrottleLevel].LiveBotScale), 1);
+}
+
+
+float USLoadGovernorComponent::GetTargetFrameMs() const
+{
+	if (TargetFrameMs > 0.0f)
+	{
+		return TargetFrameMs;
+	}
+
+	// Dedicated servers are limited by NetServerMaxTickRate
+	float TickRate = GEngine ? GEngine->GetMaxTickRate(0.0f, false) : 0.0f;
+	if (TickRate <= 0.0f)
+	{
+		TickRate = 60.0f;
+	}
+
+	return BudgetFraction * 1000.0f / TickRate;
+}
+
+
+float USLoadGovernorComponent::SampleGameThreadMs()
+{
+	FSPerfCounters& PerfCounters = FSPerfCounters::Get();
+
+	const uint64 FrameCounter = PerfCounters.GetFrameCounter();
+	const int32 NrOfFrames = (int32)FMath::Min<uint64>(FrameCounter - LastSampleFrame, FSPerfCounters::HistorySize);
+	LastSampleFrame = FrameCounter;
+
+	if (NrOfFrames <= 0)
+	{
+		return 0.0f;
+	}
+
+	TArray<FSFramePerf> Frames;
+	PerfCounters.GetHistory(Frames, NrOfFrames);
+
+	// Work time only, a tick rate limited server that has nothing to do samples close to 0
+	float TotalMs = 0.0f;
+	for (const FSFramePerf& Frame : Frames)
+	{
+		TotalMs += Frame.GameThreadMs;
+	}
+
+	return Frames.Num() > 0 ? TotalMs / Frames.Num() : 0.0f;
+}
+
+
+float USLoadGovernorComponent::SampleNetSaturation() const
+{
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (NetDriver == nullptr)
+	{
+		return 0.0f;
+	}
+
+	// The busiest connection is the one players notice
+	float MaxSaturation = 0.0f;
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (Connection && Connection->CurrentNetSpeed > 0)
+		{
+			MaxSaturation = FMath::Max(MaxSaturation, (float)Connection->OutBytesPerSecond / Connection->CurrentNetSpeed);
+		}
+	}
+
+	return MaxSaturation;
+}
+
+
+int32 USLoadGovernorComponent::CountLiveBots() const
+{
+	int32 Count = 0;
+	for (FConstPawnIterator It = GetWorld()->GetPawnIterator(); It; ++It)
+	{
+		APawn* TestPawn = It->Get();
+		if (TestPawn == nullptr || ASGameMode::IsPlayer(TestPawn->GetController()))
+		{
+			continue;
+		}
+
+		USHealthComponent* HealthComp = Cast<USHealthComponent>(TestPawn->GetComponentByClass(USHealthComponent::StaticClass()));
+		if (HealthComp && HealthComp->GetHealth() > 0.0f)
+		{
+			Count++;
+		}
+	}
+
+	return Count;
+}
+
+
+void USLoadGovernorComponent::SetThrottleLevel(int32 NewLevel, float Pressure, float GameThreadMs, float NetSaturation)
+{
+	const int32 OldLevel = ThrottleLevel;
+
+	ThrottleLevel = NewLevel;
+	SamplesOverBudget = 0;
+	SamplesUnderBudget = 0;
+
+	UE_LOG(LogCoopGame, Log, TEXT("Governor: level %d -> %d, pressure %.2f (game thread %.2f / %.2f ms, net %.0f%% / %.0f%%), live bots %d, cap %d, spawn interval x%.2f"),
+		OldLevel, NewLevel, Pressure, GameThreadMs, GetTargetFrameMs(), NetSaturation * 100.0f, TargetNetSaturation * 100.0f,
+		LiveBots, GetLiveBotCap(), GetSpawnIntervalScale());
+
+	COOP_TELEMETRY(Governor, GetOwner(), nullptr, Pressure, NewLevel);
+}
@@ -0,0 +1,307 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SSpawnPointCacheComponent.h"
+#include "CoopGame.h"
+#include "SPerfCounters.h"
+#include "SDeterminism.h"
+#include "EngineUtils.h"
+#include "Engine/TargetPoint.h"
+#include "Engine/World.h"
+#include "SGameMode.h"
+#include "GameFramework/Pawn.h"
+#include "NavigationSystem/Public/NavigationSystem.h"
+
+
+// Sets default values for this component's properties
+USSpawnPointCacheComponent::USSpawnPointCacheComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickInterval = 0.1f;
+
+	SamplesPerTargetPoint = 8;
+	SampleRadius = 600.0f;
+	MinPlayerDistance = 1500.0f;
+	MaxVisibilityDistance = 6000.0f;
+	MaxTracesPerRefresh = 32;
+	GridCellSize = 1500.0f;
+
+	RefreshCursor = 0;
+	RefreshId = 0;
+	bIsBuilt = false;
+}
+
+
+void USSpawnPointCacheComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	BuildCache();
+}
+
+
+void USSpawnPointCacheComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	COOP_SCOPE_TIME(Spawning);
+
+	// Navmesh may not have been ready at BeginPlay
+	if (!bIsBuilt)
+	{
+		BuildCache();
+		return;
+	}
+
+	RefreshBuckets();
+}
+
+
+bool USSpawnPointCacheComponent::IsBuilt() const
+{
+	return bIsBuilt;
+}
+
+
+int32 USSpawnPointCacheComponent::GetNumSpawnPoints() const
+{
+	return SpawnPoints.Num();
+}
+
+
+void USSpawnPointCacheComponent::BuildCache()
+{
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (NavSys == nullptr || NavSys->GetDefaultNavDataInstance() == nullptr)
+	{
+		return;
+	}
+
+	SpawnPoints.Reset();
+	RegionNames.Reset();
+	RegionBuckets.Reset();
+	AllBuckets = FBucketSet();
+	SpatialGrid.Reset();
+
+	for (TActorIterator<ATargetPoint> It(GetWorld()); It; ++It)
+	{
+		ATargetPoint* TargetPoint = *It;
+
+		// The first tag names the region, untagged points only take part in "any region" picks
+		FName Region = TargetPoint->Tags.Num() > 0 ? TargetPoint->Tags[0] : NAME_None;
+		int32 RegionIndex = RegionNames.AddUnique(Region);
+		if (RegionIndex >= RegionBuckets.Num())
+		{
+			RegionBuckets.AddDefaulted();
+		}
+
+		const FRotator Rotation = TargetPoint->GetActorRotation();
+
+		FNavLocation NavLocation;
+		if (NavSys->ProjectPointToNavigation(TargetPoint->GetActorLocation(), NavLocation))
+		{
+			AddSpawnPoint(NavLocation.Location, Rotation, RegionIndex);
+		}
+
+		for (int32 i = 0; i < SamplesPerTargetPoint; i++)
+		{
+			if (NavSys->GetRandomReachablePointInRadius(TargetPoint->GetActorLocation(), SampleRadius, NavLocation))
+			{
+				AddSpawnPoint(NavLocation.Location, Rotation, RegionIndex);
+			}
+		}
+	}
+
+	bIsBuilt = true;
+
+	UE_LOG(LogCoopGame, Log, TEXT("Spawn point cache: %d points in %d regions"), SpawnPoints.Num(), RegionNames.Num());
+}
+
+
+void USSpawnPointCacheComponent::AddSpawnPoint(const FVector& Location, const FRotator& Rotation, int32 RegionIndex)
+{
+	const int32 PointIndex = SpawnPoints.AddUninitialized();
+
+	FSpawnPoint& Point = SpawnPoints[PointIndex];
+	// Navmesh sits on the floor, lift the spawn a little so bots don't start inside it
+	Point.Location = Location + FVector(0.0f, 0.0f, 50.0f);
+	Point.Rotation = Rotation;
+	Point.RegionIndex = RegionIndex;
+	Point.NearStamp = INDEX_NONE;
+
+	// Start out visible until the first line of sight refresh says otherwise
+	Point.Bucket = ESpawnPointBucket::Visible;
+	Point.SlotInRegion = RegionBuckets[RegionIndex].Points[(int32)Point.Bucket].Add(PointIndex);
+	Point.SlotInAll = AllBuckets.Points[(int32)Point.Bucket].Add(PointIndex);
+
+	SpatialGrid.FindOrAdd(GetGridCell(Point.Location)).Add(PointIndex);
+}
+
+
+FIntVector USSpawnPointCacheComponent::GetGridCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / GridCellSize),
+		FMath::FloorToInt(Location.Y / GridCellSize),
+		FMath::FloorToInt(Location.Z / GridCellSize));
+}
+
+
+void USSpawnPointCacheComponent::MoveToBucket(int32 PointIndex, ESpawnPointBucket NewBucket)
+{
+	FSpawnPoint& Point = SpawnPoints[PointIndex];
+	if (Point.Bucket == NewBucket)
+	{
+		return;
+	}
+
+	// Swap-remove from the old buckets and patch up the slot of the point that took our place
+	TArray<int32>& OldRegion = RegionBuckets[Point.RegionIndex].Points[(int32)Point.Bucket];
+	OldRegion.RemoveAtSwap(Point.SlotInRegion, 1, false);
+	if (OldRegion.IsValidIndex(Point.SlotInRegion))
+	{
+		SpawnPoints[OldRegion[Point.SlotInRegion]].SlotInRegion = Point.SlotInRegion;
+	}
+
+	TArray<int32>& OldAll = AllBuckets.Points[(int32)Point.Bucket];
+	OldAll.RemoveAtSwap(Point.SlotInAll, 1, false);
+	if (OldAll.IsValidIndex(Point.SlotInAll))
+	{
+		SpawnPoints[OldAll[Point.SlotInAll]].SlotInAll = Point.SlotInAll;
+	}
+
+	Point.Bucket = NewBucket;
+	Point.SlotInRegion = RegionBuckets[Point.RegionIndex].Points[(int32)NewBucket].Add(PointIndex);
+	Point.SlotInAll = AllBuckets.Points[(int32)NewBucket].Add(PointIndex);
+}
+
+
+void USSpawnPointCacheComponent::RefreshBuckets()
+{
+	if (SpawnPoints.Num() == 0)
+	{
+		return;
+	}
+
+	RefreshId++;
+
+	PlayerViewLocations.Reset();
+	for (FConstControllerIterator It = GetWorld()->GetControllerIterator(); It; ++It)
+	{
+		AController* PC = It->Get();
+		if (ASGameMode::IsPlayer(PC) && PC->GetPawn())
+		{
+			PlayerViewLocations.Add(PC->GetPawn()->GetPawnViewLocation());
+		}
+	}
+
+	// Distance: only visit the grid cells around each player
+	const float MinDistanceSq = FMath::Square(MinPlayerDistance);
+	const int32 CellRange = FMath::CeilToInt(MinPlayerDistance / GridCellSize);
+
+	for (const FVector& PlayerLocation : PlayerViewLocations)
+	{
+		const FIntVector PlayerCell = GetGridCell(PlayerLocation);
+
+		for (int32 X = -CellRange; X <= CellRange; X++)
+		{
+			for (int32 Y = -CellRange; Y <= CellRange; Y++)
+			{
+				for (int32 Z = -CellRange; Z <= CellRange; Z++)
+				{
+					const TArray<int32>* Cell = SpatialGrid.Find(PlayerCell + FIntVector(X, Y, Z));
+					if (Cell == nullptr)
+					{
+						continue;
+					}
+
+					for (int32 PointIndex : *Cell)
+					{
+						if (FVector::DistSquared(SpawnPoints[PointIndex].Location, PlayerLocation) < MinDistanceSq)
+						{
+							SpawnPoints[PointIndex].NearStamp = RefreshId;
+							MoveToBucket(PointIndex, ESpawnPointBucket::TooClose);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Points that players walked away from go back in line for a visibility check
+	TooCloseScratch = AllBuckets.Points[(int32)ESpawnPointBucket::TooClose];
+	for (int32 PointIndex : TooCloseScratch)
+	{
+		if (SpawnPoints[PointIndex].NearStamp != RefreshId)
+		{
+			MoveToBucket(PointIndex, ESpawnPointBucket::Visible);
+		}
+	}
+
+	// Line of sight: a time slice of the points per refresh
+	const int32 NrOfTraces = FMath::Min(MaxTracesPerRefresh, SpawnPoints.Num());
+	for (int32 i = 0; i < NrOfTraces; i++)
+	{
+		RefreshCursor = (RefreshCursor + 1) % SpawnPoints.Num();
+
+		const FSpawnPoint& Point = SpawnPoints[RefreshCursor];
+		if (Point.Bucket == ESpawnPointBucket::TooClose)
+		{
+			continue;
+		}
+
+		MoveToBucket(RefreshCursor, IsVisibleToAnyPlayer(Point.Location) ? ESpawnPointBucket::Visible : ESpawnPointBucket::Hidden);
+	}
+}
+
+
+bool USSpawnPointCacheComponent::IsVisibleToAnyPlayer(const FVector& Location) const
+{
+	const float MaxDistanceSq = FMath::Square(MaxVisibilityDistance);
+
+	FCollisionQueryParams QueryParams;
+	QueryParams.bTraceComplex = false;
+
+	for (const FVector& PlayerLocation : PlayerViewLocations)
+	{
+		if (FVector::DistSquared(Location, PlayerLocation) > MaxDistanceSq)
+		{
+			continue;
+		}
+
+		if (!GetWorld()->LineTraceTestByChannel(Location, PlayerLocation, ECC_Visibility, QueryParams))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool USSpawnPointCacheComponent::PickSpawnTransform(FName Region, FTransform& OutTransform) const
+{
+	const FBucketSet* Buckets = &AllBuckets;
+	if (Region != NAME_None)
+	{
+		const int32 RegionIndex = RegionNames.IndexOfByKey(Region);
+		if (RegionIndex == INDEX_NONE)
+		{
+			return false;
+		}
+		Buckets = &RegionBuckets[RegionIndex];
+	}
+
+	// Out of sight first, then anything that isn't right next to a player
+	for (ESpawnPointBucket Bucket : { ESpawnPointBucket::Hidden, ESpawnPointBucket::Visible })
+	{
+		const TArray<int32>& Candidates = Buckets->Points[(int32)Bucket];
+		if (Candidates.Num() > 0)
+		{
+			const FSpawnPoint& Point = SpawnPoints[Candidates[FSDeterminism::GetStream(this, ECoopRandomStream::Spawns).RandHelper(Candidates.Num())]];
+			OutTransform = FTransform(Point.Rotation, Point.Location);
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,329 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SStatusEffectComponent.h"
+#include "SHealthComponent.h"
+#include "SPerfCounters.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "Kismet/GameplayStatics.h"
+#include "Net/UnrealNetwork.h"
+
+
+void FSReplicatedStatusEffect::PostReplicatedAdd(const FSReplicatedStatusEffectArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnStatusEffectChanged.Broadcast(Target, Type, true);
+	}
+}
+
+
+void FSReplicatedStatusEffect::PreReplicatedRemove(const FSReplicatedStatusEffectArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnStatusEffectChanged.Broadcast(Target, Type, false);
+	}
+}
+
+
+// Sets default values for this component's properties
+USStatusEffectComponent::USStatusEffectComponent()
+{
+	// Only ticks on the server while there are effects, clients just get told what is active
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	NextEffectId = 0;
+	bTickingEffects = false;
+
+	ReplicatedEffects.Owner = this;
+
+	SetIsReplicated(true);
+}
+
+
+void USStatusEffectComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	COOP_SCOPE_TIME(StatusEffects);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	bTickingEffects = true;
+
+	// Effects added by callbacks wait for the next pass
+	const int32 NrOfEffects = EffectIds.Num();
+	for (int32 i = 0; i < NrOfEffects; i++)
+	{
+		// Effects on actors that are gone have nothing left to do
+		if (Types[i] != EStatusEffectType::Custom && !Targets[i].IsValid())
+		{
+			EndedEffectIds.AddUnique(EffectIds[i]);
+			continue;
+		}
+
+		while (NextTickTimes[i] <= Now && TicksDone[i] < NrOfTicks[i])
+		{
+			TickEffect(i);
+			NextTickTimes[i] += Intervals[i];
+		}
+	}
+
+	bTickingEffects = false;
+
+	ApplyHealthChanges();
+
+	for (int32 EffectId : EndedEffectIds)
+	{
+		const int32 Index = EffectIds.Find(EffectId);
+		if (Index != INDEX_NONE)
+		{
+			RemoveEffectAt(Index);
+		}
+	}
+	EndedEffectIds.Reset();
+}
+
+
+int32 USStatusEffectComponent::AddEffect(const FSStatusEffectSpec& Spec, AActor* Target, AController* InstigatedBy, AActor* Causer,
+	FSStatusEffectTickDelegate OnTick)
+{
+	if (GetOwnerRole() != ROLE_Authority)
+	{
+		return INDEX_NONE;
+	}
+
+	if (Spec.Type != EStatusEffectType::Custom && Target == nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	const bool bInstant = Spec.Interval <= 0.0f;
+
+	const int32 EffectId = NextEffectId++;
+	EffectIds.Add(EffectId);
+	Types.Add(Spec.Type);
+	NextTickTimes.Add(bInstant ? Now : Now + Spec.Interval);
+	Intervals.Add(bInstant ? 0.0f : Spec.Interval);
+	Magnitudes.Add(Spec.Magnitude);
+	NrOfTicks.Add(bInstant ? 1 : FMath::Max(Spec.NrOfTicks, 1));
+	TicksDone.Add(0);
+	Targets.Add(Target);
+	Instigators.Add(InstigatedBy);
+	Causers.Add(Causer);
+	DamageTypes.Add(Spec.DamageType);
+	TickDelegates.Add(OnTick);
+
+	FSReplicatedStatusEffect& Item = ReplicatedEffects.Items.AddDefaulted_GetRef();
+	Item.Target = Target;
+	Item.Type = Spec.Type;
+	Item.EndTime = Now + Intervals.Last() * NrOfTicks.Last();
+	Item.Magnitude = Spec.Type == EStatusEffectType::SpeedBoost ? Spec.Magnitude : 0.0f;
+	Item.EffectId = EffectId;
+	ReplicatedEffects.MarkItemDirty(Item);
+
+	// Call on server
+	OnStatusEffectChanged.Broadcast(Target, Spec.Type, true);
+
+	SetComponentTickEnabled(true);
+
+	return EffectId;
+}
+
+
+void USStatusEffectComponent::RemoveEffect(int32 EffectId)
+{
+	const int32 Index = EffectIds.Find(EffectId);
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (bTickingEffects)
+	{
+		// Indices have to stay put until the pass is done, just make sure it doesn't tick again
+		NrOfTicks[Index] = TicksDone[Index];
+		EndedEffectIds.AddUnique(EffectId);
+		return;
+	}
+
+	RemoveEffectAt(Index);
+}
+
+
+void USStatusEffectComponent::RemoveEffectsOn(AActor* Target)
+{
+	for (int32 i = EffectIds.Num() - 1; i >= 0; i--)
+	{
+		if (Targets[i].Get() == Target)
+		{
+			RemoveEffect(EffectIds[i]);
+		}
+	}
+}
+
+
+bool USStatusEffectComponent::HasActiveEffect(AActor* Target, EStatusEffectType Type) const
+{
+	// Works the same on clients, the replicated list is all they have
+	for (const FSReplicatedStatusEffect& Item : ReplicatedEffects.Items)
+	{
+		if (Item.Target == Target && Item.Type == Type)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+int32 USStatusEffectComponent::GetNumActiveEffects() const
+{
+	return ReplicatedEffects.Items.Num();
+}
+
+
+float USStatusEffectComponent::GetSpeedMultiplier(const AActor* Target) const
+{
+	float Multiplier = 1.0f;
+
+	for (const FSReplicatedStatusEffect& Item : ReplicatedEffects.Items)
+	{
+		if (Item.Target == Target && Item.Type == EStatusEffectType::SpeedBoost)
+		{
+			Multiplier *= Item.Magnitude;
+		}
+	}
+
+	return Multiplier;
+}
+
+
+void USStatusEffectComponent::TickEffect(int32 Index)
+{
+	const int32 TickIndex = TicksDone[Index]++;
+	const bool bExpired = TicksDone[Index] >= NrOfTicks[Index];
+
+	if (Types[Index] == EStatusEffectType::HealOverTime || Types[Index] == EStatusEffectType::DamageOverTime)
+	{
+		QueueHealthChange(Index);
+	}
+
+	if (bExpired)
+	{
+		EndedEffectIds.AddUnique(EffectIds[Index]);
+	}
+
+	// May add or remove effects, which can reallocate the arrays but doesn't move entries until the pass is done
+	const FSStatusEffectTickDelegate OnTick = TickDelegates[Index];
+	OnTick.ExecuteIfBound(TickIndex, bExpired);
+}
+
+
+void USStatusEffectComponent::QueueHealthChange(int32 Index)
+{
+	AActor* Target = Targets[Index].Get();
+
+	int32* ChangeIndex = PendingChangeIndices.Find(Target);
+	if (ChangeIndex == nullptr)
+	{
+		ChangeIndex = &PendingChangeIndices.Add(Target, PendingChanges.AddZeroed());
+		PendingChanges[*ChangeIndex].Target = Target;
+	}
+
+	FPendingHealthChange& Change = PendingChanges[*ChangeIndex];
+	if (Types[Index] == EStatusEffectType::HealOverTime)
+	{
+		Change.Heal += Magnitudes[Index];
+	}
+	else
+	{
+		// Last damage effect of the pass gets the credit for all of it
+		Change.Damage += Magnitudes[Index];
+		Change.InstigatedBy = Instigators[Index];
+		Change.Causer = Causers[Index];
+		Change.DamageType = DamageTypes[Index];
+	}
+}
+
+
+void USStatusEffectComponent::ApplyHealthChanges()
+{
+	// One heal and one damage event per target, however many effects it has running
+	for (const FPendingHealthChange& Change : PendingChanges)
+	{
+		AActor* Target = Change.Target.Get();
+		if (Target == nullptr)
+		{
+			continue;
+		}
+
+		// Heal first, so a heal and a killing blow in the same frame still kill
+		if (Change.Heal > 0.0f)
+		{
+			USHealthComponent* HealthComp = Cast<USHealthComponent>(Target->GetComponentByClass(USHealthComponent::StaticClass()));
+			if (HealthComp)
+			{
+				HealthComp->Heal(Change.Heal);
+			}
+		}
+
+		if (Change.Damage > 0.0f)
+		{
+			UGameplayStatics::ApplyDamage(Target, Change.Damage, Change.InstigatedBy.Get(), Change.Causer.Get(), Change.DamageType);
+		}
+	}
+
+	PendingChanges.Reset();
+	PendingChangeIndices.Reset();
+}
+
+
+void USStatusEffectComponent::RemoveEffectAt(int32 Index)
+{
+	const int32 EffectId = EffectIds[Index];
+
+	EffectIds.RemoveAtSwap(Index, 1, false);
+	Types.RemoveAtSwap(Index, 1, false);
+	NextTickTimes.RemoveAtSwap(Index, 1, false);
+	Intervals.RemoveAtSwap(Index, 1, false);
+	Magnitudes.RemoveAtSwap(Index, 1, false);
+	NrOfTicks.RemoveAtSwap(Index, 1, false);
+	TicksDone.RemoveAtSwap(Index, 1, false);
+	Targets.RemoveAtSwap(Index, 1, false);
+	Instigators.RemoveAtSwap(Index, 1, false);
+	Causers.RemoveAtSwap(Index, 1, false);
+	DamageTypes.RemoveAtSwap(Index, 1, false);
+	TickDelegates.RemoveAtSwap(Index, 1, false);
+
+	for (int32 i = 0; i < ReplicatedEffects.Items.Num(); i++)
+	{
+		const FSReplicatedStatusEffect& Item = ReplicatedEffects.Items[i];
+		if (Item.EffectId == EffectId)
+		{
+			// Call on server
+			OnStatusEffectChanged.Broadcast(Item.Target, Item.Type, false);
+
+			ReplicatedEffects.Items.RemoveAtSwap(i);
+			ReplicatedEffects.MarkArrayDirty();
+			break;
+		}
+	}
+
+	if (EffectIds.Num() == 0)
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
+
+void USStatusEffectComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(USStatusEffectComponent, ReplicatedEffects);
+}
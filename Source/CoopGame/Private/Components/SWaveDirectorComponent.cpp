@@ -0,0 +1,314 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SWaveDirectorComponent.h"
+#include "SGameMode.h"
+#include "SSpawnPointCacheComponent.h"
+#include "SLoadGovernorComponent.h"
+#include "CoopGame.h"
+#include "SPerfCounters.h"
+#include "SAssetStreamer.h"
+#include "SMemoryTracker.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+
+
+// Sets default values for this component's properties
+USWaveDirectorComponent::USWaveDirectorComponent()
+{
+	// Only tick while a wave is being spawned
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	MaxSpawnsPerFrame = 2;
+	OverflowCountScale = 0.5f;
+	LateSpawnThreshold = 0.1f;
+
+	NextPendingIndex = 0;
+	ActiveWaveNumber = 0;
+	WaveClock = 0.0f;
+	WaveTime = 0.0f;
+}
+
+
+void USWaveDirectorComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	AActor* MyOwner = GetOwner();
+	if (MyOwner)
+	{
+		SpawnPointCache = Cast<USSpawnPointCacheComponent>(MyOwner->GetComponentByClass(USSpawnPointCacheComponent::StaticClass()));
+		LoadGovernor = Cast<USLoadGovernorComponent>(MyOwner->GetComponentByClass(USLoadGovernorComponent::StaticClass()));
+	}
+}
+
+
+int32 USWaveDirectorComponent::BeginWave(int32 WaveNumber)
+{
+	AbortWave();
+
+	float CountScale = 1.0f;
+	const FSWaveDefinition* Definition = FindWaveDefinition(WaveNumber, CountScale);
+	if (Definition == nullptr)
+	{
+		return 0;
+	}
+
+	ActiveWaveNumber = WaveNumber;
+	ActiveEntries = Definition->Bots;
+
+	// Interleave the entries so every bot type shows up early in the wave instead of one type after the other
+	TArray<int32> RemainingPerEntry;
+	int32 TotalToSpawn = 0;
+	for (const FSWaveBotEntry& Entry : ActiveEntries)
+	{
+		int32 Count = FMath::RoundToInt(Entry.Count * CountScale);
+		RemainingPerEntry.Add(Count);
+		TotalToSpawn += Count;
+	}
+
+	PendingSpawns.Reserve(TotalToSpawn);
+
+	const int32 BatchSize = FMath::Max(Definition->BatchSize, 1);
+	int32 EntryIndex = 0;
+	while (PendingSpawns.Num() < TotalToSpawn)
+	{
+		if (RemainingPerEntry[EntryIndex] > 0)
+		{
+			RemainingPerEntry[EntryIndex]--;
+
+			FPendingSpawn Spawn;
+			Spawn.EntryIndex = EntryIndex;
+			Spawn.PlannedTime = (PendingSpawns.Num() / BatchSize) * Definition->SpawnInterval;
+			PendingSpawns.Add(Spawn);
+		}
+
+		EntryIndex = (EntryIndex + 1) % ActiveEntries.Num();
+	}
+
+	SpawnRecords.Reset(TotalToSpawn);
+	WaveClock = 0.0f;
+	WaveTime = 0.0f;
+
+	if (PendingSpawns.Num() > 0)
+	{
+		SetComponentTickEnabled(true);
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("Wave %d: planned %d bots over %.1fs"), WaveNumber, TotalToSpawn,
+		PendingSpawns.Num() > 0 ? PendingSpawns.Last().PlannedTime : 0.0f);
+
+	return TotalToSpawn;
+}
+
+
+void USWaveDirectorComponent::AbortWave()
+{
+	SetComponentTickEnabled(false);
+
+	PendingSpawns.Reset();
+	NextPendingIndex = 0;
+}
+
+
+bool USWaveDirectorComponent::HasWaveTable() const
+{
+	return WaveTable != nullptr && WaveTable->GetRowMap().Num() > 0;
+}
+
+
+bool USWaveDirectorComponent::IsSpawning() const
+{
+	return NextPendingIndex < PendingSpawns.Num();
+}
+
+
+int32 USWaveDirectorComponent::GetNumPendingSpawns() const
+{
+	return PendingSpawns.Num() - NextPendingIndex;
+}
+
+
+const TArray<FSWaveSpawnRecord>& USWaveDirectorComponent::GetSpawnRecords() const
+{
+	return SpawnRecords;
+}
+
+
+void USWaveDirectorComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	COOP_SCOPE_TIME(Spawning);
+
+	const float IntervalScale = LoadGovernor ? LoadGovernor->GetSpawnIntervalScale() : 1.0f;
+	WaveClock += DeltaTime / IntervalScale;
+	WaveTime += DeltaTime;
+
+	// Release everything that is due, but never more than the per-frame budget. The rest carries over to the next frame
+	int32 SpawnedThisFrame = 0;
+	while (IsSpawning() && SpawnedThisFrame < MaxSpawnsPerFrame)
+	{
+		const FPendingSpawn& Spawn = PendingSpawns[NextPendingIndex];
+		if (Spawn.PlannedTime > WaveClock)
+		{
+			break;
+		}
+
+		// Live bot cap of the governor, held spawns go out as bots die
+		if (LoadGovernor && !LoadGovernor->CanSpawnBot())
+		{
+			break;
+		}
+
+		SpawnBot(ActiveEntries[Spawn.EntryIndex]);
+
+		FSWaveSpawnRecord Record;
+		Record.PlannedTime = Spawn.PlannedTime;
+		Record.DueTime = FMath::Max(WaveTime - (WaveClock - Spawn.PlannedTime) * IntervalScale, 0.0f);
+		Record.ActualTime = WaveTime;
+		SpawnRecords.Add(Record);
+
+		NextPendingIndex++;
+		SpawnedThisFrame++;
+	}
+
+	if (!IsSpawning())
+	{
+		FinishSpawning();
+	}
+}
+
+
+void USWaveDirectorComponent::GetWaveBotClasses(int32 WaveNumber, TArray<TSoftClassPtr<APawn>>& OutClasses) const
+{
+	float CountScale;
+	const FSWaveDefinition* Definition = FindWaveDefinition(WaveNumber, CountScale);
+	if (Definition == nullptr)
+	{
+		return;
+	}
+
+	for (const FSWaveBotEntry& Entry : Definition->Bots)
+	{
+		if (!Entry.BotClass.IsNull() && Entry.Count > 0)
+		{
+			OutClasses.AddUnique(Entry.BotClass);
+		}
+	}
+}
+
+
+const FSWaveDefinition* USWaveDirectorComponent::FindWaveDefinition(int32 WaveNumber, float& OutCountScale) const
+{
+	OutCountScale = 1.0f;
+
+	if (!HasWaveTable())
+	{
+		return nullptr;
+	}
+
+	TArray<FSWaveDefinition*> Rows;
+	WaveTable->GetAllRows<FSWaveDefinition>(TEXT("WaveDirector"), Rows);
+	if (Rows.Num() == 0)
+	{
+		return nullptr;
+	}
+
+	// Waves are 1-based, past the end of the table the last row keeps growing
+	const int32 RowIndex = FMath::Clamp(WaveNumber - 1, 0, Rows.Num() - 1);
+	const int32 WavesPastTable = FMath::Max(WaveNumber - Rows.Num(), 0);
+	OutCountScale = 1.0f + WavesPastTable * OverflowCountScale;
+
+	return Rows[RowIndex];
+}
+
+
+bool USWaveDirectorComponent::SpawnBot(const FSWaveBotEntry& Entry)
+{
+	FTransform SpawnTransform;
+	if (Entry.BotClass.IsNull() || SpawnPointCache == nullptr || !SpawnPointCache->PickSpawnTransform(Entry.SpawnGroup, SpawnTransform))
+	{
+		// Let the Blueprint decide what and where to spawn
+		ASGameMode* GM = Cast<ASGameMode>(GetOwner());
+		if (GM)
+		{
+			APawn* Bot = GM->SpawnBlueprintBot();
+
+			if (LoadGovernor)
+			{
+				LoadGovernor->OnBotSpawned(Bot);
+			}
+			return true;
+		}
+
+		return false;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	// Normally preloaded during the break before the wave, otherwise this is the hitch the asset report shows
+	TSubclassOf<APawn> BotClass = FSAssetStreamer::Get().LoadClassNow(Entry.BotClass, TEXT("USWaveDirectorComponent"));
+
+	COOP_LLM_SCOPE(ECoopMemCategory::Bots);
+	APawn* Bot = BotClass ? GetWorld()->SpawnActor<APawn>(BotClass, SpawnTransform, SpawnParams) : nullptr;
+	if (Bot == nullptr)
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Wave %d: failed to spawn %s"), ActiveWaveNumber, *Entry.BotClass.ToString());
+		return false;
+	}
+
+	// AI characters need a controller, physics driven bots (eg. TrackerBot) simply don't have a controller class
+	if (Bot->Controller == nullptr && Bot->AIControllerClass)
+	{
+		Bot->SpawnDefaultController();
+	}
+
+	if (LoadGovernor)
+	{
+		LoadGovernor->OnBotSpawned(Bot);
+	}
+
+	return true;
+}
+
+
+void USWaveDirectorComponent::FinishSpawning()
+{
+	SetComponentTickEnabled(false);
+
+	ReportSpawnTiming();
+
+	OnSpawningFinished.Broadcast();
+}
+
+
+void USWaveDirectorComponent::ReportSpawnTiming() const
+{
+	if (SpawnRecords.Num() == 0)
+	{
+		return;
+	}
+
+	float TotalDelay = 0.0f;
+	float MaxDelay = 0.0f;
+	int32 NrOfLateSpawns = 0;
+
+	for (const FSWaveSpawnRecord& Record : SpawnRecords)
+	{
+		// Stretching by the governor is intended, only lateness past that counts
+		const float Delay = Record.ActualTime - Record.DueTime;
+
+		TotalDelay += Delay;
+		MaxDelay = FMath::Max(MaxDelay, Delay);
+
+		if (Delay > LateSpawnThreshold)
+		{
+			NrOfLateSpawns++;
+		}
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("Wave %d: spawned %d bots, avg delay %.3fs, max delay %.3fs, %d late (> %.2fs)"),
+		ActiveWaveNumber, SpawnRecords.Num(), TotalDelay / SpawnRecords.Num(), MaxDelay, NrOfLateSpawns, LateSpawnThreshold);
+}
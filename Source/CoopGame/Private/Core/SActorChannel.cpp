@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SActorChannel.h"
+#include "SNetAccounting.h"
+#include "Net/DataBunch.h"
+
+
+FPacketIdRange USActorChannel::SendBunch(FOutBunch* Bunch, bool Merge)
+{
+	// Measured before the channel splits it into partial bunches or merges it into the previous one
+	if (Bunch && !Bunch->IsError())
+	{
+		FSNetAccounting::Get().RecordOutgoing(this, Bunch->GetNumBits(), Bunch->bOpen);
+	}
+
+	return Super::SendBunch(Bunch, Merge);
+}
+
+
+void USActorChannel::ReceivedBunch(FInBunch& Bunch)
+{
+	const int64 NumBits = Bunch.GetNumBits();
+
+	// The first bunch spawns the actor, so it is only known afterwards
+	Super::ReceivedBunch(Bunch);
+
+	FSNetAccounting::Get().RecordIncoming(this, NumBits);
+}
@@ -0,0 +1,303 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SAssetStreamer.h"
+#include "CoopGame.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#if WITH_EDITOR
+#include "Interfaces/ITargetPlatform.h"
+#include "Interfaces/ITargetPlatformManagerModule.h"
+#endif
+
+
+static void AssetReportCommand()
+{
+	FSAssetStreamer::Get().LogReport();
+}
+
+FAutoConsoleCommand AssetReportConsoleCommand(
+	TEXT("COOP.AssetReport"),
+	TEXT("Log preload times, time to playable and assets that weren't loaded on first use"),
+	FConsoleCommandDelegate::CreateStatic(&AssetReportCommand));
+
+
+FSAssetStreamer::FSAssetStreamer()
+	: MatchStartTime(0.0)
+{
+}
+
+
+FSAssetStreamer& FSAssetStreamer::Get()
+{
+	static FSAssetStreamer Instance;
+	return Instance;
+}
+
+
+void FSAssetStreamer::Shutdown()
+{
+	LogReport();
+
+	Groups.Reset();
+	Matches.Reset();
+	MissHandles.Reset();
+	StreamableManager.Reset();
+}
+
+
+void FSAssetStreamer::BeginMatch(const UWorld* World)
+{
+	MatchStartTime = FPlatformTime::Seconds();
+
+	FMatch& Match = FindOrAddMatch(World);
+	Match.StartTime = MatchStartTime;
+	Match.TimeToPlayableMs = 0.0f;
+	Match.bPlayable = false;
+
+	// Groups this world asked for before it began may be in already
+	CheckPlayable(Match);
+}
+
+
+FSAssetStreamer::FMatch& FSAssetStreamer::FindOrAddMatch(const UWorld* World)
+{
+	FMatch* Existing = Matches.FindByPredicate([World](const FMatch& Match) { return Match.World.Get() == World; });
+	if (Existing)
+	{
+		return *Existing;
+	}
+
+	FMatch& Match = Matches.AddDefaulted_GetRef();
+	Match.World = World;
+	Match.WorldName = GetNameSafe(World);
+	Match.StartTime = 0.0;
+	Match.TimeToPlayableMs = 0.0f;
+	Match.bPlayable = false;
+	return Match;
+}
+
+
+bool FSAssetStreamer::IsGroupLoaded(FName GroupName) const
+{
+	const FGroup* Group = Groups.FindByPredicate([GroupName](const FGroup& Candidate) { return Candidate.Name == GroupName; });
+	return Group && Group->bLoaded;
+}
+
+
+void FSAssetStreamer::CheckPlayable(FMatch& Match)
+{
+	if (Match.bPlayable || Match.StartTime <= 0.0 || Match.NeededGroups.Num() == 0)
+	{
+		return;
+	}
+
+	for (FName GroupName : Match.NeededGroups)
+	{
+		if (!IsGroupLoaded(GroupName))
+		{
+			return;
+		}
+	}
+
+	Match.bPlayable = true;
+	Match.TimeToPlayableMs = (float)((FPlatformTime::Seconds() - Match.StartTime) * 1000.0);
+
+	UE_LOG(LogCoopGame, Log, TEXT("Assets: %s playable %.0f ms after the match started, %.1f s after launch"),
+		*Match.WorldName, Match.TimeToPlayableMs, FPlatformTime::Seconds() - GStartTime);
+}
+
+
+FStreamableManager& FSAssetStreamer::GetStreamableManager()
+{
+	if (!StreamableManager.IsValid())
+	{
+		StreamableManager = MakeUnique<FStreamableManager>();
+	}
+	return *StreamableManager;
+}
+
+
+void FSAssetStreamer::Preload(FName GroupName, const TArray<FSoftObjectPath>& Assets, bool bCosmetic, const UWorld* NeededToPlayIn, FSimpleDelegate OnLoaded)
+{
+	if (bCosmetic && IsRunningDedicatedServer())
+	{
+		return;
+	}
+
+	if (NeededToPlayIn)
+	{
+		FindOrAddMatch(NeededToPlayIn).NeededGroups.AddUnique(GroupName);
+	}
+
+	FGroup* ExistingGroup = Groups.FindByPredicate([GroupName](const FGroup& Group) { return Group.Name == GroupName; });
+	if (ExistingGroup)
+	{
+		if (ExistingGroup->bLoaded)
+		{
+			OnLoaded.ExecuteIfBound();
+
+			// Loaded by an earlier match, so OnGroupLoaded won't come again. Checked after the callback, which may need more groups
+			FMatch* Match = NeededToPlayIn ? Matches.FindByPredicate([NeededToPlayIn](const FMatch& Candidate) { return Candidate.World.Get() == NeededToPlayIn; }) : nullptr;
+			if (Match)
+			{
+				CheckPlayable(*Match);
+			}
+		}
+		else
+		{
+			ExistingGroup->OnLoaded.Add(OnLoaded);
+		}
+		return;
+	}
+
+	const int32 GroupIndex = Groups.AddDefaulted();
+	FGroup& Group = Groups[GroupIndex];
+	Group.Name = GroupName;
+	Group.NrOfAssets = Assets.Num();
+	Group.RequestTime = FPlatformTime::Seconds();
+	Group.LoadMs = 0.0f;
+	Group.bLoaded = false;
+	Group.OnLoaded.Add(OnLoaded);
+
+	// Assets still referenced by the map are already in, the handle completes right away for them
+	TArray<FSoftObjectPath> ValidAssets = Assets.FilterByPredicate([](const FSoftObjectPath& Path) { return Path.IsValid(); });
+
+	// Completion can call back right away and preload more groups, so don't hold on to Group past this point
+	TSharedPtr<FStreamableHandle> Handle = GetStreamableManager().RequestAsyncLoad(ValidAssets,
+		FStreamableDelegate::CreateRaw(this, &FSAssetStreamer::OnGroupLoaded, GroupName), FStreamableManager::AsyncLoadHighPriority);
+
+	// The handle keeps the assets loaded for as long as the process runs
+	Groups[GroupIndex].Handle = Handle;
+
+	if (!Handle.IsValid())
+	{
+		// Nothing to load
+		OnGroupLoaded(GroupName);
+	}
+}
+
+
+void FSAssetStreamer::OnGroupLoaded(FName GroupName)
+{
+	FGroup* Group = Groups.FindByPredicate([GroupName](const FGroup& Candidate) { return Candidate.Name == GroupName; });
+	if (Group == nullptr || Group->bLoaded)
+	{
+		return;
+	}
+
+	Group->bLoaded = true;
+	Group->LoadMs = (float)((FPlatformTime::Seconds() - Group->RequestTime) * 1000.0);
+
+	UE_LOG(LogCoopGame, Verbose, TEXT("Assets: %s loaded %d assets in %.1f ms"), *GroupName.ToString(), Group->NrOfAssets, Group->LoadMs);
+
+	// Move out, the callbacks may preload more groups and grow the array
+	const TArray<FSimpleDelegate> OnLoaded = MoveTemp(Group->OnLoaded);
+	for (const FSimpleDelegate& Callback : OnLoaded)
+	{
+		Callback.ExecuteIfBound();
+	}
+
+	for (FMatch& Match : Matches)
+	{
+		if (Match.NeededGroups.Contains(GroupName))
+		{
+			CheckPlayable(Match);
+		}
+	}
+}
+
+
+void FSAssetStreamer::RequestAfterMiss(const FSoftObjectPath& Path, const TCHAR* User)
+{
+	if (MissedPaths.Contains(Path))
+	{
+		// Already streaming in
+		return;
+	}
+
+	RecordMiss(Path, User, -1.0f);
+
+	MissHandles.Add(GetStreamableManager().RequestAsyncLoad(Path, FStreamableDelegate(), FStreamableManager::AsyncLoadHighPriority));
+}
+
+
+void FSAssetStreamer::RecordMiss(const FSoftObjectPath& Path, const TCHAR* User, float SyncLoadMs)
+{
+	MissedPaths.Add(Path);
+
+	FMiss& Miss = Misses.AddDefaulted_GetRef();
+	Miss.Path = Path;
+	Miss.User = User;
+	Miss.SyncLoadMs = SyncLoadMs;
+	Miss.SecondsIntoMatch = MatchStartTime > 0.0 ? (float)(FPlatformTime::Seconds() - MatchStartTime) : 0.0f;
+
+	if (SyncLoadMs >= 0.0f)
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Assets: %s was not preloaded, %s waited %.1f ms for it"), *Path.ToString(), User, SyncLoadMs);
+	}
+	else
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Assets: %s was not preloaded, %s skipped it while it streams in"), *Path.ToString(), User);
+	}
+}
+
+
+void FSAssetStreamer::LogReport() const
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Assets: %d preload groups, %d matches"), Groups.Num(), Matches.Num());
+
+	for (const FMatch& Match : Matches)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("  %-40s time to playable %s, %d groups needed"), *Match.WorldName,
+			Match.bPlayable ? *FString::Printf(TEXT("%.0f ms"), Match.TimeToPlayableMs) : TEXT("not reached"), Match.NeededGroups.Num());
+	}
+
+	for (const FGroup& Group : Groups)
+	{
+		const bool bNeededToPlay = Matches.ContainsByPredicate([&Group](const FMatch& Match) { return Match.NeededGroups.Contains(Group.Name); });
+
+		UE_LOG(LogCoopGame, Log, TEXT("  %-40s %4d assets %s%s"), *Group.Name.ToString(), Group.NrOfAssets,
+			Group.bLoaded ? *FString::Printf(TEXT("%8.1f ms"), Group.LoadMs) : TEXT(" loading"), bNeededToPlay ? TEXT(" (needed to play)") : TEXT(""));
+	}
+
+	float TotalSyncMs = 0.0f;
+	for (const FMiss& Miss : Misses)
+	{
+		TotalSyncMs += FMath::Max(Miss.SyncLoadMs, 0.0f);
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("Assets: %d first use misses, %.1f ms spent in synchronous loads"), Misses.Num(), TotalSyncMs);
+
+	for (const FMiss& Miss : Misses)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("  %7.1fs %-24s %s %s"), Miss.SecondsIntoMatch, *Miss.User, *Miss.Path.ToString(),
+			Miss.SyncLoadMs >= 0.0f ? *FString::Printf(TEXT("hitch %.1f ms"), Miss.SyncLoadMs) : TEXT("skipped"));
+	}
+}
+
+
+FSAssetStreamer::FCosmeticReferenceScope::FCosmeticReferenceScope(const FArchive& Ar)
+{
+#if WITH_EDITOR
+	bool bServerCook = false;
+	if (Ar.IsSaving())
+	{
+		bServerCook = Ar.IsCooking() && Ar.CookingTarget()->IsServerOnly();
+	}
+	else if (Ar.IsLoading() && IsRunningCommandlet())
+	{
+		// The cook collects soft references while it loads, before there is a target, only skip them if every platform is a server
+		const TArray<ITargetPlatform*>& Platforms = GetTargetPlatformManagerRef().GetActiveTargetPlatforms();
+		bServerCook = Platforms.Num() > 0;
+		for (const ITargetPlatform* Platform : Platforms)
+		{
+			bServerCook &= Platform->IsServerOnly();
+		}
+	}
+
+	if (bServerCook)
+	{
+		Scope.Emplace(NAME_None, NAME_None, ESoftObjectPathCollectType::NeverCollect, ESoftObjectPathSerializeType::AlwaysSerialize);
+	}
+#endif
+}
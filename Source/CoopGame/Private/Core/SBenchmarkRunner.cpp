@@ -0,0 +1,558 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SBenchmarkRunner.h"
+#include "CoopGame.h"
+#include "SGameMode.h"
+#include "SSimulatedPlayerController.h"
+#include "SSpawnPointCacheComponent.h"
+#include "SDeterminism.h"
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "NavigationSystem/Public/NavigationSystem.h"
+
+
+static void StartBenchmarkCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr || World->GetAuthGameMode() == nullptr)
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("COOP.Benchmark only runs on the server"));
+		return;
+	}
+
+	World->SpawnActor<ASBenchmarkRunner>();
+}
+
+FAutoConsoleCommandWithWorldAndArgs StartBenchmarkConsoleCommand(
+	TEXT("COOP.Benchmark"),
+	TEXT("Run the horde scaling benchmark on the current map"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartBenchmarkCommand),
+	ECVF_Cheat);
+
+
+void FSBenchmarkPostPhysicsTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target && !Target->IsPendingKill())
+	{
+		Target->OnPostPhysicsTick();
+	}
+}
+
+
+FString FSBenchmarkPostPhysicsTickFunction::DiagnosticMessage()
+{
+	return TEXT("FSBenchmarkPostPhysicsTickFunction");
+}
+
+
+ASBenchmarkRunner::ASBenchmarkRunner()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	PostPhysicsTick.bCanEverTick = true;
+	PostPhysicsTick.TickGroup = TG_PostPhysics;
+
+	BotSteps = { 10, 50, 200, 1000 };
+	BarrelsPerBot = 0.1f;
+	PickupsPerBot = 0.05f;
+	ShootersPerBot = 0.02f;
+	ArenaRadius = 3000.0f;
+	WarmupSeconds = 3.0f;
+	MeasureSeconds = 10.0f;
+	SpawnsPerFrame = 20;
+	RegressionThreshold = 0.1f;
+
+	bExitWhenDone = false;
+	Phase = EPhase::Idle;
+	StepIndex = 0;
+	PhaseEndTime = 0.0f;
+	PrePhysicsTime = 0.0;
+}
+
+
+void ASBenchmarkRunner::BeginPlay()
+{
+	Super::BeginPlay();
+
+	PostPhysicsTick.Target = this;
+	PostPhysicsTick.RegisterTickFunction(GetLevel());
+
+	ParseCommandLine();
+
+	LoadedBotClass = BotClass.TryLoadClass<APawn>();
+	LoadedBarrelClass = BarrelClass.TryLoadClass<AActor>();
+	LoadedPickupClass = PickupClass.TryLoadClass<AActor>();
+
+	if (LoadedBotClass == nullptr)
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Benchmark: bot class '%s' could not be loaded"), *BotClass.ToString());
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("Benchmark: %d steps, %.0fs warmup, %.0fs measured per step"), BotSteps.Num(), WarmupSeconds, MeasureSeconds);
+
+	StepIndex = 0;
+	BeginStep();
+}
+
+
+void ASBenchmarkRunner::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	PostPhysicsTick.UnRegisterTickFunction();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+
+void ASBenchmarkRunner::ParseCommandLine()
+{
+	FString StepsString;
+	if (FParse::Value(FCommandLine::Get(), TEXT("BenchSteps="), StepsString))
+	{
+		TArray<FString> StepStrings;
+		StepsString.ParseIntoArray(StepStrings, TEXT(","));
+
+		BotSteps.Reset();
+		for (const FString& Step : StepStrings)
+		{
+			BotSteps.Add(FCString::Atoi(*Step));
+		}
+	}
+
+	FString ClassPath;
+	if (FParse::Value(FCommandLine::Get(), TEXT("BenchBotClass="), ClassPath))
+	{
+		BotClass = FSoftClassPath(ClassPath);
+	}
+
+	FParse::Value(FCommandLine::Get(), TEXT("BenchWarmup="), WarmupSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchMeasure="), MeasureSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchThreshold="), RegressionThreshold);
+}
+
+
+int32 ASBenchmarkRunner::GetTargetCount(float PerBot, int32 NrOfBots, int32 Minimum) const
+{
+	return FMath::Max(FMath::RoundToInt(PerBot * NrOfBots), Minimum);
+}
+
+
+void ASBenchmarkRunner::BeginStep()
+{
+	if (!BotSteps.IsValidIndex(StepIndex))
+	{
+		Finish();
+		return;
+	}
+
+	FrameSamples.Reset();
+	GameThreadSamples.Reset();
+	PhysicsSamples.Reset();
+	OutBytesSamples.Reset();
+	OutBytesPerConnectionSamples.Reset();
+	FMemory::Memzero(SubsystemTotals);
+
+	Phase = EPhase::Warmup;
+	PhaseEndTime = GetWorld()->TimeSeconds + WarmupSeconds;
+
+	UE_LOG(LogCoopGame, Log, TEXT("Benchmark: step %d, %d bots"), StepIndex + 1, BotSteps[StepIndex]);
+}
+
+
+void ASBenchmarkRunner::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (Phase == EPhase::Warmup || Phase == EPhase::Measure)
+	{
+		MaintainPopulation();
+	}
+
+	if (Phase == EPhase::Measure)
+	{
+		SampleFrame();
+	}
+
+	if ((Phase == EPhase::Warmup || Phase == EPhase::Measure) && GetWorld()->TimeSeconds >= PhaseEndTime)
+	{
+		if (Phase == EPhase::Warmup)
+		{
+			Phase = EPhase::Measure;
+			PhaseEndTime = GetWorld()->TimeSeconds + MeasureSeconds;
+		}
+		else
+		{
+			EndStep();
+		}
+	}
+
+	PrePhysicsTime = FPlatformTime::Seconds();
+}
+
+
+void ASBenchmarkRunner::OnPostPhysicsTick()
+{
+	if (Phase == EPhase::Measure && PrePhysicsTime > 0.0)
+	{
+		PhysicsSamples.Add((float)((FPlatformTime::Seconds() - PrePhysicsTime) * 1000.0));
+	}
+}
+
+
+void ASBenchmarkRunner::SampleFrame()
+{
+	const FSFramePerf& Frame = FSPerfCounters::Get().GetLastFrame();
+
+	FrameSamples.Add(Frame.FrameMs);
+	GameThreadSamples.Add(Frame.GameThreadMs);
+
+	for (int32 i = 0; i < (int32)ECoopSubsystem::Count; i++)
+	{
+		SubsystemTotals[i] += Frame.SubsystemMs[i];
+	}
+
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	OutBytesSamples.Add(NetDriver ? NetDriver->OutBytesPerSecond : 0.0f);
+
+	if (NetDriver && NetDriver->ClientConnections.Num() > 0)
+	{
+		OutBytesPerConnectionSamples.Add((float)NetDriver->OutBytesPerSecond / NetDriver->ClientConnections.Num());
+	}
+}
+
+
+void ASBenchmarkRunner::MaintainPopulation()
+{
+	const int32 NrOfBots = BotSteps[StepIndex];
+
+	int32 SpawnBudget = SpawnsPerFrame;
+	TopUpShooters(GetTargetCount(ShootersPerBot, NrOfBots, 1), SpawnBudget);
+	TopUp(Bots, LoadedBotClass, NrOfBots, SpawnBudget);
+	TopUp(Barrels, LoadedBarrelClass, GetTargetCount(BarrelsPerBot, NrOfBots, 0), SpawnBudget);
+	TopUp(Pickups, LoadedPickupClass, GetTargetCount(PickupsPerBot, NrOfBots, 0), SpawnBudget);
+}
+
+
+int32 ASBenchmarkRunner::TopUp(TArray<TWeakObjectPtr<AActor>>& Population, UClass* ActorClass, int32 TargetCount, int32& SpawnBudget)
+{
+	Population.RemoveAll([](const TWeakObjectPtr<AActor>& Actor) { return !Actor.IsValid() || Actor->IsPendingKillPending(); });
+
+	if (ActorClass == nullptr)
+	{
+		return 0;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	int32 NrOfSpawned = 0;
+	while (Population.Num() < TargetCount && SpawnBudget > 0)
+	{
+		SpawnBudget--;
+
+		AActor* NewActor = GetWorld()->SpawnActor<AActor>(ActorClass, PickSpawnTransform(), SpawnParams);
+		if (NewActor == nullptr)
+		{
+			break;
+		}
+
+		Population.Add(NewActor);
+		NrOfSpawned++;
+	}
+
+	return NrOfSpawned;
+}
+
+
+void ASBenchmarkRunner::TopUpShooters(int32 TargetCount, int32& SpawnBudget)
+{
+	Shooters.RemoveAll([](const TWeakObjectPtr<ASSimulatedPlayerController>& Shooter) { return !Shooter.IsValid(); });
+
+	ASGameMode* GM = GetWorld()->GetAuthGameMode<ASGameMode>();
+	if (GM == nullptr)
+	{
+		return;
+	}
+
+	while (Shooters.Num() < TargetCount && SpawnBudget > 0)
+	{
+		SpawnBudget--;
+
+		ASSimulatedPlayerController* Shooter = GetWorld()->SpawnActor<ASSimulatedPlayerController>();
+		if (Shooter == nullptr)
+		{
+			break;
+		}
+
+		Shooter->SetPolicy(ESimulatedPlayerPolicy::HoldPosition);
+		Shooter->SetRandomSeed(Shooters.Num());
+		GM->RestartPlayer(Shooter);
+
+		// Shooters keep the population stable, bots can't take them out
+		if (Shooter->GetPawn())
+		{
+			Shooter->GetPawn()->bCanBeDamaged = false;
+		}
+
+		Shooters.Add(Shooter);
+	}
+}
+
+
+void ASBenchmarkRunner::DestroyPopulation()
+{
+	for (TArray<TWeakObjectPtr<AActor>>* Population : { &Bots, &Barrels, &Pickups })
+	{
+		for (const TWeakObjectPtr<AActor>& Actor : *Population)
+		{
+			if (Actor.IsValid())
+			{
+				Actor->Destroy();
+			}
+		}
+		Population->Reset();
+	}
+
+	for (const TWeakObjectPtr<ASSimulatedPlayerController>& Shooter : Shooters)
+	{
+		if (Shooter.IsValid())
+		{
+			if (Shooter->GetPawn())
+			{
+				Shooter->GetPawn()->Destroy();
+			}
+			Shooter->Destroy();
+		}
+	}
+	Shooters.Reset();
+}
+
+
+FTransform ASBenchmarkRunner::PickSpawnTransform() const
+{
+	FTransform SpawnTransform;
+
+	// Prefer the precomputed spawn points of the map
+	ASGameMode* GM = GetWorld()->GetAuthGameMode<ASGameMode>();
+	if (GM)
+	{
+		USSpawnPointCacheComponent* SpawnPointCache = Cast<USSpawnPointCacheComponent>(GM->GetComponentByClass(USSpawnPointCacheComponent::StaticClass()));
+		if (SpawnPointCache && SpawnPointCache->PickSpawnTransform(NAME_None, SpawnTransform))
+		{
+			return SpawnTransform;
+		}
+	}
+
+	FVector Location = GetActorLocation() + FSDeterminism::GetStream(this, ECoopRandomStream::Spawns).VRand() * FVector(ArenaRadius, ArenaRadius, 0.0f);
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	FNavLocation NavLocation;
+	if (NavSys && NavSys->ProjectPointToNavigation(Location, NavLocation))
+	{
+		Location = NavLocation.Location + FVector(0.0f, 0.0f, 50.0f);
+	}
+
+	SpawnTransform.SetLocation(Location);
+	return SpawnTransform;
+}
+
+
+static float AverageOf(const TArray<float>& Samples)
+{
+	float Total = 0.0f;
+	for (float Sample : Samples)
+	{
+		Total += Sample;
+	}
+	return Samples.Num() > 0 ? Total / Samples.Num() : 0.0f;
+}
+
+
+void ASBenchmarkRunner::EndStep()
+{
+	FSBenchmarkStepResult Result;
+	Result.NrOfBots = BotSteps[StepIndex];
+	Result.NrOfBarrels = Barrels.Num();
+	Result.NrOfPickups = Pickups.Num();
+	Result.NrOfShooters = Shooters.Num();
+	Result.NrOfFrames = FrameSamples.Num();
+	Result.AvgFrameMs = AverageOf(FrameSamples);
+	Result.AvgGameThreadMs = AverageOf(GameThreadSamples);
+	Result.AvgPhysicsMs = AverageOf(PhysicsSamples);
+	Result.AvgOutBytesPerSecond = AverageOf(OutBytesSamples);
+	Result.AvgOutBytesPerConnection = AverageOf(OutBytesPerConnectionSamples);
+
+	TArray<float> SortedFrames = FrameSamples;
+	SortedFrames.Sort();
+	Result.P95FrameMs = SortedFrames.Num() > 0 ? SortedFrames[FMath::Min(FMath::FloorToInt(SortedFrames.Num() * 0.95f), SortedFrames.Num() - 1)] : 0.0f;
+	Result.MaxFrameMs = SortedFrames.Num() > 0 ? SortedFrames.Last() : 0.0f;
+
+	for (int32 i = 0; i < (int32)ECoopSubsystem::Count; i++)
+	{
+		Result.AvgSubsystemMs[i] = Result.NrOfFrames > 0 ? SubsystemTotals[i] / Result.NrOfFrames : 0.0f;
+	}
+
+	Results.Add(Result);
+
+	UE_LOG(LogCoopGame, Log, TEXT("Benchmark: %d bots -> frame %.2fms (p95 %.2fms), game thread %.2fms, physics %.2fms, replication %.2fms, out %.0f B/s (%.0f B/s per connection)"),
+		Result.NrOfBots, Result.AvgFrameMs, Result.P95FrameMs, Result.AvgGameThreadMs, Result.AvgPhysicsMs,
+		Result.AvgSubsystemMs[(int32)ECoopSubsystem::Replication], Result.AvgOutBytesPerSecond, Result.AvgOutBytesPerConnection);
+
+	DestroyPopulation();
+
+	StepIndex++;
+	BeginStep();
+}
+
+
+TSharedRef<FJsonObject> ASBenchmarkRunner::ResultsToJson() const
+{
+	TSharedRef<FJsonObject> Root = MakeShareable(new FJsonObject());
+	Root->SetStringField(TEXT("Map"), GetWorld()->GetMapName());
+	Root->SetStringField(TEXT("Date"), FDateTime::UtcNow().ToIso8601());
+
+	TArray<TSharedPtr<FJsonValue>> Steps;
+	for (const FSBenchmarkStepResult& Result : Results)
+	{
+		TSharedRef<FJsonObject> Step = MakeShareable(new FJsonObject());
+		Step->SetNumberField(TEXT("Bots"), Result.NrOfBots);
+		Step->SetNumberField(TEXT("Barrels"), Result.NrOfBarrels);
+		Step->SetNumberField(TEXT("Pickups"), Result.NrOfPickups);
+		Step->SetNumberField(TEXT("Shooters"), Result.NrOfShooters);
+		Step->SetNumberField(TEXT("Frames"), Result.NrOfFrames);
+		Step->SetNumberField(TEXT("AvgFrameMs"), Result.AvgFrameMs);
+		Step->SetNumberField(TEXT("P95FrameMs"), Result.P95FrameMs);
+		Step->SetNumberField(TEXT("MaxFrameMs"), Result.MaxFrameMs);
+		Step->SetNumberField(TEXT("AvgGameThreadMs"), Result.AvgGameThreadMs);
+		Step->SetNumberField(TEXT("AvgPhysicsMs"), Result.AvgPhysicsMs);
+		Step->SetNumberField(TEXT("AvgOutBytesPerSecond"), Result.AvgOutBytesPerSecond);
+		Step->SetNumberField(TEXT("AvgOutBytesPerConnection"), Result.AvgOutBytesPerConnection);
+		Step->SetNumberField(TEXT("AvgReplicationMs"), Result.AvgSubsystemMs[(int32)ECoopSubsystem::Replication]);
+
+		TSharedRef<FJsonObject> Subsystems = MakeShareable(new FJsonObject());
+		for (int32 i = 0; i < (int32)ECoopSubsystem::Count; i++)
+		{
+			Subsystems->SetNumberField(FSPerfCounters::GetSubsystemName((ECoopSubsystem)i), Result.AvgSubsystemMs[i]);
+		}
+		Step->SetObjectField(TEXT("SubsystemMs"), Subsystems);
+
+		Steps.Add(MakeShareable(new FJsonValueObject(Step)));
+	}
+	Root->SetArrayField(TEXT("Steps"), Steps);
+
+	return Root;
+}
+
+
+bool ASBenchmarkRunner::CompareToBaseline(const FString& BaselinePath) const
+{
+	FString BaselineString;
+	if (!FFileHelper::LoadFileToString(BaselineString, *BaselinePath))
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Benchmark: no baseline at %s, nothing to compare against"), *BaselinePath);
+		return true;
+	}
+
+	TSharedPtr<FJsonObject> Baseline;
+	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(BaselineString);
+	if (!FJsonSerializer::Deserialize(Reader, Baseline) || !Baseline.IsValid())
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Benchmark: baseline %s is not valid json"), *BaselinePath);
+		return false;
+	}
+
+	static const TCHAR* ComparedMetrics[] = { TEXT("AvgFrameMs"), TEXT("P95FrameMs"), TEXT("AvgGameThreadMs"), TEXT("AvgPhysicsMs"), TEXT("AvgOutBytesPerSecond"),
+		TEXT("AvgOutBytesPerConnection"), TEXT("AvgReplicationMs") };
+
+	TSharedRef<FJsonObject> Current = ResultsToJson();
+
+	bool bPassed = true;
+	for (const TSharedPtr<FJsonValue>& BaseValue : Baseline->GetArrayField(TEXT("Steps")))
+	{
+		const TSharedPtr<FJsonObject>& BaseStep = BaseValue->AsObject();
+		const int32 NrOfBots = (int32)BaseStep->GetNumberField(TEXT("Bots"));
+
+		for (const TSharedPtr<FJsonValue>& CurrentValue : Current->GetArrayField(TEXT("Steps")))
+		{
+			const TSharedPtr<FJsonObject>& CurrentStep = CurrentValue->AsObject();
+			if ((int32)CurrentStep->GetNumberField(TEXT("Bots")) != NrOfBots)
+			{
+				continue;
+			}
+
+			for (const TCHAR* Metric : ComparedMetrics)
+			{
+				// Baselines written before a metric existed don't have it
+				double BaseMetric = 0.0;
+				BaseStep->TryGetNumberField(Metric, BaseMetric);
+				const double CurrentMetric = CurrentStep->GetNumberField(Metric);
+
+				// Ignore metrics that are too small to compare relatively (eg. no net traffic without clients)
+				if (BaseMetric > KINDA_SMALL_NUMBER && CurrentMetric > BaseMetric * (1.0 + RegressionThreshold))
+				{
+					UE_LOG(LogCoopGame, Error, TEXT("Benchmark: %d bots %s regressed %.3f -> %.3f (+%.1f%%, allowed %.1f%%)"),
+						NrOfBots, Metric, BaseMetric, CurrentMetric, (CurrentMetric / BaseMetric - 1.0) * 100.0, RegressionThreshold * 100.0f);
+					bPassed = false;
+				}
+			}
+		}
+	}
+
+	return bPassed;
+}
+
+
+void ASBenchmarkRunner::Finish()
+{
+	Phase = EPhase::Done;
+
+	const FString BenchmarkDir = FPaths::ProjectSavedDir() / TEXT("Benchmarks");
+
+	FString BaselinePath = BenchmarkDir / TEXT("Baseline.json");
+	FParse::Value(FCommandLine::Get(), TEXT("BenchBaseline="), BaselinePath);
+
+	const bool bPassed = CompareToBaseline(BaselinePath);
+
+	TSharedRef<FJsonObject> Root = ResultsToJson();
+	Root->SetStringField(TEXT("Baseline"), BaselinePath);
+	Root->SetNumberField(TEXT("RegressionThreshold"), RegressionThreshold);
+	Root->SetStringField(TEXT("Result"), bPassed ? TEXT("Passed") : TEXT("Failed"));
+
+	FString Output;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Root, Writer);
+
+	const FString ResultPath = BenchmarkDir / FString::Printf(TEXT("Horde-%s.json"), *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(Output, *ResultPath);
+
+	// Accept the current numbers as the new baseline
+	if (FParse::Param(FCommandLine::Get(), TEXT("BenchWriteBaseline")))
+	{
+		FFileHelper::SaveStringToFile(Output, *BaselinePath);
+	}
+
+	if (bPassed)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Benchmark PASSED, results written to %s"), *ResultPath);
+	}
+	else
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Benchmark FAILED, results written to %s"), *ResultPath);
+	}
+
+	if (bExitWhenDone)
+	{
+		// A failed gate has to fail the CI step, which only sees the exit code
+		FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+	}
+	else
+	{
+		Destroy();
+	}
+}
@@ -0,0 +1,250 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SCosmeticPolicy.h"
+#include "CoopGame.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "HAL/IConsoleManager.h"
+
+
+static int32 CosmeticGating = 1;
+FAutoConsoleVariableRef CVARCosmeticGating(
+	TEXT("COOP.CosmeticGating"),
+	CosmeticGating,
+	TEXT("Skip presentation work nobody on this machine sees or hears, 0 plays everything"),
+	ECVF_Default);
+
+static float CosmeticViewTolerance = 0.2f;
+FAutoConsoleVariableRef CVARCosmeticViewTolerance(
+	TEXT("COOP.CosmeticViewTolerance"),
+	CosmeticViewTolerance,
+	TEXT("Seconds since an actor was last rendered for a listen server to still play its effects"),
+	ECVF_Default);
+
+
+static void CosmeticReportCommand(const TArray<FString>& Args)
+{
+	if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+	{
+		FSCosmeticPolicy::Get().ResetCounters();
+		return;
+	}
+
+	FSCosmeticPolicy::Get().LogReport();
+}
+
+FAutoConsoleCommand CosmeticReportConsoleCommand(
+	TEXT("COOP.CosmeticReport"),
+	TEXT("Log the presentation work every call site played and skipped, 'reset' clears the counts"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&CosmeticReportCommand));
+
+
+namespace
+{
+	// Effects at a location just outside the view still reach into it
+	const float ViewConePaddingDegrees = 15.0f;
+
+	// Anything this close to the camera counts as seen, whichever way it looks
+	const float NearViewRadius = 300.0f;
+
+	const TCHAR* GetKindName(ECoopCosmetic Kind)
+	{
+		switch (Kind)
+		{
+		case ECoopCosmetic::Effect:			return TEXT("effect");
+		case ECoopCosmetic::Sound:			return TEXT("sound");
+		case ECoopCosmetic::State:			return TEXT("state");
+		case ECoopCosmetic::CameraShake:	return TEXT("camera shake");
+		default:							return TEXT("unknown");
+		}
+	}
+}
+
+
+FSCosmeticPolicy::FSCosmeticPolicy()
+{
+}
+
+
+FSCosmeticPolicy& FSCosmeticPolicy::Get()
+{
+	static FSCosmeticPolicy Instance;
+	return Instance;
+}
+
+
+bool FSCosmeticPolicy::ShouldPlay(const AActor* Actor, ECoopCosmetic Kind, FName Site)
+{
+	if (Actor == nullptr)
+	{
+		return false;
+	}
+
+	if (!CosmeticGating)
+	{
+		return Record(Site, Kind, true, ECoopCosmeticSkip::Count);
+	}
+
+	const ENetMode NetMode = Actor->GetNetMode();
+	if (NetMode == NM_DedicatedServer)
+	{
+		return Record(Site, Kind, false, ECoopCosmeticSkip::DedicatedServer);
+	}
+
+	if (NetMode == NM_ListenServer && Kind == ECoopCosmetic::Effect && !IsActorViewed(Actor))
+	{
+		return Record(Site, Kind, false, ECoopCosmeticSkip::NotViewed);
+	}
+
+	return Record(Site, Kind, true, ECoopCosmeticSkip::Count);
+}
+
+
+bool FSCosmeticPolicy::ShouldPlayAt(const UWorld* World, const FVector& Location, ECoopCosmetic Kind, FName Site)
+{
+	if (World == nullptr)
+	{
+		return false;
+	}
+
+	if (!CosmeticGating)
+	{
+		return Record(Site, Kind, true, ECoopCosmeticSkip::Count);
+	}
+
+	const ENetMode NetMode = World->GetNetMode();
+	if (NetMode == NM_DedicatedServer)
+	{
+		return Record(Site, Kind, false, ECoopCosmeticSkip::DedicatedServer);
+	}
+
+	if (NetMode == NM_ListenServer && Kind == ECoopCosmetic::Effect && !IsViewedByLocalPlayer(World, Location))
+	{
+		return Record(Site, Kind, false, ECoopCosmeticSkip::NotViewed);
+	}
+
+	return Record(Site, Kind, true, ECoopCosmeticSkip::Count);
+}
+
+
+bool FSCosmeticPolicy::ShouldPlayCameraShake(const APlayerController* PC, FName Site)
+{
+	if (PC == nullptr)
+	{
+		return false;
+	}
+
+	if (!CosmeticGating)
+	{
+		return Record(Site, ECoopCosmetic::CameraShake, true, ECoopCosmeticSkip::Count);
+	}
+
+	if (PC->GetNetMode() == NM_DedicatedServer)
+	{
+		return Record(Site, ECoopCosmetic::CameraShake, false, ECoopCosmeticSkip::DedicatedServer);
+	}
+
+	// On the server this would be an RPC per shake, for a player whose own machine already played it
+	if (!PC->IsLocalController())
+	{
+		return Record(Site, ECoopCosmetic::CameraShake, false, ECoopCosmeticSkip::NotLocal);
+	}
+
+	return Record(Site, ECoopCosmetic::CameraShake, true, ECoopCosmeticSkip::Count);
+}
+
+
+bool FSCosmeticPolicy::IsActorViewed(const AActor* Actor) const
+{
+	// Whatever a local player does is always theirs to see, eg. their own weapon
+	const APawn* Pawn = Cast<APawn>(Actor);
+	const APawn* OwningPawn = Pawn ? Pawn : Cast<APawn>(Actor->GetOwner());
+	if (OwningPawn && OwningPawn->IsLocallyControlled())
+	{
+		return true;
+	}
+
+	return Actor->WasRecentlyRendered(CosmeticViewTolerance);
+}
+
+
+bool FSCosmeticPolicy::IsViewedByLocalPlayer(const UWorld* World, const FVector& Location) const
+{
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		if (PC == nullptr || !PC->IsLocalController() || PC->PlayerCameraManager == nullptr)
+		{
+			continue;
+		}
+
+		const FVector CameraLocation = PC->PlayerCameraManager->GetCameraLocation();
+		const FVector ToLocation = Location - CameraLocation;
+		if (ToLocation.SizeSquared() <= FMath::Square(NearViewRadius))
+		{
+			return true;
+		}
+
+		const float HalfConeRadians = FMath::DegreesToRadians(FMath::Min(PC->PlayerCameraManager->GetFOVAngle() * 0.5f + ViewConePaddingDegrees, 89.0f));
+		if (FVector::DotProduct(PC->PlayerCameraManager->GetCameraRotation().Vector(), ToLocation.GetSafeNormal()) >= FMath::Cos(HalfConeRadians))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool FSCosmeticPolicy::Record(FName Site, ECoopCosmetic Kind, bool bPlay, ECoopCosmeticSkip Reason)
+{
+	FSiteCounters& Counters = Sites.FindOrAdd(Site);
+	Counters.Kind = Kind;
+
+	if (bPlay)
+	{
+		Counters.NrOfPlayed++;
+	}
+	else
+	{
+		Counters.NrOfSkipped[(int32)Reason]++;
+	}
+
+	return bPlay;
+}
+
+
+void FSCosmeticPolicy::ResetCounters()
+{
+	Sites.Reset();
+}
+
+
+void FSCosmeticPolicy::LogReport() const
+{
+	int32 TotalPlayed = 0;
+	int32 TotalSkipped = 0;
+	for (const TPair<FName, FSiteCounters>& Pair : Sites)
+	{
+		TotalPlayed += Pair.Value.NrOfPlayed;
+		for (int32 NrOfSkipped : Pair.Value.NrOfSkipped)
+		{
+			TotalSkipped += NrOfSkipped;
+		}
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("Cosmetics: %d call sites, %d played, %d skipped%s"), Sites.Num(), TotalPlayed, TotalSkipped,
+		CosmeticGating ? TEXT("") : TEXT(" (gating off)"));
+
+	for (const TPair<FName, FSiteCounters>& Pair : Sites)
+	{
+		const FSiteCounters& Counters = Pair.Value;
+		UE_LOG(LogCoopGame, Log, TEXT("  %-36s %-12s played %7d  skipped: dedicated %7d  not viewed %7d  not local %7d"),
+			*Pair.Key.ToString(), GetKindName(Counters.Kind), Counters.NrOfPlayed,
+			Counters.NrOfSkipped[(int32)ECoopCosmeticSkip::DedicatedServer],
+			Counters.NrOfSkipped[(int32)ECoopCosmeticSkip::NotViewed],
+			Counters.NrOfSkipped[(int32)ECoopCosmeticSkip::NotLocal]);
+	}
+}
@@ -0,0 +1,239 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SDeterminism.h"
+#include "CoopGame.h"
+#include "Engine/World.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+
+namespace
+{
+	// Bumped whenever FSInputFrame changes
+	const int32 InputRecordingVersion = 1;
+
+	bool bDeterministic = false;
+
+	int32 Seed = 1;
+
+	struct FMatchStreams
+	{
+		FRandomStream Streams[(int32)ECoopRandomStream::Count];
+
+		uint64 MatchStartFrame;
+
+		FMatchStreams()
+			: MatchStartFrame(0)
+		{
+		}
+
+		void Reset()
+		{
+			// Offset the seed per stream, otherwise every stream would produce the same numbers
+			for (int32 i = 0; i < (int32)ECoopRandomStream::Count; i++)
+			{
+				Streams[i].Initialize(Seed + i * 7919);
+			}
+
+			MatchStartFrame = GFrameCounter;
+		}
+	};
+
+	TMap<TWeakObjectPtr<const UWorld>, FMatchStreams> WorldStreams;
+
+	// Anything asking without a world
+	FMatchStreams DefaultStreams;
+
+	FMatchStreams& FindOrAddStreams(const UWorld* World)
+	{
+		if (World == nullptr)
+		{
+			return DefaultStreams;
+		}
+
+		FMatchStreams* Found = WorldStreams.Find(World);
+		if (Found == nullptr)
+		{
+			Found = &WorldStreams.Add(World);
+			Found->Reset();
+		}
+		return *Found;
+	}
+
+	FString RecordPath;
+
+	FString ReplayPath;
+
+	// Dense, index is the match frame
+	TArray<FSInputFrame> InputFrames;
+}
+
+
+void FSDeterminism::Initialize()
+{
+	FParse::Value(FCommandLine::Get(), TEXT("RecordInput="), RecordPath);
+	FParse::Value(FCommandLine::Get(), TEXT("ReplayInput="), ReplayPath);
+
+	// Recording or replaying input only makes sense if the rest of the simulation is reproducible too
+	bDeterministic = FParse::Param(FCommandLine::Get(), TEXT("CoopDeterministic")) || !RecordPath.IsEmpty() || !ReplayPath.IsEmpty();
+
+	if (bDeterministic)
+	{
+		FParse::Value(FCommandLine::Get(), TEXT("CoopSeed="), Seed);
+
+		int32 FixedFPS = 30;
+		FParse::Value(FCommandLine::Get(), TEXT("CoopFixedFPS="), FixedFPS);
+
+		// Every frame advances the world by the same amount, no matter how long it took
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(1.0 / FMath::Max(FixedFPS, 1));
+
+		UE_LOG(LogCoopGame, Log, TEXT("Deterministic mode: seed %d, %d fps fixed timestep"), Seed, FixedFPS);
+	}
+	else
+	{
+		Seed = (int32)FPlatformTime::Cycles();
+	}
+
+	if (!ReplayPath.IsEmpty())
+	{
+		TArray<uint8> Data;
+		if (FFileHelper::LoadFileToArray(Data, *ReplayPath))
+		{
+			FMemoryReader Reader(Data);
+
+			int32 Version = 0;
+			Reader << Version;
+			if (Version == InputRecordingVersion)
+			{
+				Reader << InputFrames;
+			}
+			else
+			{
+				UE_LOG(LogCoopGame, Error, TEXT("Input recording %s has version %d, expected %d"), *ReplayPath, Version, InputRecordingVersion);
+			}
+		}
+
+		UE_LOG(LogCoopGame, Log, TEXT("Replaying %d input frames from %s"), InputFrames.Num(), *ReplayPath);
+	}
+
+	DefaultStreams.Reset();
+}
+
+
+void FSDeterminism::Shutdown()
+{
+	if (RecordPath.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+
+	int32 Version = InputRecordingVersion;
+	Writer << Version;
+	Writer << InputFrames;
+
+	FFileHelper::SaveArrayToFile(Data, *RecordPath);
+
+	UE_LOG(LogCoopGame, Log, TEXT("Recorded %d input frames to %s"), InputFrames.Num(), *RecordPath);
+}
+
+
+bool FSDeterminism::IsEnabled()
+{
+	return bDeterministic;
+}
+
+
+int32 FSDeterminism::GetSeed()
+{
+	return Seed;
+}
+
+
+FRandomStream& FSDeterminism::GetStream(const UObject* WorldContextObject, ECoopRandomStream Stream)
+{
+	const UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return FindOrAddStreams(World).Streams[(int32)Stream];
+}
+
+
+void FSDeterminism::BeginMatch(const UWorld* World)
+{
+	// Worlds of finished matches
+	for (auto It = WorldStreams.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	const bool bOtherMatchesRunning = WorldStreams.Num() > (WorldStreams.Contains(World) ? 1 : 0);
+
+	FindOrAddStreams(World).Reset();
+
+	// Engine code we don't control (eg. navmesh random points) still uses the global generator. There is only one of
+	// it, so it is only reproducible for the first match of the process
+	if (bDeterministic && !bOtherMatchesRunning)
+	{
+		FMath::RandInit(Seed);
+		FMath::SRandInit(Seed);
+	}
+
+	if (!RecordPath.IsEmpty())
+	{
+		InputFrames.Reset();
+	}
+}
+
+
+int32 FSDeterminism::GetMatchFrame(const UWorld* World)
+{
+	return (int32)(GFrameCounter - FindOrAddStreams(World).MatchStartFrame);
+}
+
+
+bool FSDeterminism::IsRecordingInput()
+{
+	return !RecordPath.IsEmpty();
+}
+
+
+bool FSDeterminism::IsReplayingInput()
+{
+	return !ReplayPath.IsEmpty();
+}
+
+
+void FSDeterminism::RecordInputFrame(int32 Frame, const FSInputFrame& Input)
+{
+	if (Frame < 0)
+	{
+		return;
+	}
+
+	if (Frame >= InputFrames.Num())
+	{
+		InputFrames.SetNum(Frame + 1);
+	}
+
+	InputFrames[Frame] = Input;
+}
+
+
+bool FSDeterminism::GetReplayInputFrame(int32 Frame, FSInputFrame& OutInput)
+{
+	if (!InputFrames.IsValidIndex(Frame))
+	{
+		OutInput = FSInputFrame();
+		return false;
+	}
+
+	OutInput = InputFrames[Frame];
+	return true;
+}
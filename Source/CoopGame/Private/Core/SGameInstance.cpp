@@ -9,6 +9,9 @@
 #include "OnlineSessionInterface.h"
 #include "Kismet/GameplayStatics.h"
 #include "Online.h"
+#include "SMatchHost.h"
+#include "SSessionBrowser.h"
+#include "STravelPipeline.h"
 
 USGameInstance::USGameInstance(const FObjectInitializer& ObjectInitializer)
 {
@@ -16,9 +19,6 @@ USGameInstance::USGameInstance(const FObjectInitializer& ObjectInitializer)
 	OnCreateSessionCompleteDelegate = FOnCreateSessionCompleteDelegate::CreateUObject(this, &USGameInstance::OnCreateSessionComplete);
 	OnStartSessionCompleteDelegate = FOnStartSessionCompleteDelegate::CreateUObject(this, &USGameInstance::OnStartOnlineGameComplete);
 
-	/** Bind function for FINDING a Session */
-	OnFindSessionsCompleteDelegate = FOnFindSessionsCompleteDelegate::CreateUObject(this, &USGameInstance::OnFindSessionsComplete);
-
 	/** Bind function for JOINING a Session */
 	OnJoinSessionCompleteDelegate = FOnJoinSessionCompleteDelegate::CreateUObject(this, &USGameInstance::OnJoinSessionComplete);
 
@@ -42,6 +42,12 @@ bool USGameInstance::HostSession(TSharedPtr<const FUniqueNetId> UserId, FName Se
 
 		if (Sessions.IsValid() && UserId.IsValid())
 		{
+			// Nothing to browse for while we host
+			if (SessionBrowser)
+			{
+				SessionBrowser->Stop();
+			}
+
 			/*
 				Fill in all the Session Settings that we want to use.
 
@@ -62,9 +68,21 @@ bool USGameInstance::HostSession(TSharedPtr<const FUniqueNetId> UserId, FName Se
 
 			SessionSettings->Set(SETTING_MAPNAME, FString("NewMap"), EOnlineDataAdvertisementType::ViaOnlineService);
 
+			// Clients ping this port to rank us against other hosts before they join
+			const int32 ProbePort = PingResponder.Start(0);
+			if (ProbePort > 0)
+			{
+				SessionSettings->Set(SETTING_COOP_PROBEPORT, ProbePort, EOnlineDataAdvertisementType::ViaOnlineService);
+			}
+
 			// Set the delegate to the Handle of the SessionInterface
 			OnCreateSessionCompleteDelegateHandle = Sessions->AddOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegate);
 
+			if (TravelPipeline)
+			{
+				TravelPipeline->BeginMeasure(TEXT("host"));
+			}
+
 			// Our delegate should get called when this is complete (doesn't need to be successful!)
 			return Sessions->CreateSession(*UserId, SessionName, *SessionSettings);
 		}
@@ -101,6 +119,10 @@ void USGameInstance::OnCreateSessionComplete(FName SessionName, bool bWasSuccess
 				// Our StartSessionComplete delegate should get called after this
 				Sessions->StartSession(SessionName);
 			}
+			else
+			{
+				PingResponder.Stop();
+			}
 		}
 
 	}
@@ -125,9 +147,12 @@ void USGameInstance::OnStartOnlineGameComplete(FName SessionName, bool bWasSucce
 	}
 
 	// If the start was successful, we can open a NewMap if we want. Make sure to use "listen" as a parameter!
-	if (bWasSuccessful)
+	if (bWasSuccessful && TravelPipeline)
 	{
-		UGameplayStatics::OpenLevel(GetWorld(), "NewMap", true, "listen");
+		TravelPipeline->MarkPhase(TEXT("session started"));
+
+		// Keeps the current map running until NewMap is loaded in the background
+		TravelPipeline->TravelToMap(TEXT("NewMap"), TEXT("listen"));
 	}
 }
 
@@ -137,80 +162,13 @@ void USGameInstance::OnStartOnlineGameComplete(FName SessionName, bool bWasSucce
 
 void USGameInstance::FindSessions(TSharedPtr<const FUniqueNetId> UserId, bool bIsLAN, bool bIsPresence)
 {
-	// Get the OnlineSubsystem we want to work with
-	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
-
-	if (OnlineSub)
-	{
-		// Get the SessionInterface from our OnlineSubsystem
-		IOnlineSessionPtr Sessions = OnlineSub->GetSessionInterface();
-
-		if (Sessions.IsValid() && UserId.IsValid())
-		{
-			/*
-				Fill in all the SearchSettings, like if we are searching for a LAN game and how many results we want to have!
-			*/
-			SessionSearch = MakeShareable(new FOnlineSessionSearch());
-
-			SessionSearch->bIsLanQuery = bIsLAN;
-			SessionSearch->MaxSearchResults = 20;
-			SessionSearch->PingBucketSize = 50;
-
-			// We only want to set this Query Setting if "bIsPresence" is true
-			if (bIsPresence)
-			{
-				SessionSearch->QuerySettings.Set(SEARCH_PRESENCE, bIsPresence, EOnlineComparisonOp::Equals);
-			}
-
-			TSharedRef<FOnlineSessionSearch> SearchSettingsRef = SessionSearch.ToSharedRef();
-
-			// Set the Delegate to the Delegate Handle of the FindSession function
-			OnFindSessionsCompleteDelegateHandle = Sessions->AddOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegate);
-
-			// Finally call the SessionInterface function. The Delegate gets called once this is finished
-			Sessions->FindSessions(*UserId, SearchSettingsRef);
-		}
-	}
-	else
+	if (SessionBrowser == nullptr)
 	{
-		// If something goes wrong, just call the Delegate Function directly with "false".
-		OnFindSessionsComplete(false);
+		return;
 	}
-}
-
-
-void USGameInstance::OnFindSessionsComplete(bool bWasSuccessful)
-{
-	GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("OFindSessionsComplete bSuccess: %d"), bWasSuccessful));
-
-	// Get OnlineSubsystem we want to work with
-	IOnlineSubsystem* const OnlineSub = IOnlineSubsystem::Get();
-	if (OnlineSub)
-	{
-		// Get SessionInterface of the OnlineSubsystem
-		IOnlineSessionPtr Sessions = OnlineSub->GetSessionInterface();
-		if (Sessions.IsValid())
-		{
-			// Clear the Delegate handle, since we finished this call
-			Sessions->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
-
-			// Just debugging the Number of Search results. Can be displayed in UMG or something later on
-			GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("Num Search Results: %d"), SessionSearch->SearchResults.Num()));
 
-			// If we have found at least 1 session, we just going to debug them. You could add them to a list of UMG Widgets, like it is done in the BP version!
-			if (SessionSearch->SearchResults.Num() > 0)
-			{
-				// "SessionSearch->SearchResults" is an Array that contains all the information. You can access the Session in this and get a lot of information.
-				// This can be customized later on with your own classes to add more information that can be set and displayed
-				for (int32 SearchIdx = 0; SearchIdx < SessionSearch->SearchResults.Num(); SearchIdx++)
-				{
-					// OwningUserName is just the SessionName for now. I guess you can create your own Host Settings class and GameSession Class and add a proper GameServer Name here.
-					// This is something you can't do in Blueprint for example!
-					GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Red, FString::Printf(TEXT("Session Number: %d | Sessionname: %s "), SearchIdx + 1, *(SessionSearch->SearchResults[SearchIdx].Session.OwningUserName)));
-				}
-			}
-		}
-	}
+	// Searches right away and keeps the results fresh, UI reads them from the browser whenever it wants
+	SessionBrowser->Start(UserId, bIsLAN, bIsPresence);
 }
 
 
@@ -232,6 +190,17 @@ bool USGameInstance::JoinSession(TSharedPtr<const FUniqueNetId> UserId, FName Se
 
 		if (Sessions.IsValid() && UserId.IsValid())
 		{
+			// Searching on while we travel would only compete for the connection
+			if (SessionBrowser)
+			{
+				SessionBrowser->Stop();
+			}
+
+			if (TravelPipeline)
+			{
+				TravelPipeline->BeginMeasure(TEXT("join"));
+			}
+
 			// Set the Handle again
 			OnJoinSessionCompleteDelegateHandle = Sessions->AddOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegate);
 
@@ -261,20 +230,24 @@ void USGameInstance::OnJoinSessionComplete(FName SessionName, EOnJoinSessionComp
 			// Clear the Delegate again
 			Sessions->ClearOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegateHandle);
 
-			// Get the first local PlayerController, so we can call "ClientTravel" to get to the Server Map
-			// This is something the Blueprint Node "Join Session" does automatically!
-			APlayerController * const PlayerController = GetFirstLocalPlayerController();
-
 			// We need a FString to use ClientTravel and we can let the SessionInterface contruct such a
 			// String for us by giving him the SessionName and an empty String. We want to do this, because
 			// Every OnlineSubsystem uses different TravelURLs
 			FString TravelURL;
 
-			if (PlayerController && Sessions->GetResolvedConnectString(SessionName, TravelURL))
+			if (TravelPipeline && Sessions->GetResolvedConnectString(SessionName, TravelURL))
 			{
-				// Finally call the ClienTravel. If you want, you could print the TravelURL to see
-				// how it really looks like
-				PlayerController->ClientTravel(TravelURL, ETravelType::TRAVEL_Absolute);
+				TravelPipeline->MarkPhase(TEXT("session joined"));
+
+				// The host advertises its map, so we can start loading it while we connect
+				FString MapName;
+				FNamedOnlineSession* Session = Sessions->GetNamedSession(SessionName);
+				if (Session)
+				{
+					Session->SessionSettings.Get(SETTING_MAPNAME, MapName);
+				}
+
+				TravelPipeline->TravelToServer(TravelURL, MapName);
 			}
 		}
 	}
@@ -300,11 +273,12 @@ void USGameInstance::OnDestroySessionComplete(FName SessionName, bool bWasSucces
 			// Clear the Delegate
 			Sessions->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
 
-			// If it was successful, we just load another level (could be a MainMenu!)
-			if (bWasSuccessful)
+			PingResponder.Stop();
 
+			// If it was successful, we just load another level (could be a MainMenu!)
+			if (bWasSuccessful && TravelPipeline)
 			{
-				UGameplayStatics::OpenLevel(GetWorld(), "ThirdPersonExampleMap", true);
+				TravelPipeline->TravelToMap(TEXT("ThirdPersonExampleMap"), FString());
 			}
 		}
 	}
@@ -324,32 +298,48 @@ void USGameInstance::FindOnlineGames()
 
 void USGameInstance::JoinOnlineGame()
 {
-	ULocalPlayer* const Player = GetFirstGamePlayer();
+	if (SessionBrowser == nullptr)
+	{
+		return;
+	}
 
-	// Just a SearchResult where we can save the one we want to use, for the case we find more than one!
-	FOnlineSessionSearchResult SearchResult;
+	// Measure the hosts first, the pings of the search are bucketed and say nothing about jitter or loss
+	SessionBrowser->ProbeSessions(FSimpleDelegate::CreateUObject(this, &USGameInstance::JoinBestSession));
+}
 
-	// If the Array is not empty, we can go through it
-	if (SessionSearch->SearchResults.Num() > 0)
+
+void USGameInstance::JoinBestSession()
+{
+	if (SessionBrowser == nullptr)
 	{
-		for (int32 i = 0; i < SessionSearch->SearchResults.Num(); i++)
-		{
-			// To avoid something crazy, we filter sessions from ourself
-			if (SessionSearch->SearchResults[i].Session.OwningUserId != Player->GetPreferredUniqueNetId())
-			{
-				SearchResult = SessionSearch->SearchResults[i];
+		return;
+	}
 
-				// Once we found sounce a Session that is not ours, just join it. Instead of using a for loop, you could
-				// use a widget where you click on and have a reference for the GameSession it represents which you can use
-				// here
-				JoinSession(Player->GetPreferredUniqueNetId(), GameSessionName, SearchResult);
-				break;
-			}
-		}
+	// Full sessions and our own are already left out
+	TArray<FSSessionBrowserEntry> Sessions;
+	SessionBrowser->GetSessions(FSSessionFilter(), ESessionSortKey::Best, Sessions);
+
+	if (Sessions.Num() > 0)
+	{
+		JoinBrowsedSession(Sessions[0].SessionId);
 	}
 }
 
 
+bool USGameInstance::JoinBrowsedSession(const FString& SessionId)
+{
+	ULocalPlayer* const Player = GetFirstGamePlayer();
+
+	FOnlineSessionSearchResult SearchResult;
+	if (Player == nullptr || SessionBrowser == nullptr || !SessionBrowser->FindSearchResult(SessionId, SearchResult))
+	{
+		return false;
+	}
+
+	return JoinSession(Player->GetPreferredUniqueNetId(), GameSessionName, SearchResult);
+}
+
+
 void USGameInstance::DestroySessionAndLeaveGame()
 {
 	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
@@ -364,4 +354,59 @@ void USGameInstance::DestroySessionAndLeaveGame()
 			Sessions->DestroySession(GameSessionName);
 		}
 	}
-}
\ No newline at end of file
+}
+
+
+// ------- MATCH HOSTING ------- \\
+
+
+USSessionBrowser* USGameInstance::GetSessionBrowser() const
+{
+	return SessionBrowser;
+}
+
+
+void USGameInstance::OnStart()
+{
+	Super::OnStart();
+
+	//Only dedicated servers pack several matches into one process
+	if (IsDedicatedServerInstance())
+	{
+		MatchHost = NewObject<USMatchHost>(this);
+		MatchHost->Initialize(this);
+	}
+	else
+	{
+		SessionBrowser = NewObject<USSessionBrowser>(this);
+
+		TravelPipeline = NewObject<USTravelPipeline>(this);
+		TravelPipeline->Initialize(this);
+	}
+}
+
+
+void USGameInstance::Shutdown()
+{
+	if (MatchHost)
+	{
+		MatchHost->Shutdown();
+		MatchHost = nullptr;
+	}
+
+	if (SessionBrowser)
+	{
+		SessionBrowser->Stop();
+		SessionBrowser = nullptr;
+	}
+
+	if (TravelPipeline)
+	{
+		TravelPipeline->Shutdown();
+		TravelPipeline = nullptr;
+	}
+
+	PingResponder.Stop();
+
+	Super::Shutdown();
+}
@@ -0,0 +1,308 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SHitchDetector.h"
+#include "CoopGame.h"
+#include "SGameMode.h"
+#include "SGameState.h"
+#include "Async/Async.h"
+#include "Engine/Engine.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+
+
+static float HitchThresholdMs = 100.0f;
+FAutoConsoleVariableRef CVARHitchThresholdMs(
+	TEXT("COOP.HitchThresholdMs"),
+	HitchThresholdMs,
+	TEXT("Game thread milliseconds a frame has to take to count as a hitch, 0 turns the detector off"),
+	ECVF_Default);
+
+static int32 HitchFrames = 120;
+FAutoConsoleVariableRef CVARHitchFrames(
+	TEXT("COOP.HitchFrames"),
+	HitchFrames,
+	TEXT("Frames of history a hitch capture writes"),
+	ECVF_Default);
+
+static float HitchCooldown = 30.0f;
+FAutoConsoleVariableRef CVARHitchCooldown(
+	TEXT("COOP.HitchCooldown"),
+	HitchCooldown,
+	TEXT("Seconds after a hitch capture before the next one"),
+	ECVF_Default);
+
+static int32 HitchMaxCaptures = 20;
+FAutoConsoleVariableRef CVARHitchMaxCaptures(
+	TEXT("COOP.HitchMaxCaptures"),
+	HitchMaxCaptures,
+	TEXT("Hitch captures written per run at most, later hitches are only counted"),
+	ECVF_Default);
+
+
+static void HitchReportCommand(const TArray<FString>& Args)
+{
+	FSHitchDetector::Get().LogReport();
+}
+
+FAutoConsoleCommand HitchReportConsoleCommand(
+	TEXT("COOP.HitchReport"),
+	TEXT("Log how many hitches were seen and captured"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&HitchReportCommand));
+
+
+namespace
+{
+	// Loading and the first frames of a map are long anyway
+	const double MapLoadGraceSeconds = 5.0;
+
+	// Classes per world in a capture, the rest are summed up
+	const int32 MaxCapturedClasses = 24;
+
+	// Subsystems of the hitch frame in a capture, longest first
+	const int32 MaxCapturedSubsystems = 5;
+}
+
+
+FSHitchDetector::FSHitchDetector()
+	: NrOfHitches(0)
+	, NrOfCaptures(0)
+	, NrOfSkippedHitches(0)
+	, WorstGameThreadMs(0.0f)
+	, LastCaptureTime(-DBL_MAX)
+	, LastMapLoadTime(0.0)
+{
+}
+
+
+FSHitchDetector& FSHitchDetector::Get()
+{
+	static FSHitchDetector Instance;
+	return Instance;
+}
+
+
+void FSHitchDetector::Initialize()
+{
+	LastMapLoadTime = FPlatformTime::Seconds();
+
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddRaw(this, &FSHitchDetector::EndFrame);
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddRaw(this, &FSHitchDetector::OnPostLoadMap);
+}
+
+
+void FSHitchDetector::Shutdown()
+{
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+
+	if (NrOfHitches > 0)
+	{
+		LogReport();
+	}
+}
+
+
+void FSHitchDetector::OnPostLoadMap(UWorld* World)
+{
+	LastMapLoadTime = FPlatformTime::Seconds();
+}
+
+
+void FSHitchDetector::EndFrame()
+{
+	const float ThresholdMs = HitchThresholdMs;
+	const FSFramePerf& Frame = FSPerfCounters::Get().GetLastFrame();
+	if (ThresholdMs <= 0.0f || Frame.GameThreadMs < ThresholdMs)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now - LastMapLoadTime < MapLoadGraceSeconds)
+	{
+		return;
+	}
+
+	NrOfHitches++;
+	WorstGameThreadMs = FMath::Max(WorstGameThreadMs, Frame.GameThreadMs);
+
+	if (NrOfCaptures >= HitchMaxCaptures || Now - LastCaptureTime < HitchCooldown)
+	{
+		NrOfSkippedHitches++;
+		UE_LOG(LogCoopGame, Log, TEXT("Hitch: %.1f ms game thread, not captured (%s)"), Frame.GameThreadMs,
+			NrOfCaptures >= HitchMaxCaptures ? TEXT("capture limit reached") : TEXT("cooldown"));
+		return;
+	}
+
+	LastCaptureTime = Now;
+	CaptureHitch(Frame, ThresholdMs);
+}
+
+
+void FSHitchDetector::CaptureHitch(const FSFramePerf& Frame, float ThresholdMs)
+{
+	FCapture Capture;
+	Capture.Index = NrOfCaptures++;
+	Capture.Time = FDateTime::Now();
+	Capture.FrameCounter = FSPerfCounters::Get().GetFrameCounter();
+	Capture.GameThreadMs = Frame.GameThreadMs;
+	Capture.ThresholdMs = ThresholdMs;
+	Capture.NrOfSkippedHitches = NrOfSkippedHitches;
+	NrOfSkippedHitches = 0;
+
+	FSPerfCounters::Get().GetHistory(Capture.Frames, FMath::Clamp(HitchFrames, 1, FSPerfCounters::HistorySize));
+
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		UWorld* World = Context.World();
+		if (World && World->IsGameWorld())
+		{
+			SnapshotWorld(World, Capture.Worlds.AddDefaulted_GetRef());
+		}
+	}
+
+	UE_LOG(LogCoopGame, Warning, TEXT("Hitch: %.1f ms game thread (threshold %.0f ms), capture %d"), Frame.GameThreadMs, ThresholdMs, Capture.Index);
+
+	// Formatting and disk are the slow part, and nothing the game thread has to wait for
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Capture = MoveTemp(Capture)]()
+	{
+		WriteCapture(Capture);
+	});
+}
+
+
+void FSHitchDetector::SnapshotWorld(UWorld* World, FWorldSnapshot& OutSnapshot)
+{
+	OutSnapshot.WorldName = World->GetMapName();
+	OutSnapshot.Wave = 0;
+	OutSnapshot.NrOfActors = 0;
+
+	const ASGameMode* GameMode = World->GetAuthGameMode<ASGameMode>();
+	if (GameMode)
+	{
+		OutSnapshot.Wave = GameMode->GetWaveCount();
+	}
+
+	const ASGameState* GameState = World->GetGameState<ASGameState>();
+	const UEnum* WaveStateEnum = StaticEnum<EWaveState>();
+	OutSnapshot.WaveState = GameState && WaveStateEnum ? WaveStateEnum->GetNameStringByValue((int64)GameState->GetWaveState()) : FString(TEXT("None"));
+
+	TMap<FName, int32> Counts;
+	for (const ULevel* Level : World->GetLevels())
+	{
+		if (Level == nullptr)
+		{
+			continue;
+		}
+
+		for (const AActor* Actor : Level->Actors)
+		{
+			if (Actor && !Actor->IsPendingKill())
+			{
+				Counts.FindOrAdd(Actor->GetClass()->GetFName())++;
+				OutSnapshot.NrOfActors++;
+			}
+		}
+	}
+
+	OutSnapshot.Classes.Reserve(Counts.Num());
+	for (const TPair<FName, int32>& Pair : Counts)
+	{
+		FClassCount& ClassCount = OutSnapshot.Classes.AddDefaulted_GetRef();
+		ClassCount.ClassName = Pair.Key;
+		ClassCount.NrOfActors = Pair.Value;
+	}
+}
+
+
+void FSHitchDetector::WriteCapture(const FCapture& Capture)
+{
+	const FSFramePerf& HitchFrame = Capture.Frames.Last();
+
+	FString Text;
+	Text += FString::Printf(TEXT("Hitch capture %d at %s, frame %llu\n"), Capture.Index, *Capture.Time.ToString(), Capture.FrameCounter);
+	Text += FString::Printf(TEXT("Game thread %.2f ms (threshold %.0f ms), frame %.2f ms, %d hitches not captured since the previous capture\n\n"),
+		Capture.GameThreadMs, Capture.ThresholdMs, HitchFrame.FrameMs, Capture.NrOfSkippedHitches);
+
+	// Most expensive scopes of the hitch frame
+	TArray<int32, TInlineAllocator<(int32)ECoopSubsystem::Count>> Subsystems;
+	for (int32 i = 0; i < (int32)ECoopSubsystem::Count; i++)
+	{
+		Subsystems.Add(i);
+	}
+	Subsystems.Sort([&HitchFrame](int32 A, int32 B) { return HitchFrame.SubsystemMs[A] > HitchFrame.SubsystemMs[B]; });
+
+	float SubsystemTotalMs = 0.0f;
+	for (float Ms : HitchFrame.SubsystemMs)
+	{
+		SubsystemTotalMs += Ms;
+	}
+
+	Text += TEXT("Longest subsystems in the hitch frame:\n");
+	for (int32 i = 0; i < Subsystems.Num() && i < MaxCapturedSubsystems; i++)
+	{
+		Text += FString::Printf(TEXT("  %-16s %8.2f ms\n"), FSPerfCounters::GetSubsystemName((ECoopSubsystem)Subsystems[i]), HitchFrame.SubsystemMs[Subsystems[i]]);
+	}
+	Text += FString::Printf(TEXT("  %-16s %8.2f ms\n\n"), TEXT("Outside them"), FMath::Max(Capture.GameThreadMs - SubsystemTotalMs, 0.0f));
+
+	for (const FWorldSnapshot& World : Capture.Worlds)
+	{
+		Text += FString::Printf(TEXT("World %s: wave %d, %s, %d actors\n"), *World.WorldName, World.Wave, *World.WaveState, World.NrOfActors);
+
+		TArray<FClassCount> Classes = World.Classes;
+		Classes.Sort([](const FClassCount& A, const FClassCount& B) { return A.NrOfActors > B.NrOfActors; });
+
+		int32 NrOfOtherActors = 0;
+		for (int32 i = 0; i < Classes.Num(); i++)
+		{
+			if (i < MaxCapturedClasses)
+			{
+				Text += FString::Printf(TEXT("  %-48s %6d\n"), *Classes[i].ClassName.ToString(), Classes[i].NrOfActors);
+			}
+			else
+			{
+				NrOfOtherActors += Classes[i].NrOfActors;
+			}
+		}
+		if (NrOfOtherActors > 0)
+		{
+			Text += FString::Printf(TEXT("  %-48s %6d\n"), *FString::Printf(TEXT("%d more classes"), Classes.Num() - MaxCapturedClasses), NrOfOtherActors);
+		}
+		Text += TEXT("\n");
+	}
+
+	Text += FString::Printf(TEXT("Last %d frames, oldest first (ms):\n  %8s %8s"), Capture.Frames.Num(), TEXT("Frame"), TEXT("Game"));
+	for (int32 i = 0; i < (int32)ECoopSubsystem::Count; i++)
+	{
+		Text += FString::Printf(TEXT(" %13s"), FSPerfCounters::GetSubsystemName((ECoopSubsystem)i));
+	}
+	Text += TEXT("\n");
+
+	for (const FSFramePerf& Frame : Capture.Frames)
+	{
+		Text += FString::Printf(TEXT("  %8.2f %8.2f"), Frame.FrameMs, Frame.GameThreadMs);
+		for (float Ms : Frame.SubsystemMs)
+		{
+			Text += FString::Printf(TEXT(" %13.2f"), Ms);
+		}
+		Text += Frame.GameThreadMs >= Capture.ThresholdMs ? TEXT("  <- hitch\n") : TEXT("\n");
+	}
+
+	const FString Path = FPaths::ProjectSavedDir() / TEXT("Hitches") / FString::Printf(TEXT("Hitch-%s-%d.txt"), *Capture.Time.ToString(), Capture.Index);
+	if (!FFileHelper::SaveStringToFile(Text, *Path))
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Hitch: could not write %s"), *Path);
+	}
+}
+
+
+void FSHitchDetector::LogReport() const
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Hitches: %d over %.0f ms, worst %.1f ms, %d captured to %s"), NrOfHitches, HitchThresholdMs, WorstGameThreadMs,
+		NrOfCaptures, *(FPaths::ProjectSavedDir() / TEXT("Hitches")));
+}
@@ -0,0 +1,290 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SMatchHost.h"
+#include "CoopGame.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "Engine/LevelStreamingDynamic.h"
+#include "GameFramework/GameModeBase.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "UObject/UObjectHash.h"
+
+
+namespace
+{
+	// Objects whose memory is counted per frame, the worlds of a match have a few tens of thousands
+	const int32 CountedObjectsPerFrame = 256;
+}
+
+
+USMatchHost::USMatchHost()
+{
+	MemoryMatchIndex = INDEX_NONE;
+	NrOfCountedObjects = 0;
+	CountedBytes = 0;
+
+	ReportInterval = 30.0f;
+}
+
+
+void USMatchHost::Initialize(UGameInstance* InGameInstance)
+{
+	GameInstance = InGameInstance;
+
+	UWorld* PrimaryWorld = GameInstance ? GameInstance->GetWorld() : nullptr;
+	if (PrimaryWorld == nullptr || PrimaryWorld->GetAuthGameMode() == nullptr)
+	{
+		return;
+	}
+
+	int32 NrOfMatches = 1;
+	FParse::Value(FCommandLine::Get(), TEXT("CoopMatches="), NrOfMatches);
+	if (NrOfMatches <= 1)
+	{
+		return;
+	}
+
+	FString ArenaPackage = PrimaryWorld->GetOutermost()->GetName();
+	FParse::Value(FCommandLine::Get(), TEXT("CoopMatchMap="), ArenaPackage);
+
+	// Every match runs the same rules as the one the engine started
+	const FString GameModePath = PrimaryWorld->GetAuthGameMode()->GetClass()->GetPathName();
+	const int32 BasePort = PrimaryWorld->URL.Port;
+
+	MatchWorlds.Add(PrimaryWorld);
+	MatchStats.AddDefaulted();
+	MatchMemory.Add(0);
+
+	for (int32 MatchIndex = 1; MatchIndex < NrOfMatches; MatchIndex++)
+	{
+		UWorld* World = StartMatch(MatchIndex, ArenaPackage, GameModePath, BasePort + MatchIndex);
+		if (World == nullptr)
+		{
+			break;
+		}
+
+		MatchWorlds.Add(World);
+		MatchStats.AddDefaulted();
+		MatchMemory.Add(0);
+	}
+
+	PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &USMatchHost::OnWorldPreActorTick);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &USMatchHost::OnWorldPostActorTick);
+	ReportHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &USMatchHost::ReportStats), ReportInterval);
+	MemoryHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &USMatchHost::CountMemory));
+
+	UE_LOG(LogCoopGame, Log, TEXT("Hosting %d matches of %s on ports %d-%d"), MatchWorlds.Num(), *ArenaPackage, BasePort, BasePort + MatchWorlds.Num() - 1);
+}
+
+
+void USMatchHost::Shutdown()
+{
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	FTicker::GetCoreTicker().RemoveTicker(ReportHandle);
+	FTicker::GetCoreTicker().RemoveTicker(MemoryHandle);
+
+	// Skip the first, the engine owns it
+	for (int32 i = 1; i < MatchWorlds.Num(); i++)
+	{
+		UWorld* World = MatchWorlds[i].Get();
+		if (World == nullptr)
+		{
+			continue;
+		}
+
+		World->BeginTearingDown();
+		World->DestroyWorld(true);
+		GEngine->DestroyWorldContext(World);
+		World->RemoveFromRoot();
+	}
+
+	MatchWorlds.Reset();
+	MatchStats.Reset();
+	MatchMemory.Reset();
+	MemoryObjects.Reset();
+	MemoryMatchIndex = INDEX_NONE;
+}
+
+
+int32 USMatchHost::GetNumMatches() const
+{
+	return MatchWorlds.Num();
+}
+
+
+UWorld* USMatchHost::StartMatch(int32 MatchIndex, const FString& ArenaPackage, const FString& GameModePath, int32 Port)
+{
+	FWorldContext& Context = GEngine->CreateNewWorldContext(EWorldType::Game);
+	Context.OwningGameInstance = GameInstance;
+
+	// Empty world, the arena gets streamed in below
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, *FString::Printf(TEXT("CoopMatch%d"), MatchIndex));
+	World->SetGameInstance(GameInstance);
+	Context.SetCurrentWorld(World);
+
+	FURL URL(nullptr, *FString::Printf(TEXT("%s?game=%s"), *ArenaPackage, *GameModePath), TRAVEL_Absolute);
+	URL.Port = Port;
+
+	World->SetGameMode(URL);
+
+	// A level instance gets its own package name, which is what lets the same map load once per match
+	bool bSuccess = false;
+	ULevelStreamingDynamic::LoadLevelInstance(World, ArenaPackage, FVector::ZeroVector, FRotator::ZeroRotator, bSuccess);
+	if (!bSuccess)
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Match %d: could not load arena %s"), MatchIndex, *ArenaPackage);
+
+		World->DestroyWorld(false);
+		GEngine->DestroyWorldContext(World);
+		World->RemoveFromRoot();
+		return nullptr;
+	}
+
+	// Arena has to be in before any actor begins play or anyone joins
+	World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+	World->InitializeActorsForPlay(URL);
+
+	if (!World->Listen(URL))
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Match %d: could not listen on port %d"), MatchIndex, Port);
+	}
+
+	World->BeginPlay();
+
+	return World;
+}
+
+
+void USMatchHost::OnWorldPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	// The engine's world changes when the first match travels
+	if (MatchWorlds.Num() > 0 && !MatchWorlds[0].IsValid() && GameInstance && World == GameInstance->GetWorld())
+	{
+		MatchWorlds[0] = World;
+	}
+
+	const int32 MatchIndex = MatchWorlds.IndexOfByKey(World);
+	if (MatchIndex != INDEX_NONE)
+	{
+		MatchStats[MatchIndex].TickStartTime = FPlatformTime::Seconds();
+	}
+}
+
+
+void USMatchHost::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	const int32 MatchIndex = MatchWorlds.IndexOfByKey(World);
+	if (MatchIndex == INDEX_NONE || MatchStats[MatchIndex].TickStartTime == 0.0)
+	{
+		return;
+	}
+
+	FMatchStats& Stats = MatchStats[MatchIndex];
+	const float TickMs = (FPlatformTime::Seconds() - Stats.TickStartTime) * 1000.0;
+	Stats.TotalTickMs += TickMs;
+	Stats.MaxTickMs = FMath::Max(Stats.MaxTickMs, TickMs);
+	Stats.NrOfTicks++;
+	Stats.TickStartTime = 0.0;
+}
+
+
+bool USMatchHost::ReportStats(float DeltaTime)
+{
+	const FPlatformMemoryStats ProcessMemory = FPlatformMemory::GetStats();
+	int64 TotalWorldBytes = 0;
+
+	for (int32 i = 0; i < MatchWorlds.Num(); i++)
+	{
+		UWorld* World = MatchWorlds[i].Get();
+		FMatchStats& Stats = MatchStats[i];
+		if (World == nullptr)
+		{
+			continue;
+		}
+
+		const int64 WorldBytes = MatchMemory[i];
+		TotalWorldBytes += WorldBytes;
+
+		UE_LOG(LogCoopGame, Log, TEXT("Match %d (%s): tick avg %.2f ms, max %.2f ms over %d frames, %d players, %.1f MB own objects"),
+			i, *World->GetName(), Stats.NrOfTicks > 0 ? Stats.TotalTickMs / Stats.NrOfTicks : 0.0, Stats.MaxTickMs, Stats.NrOfTicks,
+			World->GetNumPlayerControllers(), WorldBytes / (1024.0 * 1024.0));
+
+		Stats = FMatchStats();
+	}
+
+	// What isn't in any world is shared between all of them
+	UE_LOG(LogCoopGame, Log, TEXT("Matches: %d, process %.1f MB, of which %.1f MB in match worlds"),
+		MatchWorlds.Num(), ProcessMemory.UsedPhysical / (1024.0 * 1024.0), TotalWorldBytes / (1024.0 * 1024.0));
+
+	return true;
+}
+
+
+bool USMatchHost::CountMemory(float DeltaTime)
+{
+	if (MatchWorlds.Num() == 0)
+	{
+		return true;
+	}
+
+	if (NrOfCountedObjects >= MemoryObjects.Num())
+	{
+		// Previous count is done, start on the next match
+		if (MatchMemory.IsValidIndex(MemoryMatchIndex))
+		{
+			MatchMemory[MemoryMatchIndex] = CountedBytes;
+		}
+
+		MemoryMatchIndex = (MemoryMatchIndex + 1) % MatchWorlds.Num();
+		MemoryObjects.Reset();
+		NrOfCountedObjects = 0;
+		CountedBytes = 0;
+
+		UWorld* World = MatchWorlds[MemoryMatchIndex].Get();
+		if (World)
+		{
+			GetWorldObjects(World, MemoryObjects);
+		}
+		return true;
+	}
+
+	const int32 LastObject = FMath::Min(NrOfCountedObjects + CountedObjectsPerFrame, MemoryObjects.Num());
+	for (; NrOfCountedObjects < LastObject; NrOfCountedObjects++)
+	{
+		// Objects destroyed since the count started no longer take memory
+		UObject* Object = MemoryObjects[NrOfCountedObjects].Get();
+		if (Object)
+		{
+			FArchiveCountMem Count(Object);
+			CountedBytes += Count.GetMax();
+		}
+	}
+
+	return true;
+}
+
+
+void USMatchHost::GetWorldObjects(UWorld* World, TArray<TWeakObjectPtr<UObject>>& OutObjects) const
+{
+	// Sublevels and level instances live in packages of their own
+	TArray<UPackage*, TInlineAllocator<4>> Packages;
+	Packages.AddUnique(World->GetOutermost());
+	for (ULevel* Level : World->GetLevels())
+	{
+		if (Level)
+		{
+			Packages.AddUnique(Level->GetOutermost());
+		}
+	}
+
+	for (UPackage* Package : Packages)
+	{
+		ForEachObjectWithOuter(Package, [&OutObjects](UObject* Object)
+		{
+			OutObjects.Add(Object);
+		}, true);
+	}
+}
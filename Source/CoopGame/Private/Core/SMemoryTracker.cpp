@@ -0,0 +1,441 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SMemoryTracker.h"
+#include "CoopGame.h"
+#include "GameFramework/Actor.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/LowLevelMemStats.h"
+#include "Misc/CommandLine.h"
+
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT(TEXT("CoopBots"), STAT_CoopLLMBots, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("CoopWeapons"), STAT_CoopLLMWeapons, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("CoopFX"), STAT_CoopLLMFX, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("CoopNavPaths"), STAT_CoopLLMNavPaths, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("CoopPickups"), STAT_CoopLLMPickups, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("CoopGame"), STAT_CoopLLMSummary, STATGROUP_LLM);
+#endif
+
+
+static int32 MemSoakWaves = 0;
+FAutoConsoleVariableRef CVARMemSoakWaves(
+	TEXT("COOP.MemSoakWaves"),
+	MemSoakWaves,
+	TEXT("Warn about gameplay memory that grew over this many waves in a row, 0 is off (-MemSoak sets 50)"),
+	ECVF_Default);
+
+static float MemSampleInterval = 1.0f;
+FAutoConsoleVariableRef CVARMemSampleInterval(
+	TEXT("COOP.MemSampleInterval"),
+	MemSampleInterval,
+	TEXT("Seconds between samples of the tracked gameplay objects, takes effect on the next start"),
+	ECVF_Default);
+
+
+static void MemReportCommand(const TArray<FString>& Args)
+{
+	FSMemoryTracker::Get().LogReport();
+}
+
+FAutoConsoleCommand MemReportConsoleCommand(
+	TEXT("COOP.MemReport"),
+	TEXT("Log live counts and sizes of gameplay objects per category and wave"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&MemReportCommand));
+
+
+namespace
+{
+	const int32 DefaultSoakWaves = 50;
+
+	const double BytesPerKB = 1024.0;
+
+	const double BytesPerMB = 1024.0 * 1024.0;
+
+	int64 GetCategoryBytes(const FSMemoryUsage (&Usage)[(int32)ECoopMemKind::Count])
+	{
+		int64 Bytes = 0;
+		for (const FSMemoryUsage& KindUsage : Usage)
+		{
+			Bytes += KindUsage.Bytes;
+		}
+		return Bytes;
+	}
+}
+
+
+FSMemoryTracker::FSMemoryTracker()
+	: UsedPhysical(0)
+	, PeakUsedPhysical(0)
+{
+}
+
+
+FSMemoryTracker& FSMemoryTracker::Get()
+{
+	static FSMemoryTracker Instance;
+	return Instance;
+}
+
+
+const TCHAR* FSMemoryTracker::GetCategoryName(ECoopMemCategory Category)
+{
+	switch (Category)
+	{
+	case ECoopMemCategory::Bots:		return TEXT("Bots");
+	case ECoopMemCategory::Weapons:		return TEXT("Weapons");
+	case ECoopMemCategory::FX:			return TEXT("FX");
+	case ECoopMemCategory::NavPaths:	return TEXT("NavPaths");
+	case ECoopMemCategory::Pickups:		return TEXT("Pickups");
+	default:							return TEXT("Unknown");
+	}
+}
+
+
+const TCHAR* FSMemoryTracker::GetKindName(ECoopMemKind Kind)
+{
+	switch (Kind)
+	{
+	case ECoopMemKind::Actor:			return TEXT("actors");
+	case ECoopMemKind::Component:		return TEXT("components");
+	case ECoopMemKind::Material:		return TEXT("materials");
+	case ECoopMemKind::PhysicsBody:		return TEXT("physics bodies");
+	case ECoopMemKind::Object:			return TEXT("objects");
+	default:							return TEXT("unknown");
+	}
+}
+
+
+void FSMemoryTracker::Initialize()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+#if STATS
+	const FName StatNames[] = { GET_STATFNAME(STAT_CoopLLMBots), GET_STATFNAME(STAT_CoopLLMWeapons), GET_STATFNAME(STAT_CoopLLMFX), GET_STATFNAME(STAT_CoopLLMNavPaths), GET_STATFNAME(STAT_CoopLLMPickups) };
+	static_assert(ARRAY_COUNT(StatNames) == (int32)ECoopMemCategory::Count, "One LLM stat per category");
+	const FName SummaryStatName = GET_STATFNAME(STAT_CoopLLMSummary);
+#endif
+
+	for (int32 i = 0; i < (int32)ECoopMemCategory::Count; i++)
+	{
+		const ECoopMemCategory Category = (ECoopMemCategory)i;
+		const FString TagName = FString::Printf(TEXT("Coop%s"), GetCategoryName(Category));
+#if STATS
+		FLowLevelMemTracker::Get().RegisterProjectTag((int32)GetLLMTag(Category), *TagName, StatNames[i], SummaryStatName);
+#else
+		FLowLevelMemTracker::Get().RegisterProjectTag((int32)GetLLMTag(Category), *TagName, NAME_None, NAME_None);
+#endif
+	}
+#endif
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("MemSoak")))
+	{
+		MemSoakWaves = DefaultSoakWaves;
+	}
+	FParse::Value(FCommandLine::Get(), TEXT("MemSoakWaves="), MemSoakWaves);
+
+	SampleHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FSMemoryTracker::Sample), FMath::Max(MemSampleInterval, 0.1f));
+}
+
+
+void FSMemoryTracker::Shutdown()
+{
+	FTicker::GetCoreTicker().RemoveTicker(SampleHandle);
+
+	LogReport();
+
+	Tracked.Empty();
+}
+
+
+void FSMemoryTracker::TrackActor(AActor* Actor, ECoopMemCategory Category)
+{
+	if (Actor == nullptr)
+	{
+		return;
+	}
+
+	TrackObject(Actor, Category, ECoopMemKind::Actor);
+
+	TInlineComponentArray<UActorComponent*> Components(Actor);
+	for (UActorComponent* Component : Components)
+	{
+		TrackObject(Component, Category, ECoopMemKind::Component);
+	}
+}
+
+
+void FSMemoryTracker::TrackObject(UObject* Object, ECoopMemCategory Category, ECoopMemKind Kind)
+{
+	if (Object)
+	{
+		FTrackedObject& Entry = Tracked.AddDefaulted_GetRef();
+		Entry.Object = Object;
+		Entry.World = FObjectKey(Object->GetWorld());
+		Entry.Category = Category;
+		Entry.Kind = Kind;
+	}
+}
+
+
+bool FSMemoryTracker::Sample(float DeltaTime)
+{
+	for (TPair<FObjectKey, FWorldMemory>& Pair : Worlds)
+	{
+		for (auto& CategoryUsage : Pair.Value.Current)
+		{
+			for (FSMemoryUsage& Usage : CategoryUsage)
+			{
+				Usage.Live = 0;
+				Usage.Bytes = 0;
+			}
+		}
+	}
+
+	// Destroyed objects (and the ones pending kill) are done with, whether or not garbage collection got to them
+	Tracked.RemoveAllSwap([](const FTrackedObject& Entry) { return !Entry.Object.IsValid(); }, false);
+
+	for (const FTrackedObject& Entry : Tracked)
+	{
+		UObject* Object = Entry.Object.Get();
+		const int32 CategoryIndex = (int32)Entry.Category;
+		FSMemoryUsage (&Usage)[(int32)ECoopMemKind::Count] = FindOrAddWorld(Entry.World).Current[CategoryIndex];
+
+		Usage[(int32)Entry.Kind].Live++;
+		Usage[(int32)Entry.Kind].Bytes += GetObjectBytes(Object);
+
+		const UPrimitiveComponent* Primitive = Entry.Kind == ECoopMemKind::Component ? Cast<UPrimitiveComponent>(Object) : nullptr;
+		const FBodyInstance* Body = Primitive ? Primitive->GetBodyInstance() : nullptr;
+		if (Body && Body->IsValidBodyInstance())
+		{
+			Usage[(int32)ECoopMemKind::PhysicsBody].Live++;
+			Usage[(int32)ECoopMemKind::PhysicsBody].Bytes += sizeof(FBodyInstance);
+		}
+	}
+
+	UsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+	PeakUsedPhysical = FMath::Max(PeakUsedPhysical, UsedPhysical);
+
+	int32 TotalLive[(int32)ECoopMemCategory::Count][(int32)ECoopMemKind::Count];
+	int64 TotalBytes[(int32)ECoopMemCategory::Count][(int32)ECoopMemKind::Count];
+	FMemory::Memzero(TotalLive);
+	FMemory::Memzero(TotalBytes);
+
+	for (TPair<FObjectKey, FWorldMemory>& Pair : Worlds)
+	{
+		FWorldMemory& WorldMemory = Pair.Value;
+		WorldMemory.PeakUsedPhysical = FMath::Max(WorldMemory.PeakUsedPhysical, UsedPhysical);
+
+		for (int32 CategoryIndex = 0; CategoryIndex < (int32)ECoopMemCategory::Count; CategoryIndex++)
+		{
+			for (int32 KindIndex = 0; KindIndex < (int32)ECoopMemKind::Count; KindIndex++)
+			{
+				FSMemoryUsage& Usage = WorldMemory.Current[CategoryIndex][KindIndex];
+				Usage.PeakLive = FMath::Max(Usage.PeakLive, Usage.Live);
+				Usage.PeakBytes = FMath::Max(Usage.PeakBytes, Usage.Bytes);
+
+				TotalLive[CategoryIndex][KindIndex] += Usage.Live;
+				TotalBytes[CategoryIndex][KindIndex] += Usage.Bytes;
+			}
+		}
+	}
+
+	for (int32 CategoryIndex = 0; CategoryIndex < (int32)ECoopMemCategory::Count; CategoryIndex++)
+	{
+		for (int32 KindIndex = 0; KindIndex < (int32)ECoopMemKind::Count; KindIndex++)
+		{
+			FSMemoryUsage& Usage = Current[CategoryIndex][KindIndex];
+			Usage.Live = TotalLive[CategoryIndex][KindIndex];
+			Usage.Bytes = TotalBytes[CategoryIndex][KindIndex];
+			Usage.PeakLive = FMath::Max(Usage.PeakLive, Usage.Live);
+			Usage.PeakBytes = FMath::Max(Usage.PeakBytes, Usage.Bytes);
+		}
+	}
+
+	return true;
+}
+
+
+FSMemoryTracker::FWorldMemory& FSMemoryTracker::FindOrAddWorld(const FObjectKey& WorldKey)
+{
+	FWorldMemory* WorldMemory = Worlds.Find(WorldKey);
+	if (WorldMemory == nullptr)
+	{
+		WorldMemory = &Worlds.Add(WorldKey);
+		WorldMemory->WorldName = GetNameSafe(WorldKey.ResolveObjectPtr());
+		WorldMemory->PeakUsedPhysical = UsedPhysical;
+	}
+	return *WorldMemory;
+}
+
+
+int64 FSMemoryTracker::GetObjectBytes(UObject* Object)
+{
+	return Object->GetClass()->GetStructureSize() + Object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+}
+
+
+void FSMemoryTracker::BeginWave(const UWorld* World)
+{
+	Sample(0.0f);
+
+	FWorldMemory& WorldMemory = FindOrAddWorld(FObjectKey(World));
+
+	FWaveMemory& Wave = WorldMemory.Waves.AddDefaulted_GetRef();
+	FMemory::Memcpy(Wave.Usage, WorldMemory.Current, sizeof(WorldMemory.Current));
+	Wave.UsedPhysical = UsedPhysical;
+	Wave.PeakUsedPhysical = WorldMemory.PeakUsedPhysical;
+
+	FString Summary;
+	for (int32 CategoryIndex = 0; CategoryIndex < (int32)ECoopMemCategory::Count; CategoryIndex++)
+	{
+		Summary += FString::Printf(TEXT(" %s %.0f KB"), GetCategoryName((ECoopMemCategory)CategoryIndex), GetCategoryBytes(WorldMemory.Current[CategoryIndex]) / BytesPerKB);
+	}
+
+	if (WorldMemory.Waves.Num() == 1)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Memory: %s before the first wave, used %.1f MB,%s"), *WorldMemory.WorldName, UsedPhysical / BytesPerMB, *Summary);
+	}
+	else
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Memory: %s wave %d ended, used %.1f MB,%s"), *WorldMemory.WorldName, WorldMemory.Waves.Num() - 1, UsedPhysical / BytesPerMB, *Summary);
+	}
+
+	// Peaks are per wave
+	for (auto& CategoryUsage : WorldMemory.Current)
+	{
+		for (FSMemoryUsage& Usage : CategoryUsage)
+		{
+			Usage.PeakLive = Usage.Live;
+			Usage.PeakBytes = Usage.Bytes;
+		}
+	}
+	WorldMemory.PeakUsedPhysical = UsedPhysical;
+
+	if (MemSoakWaves > 1)
+	{
+		CheckForGrowth(WorldMemory, MemSoakWaves);
+	}
+}
+
+
+void FSMemoryTracker::CheckForGrowth(FWorldMemory& World, int32 NrOfWaves)
+{
+	const TArray<FWaveMemory>& Waves = World.Waves;
+	if (Waves.Num() <= NrOfWaves)
+	{
+		return;
+	}
+
+	const int32 FirstWave = Waves.Num() - 1 - NrOfWaves;
+
+	// Never shrank and grew in at least half of the waves, allocations that come and go shrink now and then
+	auto IsGrowing = [&Waves, FirstWave, NrOfWaves](TFunctionRef<int64(const FWaveMemory&)> GetBytes)
+	{
+		int32 NrOfGrowingWaves = 0;
+		for (int32 i = FirstWave + 1; i < Waves.Num(); i++)
+		{
+			const int64 Previous = GetBytes(Waves[i - 1]);
+			const int64 Next = GetBytes(Waves[i]);
+			if (Next < Previous)
+			{
+				return false;
+			}
+			NrOfGrowingWaves += Next > Previous ? 1 : 0;
+		}
+		return NrOfGrowingWaves * 2 >= NrOfWaves;
+	};
+
+	for (int32 CategoryIndex = 0; CategoryIndex < (int32)ECoopMemCategory::Count; CategoryIndex++)
+	{
+		for (int32 KindIndex = 0; KindIndex < (int32)ECoopMemKind::Count; KindIndex++)
+		{
+			const uint32 Bit = 1u << KindIndex;
+			if ((World.FlaggedGrowth[CategoryIndex] & Bit) != 0)
+			{
+				continue;
+			}
+
+			if (IsGrowing([CategoryIndex, KindIndex](const FWaveMemory& Wave) { return Wave.Usage[CategoryIndex][KindIndex].Bytes; }))
+			{
+				World.FlaggedGrowth[CategoryIndex] |= Bit;
+
+				const FSMemoryUsage& First = Waves[FirstWave].Usage[CategoryIndex][KindIndex];
+				const FSMemoryUsage& Last = Waves.Last().Usage[CategoryIndex][KindIndex];
+				UE_LOG(LogCoopGame, Warning, TEXT("Memory: %s %s %s grew over the last %d waves, %d live %.1f KB to %d live %.1f KB"), *World.WorldName,
+					GetCategoryName((ECoopMemCategory)CategoryIndex), GetKindName((ECoopMemKind)KindIndex), NrOfWaves,
+					First.Live, First.Bytes / BytesPerKB, Last.Live, Last.Bytes / BytesPerKB);
+			}
+		}
+	}
+
+	if (!World.bFlaggedProcessGrowth && IsGrowing([](const FWaveMemory& Wave) { return (int64)Wave.UsedPhysical; }))
+	{
+		World.bFlaggedProcessGrowth = true;
+
+		UE_LOG(LogCoopGame, Warning, TEXT("Memory: used physical memory grew over the last %d waves of %s, %.1f MB to %.1f MB"),
+			NrOfWaves, *World.WorldName, Waves[FirstWave].UsedPhysical / BytesPerMB, Waves.Last().UsedPhysical / BytesPerMB);
+	}
+}
+
+
+const FSMemoryUsage& FSMemoryTracker::GetUsage(ECoopMemCategory Category, ECoopMemKind Kind) const
+{
+	return Current[(int32)Category][(int32)Kind];
+}
+
+
+void FSMemoryTracker::LogReport() const
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Memory: %d worlds, used %.1f MB (peak %.1f MB)%s"), Worlds.Num(),
+		UsedPhysical / BytesPerMB, PeakUsedPhysical / BytesPerMB,
+		MemSoakWaves > 1 ? *FString::Printf(TEXT(", soak test over %d waves"), MemSoakWaves) : TEXT(""));
+
+	FString Header;
+	for (int32 CategoryIndex = 0; CategoryIndex < (int32)ECoopMemCategory::Count; CategoryIndex++)
+	{
+		Header += FString::Printf(TEXT(" %10s"), GetCategoryName((ECoopMemCategory)CategoryIndex));
+	}
+
+	// Where each wave of each world ended, then what is live now
+	for (const TPair<FObjectKey, FWorldMemory>& Pair : Worlds)
+	{
+		const TArray<FWaveMemory>& Waves = Pair.Value.Waves;
+		if (Waves.Num() == 0)
+		{
+			continue;
+		}
+
+		UE_LOG(LogCoopGame, Log, TEXT(" %s, %d waves"), *Pair.Value.WorldName, Waves.Num() - 1);
+		UE_LOG(LogCoopGame, Log, TEXT("  %-6s %9s %9s%s (KB)"), TEXT("Wave"), TEXT("Used MB"), TEXT("Peak MB"), *Header);
+
+		for (int32 WaveIndex = 0; WaveIndex < Waves.Num(); WaveIndex++)
+		{
+			const FWaveMemory& Wave = Waves[WaveIndex];
+
+			FString Row;
+			for (int32 CategoryIndex = 0; CategoryIndex < (int32)ECoopMemCategory::Count; CategoryIndex++)
+			{
+				Row += FString::Printf(TEXT(" %10.0f"), GetCategoryBytes(Wave.Usage[CategoryIndex]) / BytesPerKB);
+			}
+			UE_LOG(LogCoopGame, Log, TEXT("  %-6d %9.1f %9.1f%s"), WaveIndex, Wave.UsedPhysical / BytesPerMB, Wave.PeakUsedPhysical / BytesPerMB, *Row);
+		}
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("  %-26s %8s %10s %8s %10s"), TEXT("Now"), TEXT("Live"), TEXT("KB"), TEXT("Peak"), TEXT("Peak KB"));
+	for (int32 CategoryIndex = 0; CategoryIndex < (int32)ECoopMemCategory::Count; CategoryIndex++)
+	{
+		for (int32 KindIndex = 0; KindIndex < (int32)ECoopMemKind::Count; KindIndex++)
+		{
+			const FSMemoryUsage& Usage = Current[CategoryIndex][KindIndex];
+			if (Usage.PeakLive == 0)
+			{
+				continue;
+			}
+
+			const FString Name = FString::Printf(TEXT("%s %s"), GetCategoryName((ECoopMemCategory)CategoryIndex), GetKindName((ECoopMemKind)KindIndex));
+			UE_LOG(LogCoopGame, Log, TEXT("  %-26s %8d %10.1f %8d %10.1f"), *Name, Usage.Live, Usage.Bytes / BytesPerKB, Usage.PeakLive, Usage.PeakBytes / BytesPerKB);
+		}
+	}
+}
@@ -0,0 +1,512 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SMetrics.h"
+#include "CoopGame.h"
+#include "SPerfCounters.h"
+#include "SGameMode.h"
+#include "Engine/Engine.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+
+static float MetricsWindow = 10.0f;
+FAutoConsoleVariableRef CVARMetricsWindow(
+	TEXT("COOP.MetricsWindow"),
+	MetricsWindow,
+	TEXT("Seconds of frames the exported quantiles are over"),
+	ECVF_Default);
+
+static float MetricsFileInterval = 5.0f;
+FAutoConsoleVariableRef CVARMetricsFileInterval(
+	TEXT("COOP.MetricsFileInterval"),
+	MetricsFileInterval,
+	TEXT("Seconds between rewrites of the metrics file (-MetricsFile)"),
+	ECVF_Default);
+
+
+static void MetricsCommand(const TArray<FString>& Args)
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Metrics:\n%s"), *FSMetrics::Get().Export());
+}
+
+FAutoConsoleCommand MetricsConsoleCommand(
+	TEXT("COOP.Metrics"),
+	TEXT("Log the metrics as a scrape would get them"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&MetricsCommand));
+
+
+namespace
+{
+	const double GaugeSampleInterval = 1.0;
+
+	// Scrapers send their request right after connecting, anything slower is dropped
+	const double ScrapeTimeout = 2.0;
+
+	// Blank line after the headers, as the last four bytes received
+	const uint32 RequestEnd = ('\r' << 24) | ('\n' << 16) | ('\r' << 8) | '\n';
+
+	const double MicrosecondsPerSecond = 1000000.0;
+
+	const double Quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+	struct FMetricInfo
+	{
+		const TCHAR* Name;
+
+		const TCHAR* Help;
+	};
+
+	const FMetricInfo GaugeInfos[] =
+	{
+		{ TEXT("coop_wave"), TEXT("Highest wave any match is in") },
+		{ TEXT("coop_matches"), TEXT("Game worlds running in this process") },
+		{ TEXT("coop_bots_alive"), TEXT("Pawns not controlled by players") },
+		{ TEXT("coop_players"), TEXT("Player states, simulated players included") },
+		{ TEXT("coop_connections"), TEXT("Client connections") },
+		{ TEXT("coop_net_in_bytes_per_second"), TEXT("Received over the last second") },
+		{ TEXT("coop_net_out_bytes_per_second"), TEXT("Sent over the last second") },
+		{ TEXT("coop_net_in_packets_lost_per_second"), TEXT("Incoming packets lost over the last second") },
+		{ TEXT("coop_net_out_packets_lost_per_second"), TEXT("Outgoing packets lost over the last second") },
+	};
+	static_assert(ARRAY_COUNT(GaugeInfos) == (int32)ECoopGauge::Count, "One name per gauge");
+
+	const FMetricInfo CounterInfos[] =
+	{
+		{ TEXT("coop_waves_started_total"), TEXT("Waves started by all matches") },
+		{ TEXT("coop_games_over_total"), TEXT("Matches the players lost") },
+		{ TEXT("coop_scrapes_total"), TEXT("Scrapes answered") },
+	};
+	static_assert(ARRAY_COUNT(CounterInfos) == (int32)ECoopCounter::Count, "One name per counter");
+
+	const FMetricInfo HistogramInfos[] =
+	{
+		{ TEXT("coop_frame_time_seconds"), TEXT("Start of one frame to the start of the next") },
+		{ TEXT("coop_game_thread_time_seconds"), TEXT("Game thread time of a frame, without idling for the tick rate") },
+	};
+	static_assert(ARRAY_COUNT(HistogramInfos) == (int32)ECoopHistogram::Count, "One name per histogram");
+}
+
+
+FSHdrHistogram::FSHdrHistogram()
+{
+	Reset();
+}
+
+
+int32 FSHdrHistogram::GetBucketIndex(uint64 Value)
+{
+	if (Value < SubBucketCount)
+	{
+		return (int32)Value;
+	}
+
+	const int32 Shift = FMath::Min((int32)FPlatformMath::FloorLog2_64(Value) - SubBucketBits, NrOfShifts - 1);
+	const uint64 SubBucket = FMath::Min<uint64>(Value >> Shift, 2 * SubBucketCount - 1);
+	return (Shift + 1) * SubBucketCount + (int32)(SubBucket - SubBucketCount);
+}
+
+
+uint64 FSHdrHistogram::GetBucketValue(int32 Index)
+{
+	if (Index < SubBucketCount)
+	{
+		return Index;
+	}
+
+	const int32 Shift = Index / SubBucketCount - 1;
+	const uint64 SubBucket = Index % SubBucketCount + SubBucketCount;
+	return ((SubBucket + 1) << Shift) - 1;
+}
+
+
+void FSHdrHistogram::Record(uint64 Value)
+{
+	Counts[GetBucketIndex(Value)]++;
+	TotalCount++;
+	Sum += Value;
+	Max = FMath::Max(Max, Value);
+}
+
+
+void FSHdrHistogram::Reset()
+{
+	FMemory::Memzero(Counts);
+	TotalCount = 0;
+	Sum = 0;
+	Max = 0;
+}
+
+
+uint64 FSHdrHistogram::GetValueAtPercentile(double Percentile) const
+{
+	if (TotalCount == 0)
+	{
+		return 0;
+	}
+
+	const uint64 Target = FMath::Max<uint64>(1, (uint64)FMath::CeilToDouble(TotalCount * FMath::Clamp(Percentile, 0.0, 100.0) / 100.0));
+
+	uint64 Seen = 0;
+	for (int32 i = 0; i < NrOfBuckets; i++)
+	{
+		Seen += Counts[i];
+		if (Seen >= Target)
+		{
+			// The bucket's upper bound can lie above anything actually recorded
+			return FMath::Min(GetBucketValue(i), Max);
+		}
+	}
+	return Max;
+}
+
+
+FSMetrics::FSMetrics()
+	: StartTime(0.0)
+	, WindowStartTime(0.0)
+	, LastSampleTime(0.0)
+	, LastFileTime(0.0)
+	, ListenSocket(nullptr)
+{
+	FMemory::Memzero(Gauges);
+	FMemory::Memzero(Counters);
+}
+
+
+FSMetrics& FSMetrics::Get()
+{
+	static FSMetrics Instance;
+	return Instance;
+}
+
+
+void FSMetrics::Initialize()
+{
+	StartTime = FPlatformTime::Seconds();
+	WindowStartTime = StartTime;
+
+	FString Path;
+	if (FParse::Value(FCommandLine::Get(), TEXT("MetricsFile="), Path))
+	{
+		FilePath = Path;
+	}
+	else if (FParse::Param(FCommandLine::Get(), TEXT("MetricsFile")))
+	{
+		FilePath = FPaths::ProjectSavedDir() / TEXT("Metrics") / FString::Printf(TEXT("CoopGame-%u.prom"), FPlatformProcess::GetCurrentProcessId());
+	}
+
+	int32 Port = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("MetricsPort="), Port) && Port > 0)
+	{
+		OpenEndpoint(Port);
+	}
+
+	// Bound after FSPerfCounters, so the frame that just ended is in its history
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddRaw(this, &FSMetrics::EndFrame);
+	TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FSMetrics::Tick));
+
+	if (!FilePath.IsEmpty())
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Metrics: writing %s every %.0f s"), *FilePath, MetricsFileInterval);
+	}
+}
+
+
+void FSMetrics::Shutdown()
+{
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+
+	CloseEndpoint();
+
+	if (!FilePath.IsEmpty())
+	{
+		WriteFile();
+	}
+}
+
+
+void FSMetrics::AddCount(ECoopCounter Counter, uint64 Amount)
+{
+	Counters[(int32)Counter] += Amount;
+}
+
+
+void FSMetrics::EndFrame()
+{
+	const FSFramePerf& Frame = FSPerfCounters::Get().GetLastFrame();
+	if (Frame.FrameMs <= 0.0f)
+	{
+		return;
+	}
+
+	const uint64 FrameMicroseconds = (uint64)(Frame.FrameMs * 1000.0f);
+	const uint64 GameThreadMicroseconds = (uint64)(Frame.GameThreadMs * 1000.0f);
+
+	Lifetime[(int32)ECoopHistogram::FrameTime].Record(FrameMicroseconds);
+	Window[(int32)ECoopHistogram::FrameTime].Record(FrameMicroseconds);
+	Lifetime[(int32)ECoopHistogram::GameThreadTime].Record(GameThreadMicroseconds);
+	Window[(int32)ECoopHistogram::GameThreadTime].Record(GameThreadMicroseconds);
+}
+
+
+bool FSMetrics::Tick(float DeltaTime)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	if (Now - WindowStartTime >= FMath::Max(MetricsWindow, 1.0f))
+	{
+		for (int32 i = 0; i < (int32)ECoopHistogram::Count; i++)
+		{
+			LastWindow[i] = Window[i];
+			Window[i].Reset();
+		}
+		WindowStartTime = Now;
+	}
+
+	if (Now - LastSampleTime >= GaugeSampleInterval)
+	{
+		LastSampleTime = Now;
+		SampleWorlds();
+	}
+
+	if (!FilePath.IsEmpty() && Now - LastFileTime >= FMath::Max(MetricsFileInterval, 1.0f))
+	{
+		LastFileTime = Now;
+		WriteFile();
+	}
+
+	if (ListenSocket)
+	{
+		ServeScrapes();
+	}
+
+	return true;
+}
+
+
+void FSMetrics::SampleWorlds()
+{
+	double Sampled[(int32)ECoopGauge::Count];
+	FMemory::Memzero(Sampled);
+
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		UWorld* World = Context.World();
+		if (World == nullptr || !World->IsGameWorld())
+		{
+			continue;
+		}
+
+		Sampled[(int32)ECoopGauge::Matches] += 1.0;
+
+		const ASGameMode* GameMode = World->GetAuthGameMode<ASGameMode>();
+		if (GameMode)
+		{
+			Sampled[(int32)ECoopGauge::Wave] = FMath::Max(Sampled[(int32)ECoopGauge::Wave], (double)GameMode->GetWaveCount());
+		}
+
+		const AGameStateBase* GameState = World->GetGameState();
+		if (GameState)
+		{
+			Sampled[(int32)ECoopGauge::Players] += GameState->PlayerArray.Num();
+		}
+
+		for (FConstPawnIterator It = World->GetPawnIterator(); It; ++It)
+		{
+			const APawn* Pawn = It->Get();
+			if (Pawn && !Pawn->IsPendingKill() && !ASGameMode::IsPlayer(Pawn->GetController()))
+			{
+				Sampled[(int32)ECoopGauge::BotsAlive] += 1.0;
+			}
+		}
+
+		const UNetDriver* NetDriver = World->GetNetDriver();
+		if (NetDriver)
+		{
+			Sampled[(int32)ECoopGauge::Connections] += NetDriver->ClientConnections.Num();
+			Sampled[(int32)ECoopGauge::InBytesPerSecond] += NetDriver->InBytesPerSecond;
+			Sampled[(int32)ECoopGauge::OutBytesPerSecond] += NetDriver->OutBytesPerSecond;
+			Sampled[(int32)ECoopGauge::InPacketsLostPerSecond] += NetDriver->InPacketsLost;
+			Sampled[(int32)ECoopGauge::OutPacketsLostPerSecond] += NetDriver->OutPacketsLost;
+		}
+	}
+
+	FMemory::Memcpy(Gauges, Sampled, sizeof(Gauges));
+}
+
+
+FString FSMetrics::Export() const
+{
+	FString Text;
+	Text.Reserve(4096);
+
+	Text += FString::Printf(TEXT("# HELP coop_uptime_seconds Seconds since the game module started\n# TYPE coop_uptime_seconds gauge\ncoop_uptime_seconds %.0f\n"),
+		FPlatformTime::Seconds() - StartTime);
+
+	for (int32 i = 0; i < (int32)ECoopGauge::Count; i++)
+	{
+		Text += FString::Printf(TEXT("# HELP %s %s\n# TYPE %s gauge\n%s %.0f\n"), GaugeInfos[i].Name, GaugeInfos[i].Help, GaugeInfos[i].Name, GaugeInfos[i].Name, Gauges[i]);
+	}
+
+	for (int32 i = 0; i < (int32)ECoopCounter::Count; i++)
+	{
+		Text += FString::Printf(TEXT("# HELP %s %s\n# TYPE %s counter\n%s %llu\n"), CounterInfos[i].Name, CounterInfos[i].Help, CounterInfos[i].Name, CounterInfos[i].Name, Counters[i]);
+	}
+
+	for (int32 i = 0; i < (int32)ECoopHistogram::Count; i++)
+	{
+		const TCHAR* Name = HistogramInfos[i].Name;
+
+		// Until the first window completes the current one is all there is
+		const FSHdrHistogram& Recent = LastWindow[i].GetCount() > 0 ? LastWindow[i] : Window[i];
+
+		Text += FString::Printf(TEXT("# HELP %s %s, quantiles over the last %.0f s\n# TYPE %s summary\n"), Name, HistogramInfos[i].Help, MetricsWindow, Name);
+		for (double Quantile : Quantiles)
+		{
+			Text += FString::Printf(TEXT("%s{quantile=\"%g\"} %.6f\n"), Name, Quantile, Recent.GetValueAtPercentile(Quantile * 100.0) / MicrosecondsPerSecond);
+		}
+		Text += FString::Printf(TEXT("%s{quantile=\"1\"} %.6f\n"), Name, Recent.GetMax() / MicrosecondsPerSecond);
+		Text += FString::Printf(TEXT("%s_sum %.6f\n%s_count %llu\n"), Name, Lifetime[i].GetSum() / MicrosecondsPerSecond, Name, Lifetime[i].GetCount());
+	}
+
+	return Text;
+}
+
+
+void FSMetrics::WriteFile() const
+{
+	const FString TempPath = FilePath + TEXT(".tmp");
+	if (!FFileHelper::SaveStringToFile(Export(), *TempPath) || !IFileManager::Get().Move(*FilePath, *TempPath, true, true))
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Metrics: could not write %s"), *FilePath);
+	}
+}
+
+
+bool FSMetrics::OpenEndpoint(int32 Port)
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	if (SocketSubsystem == nullptr)
+	{
+		return false;
+	}
+
+	ListenSocket = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("CoopMetrics"), false);
+	if (ListenSocket == nullptr)
+	{
+		return false;
+	}
+
+	// Only scrapers on the same machine, whatever exports further (eg. a node agent) runs next to the server
+	bool bIsValid = false;
+	TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+	Address->SetIp(TEXT("127.0.0.1"), bIsValid);
+	Address->SetPort(Port);
+
+	ListenSocket->SetReuseAddr(true);
+	if (!bIsValid || !ListenSocket->SetNonBlocking(true) || !ListenSocket->Bind(*Address) || !ListenSocket->Listen(MaxPendingScrapes))
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Metrics: could not listen on port %d"), Port);
+		CloseEndpoint();
+		return false;
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("Metrics: answering scrapes on http://127.0.0.1:%d/metrics"), Port);
+	return true;
+}
+
+
+void FSMetrics::CloseEndpoint()
+{
+	for (FPendingScrape& Scrape : PendingScrapes)
+	{
+		CloseScrape(Scrape);
+	}
+
+	if (ListenSocket)
+	{
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(ListenSocket);
+		ListenSocket = nullptr;
+	}
+}
+
+
+void FSMetrics::ServeScrapes()
+{
+	// Take new connections while there is room, the rest waits in the listen backlog
+	for (FPendingScrape& Scrape : PendingScrapes)
+	{
+		bool bHasPendingConnection = false;
+		if (Scrape.Socket == nullptr && ListenSocket->HasPendingConnection(bHasPendingConnection) && bHasPendingConnection)
+		{
+			Scrape.Socket = ListenSocket->Accept(TEXT("CoopMetricsScrape"));
+			Scrape.AcceptTime = FPlatformTime::Seconds();
+			Scrape.RequestTail = 0;
+			if (Scrape.Socket)
+			{
+				Scrape.Socket->SetNonBlocking(true);
+			}
+		}
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	for (FPendingScrape& Scrape : PendingScrapes)
+	{
+		if (Scrape.Socket == nullptr)
+		{
+			continue;
+		}
+
+		// Whatever the request is, the answer is the same, it only has to be complete
+		uint8 Buffer[512];
+		int32 BytesRead = 0;
+		bool bRequestComplete = false;
+		while (!bRequestComplete && Scrape.Socket->Recv(Buffer, sizeof(Buffer), BytesRead) && BytesRead > 0)
+		{
+			for (int32 i = 0; i < BytesRead && !bRequestComplete; i++)
+			{
+				Scrape.RequestTail = (Scrape.RequestTail << 8) | Buffer[i];
+				bRequestComplete = Scrape.RequestTail == RequestEnd;
+			}
+		}
+
+		if (bRequestComplete)
+		{
+			const FTCHARToUTF8 Body(*Export());
+			const FTCHARToUTF8 Header(*FString::Printf(TEXT("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n"), Body.Length()));
+
+			int32 BytesSent = 0;
+			Scrape.Socket->Send((const uint8*)Header.Get(), Header.Length(), BytesSent);
+			Scrape.Socket->Send((const uint8*)Body.Get(), Body.Length(), BytesSent);
+
+			Counters[(int32)ECoopCounter::Scrapes]++;
+			CloseScrape(Scrape);
+		}
+		else if (Now - Scrape.AcceptTime > ScrapeTimeout)
+		{
+			CloseScrape(Scrape);
+		}
+	}
+}
+
+
+void FSMetrics::CloseScrape(FPendingScrape& Scrape)
+{
+	if (Scrape.Socket)
+	{
+		Scrape.Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Scrape.Socket);
+		Scrape.Socket = nullptr;
+	}
+}
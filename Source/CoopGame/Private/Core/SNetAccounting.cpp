@@ -0,0 +1,566 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SNetAccounting.h"
+#include "CoopGame.h"
+#include "SPerfCounters.h"
+#include "GameFramework/Actor.h"
+#include "Components/ActorComponent.h"
+#include "Engine/ActorChannel.h"
+#include "Engine/World.h"
+#include "Engine/NetConnection.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UnrealType.h"
+
+
+static int32 NetAccounting = 0;
+FAutoConsoleVariableRef CVARNetAccounting(
+	TEXT("COOP.NetAccounting"),
+	NetAccounting,
+	TEXT("Attribute the bunches of every actor channel to classes, properties, RPCs and connections (see COOP.NetReport)"),
+	ECVF_Default);
+
+
+static void NetReportCommand(const TArray<FString>& Args)
+{
+	if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+	{
+		FSNetAccounting::Get().Reset();
+		return;
+	}
+
+	if (Args.Num() > 0 && Args[0] == TEXT("file"))
+	{
+		const FString Path = FSNetAccounting::Get().WriteReport();
+		UE_LOG(LogCoopGame, Log, TEXT("Net: %s"), Path.IsEmpty() ? TEXT("nothing written") : *Path);
+		return;
+	}
+
+	FSNetAccounting::Get().LogReport();
+}
+
+FAutoConsoleCommand NetReportConsoleCommand(
+	TEXT("COOP.NetReport"),
+	TEXT("Log the network traffic per wave by class, property, RPC and connection, 'file' writes it as CSV, 'reset' clears it"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&NetReportCommand));
+
+
+namespace
+{
+	// Rows per table in the log, the file has all of them
+	const int32 MaxLoggedRows = 12;
+
+	// Shadows of actors that are gone are dropped this often
+	const uint64 PruneIntervalFrames = 600;
+
+	const FName OtherRpcName(TEXT("<other RPC>"));
+
+	const FName UnattributedName(TEXT("<unattributed>"));
+
+	FString GetRowName(FName Name)
+	{
+		return Name.ToString();
+	}
+
+	const FString& GetRowName(const FString& Name)
+	{
+		return Name;
+	}
+
+	template<typename KeyType>
+	void AddBits(TMap<KeyType, FSNetCounter>& Table, const KeyType& Key, int64 NumBits)
+	{
+		FSNetCounter& Counter = Table.FindOrAdd(Key);
+		Counter.Bits += NumBits;
+		Counter.NrOfBunches++;
+	}
+
+	template<typename KeyType>
+	TArray<TPair<FString, FSNetCounter>> SortByBits(const TMap<KeyType, FSNetCounter>& Table)
+	{
+		TArray<TPair<FString, FSNetCounter>> Rows;
+		Rows.Reserve(Table.Num());
+		for (const TPair<KeyType, FSNetCounter>& Pair : Table)
+		{
+			Rows.Emplace(GetRowName(Pair.Key), Pair.Value);
+		}
+
+		Rows.Sort([](const TPair<FString, FSNetCounter>& A, const TPair<FString, FSNetCounter>& B)
+		{
+			return A.Value.Bits > B.Value.Bits;
+		});
+		return Rows;
+	}
+
+	template<typename KeyType>
+	void LogTable(const TCHAR* Title, const TMap<KeyType, FSNetCounter>& Table)
+	{
+		if (Table.Num() == 0)
+		{
+			return;
+		}
+
+		const TArray<TPair<FString, FSNetCounter>> Rows = SortByBits(Table);
+
+		int64 TotalBits = 0;
+		for (const TPair<FString, FSNetCounter>& Row : Rows)
+		{
+			TotalBits += Row.Value.Bits;
+		}
+
+		UE_LOG(LogCoopGame, Log, TEXT("  %s: %.1f KB"), Title, TotalBits / 8192.0);
+
+		for (int32 i = 0; i < Rows.Num() && i < MaxLoggedRows; i++)
+		{
+			const FSNetCounter& Counter = Rows[i].Value;
+			UE_LOG(LogCoopGame, Log, TEXT("    %-56s %9.1f KB %5.1f%% %8d bunches"), *Rows[i].Key, Counter.Bits / 8192.0,
+				TotalBits > 0 ? 100.0 * Counter.Bits / TotalBits : 0.0, Counter.NrOfBunches);
+		}
+
+		if (Rows.Num() > MaxLoggedRows)
+		{
+			UE_LOG(LogCoopGame, Log, TEXT("    ... %d more"), Rows.Num() - MaxLoggedRows);
+		}
+	}
+
+	template<typename KeyType>
+	void AppendCsv(FString& Csv, const FString& World, int32 Wave, const TCHAR* Table, const TMap<KeyType, FSNetCounter>& Counters)
+	{
+		for (const TPair<FString, FSNetCounter>& Row : SortByBits(Counters))
+		{
+			Csv += FString::Printf(TEXT("%s,%d,%s,\"%s\",%lld,%d\n"), *World, Wave, Table, *Row.Key.Replace(TEXT("\""), TEXT("\"\"")),
+				(Row.Value.Bits + 7) / 8, Row.Value.NrOfBunches);
+		}
+	}
+}
+
+
+FSNetAccounting::FSNetAccounting()
+	: LastPruneFrame(0)
+{
+}
+
+
+FSNetAccounting& FSNetAccounting::Get()
+{
+	static FSNetAccounting Instance;
+	return Instance;
+}
+
+
+void FSNetAccounting::Initialize()
+{
+	if (FParse::Param(FCommandLine::Get(), TEXT("NetAccounting")))
+	{
+		NetAccounting = 1;
+	}
+}
+
+
+void FSNetAccounting::Shutdown()
+{
+	WriteReport();
+
+	ActorShadows.Empty();
+}
+
+
+bool FSNetAccounting::IsEnabled() const
+{
+	return NetAccounting != 0;
+}
+
+
+void FSNetAccounting::BeginMatch(const UWorld* World)
+{
+	// Other matches may still be running, only the finished ones and this world's previous one are done
+	const FObjectKey WorldKey(World);
+	TArray<FObjectKey> FinishedKeys;
+	TArray<const FMatchStats*> Finished;
+	for (const TPair<FObjectKey, FMatchStats>& Pair : Matches)
+	{
+		if (Pair.Key == WorldKey || Pair.Key.ResolveObjectPtr() == nullptr)
+		{
+			FinishedKeys.Add(Pair.Key);
+			Finished.Add(&Pair.Value);
+		}
+	}
+
+	const FString Path = WriteMatches(Finished);
+	if (!Path.IsEmpty())
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Net: %d finished matches written to %s"), Finished.Num(), *Path);
+	}
+
+	for (const FObjectKey& Key : FinishedKeys)
+	{
+		Matches.Remove(Key);
+	}
+
+	FindOrAddMatch(World);
+}
+
+
+void FSNetAccounting::BeginWave(const UWorld* World)
+{
+	if (IsEnabled())
+	{
+		FindOrAddMatch(World).Waves.AddDefaulted();
+	}
+}
+
+
+FSNetAccounting::FMatchStats& FSNetAccounting::FindOrAddMatch(const UWorld* World)
+{
+	FMatchStats* Match = Matches.Find(FObjectKey(World));
+	if (Match == nullptr)
+	{
+		Match = &Matches.Add(FObjectKey(World));
+		Match->WorldName = GetNameSafe(World);
+		Match->Waves.AddDefaulted();
+	}
+	return *Match;
+}
+
+
+FSNetAccounting::FWaveStats& FSNetAccounting::GetCurrentWave(const UWorld* World)
+{
+	// Traffic can start before the match does, eg. on clients joining
+	return FindOrAddMatch(World).Waves.Last();
+}
+
+
+void FSNetAccounting::RecordOutgoing(UActorChannel* Channel, int64 NumBits, bool bOpen)
+{
+	AActor* Actor = Channel ? Channel->Actor : nullptr;
+	if (!IsEnabled() || Actor == nullptr || NumBits <= 0)
+	{
+		return;
+	}
+
+	FWaveStats& Wave = GetCurrentWave(Actor->GetWorld());
+	const FName ClassName = Actor->GetClass()->GetFName();
+
+	AddBits(Wave.ClassesOut, ClassName, NumBits);
+	AddBits(Wave.ConnectionsOut, GetConnectionName(Channel->Connection), NumBits);
+
+	// Replication can call RPCs itself (eg. client adjustments), those carry their own name
+	if (CurrentRpc != NAME_None)
+	{
+		AddBits(Wave.Rpcs, FName(*FString::Printf(TEXT("%s.%s"), *ClassName.ToString(), *CurrentRpc.ToString())), NumBits);
+	}
+	else if (FSPerfCounters::Get().IsReplicating())
+	{
+		AttributeToProperties(Wave, Actor, NumBits, bOpen);
+	}
+	else
+	{
+		AddBits(Wave.Rpcs, FName(*FString::Printf(TEXT("%s.%s"), *ClassName.ToString(), *OtherRpcName.ToString())), NumBits);
+	}
+
+	const uint64 Frame = FSPerfCounters::Get().GetFrameCounter();
+	if (Frame - LastPruneFrame > PruneIntervalFrames)
+	{
+		LastPruneFrame = Frame;
+		PruneShadows();
+	}
+}
+
+
+void FSNetAccounting::RecordIncoming(UActorChannel* Channel, int64 NumBits)
+{
+	AActor* Actor = Channel ? Channel->Actor : nullptr;
+	if (!IsEnabled() || Actor == nullptr || NumBits <= 0)
+	{
+		return;
+	}
+
+	FWaveStats& Wave = GetCurrentWave(Actor->GetWorld());
+	AddBits(Wave.ClassesIn, Actor->GetClass()->GetFName(), NumBits);
+	AddBits(Wave.ConnectionsIn, GetConnectionName(Channel->Connection), NumBits);
+}
+
+
+void FSNetAccounting::AttributeToProperties(FWaveStats& Wave, AActor* Actor, int64 NumBits, bool bOpen)
+{
+	FActorShadow& Shadow = ActorShadows.FindOrAdd(FObjectKey(Actor));
+
+	// Components can be added after the actor started replicating
+	if (Shadow.NrOfReplicatedComponents != Actor->GetReplicatedComponents().Num())
+	{
+		BuildShadow(Actor, Shadow);
+	}
+
+	// Every connection that gets this actor in the same frame gets the same changes
+	const uint64 Frame = FSPerfCounters::Get().GetFrameCounter();
+	if (Shadow.LastDiffFrame != Frame)
+	{
+		DiffShadow(Shadow);
+		Shadow.LastDiffFrame = Frame;
+	}
+
+	// The first bunch of a channel carries everything
+	TArray<int32> AllProperties;
+	if (bOpen)
+	{
+		AllProperties.Reserve(Shadow.Properties.Num());
+		for (int32 i = 0; i < Shadow.Properties.Num(); i++)
+		{
+			AllProperties.Add(i);
+		}
+	}
+	const TArray<int32>& Sent = bOpen ? AllProperties : Shadow.Changed;
+
+	int64 TotalWeight = 0;
+	TArray<int32, TInlineAllocator<16>> Weights;
+	for (int32 Index : Sent)
+	{
+		const int32 Weight = EstimateBits(Shadow.Properties[Index]);
+		Weights.Add(Weight);
+		TotalWeight += Weight;
+	}
+
+	if (TotalWeight <= 0)
+	{
+		// Resends, subobject headers or unreliable multicasts queued until the flush
+		AddBits(Wave.Properties, FName(*FString::Printf(TEXT("%s.%s"), *Actor->GetClass()->GetName(), *UnattributedName.ToString())), NumBits);
+		return;
+	}
+
+	int64 AssignedBits = 0;
+	for (int32 i = 0; i < Sent.Num(); i++)
+	{
+		// Whatever rounding leaves goes to the last one
+		const int64 Bits = i == Sent.Num() - 1 ? NumBits - AssignedBits : NumBits * Weights[i] / TotalWeight;
+		AssignedBits += Bits;
+
+		FSNetCounter& Counter = Wave.Properties.FindOrAdd(Shadow.Properties[Sent[i]].Label);
+		Counter.Bits += Bits;
+		Counter.NrOfBunches++;
+	}
+}
+
+
+void FSNetAccounting::BuildShadow(AActor* Actor, FActorShadow& Shadow) const
+{
+	Shadow.Properties.Reset();
+	Shadow.Changed.Reset();
+	Shadow.LastDiffFrame = MAX_uint64;
+
+	const FString ActorClassName = Actor->GetClass()->GetName();
+
+	TArray<UObject*, TInlineAllocator<8>> Objects;
+	Objects.Add(Actor);
+	for (UActorComponent* Component : Actor->GetReplicatedComponents())
+	{
+		if (Component)
+		{
+			Objects.Add(Component);
+		}
+	}
+	Shadow.NrOfReplicatedComponents = Actor->GetReplicatedComponents().Num();
+
+	for (UObject* Object : Objects)
+	{
+		// Component properties are named after the component, an actor can have several of a class
+		const FString Prefix = Object == Actor ? ActorClassName : FString::Printf(TEXT("%s.%s"), *ActorClassName, *Object->GetName());
+
+		for (TFieldIterator<UProperty> It(Object->GetClass()); It; ++It)
+		{
+			if (!It->HasAnyPropertyFlags(CPF_Net))
+			{
+				continue;
+			}
+
+			FTrackedProperty Tracked;
+			Tracked.Object = Object;
+			Tracked.Property = *It;
+			Tracked.Label = FName(*FString::Printf(TEXT("%s.%s"), *Prefix, *It->GetName()));
+			Tracked.LastValue = ExportValue(Tracked);
+			Shadow.Properties.Add(MoveTemp(Tracked));
+		}
+	}
+}
+
+
+void FSNetAccounting::DiffShadow(FActorShadow& Shadow) const
+{
+	Shadow.Changed.Reset();
+
+	for (int32 i = 0; i < Shadow.Properties.Num(); i++)
+	{
+		FTrackedProperty& Tracked = Shadow.Properties[i];
+		if (!Tracked.Object.IsValid())
+		{
+			continue;
+		}
+
+		FString Value = ExportValue(Tracked);
+		if (Value != Tracked.LastValue)
+		{
+			Tracked.LastValue = MoveTemp(Value);
+			Shadow.Changed.Add(i);
+		}
+	}
+}
+
+
+void FSNetAccounting::PruneShadows()
+{
+	for (auto It = ActorShadows.CreateIterator(); It; ++It)
+	{
+		if (It.Key().ResolveObjectPtr() == nullptr)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+
+FString FSNetAccounting::GetConnectionName(UNetConnection* Connection)
+{
+	return Connection ? Connection->LowLevelGetRemoteAddress(true) : FString(TEXT("<none>"));
+}
+
+
+FString FSNetAccounting::ExportValue(const FTrackedProperty& Tracked)
+{
+	UObject* Object = Tracked.Object.Get();
+
+	FString Value;
+	for (int32 Index = 0; Index < Tracked.Property->ArrayDim; Index++)
+	{
+		Tracked.Property->ExportTextItem(Value, Tracked.Property->ContainerPtrToValuePtr<void>(Object, Index), nullptr, Object, PPF_None);
+		Value += TEXT('|');
+	}
+	return Value;
+}
+
+
+int32 FSNetAccounting::EstimateBits(const FTrackedProperty& Tracked)
+{
+	const UProperty* Property = Tracked.Property;
+	if (Property->IsA<UBoolProperty>())
+	{
+		return 1;
+	}
+
+	// Dynamic arrays send their length and then every element
+	if (const UArrayProperty* ArrayProperty = Cast<UArrayProperty>(Property))
+	{
+		UObject* Object = Tracked.Object.Get();
+		FScriptArrayHelper Helper(ArrayProperty, ArrayProperty->ContainerPtrToValuePtr<void>(Object));
+		return 16 + Helper.Num() * ArrayProperty->Inner->ElementSize * 8;
+	}
+
+	return Property->ElementSize * Property->ArrayDim * 8;
+}
+
+
+void FSNetAccounting::LogReport() const
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Net: %d matches counted%s, sizes are bunch payload"), Matches.Num(), IsEnabled() ? TEXT("") : TEXT(" (COOP.NetAccounting is off)"));
+
+	for (const TPair<FObjectKey, FMatchStats>& Pair : Matches)
+	{
+		const FMatchStats& Match = Pair.Value;
+		UE_LOG(LogCoopGame, Log, TEXT(" %s, %d waves"), *Match.WorldName, Match.Waves.Num() - 1);
+
+		for (int32 WaveIndex = 0; WaveIndex < Match.Waves.Num(); WaveIndex++)
+		{
+			const FWaveStats& Wave = Match.Waves[WaveIndex];
+			if (Wave.ClassesOut.Num() == 0 && Wave.ClassesIn.Num() == 0)
+			{
+				continue;
+			}
+
+			if (WaveIndex == 0)
+			{
+				UE_LOG(LogCoopGame, Log, TEXT(" Before the first wave"));
+			}
+			else
+			{
+				UE_LOG(LogCoopGame, Log, TEXT(" Wave %d"), WaveIndex);
+			}
+
+			LogTable(TEXT("Sent by class"), Wave.ClassesOut);
+			LogTable(TEXT("Sent by property"), Wave.Properties);
+			LogTable(TEXT("Sent by RPC"), Wave.Rpcs);
+			LogTable(TEXT("Sent by connection"), Wave.ConnectionsOut);
+			LogTable(TEXT("Received by class"), Wave.ClassesIn);
+			LogTable(TEXT("Received by connection"), Wave.ConnectionsIn);
+		}
+	}
+}
+
+
+FString FSNetAccounting::WriteReport() const
+{
+	TArray<const FMatchStats*> AllMatches;
+	for (const TPair<FObjectKey, FMatchStats>& Pair : Matches)
+	{
+		AllMatches.Add(&Pair.Value);
+	}
+	return WriteMatches(AllMatches);
+}
+
+
+FString FSNetAccounting::WriteMatches(const TArray<const FMatchStats*>& MatchesToWrite)
+{
+	FString Csv = TEXT("World,Wave,Table,Name,Bytes,Bunches\n");
+	const int32 HeaderLength = Csv.Len();
+
+	for (const FMatchStats* Match : MatchesToWrite)
+	{
+		for (int32 WaveIndex = 0; WaveIndex < Match->Waves.Num(); WaveIndex++)
+		{
+			const FWaveStats& Wave = Match->Waves[WaveIndex];
+			AppendCsv(Csv, Match->WorldName, WaveIndex, TEXT("ClassOut"), Wave.ClassesOut);
+			AppendCsv(Csv, Match->WorldName, WaveIndex, TEXT("Property"), Wave.Properties);
+			AppendCsv(Csv, Match->WorldName, WaveIndex, TEXT("RPC"), Wave.Rpcs);
+			AppendCsv(Csv, Match->WorldName, WaveIndex, TEXT("ConnectionOut"), Wave.ConnectionsOut);
+			AppendCsv(Csv, Match->WorldName, WaveIndex, TEXT("ClassIn"), Wave.ClassesIn);
+			AppendCsv(Csv, Match->WorldName, WaveIndex, TEXT("ConnectionIn"), Wave.ConnectionsIn);
+		}
+	}
+
+	if (Csv.Len() == HeaderLength)
+	{
+		return FString();
+	}
+
+	// Clients and the server of a loopback test share Saved, the process id keeps them apart
+	const FString Path = FPaths::ProjectSavedDir() / TEXT("NetAccounting") /
+		FString::Printf(TEXT("NetAccounting-%s-%u.csv"), *FDateTime::Now().ToString(), FPlatformProcess::GetCurrentProcessId());
+
+	if (!FFileHelper::SaveStringToFile(Csv, *Path))
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Net: could not write %s"), *Path);
+		return FString();
+	}
+	return Path;
+}
+
+
+void FSNetAccounting::Reset()
+{
+	Matches.Empty();
+
+	ActorShadows.Empty();
+}
+
+
+FSNetAccounting::FRpcScope::FRpcScope(const UFunction* Function)
+	: PreviousRpc(FSNetAccounting::Get().CurrentRpc)
+{
+	FSNetAccounting::Get().CurrentRpc = Function ? Function->GetFName() : NAME_None;
+}
+
+
+FSNetAccounting::FRpcScope::~FRpcScope()
+{
+	FSNetAccounting::Get().CurrentRpc = PreviousRpc;
+}
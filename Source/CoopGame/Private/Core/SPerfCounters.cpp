@@ -0,0 +1,227 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SPerfCounters.h"
+#include "CoopGame.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+
+
+DEFINE_STAT(STAT_CoopWeaponFire);
+DEFINE_STAT(STAT_CoopTrackerBotTick);
+DEFINE_STAT(STAT_CoopTrackerBotPath);
+DEFINE_STAT(STAT_CoopTrackerBotNearbyBots);
+DEFINE_STAT(STAT_CoopTrackerBotSelfDestruct);
+DEFINE_STAT(STAT_CoopHealthDamage);
+DEFINE_STAT(STAT_CoopGameModeWaveState);
+DEFINE_STAT(STAT_CoopGameModePlayersAlive);
+DEFINE_STAT(STAT_CoopPickupRespawn);
+
+DEFINE_STAT(STAT_CoopShotsFired);
+DEFINE_STAT(STAT_CoopPathQueries);
+DEFINE_STAT(STAT_CoopNearbyBotOverlaps);
+DEFINE_STAT(STAT_CoopSelfDestructs);
+DEFINE_STAT(STAT_CoopDamageEvents);
+DEFINE_STAT(STAT_CoopPickupRespawns);
+
+CSV_DEFINE_CATEGORY(CoopGame, true);
+CSV_DEFINE_CATEGORY(CoopGameCounts, true);
+
+
+static void CostTableCommand(const TArray<FString>& Args)
+{
+	const int32 NrOfFrames = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 300;
+	FSPerfCounters::Get().LogCostTable(FMath::Clamp(NrOfFrames, 1, FSPerfCounters::HistorySize));
+}
+
+FAutoConsoleCommand CostTableConsoleCommand(
+	TEXT("COOP.CostTable"),
+	TEXT("Log average, 95th percentile and worst game thread time per subsystem over the last N frames (default 300)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&CostTableCommand));
+
+
+#if CSV_PROFILER
+namespace
+{
+	// Column names of the subsystem timings in the CSV, the profiler takes them as ANSI
+	const char* const CsvSubsystemNames[] =
+	{
+		"WeaponsMs",
+		"TrackerBotsMs",
+		"HealthMs",
+		"GameModeMs",
+		"PickupsMs",
+		"SpawningMs",
+		"StatusEffectsMs",
+		"ReplicationMs",
+	};
+	static_assert(ARRAY_COUNT(CsvSubsystemNames) == (int32)ECoopSubsystem::Count, "Every subsystem needs a CSV column");
+}
+#endif
+
+
+FSPerfCounters::FSPerfCounters()
+	: HistoryHead(0)
+	, HistoryNum(0)
+	, FrameCounter(0)
+	, ReplicationStartCycles(0)
+	, FrameStartTime(0.0)
+	, PreviousFrameStartTime(0.0)
+{
+	FMemory::Memzero(History);
+	FMemory::Memzero(CurrentCycles);
+}
+
+
+FSPerfCounters& FSPerfCounters::Get()
+{
+	static FSPerfCounters Instance;
+	return Instance;
+}
+
+
+const TCHAR* FSPerfCounters::GetSubsystemName(ECoopSubsystem Subsystem)
+{
+	switch (Subsystem)
+	{
+	case ECoopSubsystem::Weapons:		return TEXT("Weapons");
+	case ECoopSubsystem::TrackerBots:	return TEXT("TrackerBots");
+	case ECoopSubsystem::Health:		return TEXT("Health");
+	case ECoopSubsystem::GameMode:		return TEXT("GameMode");
+	case ECoopSubsystem::Pickups:		return TEXT("Pickups");
+	case ECoopSubsystem::Spawning:		return TEXT("Spawning");
+	case ECoopSubsystem::StatusEffects:	return TEXT("StatusEffects");
+	case ECoopSubsystem::Replication:	return TEXT("Replication");
+	default:							return TEXT("Unknown");
+	}
+}
+
+
+void FSPerfCounters::BeginFrame()
+{
+	PreviousFrameStartTime = FrameStartTime;
+	FrameStartTime = FPlatformTime::Seconds();
+}
+
+
+void FSPerfCounters::EndFrame()
+{
+	// Never carry an open bracket into the next frame (eg. a world torn down between its actor tick and its flush)
+	EndReplication();
+
+	const double Now = FPlatformTime::Seconds();
+
+	FSFramePerf& Frame = History[HistoryHead];
+	Frame.FrameMs = PreviousFrameStartTime > 0.0 ? (float)((FrameStartTime - PreviousFrameStartTime) * 1000.0) : 0.0f;
+	// OnBeginFrame fires before the engine sleeps for its max tick rate, that sleep isn't work
+	Frame.GameThreadMs = (float)(FMath::Max(Now - FrameStartTime - FApp::GetIdleTime(), 0.0) * 1000.0);
+
+	for (int32 i = 0; i < (int32)ECoopSubsystem::Count; i++)
+	{
+		Frame.SubsystemMs[i] = (float)FPlatformTime::ToMilliseconds(CurrentCycles[i]);
+		CurrentCycles[i] = 0;
+
+#if CSV_PROFILER
+		FCsvProfiler::RecordCustomStat(CsvSubsystemNames[i], CSV_CATEGORY_INDEX(CoopGame), Frame.SubsystemMs[i], ECsvCustomStatOp::Set);
+#endif
+	}
+
+	HistoryHead = (HistoryHead + 1) % HistorySize;
+	HistoryNum = FMath::Min(HistoryNum + 1, HistorySize);
+	FrameCounter++;
+}
+
+
+void FSPerfCounters::BeginReplication()
+{
+	ReplicationStartCycles = FPlatformTime::Cycles();
+}
+
+
+void FSPerfCounters::EndReplication()
+{
+	if (ReplicationStartCycles != 0)
+	{
+		AddCycles(ECoopSubsystem::Replication, FPlatformTime::Cycles() - ReplicationStartCycles);
+		ReplicationStartCycles = 0;
+	}
+}
+
+
+const FSFramePerf& FSPerfCounters::GetLastFrame() const
+{
+	return History[(HistoryHead + HistorySize - 1) % HistorySize];
+}
+
+
+void FSPerfCounters::GetHistory(TArray<FSFramePerf>& OutFrames, int32 MaxFrames) const
+{
+	const int32 NumFrames = FMath::Min(MaxFrames, HistoryNum);
+
+	OutFrames.Reset(NumFrames);
+	for (int32 i = NumFrames; i > 0; i--)
+	{
+		OutFrames.Add(History[(HistoryHead + HistorySize - i) % HistorySize]);
+	}
+}
+
+
+uint64 FSPerfCounters::GetFrameCounter() const
+{
+	return FrameCounter;
+}
+
+
+void FSPerfCounters::LogCostTable(int32 MaxFrames) const
+{
+	TArray<FSFramePerf> Frames;
+	GetHistory(Frames, MaxFrames);
+	if (Frames.Num() == 0)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Cost table: no frames recorded yet"));
+		return;
+	}
+
+	// Frame, game thread, then every subsystem
+	const int32 NrOfRows = 2 + (int32)ECoopSubsystem::Count;
+	TArray<TArray<float>> Samples;
+	Samples.SetNum(NrOfRows);
+	for (const FSFramePerf& Frame : Frames)
+	{
+		Samples[0].Add(Frame.FrameMs);
+		Samples[1].Add(Frame.GameThreadMs);
+		for (int32 i = 0; i < (int32)ECoopSubsystem::Count; i++)
+		{
+			Samples[2 + i].Add(Frame.SubsystemMs[i]);
+		}
+	}
+
+	float AvgGameThreadMs = 0.0f;
+	for (float Ms : Samples[1])
+	{
+		AvgGameThreadMs += Ms;
+	}
+	AvgGameThreadMs /= Frames.Num();
+
+	UE_LOG(LogCoopGame, Log, TEXT("Cost table over the last %d frames (ms):"), Frames.Num());
+	UE_LOG(LogCoopGame, Log, TEXT("  %-16s %8s %8s %8s %8s"), TEXT(""), TEXT("avg"), TEXT("p95"), TEXT("max"), TEXT("% of GT"));
+
+	for (int32 Row = 0; Row < NrOfRows; Row++)
+	{
+		TArray<float>& RowSamples = Samples[Row];
+
+		float Total = 0.0f;
+		for (float Ms : RowSamples)
+		{
+			Total += Ms;
+		}
+		const float Avg = Total / RowSamples.Num();
+
+		RowSamples.Sort();
+		const float P95 = RowSamples[FMath::Min(FMath::FloorToInt(RowSamples.Num() * 0.95f), RowSamples.Num() - 1)];
+
+		const TCHAR* Name = Row == 0 ? TEXT("Frame") : Row == 1 ? TEXT("Game thread") : GetSubsystemName((ECoopSubsystem)(Row - 2));
+		const FString Share = Row >= 1 && AvgGameThreadMs > 0.0f ? FString::Printf(TEXT("%7.1f%%"), Avg / AvgGameThreadMs * 100.0f) : FString();
+
+		UE_LOG(LogCoopGame, Log, TEXT("  %-16s %8.3f %8.3f %8.3f %8s"), Name, Avg, P95, RowSamples.Last(), *Share);
+	}
+}
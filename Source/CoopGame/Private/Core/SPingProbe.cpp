@@ -0,0 +1,415 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SPingProbe.h"
+#include "CoopGame.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "HAL/IConsoleManager.h"
+
+
+static int32 PingResponderLag = 0;
+FAutoConsoleVariableRef CVARPingResponderLag(
+	TEXT("COOP.PingResponderLag"),
+	PingResponderLag,
+	TEXT("Milliseconds the ping responder holds back every reply, to emulate latency to this host"),
+	ECVF_Cheat);
+
+static int32 PingResponderLagVariance = 0;
+FAutoConsoleVariableRef CVARPingResponderLagVariance(
+	TEXT("COOP.PingResponderLagVariance"),
+	PingResponderLagVariance,
+	TEXT("Up to this many extra milliseconds of random delay per reply, to emulate jitter"),
+	ECVF_Cheat);
+
+
+namespace
+{
+	// Magic, target index, round, nonce
+	const uint32 ProbeMagic = 0x504F4F43;
+	const int32 ProbePacketSize = 12;
+
+	void WriteUInt32(uint8* Data, uint32 Value)
+	{
+		Data[0] = Value & 0xFF;
+		Data[1] = (Value >> 8) & 0xFF;
+		Data[2] = (Value >> 16) & 0xFF;
+		Data[3] = (Value >> 24) & 0xFF;
+	}
+
+	uint32 ReadUInt32(const uint8* Data)
+	{
+		return Data[0] | (Data[1] << 8) | (Data[2] << 16) | ((uint32)Data[3] << 24);
+	}
+
+	void WriteProbe(uint8* Data, uint16 TargetIndex, uint16 Round, uint32 Nonce)
+	{
+		WriteUInt32(Data, ProbeMagic);
+		WriteUInt32(Data + 4, TargetIndex | ((uint32)Round << 16));
+		WriteUInt32(Data + 8, Nonce);
+	}
+
+	bool ReadProbe(const uint8* Data, int32 Size, uint16& OutTargetIndex, uint16& OutRound, uint32& OutNonce)
+	{
+		if (Size != ProbePacketSize || ReadUInt32(Data) != ProbeMagic)
+		{
+			return false;
+		}
+
+		const uint32 Indices = ReadUInt32(Data + 4);
+		OutTargetIndex = Indices & 0xFFFF;
+		OutRound = Indices >> 16;
+		OutNonce = ReadUInt32(Data + 8);
+		return true;
+	}
+
+	FSocket* CreateProbeSocket(const TCHAR* Description, int32 Port)
+	{
+		ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+		if (SocketSubsystem == nullptr)
+		{
+			return nullptr;
+		}
+
+		FSocket* Socket = SocketSubsystem->CreateSocket(NAME_DGram, Description, true);
+		if (Socket == nullptr)
+		{
+			return nullptr;
+		}
+
+		TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+		Address->SetAnyAddress();
+		Address->SetPort(Port);
+
+		if (!Socket->SetNonBlocking(true) || !Socket->Bind(*Address))
+		{
+			SocketSubsystem->DestroySocket(Socket);
+			return nullptr;
+		}
+
+		return Socket;
+	}
+}
+
+
+FSPingResponder::FSPingResponder()
+	: Socket(nullptr)
+	, BoundPort(0)
+{
+}
+
+
+FSPingResponder::~FSPingResponder()
+{
+	Stop();
+}
+
+
+int32 FSPingResponder::Start(int32 Port)
+{
+	Stop();
+
+	Socket = CreateProbeSocket(TEXT("CoopPingResponder"), Port);
+	if (Socket == nullptr)
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Ping responder: could not bind port %d"), Port);
+		return 0;
+	}
+
+	BoundPort = Socket->GetPortNo();
+	TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FSPingResponder::Tick));
+
+	UE_LOG(LogCoopGame, Log, TEXT("Ping responder: answering probes on port %d"), BoundPort);
+
+	return BoundPort;
+}
+
+
+void FSPingResponder::Stop()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	TickHandle.Reset();
+
+	if (Socket)
+	{
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+
+	BoundPort = 0;
+	DelayedReplies.Reset();
+}
+
+
+int32 FSPingResponder::GetPort() const
+{
+	return BoundPort;
+}
+
+
+bool FSPingResponder::Tick(float DeltaTime)
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	const double Now = FPlatformTime::Seconds();
+
+	uint8 Packet[ProbePacketSize + 1];
+	uint32 PendingSize = 0;
+	while (Socket->HasPendingData(PendingSize))
+	{
+		TSharedRef<FInternetAddr> Source = SocketSubsystem->CreateInternetAddr();
+		int32 BytesRead = 0;
+		if (!Socket->RecvFrom(Packet, sizeof(Packet), BytesRead, *Source))
+		{
+			break;
+		}
+
+		uint16 TargetIndex, Round;
+		uint32 Nonce;
+		if (!ReadProbe(Packet, BytesRead, TargetIndex, Round, Nonce))
+		{
+			continue;
+		}
+
+		FDelayedReply& Reply = DelayedReplies.AddDefaulted_GetRef();
+		Reply.Packet.Append(Packet, BytesRead);
+		Reply.Destination = Source;
+		Reply.SendTime = Now + (PingResponderLag + FMath::RandRange(0, FMath::Max(PingResponderLagVariance, 0))) / 1000.0;
+	}
+
+	// Without emulated lag every reply goes out in the frame its probe came in
+	for (int32 i = 0; i < DelayedReplies.Num(); i++)
+	{
+		const FDelayedReply& Reply = DelayedReplies[i];
+		if (Reply.SendTime > Now)
+		{
+			continue;
+		}
+
+		int32 BytesSent = 0;
+		Socket->SendTo(Reply.Packet.GetData(), Reply.Packet.Num(), BytesSent, *Reply.Destination);
+
+		DelayedReplies.RemoveAtSwap(i, 1, false);
+		i--;
+	}
+
+	return true;
+}
+
+
+FSPingProber::FSPingProber()
+	: Socket(nullptr)
+	, NrOfProbes(0)
+	, ProbeInterval(0.0f)
+	, Timeout(0.0f)
+	, Nonce(0)
+{
+}
+
+
+FSPingProber::~FSPingProber()
+{
+	Cancel();
+}
+
+
+bool FSPingProber::Start(const TArray<TSharedPtr<FInternetAddr>>& InTargets, int32 InNrOfProbes, float InProbeInterval, float InTimeout, FOnProbesFinished InOnFinished)
+{
+	Cancel();
+
+	if (InTargets.Num() == 0 || InTargets.Num() > MAX_uint16 || InNrOfProbes <= 0)
+	{
+		return false;
+	}
+
+	Socket = CreateProbeSocket(TEXT("CoopPingProber"), 0);
+	if (Socket == nullptr)
+	{
+		return false;
+	}
+
+	Targets = InTargets;
+	NrOfProbes = FMath::Min(InNrOfProbes, (int32)MAX_uint16);
+	ProbeInterval = InProbeInterval;
+	Timeout = InTimeout;
+	OnFinished = InOnFinished;
+	Nonce = FMath::Rand() ^ (uint32)(FPlatformTime::Cycles64() & 0xFFFFFFFF);
+
+	RttMs.SetNum(Targets.Num());
+	for (TArray<float>& TargetRtts : RttMs)
+	{
+		TargetRtts.Init(-1.0f, NrOfProbes);
+	}
+	RoundSendTimes.Reset();
+
+	SendRound();
+
+	TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FSPingProber::Tick));
+
+	return true;
+}
+
+
+void FSPingProber::Cancel()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	TickHandle.Reset();
+
+	CloseSocket();
+	OnFinished.Unbind();
+}
+
+
+bool FSPingProber::IsRunning() const
+{
+	return Socket != nullptr;
+}
+
+
+bool FSPingProber::Tick(float DeltaTime)
+{
+	ReceiveReplies();
+
+	const double Now = FPlatformTime::Seconds();
+	const bool bAllRoundsSent = RoundSendTimes.Num() >= NrOfProbes;
+
+	if (!bAllRoundsSent && Now - RoundSendTimes.Last() >= ProbeInterval)
+	{
+		SendRound();
+		return true;
+	}
+
+	if (bAllRoundsSent && (HasAllReplies() || Now - RoundSendTimes.Last() >= Timeout))
+	{
+		Finish();
+		return false;
+	}
+
+	return true;
+}
+
+
+void FSPingProber::SendRound()
+{
+	const uint16 Round = RoundSendTimes.Num();
+	RoundSendTimes.Add(FPlatformTime::Seconds());
+
+	// Every host gets its probe in the same frame
+	uint8 Packet[ProbePacketSize];
+	for (int32 i = 0; i < Targets.Num(); i++)
+	{
+		WriteProbe(Packet, i, Round, Nonce);
+
+		int32 BytesSent = 0;
+		Socket->SendTo(Packet, ProbePacketSize, BytesSent, *Targets[i]);
+	}
+}
+
+
+void FSPingProber::ReceiveReplies()
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	const double Now = FPlatformTime::Seconds();
+
+	uint8 Packet[ProbePacketSize + 1];
+	uint32 PendingSize = 0;
+	while (Socket->HasPendingData(PendingSize))
+	{
+		TSharedRef<FInternetAddr> Source = SocketSubsystem->CreateInternetAddr();
+		int32 BytesRead = 0;
+		if (!Socket->RecvFrom(Packet, sizeof(Packet), BytesRead, *Source))
+		{
+			break;
+		}
+
+		uint16 TargetIndex, Round;
+		uint32 ReplyNonce;
+		if (!ReadProbe(Packet, BytesRead, TargetIndex, Round, ReplyNonce) || ReplyNonce != Nonce
+			|| !RttMs.IsValidIndex(TargetIndex) || !RoundSendTimes.IsValidIndex(Round))
+		{
+			continue;
+		}
+
+		float& Rtt = RttMs[TargetIndex][Round];
+		if (Rtt < 0.0f)
+		{
+			Rtt = (float)((Now - RoundSendTimes[Round]) * 1000.0);
+		}
+	}
+}
+
+
+bool FSPingProber::HasAllReplies() const
+{
+	for (const TArray<float>& TargetRtts : RttMs)
+	{
+		for (float Rtt : TargetRtts)
+		{
+			if (Rtt < 0.0f)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+void FSPingProber::Finish()
+{
+	TArray<FSPingProbeResult> Results;
+	Results.SetNum(Targets.Num());
+
+	for (int32 i = 0; i < Targets.Num(); i++)
+	{
+		FSPingProbeResult& Result = Results[i];
+		Result.NrOfSent = NrOfProbes;
+
+		float TotalRtt = 0.0f;
+		float TotalDelta = 0.0f;
+		float PreviousRtt = -1.0f;
+		for (float Rtt : RttMs[i])
+		{
+			if (Rtt < 0.0f)
+			{
+				continue;
+			}
+
+			Result.NrOfReceived++;
+			TotalRtt += Rtt;
+
+			if (PreviousRtt >= 0.0f)
+			{
+				TotalDelta += FMath::Abs(Rtt - PreviousRtt);
+			}
+			PreviousRtt = Rtt;
+		}
+
+		if (Result.NrOfReceived > 0)
+		{
+			Result.MeanRttMs = TotalRtt / Result.NrOfReceived;
+		}
+		if (Result.NrOfReceived > 1)
+		{
+			Result.JitterMs = TotalDelta / (Result.NrOfReceived - 1);
+		}
+	}
+
+	CloseSocket();
+	TickHandle.Reset();
+
+	// Copy, the callback may start the next run
+	const FOnProbesFinished Callback = OnFinished;
+	OnFinished.Unbind();
+	Callback.ExecuteIfBound(Results);
+}
+
+
+void FSPingProber::CloseSocket()
+{
+	if (Socket)
+	{
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+}
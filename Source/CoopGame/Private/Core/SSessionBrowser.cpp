@@ -0,0 +1,477 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SSessionBrowser.h"
+#include "CoopGame.h"
+#include "SGameInstance.h"
+#include "OnlineSubsystem.h"
+#include "OnlineSessionInterface.h"
+#include "Engine/World.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+
+
+static void SessionsCommand(const TArray<FString>& Args, UWorld* World)
+{
+	USGameInstance* GI = World ? World->GetGameInstance<USGameInstance>() : nullptr;
+	USSessionBrowser* SessionBrowser = GI ? GI->GetSessionBrowser() : nullptr;
+	if (SessionBrowser == nullptr)
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("COOP.Sessions: no session browser, dedicated servers don't browse"));
+		return;
+	}
+
+	if (Args.Num() > 0 && Args[0] == TEXT("refresh"))
+	{
+		SessionBrowser->Refresh();
+		return;
+	}
+
+	if (Args.Num() > 0 && Args[0] == TEXT("probe"))
+	{
+		// Logs the ranking once the measurements are in
+		SessionBrowser->ProbeSessions(FSimpleDelegate());
+		return;
+	}
+
+	SessionBrowser->LogSessions();
+}
+
+FAutoConsoleCommandWithWorldAndArgs SessionsConsoleCommand(
+	TEXT("COOP.Sessions"),
+	TEXT("Log the cached sessions of the session browser, 'refresh' searches again right away, 'probe' pings their hosts"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SessionsCommand));
+
+
+USSessionBrowser::USSessionBrowser()
+{
+	RefreshInterval = 10.0f;
+	MaxSearchResults = 20;
+	PingBucketSize = 50;
+	HistoryLength = 8;
+	DropAfterMissedRefreshes = 3;
+
+	NrOfProbes = 5;
+	ProbeInterval = 0.1f;
+	ProbeTimeout = 1.0f;
+
+	JitterWeight = 2.0f;
+	LossPenaltyMs = 200.0f;
+	FullServerPenaltyMs = 30.0f;
+	UnprobedPenaltyMs = 50.0f;
+
+	bIsLAN = false;
+	bIsPresence = false;
+	SearchStartTime = 0.0;
+}
+
+
+void USSessionBrowser::Start(TSharedPtr<const FUniqueNetId> InUserId, bool bInIsLAN, bool bInIsPresence)
+{
+	// Different kind of search, what we have cached doesn't apply anymore
+	if (bInIsLAN != bIsLAN || bInIsPresence != bIsPresence)
+	{
+		CachedSessions.Reset();
+	}
+
+	UserId = InUserId;
+	bIsLAN = bInIsLAN;
+	bIsPresence = bInIsPresence;
+
+	if (!RefreshHandle.IsValid())
+	{
+		RefreshHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &USSessionBrowser::OnRefreshTimer), RefreshInterval);
+	}
+
+	Refresh();
+}
+
+
+void USSessionBrowser::Stop()
+{
+	FTicker::GetCoreTicker().RemoveTicker(RefreshHandle);
+	RefreshHandle.Reset();
+}
+
+
+void USSessionBrowser::Refresh()
+{
+	if (IsRefreshing() || !UserId.IsValid())
+	{
+		return;
+	}
+
+	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
+	IOnlineSessionPtr Sessions = OnlineSub ? OnlineSub->GetSessionInterface() : IOnlineSessionPtr();
+	if (!Sessions.IsValid())
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Sessions: no online subsystem to search with"));
+		return;
+	}
+
+	SessionSearch = MakeShareable(new FOnlineSessionSearch());
+	SessionSearch->bIsLanQuery = bIsLAN;
+	SessionSearch->MaxSearchResults = MaxSearchResults;
+	SessionSearch->PingBucketSize = PingBucketSize;
+
+	if (bIsPresence)
+	{
+		SessionSearch->QuerySettings.Set(SEARCH_PRESENCE, bIsPresence, EOnlineComparisonOp::Equals);
+	}
+
+	SearchStartTime = FPlatformTime::Seconds();
+
+	OnFindSessionsCompleteDelegateHandle = Sessions->AddOnFindSessionsCompleteDelegate_Handle(
+		FOnFindSessionsCompleteDelegate::CreateUObject(this, &USSessionBrowser::OnFindSessionsComplete));
+
+	if (!Sessions->FindSessions(*UserId, SessionSearch.ToSharedRef()))
+	{
+		// Some subsystems already fired the delegate, then this does nothing
+		OnFindSessionsComplete(false);
+	}
+}
+
+
+bool USSessionBrowser::IsRefreshing() const
+{
+	return SessionSearch.IsValid();
+}
+
+
+bool USSessionBrowser::OnRefreshTimer(float DeltaTime)
+{
+	Refresh();
+	return true;
+}
+
+
+void USSessionBrowser::OnFindSessionsComplete(bool bWasSuccessful)
+{
+	if (!SessionSearch.IsValid())
+	{
+		return;
+	}
+
+	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
+	IOnlineSessionPtr Sessions = OnlineSub ? OnlineSub->GetSessionInterface() : IOnlineSessionPtr();
+	if (Sessions.IsValid())
+	{
+		Sessions->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
+	}
+
+	// A failed search says nothing about the sessions we know of, keep them as they are
+	if (bWasSuccessful)
+	{
+		MergeResults(SessionSearch->SearchResults);
+	}
+
+	UE_LOG(LogCoopGame, Verbose, TEXT("Sessions: search %s after %.0f ms, %d results, %d cached"), bWasSuccessful ? TEXT("finished") : TEXT("failed"),
+		(FPlatformTime::Seconds() - SearchStartTime) * 1000.0, SessionSearch->SearchResults.Num(), CachedSessions.Num());
+
+	SessionSearch.Reset();
+
+	OnSessionsUpdated.Broadcast();
+}
+
+
+void USSessionBrowser::MergeResults(const TArray<FOnlineSessionSearchResult>& Results)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	for (FCachedSession& Cached : CachedSessions)
+	{
+		Cached.NrOfMissedRefreshes++;
+	}
+
+	for (const FOnlineSessionSearchResult& Result : Results)
+	{
+		if (!Result.IsValid())
+		{
+			continue;
+		}
+
+		// Filter sessions from ourself
+		if (Result.Session.OwningUserId.IsValid() && *Result.Session.OwningUserId == *UserId)
+		{
+			continue;
+		}
+
+		const FString SessionId = Result.GetSessionIdStr();
+
+		FCachedSession* Cached = CachedSessions.FindByPredicate([&SessionId](const FCachedSession& Candidate) { return Candidate.Entry.SessionId == SessionId; });
+		if (Cached == nullptr)
+		{
+			Cached = &CachedSessions.AddDefaulted_GetRef();
+			Cached->Entry.SessionId = SessionId;
+		}
+
+		Cached->Result = Result;
+		Cached->LastSeenTime = Now;
+		Cached->NrOfMissedRefreshes = 0;
+
+		FSSessionBrowserEntry& Entry = Cached->Entry;
+		Entry.OwningUserName = Result.Session.OwningUserName;
+		Entry.PingMs = Result.PingInMs;
+		Entry.MaxPlayers = Result.Session.SessionSettings.NumPublicConnections;
+		Entry.NumPlayers = FMath::Max(Entry.MaxPlayers - Result.Session.NumOpenPublicConnections, 0);
+
+		AddSample(Entry.PingHistory, Entry.PingMs);
+		AddSample(Entry.PlayerHistory, Entry.NumPlayers);
+
+		int32 TotalPing = 0;
+		for (int32 Ping : Entry.PingHistory)
+		{
+			TotalPing += Ping;
+		}
+		Entry.AveragePingMs = (float)TotalPing / Entry.PingHistory.Num();
+	}
+
+	CachedSessions.RemoveAll([this](const FCachedSession& Cached) { return Cached.NrOfMissedRefreshes >= DropAfterMissedRefreshes; });
+}
+
+
+void USSessionBrowser::AddSample(TArray<int32>& History, int32 Sample) const
+{
+	if (History.Num() >= HistoryLength)
+	{
+		History.RemoveAt(0, History.Num() - HistoryLength + 1, false);
+	}
+	History.Add(Sample);
+}
+
+
+void USSessionBrowser::GetSessions(const FSSessionFilter& Filter, ESessionSortKey SortKey, TArray<FSSessionBrowserEntry>& OutSessions) const
+{
+	const double Now = FPlatformTime::Seconds();
+
+	OutSessions.Reset(CachedSessions.Num());
+
+	for (const FCachedSession& Cached : CachedSessions)
+	{
+		const FSSessionBrowserEntry& Entry = Cached.Entry;
+
+		if (Filter.bHideFull && Entry.NumPlayers >= Entry.MaxPlayers)
+		{
+			continue;
+		}
+		if (Filter.MaxPingMs > 0 && Entry.PingMs > Filter.MaxPingMs)
+		{
+			continue;
+		}
+		if (!Filter.NameContains.IsEmpty() && !Entry.OwningUserName.Contains(Filter.NameContains))
+		{
+			continue;
+		}
+
+		FSSessionBrowserEntry& OutEntry = OutSessions.Add_GetRef(Entry);
+		OutEntry.SecondsSinceSeen = (float)(Now - Cached.LastSeenTime);
+		OutEntry.Score = GetScore(Entry);
+	}
+
+	switch (SortKey)
+	{
+	case ESessionSortKey::Best:
+		OutSessions.Sort([](const FSSessionBrowserEntry& A, const FSSessionBrowserEntry& B) { return A.Score < B.Score; });
+		break;
+	case ESessionSortKey::Ping:
+		OutSessions.Sort([](const FSSessionBrowserEntry& A, const FSSessionBrowserEntry& B) { return A.PingMs < B.PingMs; });
+		break;
+	case ESessionSortKey::Players:
+		OutSessions.Sort([](const FSSessionBrowserEntry& A, const FSSessionBrowserEntry& B) { return A.NumPlayers > B.NumPlayers; });
+		break;
+	case ESessionSortKey::Name:
+		OutSessions.Sort([](const FSSessionBrowserEntry& A, const FSSessionBrowserEntry& B) { return A.OwningUserName < B.OwningUserName; });
+		break;
+	}
+}
+
+
+bool USSessionBrowser::FindSearchResult(const FString& SessionId, FOnlineSessionSearchResult& OutResult) const
+{
+	const FCachedSession* Cached = CachedSessions.FindByPredicate([&SessionId](const FCachedSession& Candidate) { return Candidate.Entry.SessionId == SessionId; });
+	if (Cached == nullptr)
+	{
+		return false;
+	}
+
+	OutResult = Cached->Result;
+	return true;
+}
+
+
+void USSessionBrowser::LogSessions() const
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Sessions: %d cached%s"), CachedSessions.Num(), IsRefreshing() ? TEXT(", refreshing") : TEXT(""));
+
+	TArray<FSSessionBrowserEntry> Sessions;
+	FSSessionFilter ShowAll;
+	ShowAll.bHideFull = false;
+	GetSessions(ShowAll, ESessionSortKey::Best, Sessions);
+
+	for (const FSSessionBrowserEntry& Entry : Sessions)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("  %-24s %2d/%-2d players %4d ms (avg %4.0f over %d) rtt %5.1f jitter %4.1f loss %3.0f%% score %5.1f seen %.0fs ago  %s"),
+			*Entry.OwningUserName, Entry.NumPlayers, Entry.MaxPlayers, Entry.PingMs, Entry.AveragePingMs, Entry.PingHistory.Num(),
+			Entry.MeasuredRttMs, Entry.JitterMs, Entry.ProbeLoss * 100.0f, Entry.Score, Entry.SecondsSinceSeen, *Entry.SessionId);
+	}
+}
+
+
+void USSessionBrowser::ProbeSessions(FSimpleDelegate OnFinished)
+{
+	OnProbesFinished = OnFinished;
+
+	if (IsProbing())
+	{
+		// The running probe reports to the latest caller
+		return;
+	}
+
+	TArray<TSharedPtr<FInternetAddr>> Targets;
+	ProbedSessionIds.Reset();
+
+	for (FCachedSession& Cached : CachedSessions)
+	{
+		FSSessionBrowserEntry& Entry = Cached.Entry;
+		if (Entry.NumPlayers >= Entry.MaxPlayers)
+		{
+			continue;
+		}
+
+		TSharedPtr<FInternetAddr> Address = GetProbeAddress(Cached.Result);
+		if (Address.IsValid())
+		{
+			Targets.Add(Address);
+			ProbedSessionIds.Add(Entry.SessionId);
+		}
+	}
+
+	const bool bStarted = Targets.Num() > 0 && Prober.Start(Targets, NrOfProbes, ProbeInterval, ProbeTimeout,
+		FSPingProber::FOnProbesFinished::CreateUObject(this, &USSessionBrowser::OnProbed));
+
+	if (!bStarted)
+	{
+		// Nothing to measure, the ranking falls back to the pings of the search
+		ProbedSessionIds.Reset();
+
+		const FSimpleDelegate Callback = OnProbesFinished;
+		OnProbesFinished.Unbind();
+		Callback.ExecuteIfBound();
+	}
+}
+
+
+bool USSessionBrowser::IsProbing() const
+{
+	return Prober.IsRunning();
+}
+
+
+TSharedPtr<FInternetAddr> USSessionBrowser::GetProbeAddress(const FOnlineSessionSearchResult& Result) const
+{
+	int32 ProbePort = 0;
+	if (!Result.Session.SessionSettings.Get(SETTING_COOP_PROBEPORT, ProbePort) || ProbePort <= 0)
+	{
+		return nullptr;
+	}
+
+	IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
+	IOnlineSessionPtr Sessions = OnlineSub ? OnlineSub->GetSessionInterface() : IOnlineSessionPtr();
+
+	FString ConnectInfo;
+	if (!Sessions.IsValid() || !Sessions->GetResolvedConnectString(Result, NAME_GamePort, ConnectInfo))
+	{
+		return nullptr;
+	}
+
+	// ip:port of the game, subsystems that connect through their own addresses (eg. steam.1234) can't be probed
+	FString Host = ConnectInfo;
+	int32 ColonIndex;
+	if (ConnectInfo.FindLastChar(TEXT(':'), ColonIndex))
+	{
+		Host = ConnectInfo.Left(ColonIndex);
+	}
+
+	TSharedRef<FInternetAddr> Address = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+
+	bool bIsValid = false;
+	Address->SetIp(*Host, bIsValid);
+	if (!bIsValid)
+	{
+		return nullptr;
+	}
+
+	Address->SetPort(ProbePort);
+	return Address;
+}
+
+
+void USSessionBrowser::OnProbed(const TArray<FSPingProbeResult>& Results)
+{
+	for (int32 i = 0; i < Results.Num() && i < ProbedSessionIds.Num(); i++)
+	{
+		const FString& SessionId = ProbedSessionIds[i];
+
+		// The session may have been dropped by a search while we probed
+		FCachedSession* Cached = CachedSessions.FindByPredicate([&SessionId](const FCachedSession& Candidate) { return Candidate.Entry.SessionId == SessionId; });
+		if (Cached == nullptr)
+		{
+			continue;
+		}
+
+		const FSPingProbeResult& Result = Results[i];
+		if (Result.NrOfReceived > 0)
+		{
+			Cached->Entry.MeasuredRttMs = Result.MeanRttMs;
+			Cached->Entry.JitterMs = Result.JitterMs;
+			Cached->Entry.ProbeLoss = Result.GetLoss();
+		}
+		else
+		{
+			// Scored on the search ping like an unprobed host, but every probe we sent was lost and ranks it below any host that answered
+			Cached->Entry.MeasuredRttMs = -1.0f;
+			Cached->Entry.JitterMs = 0.0f;
+			Cached->Entry.ProbeLoss = Result.GetLoss();
+		}
+	}
+
+	ProbedSessionIds.Reset();
+
+	LogSessions();
+
+	OnSessionsUpdated.Broadcast();
+
+	const FSimpleDelegate Callback = OnProbesFinished;
+	OnProbesFinished.Unbind();
+	Callback.ExecuteIfBound();
+}
+
+
+float USSessionBrowser::GetScore(const FSSessionBrowserEntry& Entry) const
+{
+	const float Rtt = Entry.MeasuredRttMs >= 0.0f ? Entry.MeasuredRttMs : Entry.PingMs + UnprobedPenaltyMs;
+	const float Load = Entry.MaxPlayers > 0 ? (float)Entry.NumPlayers / Entry.MaxPlayers : 1.0f;
+
+	return Rtt + JitterWeight * Entry.JitterMs + LossPenaltyMs * Entry.ProbeLoss + FullServerPenaltyMs * Load;
+}
+
+
+void USSessionBrowser::BeginDestroy()
+{
+	Stop();
+
+	Prober.Cancel();
+	OnProbesFinished.Unbind();
+
+	if (SessionSearch.IsValid())
+	{
+		IOnlineSubsystem* OnlineSub = IOnlineSubsystem::Get();
+		IOnlineSessionPtr Sessions = OnlineSub ? OnlineSub->GetSessionInterface() : IOnlineSessionPtr();
+		if (Sessions.IsValid())
+		{
+			Sessions->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
+		}
+		SessionSearch.Reset();
+	}
+
+	Super::BeginDestroy();
+}
@@ -0,0 +1,339 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "STelemetry.h"
+#include "CoopGame.h"
+#include "HAL/FileManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Compression.h"
+#include "Misc/Paths.h"
+
+
+namespace
+{
+	// 2 MB of events, a few seconds of a busy wave even if the writer stalls
+	const uint32 RingCapacity = 1 << 16;
+
+	// Uncompressed bytes per compressed block
+	const int32 BlockSize = 64 * 1024;
+
+	// Blocks are flushed at least this often, so a crash loses little
+	const double MaxBlockAgeSeconds = 1.0;
+
+	const int64 MaxFileBytes = 32 * 1024 * 1024;
+
+	// Oldest files are deleted beyond this
+	const int32 MaxFiles = 8;
+
+	const float WriterSleepSeconds = 0.01f;
+}
+
+
+FSTelemetryRing::FSTelemetryRing(uint32 CapacityPow2)
+	: Slots(MakeUnique<FSlot[]>(CapacityPow2))
+	, Mask(CapacityPow2 - 1)
+	, EnqueuePos(0)
+	, DequeuePos(0)
+{
+	check(FMath::IsPowerOfTwo(CapacityPow2));
+
+	for (uint32 i = 0; i < CapacityPow2; i++)
+	{
+		Slots[i].Sequence.Store(i);
+	}
+}
+
+
+bool FSTelemetryRing::Pop(FSTelemetryEvent& OutEvent)
+{
+	FSlot& Slot = Slots[DequeuePos & Mask];
+	if (Slot.Sequence.Load() != DequeuePos + 1)
+	{
+		// Empty, or the producer that claimed the slot is still copying
+		return false;
+	}
+
+	OutEvent = Slot.Event;
+
+	// Hand the slot back to producers for the next lap around the ring
+	Slot.Sequence.Store(DequeuePos + Mask + 1);
+	DequeuePos++;
+	return true;
+}
+
+
+// Drains the ring into compressed blocks, owns the files
+class FSTelemetryWriter : public FRunnable
+{
+public:
+
+	explicit FSTelemetryWriter(FSTelemetry& InOwner)
+		: Owner(InOwner)
+		, bStopRequested(false)
+		, File(nullptr)
+		, FileBytes(0)
+		, FileIndex(0)
+		, ReportedDropped(0)
+		, BlockStartTime(0.0)
+	{
+		Block.Reserve(BlockSize + sizeof(FSTelemetryEvent));
+
+		BaseName = FPaths::ProjectSavedDir() / TEXT("Telemetry") / FString::Printf(TEXT("Telemetry-%s"), *FDateTime::Now().ToString());
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopRequested)
+		{
+			Drain();
+
+			if (Block.Num() > 0 && FPlatformTime::Seconds() - BlockStartTime > MaxBlockAgeSeconds)
+			{
+				FlushBlock();
+			}
+
+			FPlatformProcess::Sleep(WriterSleepSeconds);
+		}
+
+		Drain();
+		FlushBlock();
+		CloseFile();
+		return 0;
+	}
+
+	virtual void Stop() override
+	{
+		bStopRequested = true;
+	}
+
+private:
+
+	void Drain()
+	{
+		// Drops are reported in the stream itself, so a decoded log shows where it has gaps
+		const uint32 Dropped = Owner.NumDropped.Load();
+		if (Dropped != ReportedDropped)
+		{
+			FSTelemetryEvent Event;
+			FMemory::Memzero(Event);
+			Event.Cycles = FPlatformTime::Cycles64();
+			Event.Type = ECoopTelemetryEvent::Dropped;
+			Event.Extra = (int32)(Dropped - ReportedDropped);
+			Append(Event);
+
+			ReportedDropped = Dropped;
+		}
+
+		FSTelemetryEvent Event;
+		while (Owner.Ring.Pop(Event))
+		{
+			Append(Event);
+		}
+	}
+
+	void Append(const FSTelemetryEvent& Event)
+	{
+		if (Block.Num() == 0)
+		{
+			BlockStartTime = FPlatformTime::Seconds();
+		}
+
+		Block.Append((const uint8*)&Event, sizeof(Event));
+		Owner.NumWritten++;
+
+		if (Block.Num() >= BlockSize)
+		{
+			FlushBlock();
+		}
+	}
+
+	void FlushBlock()
+	{
+		if (Block.Num() == 0)
+		{
+			return;
+		}
+
+		if (File == nullptr || FileBytes >= MaxFileBytes)
+		{
+			OpenNextFile();
+		}
+
+		int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Block.Num());
+		Compressed.SetNumUninitialized(CompressedSize, false);
+
+		uint32 UncompressedSize = Block.Num();
+		if (!FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, Block.GetData(), Block.Num()))
+		{
+			// Store it raw, the decoder tells them apart by the sizes
+			Compressed = Block;
+			CompressedSize = Block.Num();
+		}
+
+		if (File)
+		{
+			uint32 CompressedSize32 = CompressedSize;
+			*File << UncompressedSize;
+			*File << CompressedSize32;
+			File->Serialize(Compressed.GetData(), CompressedSize);
+
+			FileBytes += 2 * sizeof(uint32) + CompressedSize;
+		}
+
+		Block.Reset();
+	}
+
+	void OpenNextFile()
+	{
+		CloseFile();
+
+		const FString Path = FString::Printf(TEXT("%s-%d.ctlm"), *BaseName, FileIndex++);
+		File = IFileManager::Get().CreateFileWriter(*Path);
+		if (File == nullptr)
+		{
+			UE_LOG(LogCoopGame, Warning, TEXT("Telemetry: could not open %s"), *Path);
+			return;
+		}
+
+		FSTelemetry::FFileHeader Header;
+		Header.Magic = FSTelemetry::FileMagic;
+		Header.Version = FSTelemetry::FileVersion;
+		Header.EventSize = sizeof(FSTelemetryEvent);
+		Header.Padding = 0;
+		Header.SecondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+		File->Serialize(&Header, sizeof(Header));
+		FileBytes = sizeof(Header);
+
+		Files.Add(Path);
+		while (Files.Num() > MaxFiles)
+		{
+			IFileManager::Get().Delete(*Files[0]);
+			Files.RemoveAt(0);
+		}
+	}
+
+	void CloseFile()
+	{
+		if (File)
+		{
+			File->Close();
+			delete File;
+			File = nullptr;
+		}
+	}
+
+	FSTelemetry& Owner;
+
+	TAtomic<bool> bStopRequested;
+
+	FString BaseName;
+
+	TArray<FString> Files;
+
+	FArchive* File;
+
+	int64 FileBytes;
+
+	int32 FileIndex;
+
+	uint32 ReportedDropped;
+
+	double BlockStartTime;
+
+	TArray<uint8> Block;
+
+	TArray<uint8> Compressed;
+};
+
+
+FSTelemetry::FSTelemetry()
+	: bEnabled(false)
+	, Ring(RingCapacity)
+	, NumDropped(0)
+	, NumWritten(0)
+	, Writer(nullptr)
+	, WriterThread(nullptr)
+{
+}
+
+
+FSTelemetry& FSTelemetry::Get()
+{
+	static FSTelemetry Instance;
+	return Instance;
+}
+
+
+const TCHAR* FSTelemetry::GetEventName(ECoopTelemetryEvent Type)
+{
+	switch (Type)
+	{
+	case ECoopTelemetryEvent::Dropped:		return TEXT("Dropped");
+	case ECoopTelemetryEvent::Shot:			return TEXT("Shot");
+	case ECoopTelemetryEvent::Damage:		return TEXT("Damage");
+	case ECoopTelemetryEvent::Kill:			return TEXT("Kill");
+	case ECoopTelemetryEvent::WaveState:	return TEXT("WaveState");
+	case ECoopTelemetryEvent::Governor:		return TEXT("Governor");
+	case ECoopTelemetryEvent::Correction:	return TEXT("Correction");
+	default:								return TEXT("Unknown");
+	}
+}
+
+
+void FSTelemetry::Start()
+{
+	bool bWanted = IsRunningDedicatedServer() || FParse::Param(FCommandLine::Get(), TEXT("CoopTelemetry"));
+	if (FParse::Param(FCommandLine::Get(), TEXT("NoCoopTelemetry")))
+	{
+		bWanted = false;
+	}
+
+	if (!bWanted || WriterThread || !FPlatformProcess::SupportsMultithreading())
+	{
+		return;
+	}
+
+	Writer = new FSTelemetryWriter(*this);
+	WriterThread = FRunnableThread::Create(Writer, TEXT("CoopTelemetryWriter"), 0, TPri_BelowNormal);
+	if (WriterThread == nullptr)
+	{
+		delete Writer;
+		Writer = nullptr;
+		return;
+	}
+
+	bEnabled = true;
+}
+
+
+void FSTelemetry::Stop()
+{
+	if (WriterThread == nullptr)
+	{
+		return;
+	}
+
+	bEnabled = false;
+
+	// Kill waits for Run to return, which flushes whatever is still in the ring
+	WriterThread->Kill(true);
+	delete WriterThread;
+	WriterThread = nullptr;
+
+	delete Writer;
+	Writer = nullptr;
+
+	UE_LOG(LogCoopGame, Log, TEXT("Telemetry: wrote %llu events, dropped %u"), GetNumWritten(), GetNumDropped());
+}
+
+
+uint32 FSTelemetry::GetNumDropped() const
+{
+	return NumDropped.Load();
+}
+
+
+uint64 FSTelemetry::GetNumWritten() const
+{
+	return NumWritten.Load();
+}
@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "STelemetryDecodeCommandlet.h"
+#include "STelemetry.h"
+#include "CoopGame.h"
+#include "HAL/FileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+USTelemetryDecodeCommandlet::USTelemetryDecodeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+
+int32 USTelemetryDecodeCommandlet::Main(const FString& Params)
+{
+	FString InputPath;
+	if (!FParse::Value(*Params, TEXT("File="), InputPath))
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Usage: -run=STelemetryDecode -File=<.ctlm file or folder> [-Out=<csv>]"));
+		return 1;
+	}
+
+	// A folder decodes every file in it, rotated files sort in write order by name
+	TArray<FString> Files;
+	if (IFileManager::Get().DirectoryExists(*InputPath))
+	{
+		IFileManager::Get().FindFiles(Files, *(InputPath / TEXT("*.ctlm")), true, false);
+		Files.Sort();
+		for (FString& File : Files)
+		{
+			File = InputPath / File;
+		}
+	}
+	else
+	{
+		Files.Add(InputPath);
+	}
+
+	FString OutPath = FPaths::ChangeExtension(Files.Num() == 1 ? Files[0] : InputPath / TEXT("Telemetry"), TEXT("csv"));
+	FParse::Value(*Params, TEXT("Out="), OutPath);
+
+	FString Csv = TEXT("Seconds,Frame,Type,SourceId,TargetId,Value,Extra\n");
+	int32 TypeCounts[(int32)ECoopTelemetryEvent::Count] = {};
+	uint64 Dropped = 0;
+	uint64 BaseCycles = 0;
+
+	for (const FString& File : Files)
+	{
+		if (!DecodeFile(File, BaseCycles, Csv, TypeCounts, Dropped))
+		{
+			return 1;
+		}
+	}
+
+	if (!FFileHelper::SaveStringToFile(Csv, *OutPath))
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Could not write %s"), *OutPath);
+		return 1;
+	}
+
+	UE_LOG(LogCoopGame, Display, TEXT("Decoded %d file(s) to %s"), Files.Num(), *OutPath);
+	for (int32 i = 0; i < (int32)ECoopTelemetryEvent::Count; i++)
+	{
+		UE_LOG(LogCoopGame, Display, TEXT("  %-10s %d"), FSTelemetry::GetEventName((ECoopTelemetryEvent)i), TypeCounts[i]);
+	}
+	UE_LOG(LogCoopGame, Display, TEXT("  Events lost to a full buffer: %llu"), Dropped);
+
+	return 0;
+}
+
+
+bool USTelemetryDecodeCommandlet::DecodeFile(const FString& Path, uint64& BaseCycles, FString& OutCsv, int32* TypeCounts, uint64& OutDropped)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Path))
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("Could not read %s"), *Path);
+		return false;
+	}
+
+	FSTelemetry::FFileHeader Header;
+	if (Data.Num() < sizeof(Header))
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("%s is too small to be a telemetry file"), *Path);
+		return false;
+	}
+
+	FMemory::Memcpy(&Header, Data.GetData(), sizeof(Header));
+	if (Header.Magic != FSTelemetry::FileMagic || Header.Version != FSTelemetry::FileVersion || Header.EventSize != sizeof(FSTelemetryEvent))
+	{
+		UE_LOG(LogCoopGame, Error, TEXT("%s is not a version %u telemetry file"), *Path, FSTelemetry::FileVersion);
+		return false;
+	}
+
+	TArray<uint8> Block;
+	int32 Offset = sizeof(Header);
+	while (Offset + 2 * (int32)sizeof(uint32) <= Data.Num())
+	{
+		uint32 UncompressedSize;
+		uint32 CompressedSize;
+		FMemory::Memcpy(&UncompressedSize, &Data[Offset], sizeof(uint32));
+		FMemory::Memcpy(&CompressedSize, &Data[Offset + sizeof(uint32)], sizeof(uint32));
+		Offset += 2 * sizeof(uint32);
+
+		if (Offset + (int64)CompressedSize > Data.Num())
+		{
+			// The process died mid-write, everything before it is still good
+			UE_LOG(LogCoopGame, Warning, TEXT("%s ends in a truncated block"), *Path);
+			break;
+		}
+
+		Block.SetNumUninitialized(UncompressedSize);
+		if (UncompressedSize == CompressedSize)
+		{
+			// Stored raw because compression failed
+			FMemory::Memcpy(Block.GetData(), &Data[Offset], CompressedSize);
+		}
+		else if (!FCompression::UncompressMemory(NAME_Zlib, Block.GetData(), UncompressedSize, &Data[Offset], CompressedSize))
+		{
+			UE_LOG(LogCoopGame, Error, TEXT("%s has a corrupt block at offset %d"), *Path, Offset);
+			return false;
+		}
+		Offset += CompressedSize;
+
+		const int32 NumEvents = Block.Num() / sizeof(FSTelemetryEvent);
+		const FSTelemetryEvent* Events = (const FSTelemetryEvent*)Block.GetData();
+		for (int32 i = 0; i < NumEvents; i++)
+		{
+			const FSTelemetryEvent& Event = Events[i];
+			if (BaseCycles == 0)
+			{
+				BaseCycles = Event.Cycles;
+			}
+
+			const int32 TypeIndex = (int32)Event.Type;
+			if (TypeIndex < (int32)ECoopTelemetryEvent::Count)
+			{
+				TypeCounts[TypeIndex]++;
+			}
+
+			if (Event.Type == ECoopTelemetryEvent::Dropped)
+			{
+				OutDropped += Event.Extra;
+			}
+
+			const double Seconds = (double)(int64)(Event.Cycles - BaseCycles) * Header.SecondsPerCycle;
+			OutCsv += FString::Printf(TEXT("%.6f,%u,%s,%u,%u,%g,%d\n"), Seconds, Event.Frame, FSTelemetry::GetEventName(Event.Type),
+				Event.SourceId, Event.TargetId, Event.Value, Event.Extra);
+		}
+	}
+
+	return true;
+}
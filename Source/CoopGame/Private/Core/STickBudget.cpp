@@ -0,0 +1,396 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "STickBudget.h"
+#include "CoopGame.h"
+#include "SDeterminism.h"
+#include "SGameMode.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/Controller.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+
+
+static int32 TickSignificance = 1;
+FAutoConsoleVariableRef CVARTickSignificance(
+	TEXT("COOP.TickSignificance"),
+	TickSignificance,
+	TEXT("Slow down ticks of actors far from players and keep them inside the tick budget, 0 ticks everything at its own rate"),
+	ECVF_Default);
+
+static float TickBudget = 48.0f;
+FAutoConsoleVariableRef CVARTickBudget(
+	TEXT("COOP.TickBudget"),
+	TickBudget,
+	TEXT("Ticks per frame the managed actors may run together, 0 is no limit"),
+	ECVF_Default);
+
+static float TickMaxInterval = 0.25f;
+FAutoConsoleVariableRef CVARTickMaxInterval(
+	TEXT("COOP.TickMaxInterval"),
+	TickMaxInterval,
+	TEXT("Seconds between ticks of the least significant actors, the budget may stretch it to four times that"),
+	ECVF_Default);
+
+static float SignificanceNear = 2000.0f;
+FAutoConsoleVariableRef CVARSignificanceNear(
+	TEXT("COOP.SignificanceNear"),
+	SignificanceNear,
+	TEXT("Distance to the nearest player view up to which actors tick every frame"),
+	ECVF_Default);
+
+static float SignificanceFar = 8000.0f;
+FAutoConsoleVariableRef CVARSignificanceFar(
+	TEXT("COOP.SignificanceFar"),
+	SignificanceFar,
+	TEXT("Distance to the nearest player view from which actors tick at the slowest rate"),
+	ECVF_Default);
+
+static float SignificanceInterval = 0.25f;
+FAutoConsoleVariableRef CVARSignificanceInterval(
+	TEXT("COOP.SignificanceInterval"),
+	SignificanceInterval,
+	TEXT("Seconds between scoring the managed actors"),
+	ECVF_Default);
+
+
+static void TickReportCommand(const TArray<FString>& Args)
+{
+	if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+	{
+		FSTickBudget::Get().ResetCounters();
+		return;
+	}
+
+	FSTickBudget::Get().LogReport();
+}
+
+FAutoConsoleCommand TickReportConsoleCommand(
+	TEXT("COOP.TickReport"),
+	TEXT("Log the ticks managed actors ran and skipped per class, 'reset' clears the counts"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&TickReportCommand));
+
+
+namespace
+{
+	// Seconds since an actor was drawn for it to count as seen
+	const float RenderedTolerance = 0.2f;
+
+	// Significance of actors nobody on a rendering machine saw lately
+	const float UnseenScale = 0.5f;
+
+	// The budget stretches the slowest interval up to this
+	const float BudgetIntervalScale = 4.0f;
+
+	bool IsControlledByPlayer(const AActor* Actor)
+	{
+		const APawn* Pawn = Cast<APawn>(Actor);
+		if (Pawn == nullptr)
+		{
+			return false;
+		}
+
+		// The server runs every player's (and simulated player's) pawn for its owner, clients only see their own as theirs
+		return Pawn->Role == ROLE_Authority ? ASGameMode::IsPlayer(Pawn->GetController()) : Pawn->IsLocallyControlled();
+	}
+}
+
+
+FSTickBudget::FSTickBudget()
+	: NrOfUpdates(0)
+	, NrOfUpdatesOverBudget(0)
+	, NrOfBudgeted(0)
+	, AverageFrameSeconds(1.0f / 60.0f)
+	, TimeSinceUpdate(0.0f)
+{
+	FMemory::Memzero(NrOfManaged);
+	FMemory::Memzero(NrOfFrameTicks);
+	FMemory::Memzero(NrOfTicks);
+}
+
+
+FSTickBudget& FSTickBudget::Get()
+{
+	static FSTickBudget Instance;
+	return Instance;
+}
+
+
+const TCHAR* FSTickBudget::GetClassName(ECoopTickClass Class)
+{
+	switch (Class)
+	{
+	case ECoopTickClass::Characters:	return TEXT("Characters");
+	case ECoopTickClass::TrackerBots:	return TEXT("TrackerBots");
+	case ECoopTickClass::GameMode:		return TEXT("GameMode");
+	default:							return TEXT("Unknown");
+	}
+}
+
+
+void FSTickBudget::Initialize()
+{
+	// Every frame, the frame count is what skipped ticks are measured against
+	TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FSTickBudget::Tick));
+}
+
+
+void FSTickBudget::Shutdown()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+
+	if (Actors.Num() > 0 || NrOfUpdates > 0)
+	{
+		LogReport();
+	}
+	Actors.Empty();
+}
+
+
+void FSTickBudget::Register(AActor* Actor, ECoopTickClass Class)
+{
+	if (Actor == nullptr || !Actor->PrimaryActorTick.bCanEverTick)
+	{
+		return;
+	}
+
+	FManagedActor& Managed = Actors.AddDefaulted_GetRef();
+	Managed.Actor = Actor;
+	Managed.Class = Class;
+	Managed.DefaultInterval = Actor->GetActorTickInterval();
+	Managed.Significance = 1.0f;
+	Managed.Interval = Managed.DefaultInterval;
+
+	NrOfManaged[(int32)Class]++;
+}
+
+
+bool FSTickBudget::Tick(float DeltaTime)
+{
+	for (int32 i = 0; i < (int32)ECoopTickClass::Count; i++)
+	{
+		NrOfFrameTicks[i] += NrOfManaged[i];
+	}
+
+	AverageFrameSeconds = FMath::Lerp(AverageFrameSeconds, FMath::Max((float)FApp::GetDeltaTime(), KINDA_SMALL_NUMBER), 0.05f);
+
+	// Frame time rather than the clock, a hitch doesn't bunch up updates
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate >= SignificanceInterval)
+	{
+		TimeSinceUpdate = 0.0f;
+		Update();
+	}
+
+	return true;
+}
+
+
+void FSTickBudget::Update()
+{
+	// Destroyed actors drop out here, until then their frames still count
+	for (int32 i = Actors.Num() - 1; i >= 0; i--)
+	{
+		const AActor* Actor = Actors[i].Actor.Get();
+		if (Actor == nullptr || Actor->IsPendingKill())
+		{
+			NrOfManaged[(int32)Actors[i].Class]--;
+			Actors.RemoveAtSwap(i, 1, false);
+		}
+	}
+
+	if (Actors.Num() == 0)
+	{
+		return;
+	}
+
+	NrOfUpdates++;
+
+	// Render state and frame times would make deterministic runs tick differently every time
+	if (!TickSignificance || FSDeterminism::IsEnabled())
+	{
+		NrOfBudgeted = 0;
+		for (FManagedActor& Managed : Actors)
+		{
+			Managed.Significance = 1.0f;
+			ApplyInterval(Managed, Managed.DefaultInterval);
+		}
+		return;
+	}
+
+	TArray<FWorldViews> Views;
+	GatherViews(Views);
+
+	const float MaxInterval = FMath::Max(TickMaxInterval, 0.0f);
+
+	float TicksPerFrame = 0.0f;
+	TArray<float> Intervals;
+	Intervals.SetNumUninitialized(Actors.Num());
+
+	for (int32 i = 0; i < Actors.Num(); i++)
+	{
+		FManagedActor& Managed = Actors[i];
+		Managed.Significance = GetSignificance(Managed, Views);
+
+		float Interval = Managed.DefaultInterval;
+		if (Managed.Class != ECoopTickClass::GameMode)
+		{
+			Interval = FMath::Max(Managed.DefaultInterval, (1.0f - Managed.Significance) * MaxInterval);
+
+			// Anything faster than a frame is every frame anyway
+			if (Interval < AverageFrameSeconds)
+			{
+				Interval = 0.0f;
+			}
+		}
+
+		Intervals[i] = Interval;
+		TicksPerFrame += GetTicksPerFrame(Interval);
+	}
+
+	// Least significant first drop to the slowest rate until the rest fits
+	NrOfBudgeted = 0;
+	if (TickBudget > 0.0f && TicksPerFrame > TickBudget)
+	{
+		NrOfUpdatesOverBudget++;
+
+		TArray<int32> Order;
+		Order.Reserve(Actors.Num());
+		for (int32 i = 0; i < Actors.Num(); i++)
+		{
+			if (Actors[i].Class != ECoopTickClass::GameMode && Actors[i].Significance < 1.0f)
+			{
+				Order.Add(i);
+			}
+		}
+		Order.Sort([this](int32 A, int32 B) { return Actors[A].Significance < Actors[B].Significance; });
+
+		const float BudgetInterval = FMath::Max(MaxInterval * BudgetIntervalScale, AverageFrameSeconds);
+		for (int32 Index : Order)
+		{
+			if (TicksPerFrame <= TickBudget)
+			{
+				break;
+			}
+
+			TicksPerFrame += GetTicksPerFrame(BudgetInterval) - GetTicksPerFrame(Intervals[Index]);
+			Intervals[Index] = BudgetInterval;
+			NrOfBudgeted++;
+		}
+	}
+
+	for (int32 i = 0; i < Actors.Num(); i++)
+	{
+		ApplyInterval(Actors[i], Intervals[i]);
+	}
+}
+
+
+void FSTickBudget::GatherViews(TArray<FWorldViews>& OutViews) const
+{
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		const UWorld* World = Context.World();
+		if (World == nullptr || !World->IsGameWorld())
+		{
+			continue;
+		}
+
+		FWorldViews& WorldViews = OutViews.AddDefaulted_GetRef();
+		WorldViews.World = World;
+
+		// Simulated players are AI controllers, they count as players as much as the real ones
+		for (FConstControllerIterator It = World->GetControllerIterator(); It; ++It)
+		{
+			const AController* Controller = It->Get();
+			if (ASGameMode::IsPlayer(Controller))
+			{
+				FVector Location;
+				FRotator Rotation;
+				Controller->GetPlayerViewPoint(Location, Rotation);
+				WorldViews.Locations.Add(Location);
+			}
+		}
+	}
+}
+
+
+float FSTickBudget::GetSignificance(const FManagedActor& Managed, const TArray<FWorldViews>& Views) const
+{
+	const AActor* Actor = Managed.Actor.Get();
+	if (Managed.Class == ECoopTickClass::GameMode || IsControlledByPlayer(Actor))
+	{
+		return 1.0f;
+	}
+
+	const UWorld* World = Actor->GetWorld();
+	const FWorldViews* WorldViews = Views.FindByPredicate([World](const FWorldViews& Candidate) { return Candidate.World == World; });
+
+	// Without players there is nobody to notice
+	if (WorldViews == nullptr || WorldViews->Locations.Num() == 0)
+	{
+		return 0.0f;
+	}
+
+	const FVector ActorLocation = Actor->GetActorLocation();
+	float ClosestDistSquared = MAX_flt;
+	for (const FVector& Location : WorldViews->Locations)
+	{
+		ClosestDistSquared = FMath::Min(ClosestDistSquared, FVector::DistSquared(Location, ActorLocation));
+	}
+
+	const float Range = FMath::Max(SignificanceFar - SignificanceNear, 1.0f);
+	float Significance = 1.0f - FMath::Clamp((FMath::Sqrt(ClosestDistSquared) - SignificanceNear) / Range, 0.0f, 1.0f);
+
+	if (Actor->GetNetMode() != NM_DedicatedServer && !Actor->WasRecentlyRendered(RenderedTolerance))
+	{
+		Significance *= UnseenScale;
+	}
+
+	return Significance;
+}
+
+
+float FSTickBudget::GetTicksPerFrame(float Interval) const
+{
+	return Interval <= AverageFrameSeconds ? 1.0f : AverageFrameSeconds / Interval;
+}
+
+
+void FSTickBudget::ApplyInterval(FManagedActor& Managed, float Interval)
+{
+	if (FMath::IsNearlyEqual(Managed.Interval, Interval))
+	{
+		return;
+	}
+
+	Managed.Interval = Interval;
+	Managed.Actor->SetActorTickInterval(Interval);
+}
+
+
+void FSTickBudget::ResetCounters()
+{
+	FMemory::Memzero(NrOfFrameTicks);
+	FMemory::Memzero(NrOfTicks);
+	NrOfUpdates = 0;
+	NrOfUpdatesOverBudget = 0;
+}
+
+
+void FSTickBudget::LogReport() const
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Tick budget (%s): %.0f ticks per frame, over it in %d of %d updates, %d actors slowed down by it now"),
+		TickSignificance ? TEXT("on") : TEXT("off"), TickBudget, NrOfUpdatesOverBudget, NrOfUpdates, NrOfBudgeted);
+
+	UE_LOG(LogCoopGame, Log, TEXT("  %-14s %8s %12s %12s %8s"), TEXT("Class"), TEXT("Actors"), TEXT("Ticked"), TEXT("Skipped"), TEXT("Skipped%"));
+	for (int32 i = 0; i < (int32)ECoopTickClass::Count; i++)
+	{
+		// Actors registered between two frames can tick before their first frame counts
+		const uint64 NrOfSkipped = NrOfFrameTicks[i] > NrOfTicks[i] ? NrOfFrameTicks[i] - NrOfTicks[i] : 0;
+		const double SkippedPercent = NrOfFrameTicks[i] > 0 ? 100.0 * NrOfSkipped / NrOfFrameTicks[i] : 0.0;
+
+		UE_LOG(LogCoopGame, Log, TEXT("  %-14s %8d %12llu %12llu %7.1f%%"), GetClassName((ECoopTickClass)i), NrOfManaged[i], NrOfTicks[i], NrOfSkipped, SkippedPercent);
+	}
+}
@@ -0,0 +1,275 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "STravelPipeline.h"
+#include "CoopGame.h"
+#include "SAssetStreamer.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "AssetRegistryModule.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/WorldSettings.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/PackageName.h"
+
+
+USTravelPipeline::USTravelPipeline()
+{
+	MeasureTimeout = 60.0f;
+
+	bOpenWhenLoaded = false;
+	bMeasuring = false;
+	MeasureStartTime = 0.0;
+}
+
+
+void USTravelPipeline::Initialize(UGameInstance* InGameInstance)
+{
+	GameInstance = InGameInstance;
+
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &USTravelPipeline::OnPostLoadMap);
+	TravelFailureHandle = GEngine->OnTravelFailure().AddUObject(this, &USTravelPipeline::OnTravelFailure);
+	NetworkFailureHandle = GEngine->OnNetworkFailure().AddUObject(this, &USTravelPipeline::OnNetworkFailure);
+}
+
+
+void USTravelPipeline::Shutdown()
+{
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+	if (GEngine)
+	{
+		GEngine->OnTravelFailure().Remove(TravelFailureHandle);
+		GEngine->OnNetworkFailure().Remove(NetworkFailureHandle);
+	}
+	FTicker::GetCoreTicker().RemoveTicker(PollHandle);
+
+	PreloadedWorld = nullptr;
+	bMeasuring = false;
+}
+
+
+void USTravelPipeline::BeginMeasure(const FString& Reason)
+{
+	MeasureReason = Reason;
+	MeasureStartTime = FPlatformTime::Seconds();
+	bMeasuring = true;
+
+	UE_LOG(LogCoopGame, Log, TEXT("Travel: %s requested"), *MeasureReason);
+}
+
+
+void USTravelPipeline::MarkPhase(const TCHAR* Phase)
+{
+	if (bMeasuring)
+	{
+		UE_LOG(LogCoopGame, Log, TEXT("Travel: %s %s after %.0f ms"), *MeasureReason, Phase, (FPlatformTime::Seconds() - MeasureStartTime) * 1000.0);
+	}
+}
+
+
+void USTravelPipeline::TravelToMap(const FString& MapName, const FString& Options)
+{
+	PendingMapName = MapName;
+	PendingOptions = Options;
+	bOpenWhenLoaded = true;
+
+	PreloadMap(MapName);
+}
+
+
+void USTravelPipeline::TravelToServer(const FString& TravelURL, const FString& MapName)
+{
+	APlayerController* PC = GameInstance ? GameInstance->GetFirstLocalPlayerController() : nullptr;
+	if (PC == nullptr)
+	{
+		return;
+	}
+
+	bOpenWhenLoaded = false;
+
+	// The server tells us which map to open once we are connected, by then it should be in memory
+	if (!MapName.IsEmpty())
+	{
+		PreloadMap(MapName);
+	}
+
+	PC->ClientTravel(TravelURL, ETravelType::TRAVEL_Absolute);
+}
+
+
+void USTravelPipeline::PreloadMap(const FString& MapName)
+{
+	const FString LongPackageName = ResolveMapPackage(MapName);
+	const bool bFound = !LongPackageName.IsEmpty();
+
+	// PIE renames map packages per instance, loading the original in the background would only duplicate it
+	const bool bPlayInEditor = GameInstance && GameInstance->GetWorld() && GameInstance->GetWorld()->IsPlayInEditor();
+
+	if (!bFound || bPlayInEditor)
+	{
+		if (!bFound)
+		{
+			UE_LOG(LogCoopGame, Warning, TEXT("Travel: no map package %s to preload"), *MapName);
+		}
+
+		if (bOpenWhenLoaded)
+		{
+			OpenPendingMap();
+		}
+		return;
+	}
+
+	LoadPackageAsync(LongPackageName, FLoadPackageAsyncDelegate::CreateUObject(this, &USTravelPipeline::OnMapPackageLoaded));
+}
+
+
+FString USTravelPipeline::ResolveMapPackage(const FString& MapName) const
+{
+	if (FPackageName::IsValidLongPackageName(MapName))
+	{
+		return MapName;
+	}
+
+	// Short names as OpenLevel takes them, searching the content directories for them would block on the disk
+	const IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+
+	TArray<FAssetData> Maps;
+	AssetRegistry.GetAssetsByClass(UWorld::StaticClass()->GetFName(), Maps);
+
+	const FName ShortName(*MapName);
+	for (const FAssetData& Map : Maps)
+	{
+		if (Map.AssetName == ShortName)
+		{
+			return Map.PackageName.ToString();
+		}
+	}
+
+	return FString();
+}
+
+
+void USTravelPipeline::OnMapPackageLoaded(const FName& PackageName, UPackage* Package, EAsyncLoadingResult::Type Result)
+{
+	UWorld* MapWorld = Result == EAsyncLoadingResult::Succeeded && Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (MapWorld)
+	{
+		MarkPhase(TEXT("map preloaded"));
+
+		// Clients may already be in the map by now, holding on to a world the engine runs would leak it once it's left
+		if (!MapWorld->bIsWorldInitialized)
+		{
+			PreloadedWorld = MapWorld;
+		}
+
+		PreloadGameplayAssets(MapWorld);
+	}
+	else
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Travel: preloading %s failed, the level loads it instead"), *PackageName.ToString());
+	}
+
+	if (bOpenWhenLoaded)
+	{
+		OpenPendingMap();
+	}
+}
+
+
+void USTravelPipeline::PreloadGameplayAssets(UWorld* MapWorld)
+{
+	AWorldSettings* WorldSettings = MapWorld->PersistentLevel ? MapWorld->PersistentLevel->GetWorldSettings(false) : nullptr;
+
+	// Same fallback the engine uses when the map doesn't override the game mode
+	UClass* GameModeClass = WorldSettings ? WorldSettings->DefaultGameMode.Get() : nullptr;
+	if (GameModeClass == nullptr)
+	{
+		FString GlobalDefaultGameMode;
+		GConfig->GetString(TEXT("/Script/EngineSettings.GameMapsSettings"), TEXT("GlobalDefaultGameMode"), GlobalDefaultGameMode, GEngineIni);
+		GameModeClass = GlobalDefaultGameMode.IsEmpty() ? nullptr : LoadClass<AGameModeBase>(nullptr, *GlobalDefaultGameMode);
+	}
+
+	const AGameModeBase* GameModeCDO = GameModeClass ? GameModeClass->GetDefaultObject<AGameModeBase>() : nullptr;
+	const ASCharacter* PawnCDO = GameModeCDO ? Cast<ASCharacter>(GameModeCDO->DefaultPawnClass.GetDefaultObject()) : nullptr;
+	if (PawnCDO == nullptr || PawnCDO->GetStarterWeaponClass().IsNull())
+	{
+		return;
+	}
+
+	// Same group the game state requests when the match starts, so that one finds it loaded
+	const TSoftClassPtr<ASWeapon>& WeaponClass = PawnCDO->GetStarterWeaponClass();
+	TArray<FSoftObjectPath> Assets;
+	Assets.Add(WeaponClass.ToSoftObjectPath());
+	FSAssetStreamer::Get().Preload(FName(*WeaponClass.ToString()), Assets, false, nullptr);
+}
+
+
+void USTravelPipeline::OpenPendingMap()
+{
+	bOpenWhenLoaded = false;
+
+	MarkPhase(TEXT("opening map"));
+
+	UGameplayStatics::OpenLevel(GameInstance, FName(*PendingMapName), true, PendingOptions);
+}
+
+
+void USTravelPipeline::OnPostLoadMap(UWorld* World)
+{
+	// The engine has its own reference now, and we mustn't keep the map alive once it is left
+	PreloadedWorld = nullptr;
+
+	if (!bMeasuring || World == nullptr || World->GetGameInstance() != GameInstance)
+	{
+		return;
+	}
+
+	MarkPhase(TEXT("map loaded"));
+
+	FTicker::GetCoreTicker().RemoveTicker(PollHandle);
+	PollHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &USTravelPipeline::PollForPawn));
+}
+
+
+void USTravelPipeline::OnTravelFailure(UWorld* World, ETravelFailure::Type FailureType, const FString& Error)
+{
+	// The map we preloaded won't be opened
+	PreloadedWorld = nullptr;
+}
+
+
+void USTravelPipeline::OnNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& Error)
+{
+	PreloadedWorld = nullptr;
+}
+
+
+bool USTravelPipeline::PollForPawn(float DeltaTime)
+{
+	if (!bMeasuring)
+	{
+		return false;
+	}
+
+	APlayerController* PC = GameInstance ? GameInstance->GetFirstLocalPlayerController() : nullptr;
+	APawn* Pawn = PC ? PC->GetPawn() : nullptr;
+
+	if (Pawn && Pawn->HasActorBegunPlay())
+	{
+		MarkPhase(TEXT("controllable"));
+		bMeasuring = false;
+		return false;
+	}
+
+	if (FPlatformTime::Seconds() - MeasureStartTime > MeasureTimeout)
+	{
+		UE_LOG(LogCoopGame, Warning, TEXT("Travel: %s got no pawn within %.0f s"), *MeasureReason, MeasureTimeout);
+		bMeasuring = false;
+		return false;
+	}
+
+	return true;
+}
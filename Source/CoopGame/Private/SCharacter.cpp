@@ -7,12 +7,18 @@
 #include "Components/CapsuleComponent.h"
 #include "CoopGame.h"
 #include "SHealthComponent.h"
+#include "SCharacterMovementComponent.h"
 #include "SWeapon.h"
+#include "SAssetStreamer.h"
+#include "SNetAccounting.h"
+#include "SMemoryTracker.h"
+#include "STickBudget.h"
 #include "Net/UnrealNetwork.h"
 
 
 // Sets default values
-ASCharacter::ASCharacter()
+ASCharacter::ASCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<USCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
  	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
@@ -27,6 +33,9 @@ ASCharacter::ASCharacter()
 
 	GetMesh()->SetOwnerNoSee(true);
 
+//Sprint and aim are predicted like the rest of the movement
+	MoveComp = Cast<USCharacterMovementComponent>(GetCharacterMovement());
+
 //Make it so the player and crouch using the default engine function
 	GetMovementComponent()->GetNavAgentPropertiesRef().bCanCrouch = true;
 
@@ -45,6 +54,7 @@ ASCharacter::ASCharacter()
 //FPSMesh
 
 	// Create a first person mesh component for the owning player.
+	// Unlike the other cosmetics it stays in server builds, the server attaches the weapon to the mesh's WeaponSocketFPS.
 	FPSMesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("FirstPersonMesh"));
 	// Only the owning player sees this mesh.
 	FPSMesh->SetOnlyOwnerSee(true);
@@ -68,6 +78,9 @@ ASCharacter::ASCharacter()
 	WeaponAttachSocketNameFPS = "WeaponSocketFPS";
 
 	IsRunning = false;
+
+	FrameInputNumber = INDEX_NONE;
+	ReplayedButtons = 0;
 }
 
 // Called when the game starts or when spawned
@@ -79,6 +92,8 @@ void ASCharacter::BeginPlay()
 	DefaultFOV = CameraComp->FieldOfView;
 	HealthComp->OnHealthChanged.AddDynamic(this, &ASCharacter::OnHealthChanged);
 
+	FSTickBudget::Get().Register(this, ECoopTickClass::Characters);
+
 //Check if we are the server
 	if (Role == ROLE_Authority)
 	{
@@ -87,7 +102,8 @@ void ASCharacter::BeginPlay()
 		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 
 		//Set the current weapon
-		CurrentWeapon = GetWorld()->SpawnActor<ASWeapon>(StarterWeaponClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+		COOP_LLM_SCOPE(ECoopMemCategory::Weapons);
+		CurrentWeapon = GetWorld()->SpawnActor<ASWeapon>(FSAssetStreamer::Get().LoadClassNow(StarterWeaponClass, TEXT("ASCharacter")), FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
 		if (CurrentWeapon)
 		{
 			if (IsAI)
@@ -108,10 +124,45 @@ void ASCharacter::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	float TargetFOV = bWantsToZoom ? ZoomedFOV : DefaultFOV;
-	float NewFOV = FMath::FInterpTo(CameraComp->FieldOfView, TargetFOV, DeltaTime, ZoomInterpSpeed);
+	FSTickBudget::Get().CountTick(ECoopTickClass::Characters);
+
+#if COOP_WITH_COSMETICS
+	//Only the player looking through this camera sees the zoom
+	if (IsLocallyControlled())
+	{
+		float TargetFOV = bWantsToZoom ? ZoomedFOV : DefaultFOV;
+		float NewFOV = FMath::FInterpTo(CameraComp->FieldOfView, TargetFOV, DeltaTime, ZoomInterpSpeed);
+
+		CameraComp->SetFieldOfView(NewFOV);
+	}
+#endif
+
+	//Faster than walking means sprinting, works for every copy of the character without replicating the flag
+	IsRunning = GetVelocity().SizeSquared2D() > FMath::Square(GetCharacterMovement()->MaxWalkSpeed * 1.05f);
 
-	CameraComp->SetFieldOfView(NewFOV);
+	//The server learns about aiming from the client's moves
+	if (Role == ROLE_Authority && !IsLocallyControlled() && MoveComp && bWantsToZoom != MoveComp->WantsToAim())
+	{
+		bWantsToZoom = MoveComp->WantsToAim();
+		if (CurrentWeapon)
+		{
+			CurrentWeapon->IsAiming = bWantsToZoom;
+		}
+	}
+
+	//Input streams only cover the local player, everyone else is driven by the simulation
+	if (IsLocallyControlled() && IsPlayerControlled())
+	{
+		if (FSDeterminism::IsReplayingInput())
+		{
+			ApplyReplayedButtons();
+		}
+		else if (FSDeterminism::IsRecordingInput())
+		{
+			const FSInputFrame& Input = GetFrameInput();
+			FSDeterminism::RecordInputFrame(FrameInputNumber, Input);
+		}
+	}
 }
 
 // Called to bind functionality to input
@@ -125,37 +176,52 @@ void ASCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponen
 	PlayerInputComponent->BindAxis("LookUp", this, &ASCharacter::LookUp);
 	PlayerInputComponent->BindAxis("Turn", this, &ASCharacter::Turn);
 
+	//Buttons come from the recording during a replay, the axes still run so they can pick up the recorded values
+	if (FSDeterminism::IsReplayingInput())
+	{
+		return;
+	}
+
 	PlayerInputComponent->BindAction("Crouch", IE_Pressed, this, &ASCharacter::BeginCrouch);
 	PlayerInputComponent->BindAction("Crouch", IE_Released, this, &ASCharacter::EndCrouch);
 
 	PlayerInputComponent->BindAction("Zoom", IE_Pressed, this, &ASCharacter::BeginZoom);
 	PlayerInputComponent->BindAction("Zoom", IE_Released, this, &ASCharacter::EndZoom);
 
+	PlayerInputComponent->BindAction("Sprint", IE_Pressed, this, &ASCharacter::BeginSprint);
+	PlayerInputComponent->BindAction("Sprint", IE_Released, this, &ASCharacter::EndSprint);
+
 	PlayerInputComponent->BindAction("Reload", IE_Pressed, this, &ASCharacter::Reload);
 
 	PlayerInputComponent->BindAction("Fire", IE_Pressed, this, &ASCharacter::StartFire);
 	PlayerInputComponent->BindAction("Fire", IE_Released, this, &ASCharacter::StopFire);
 
 	// CHALLENGE CODE
-	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ACharacter::Jump);
+	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ASCharacter::BeginJump);
 }
 
 // ------- INPUT ------- \\
 
 void ASCharacter::MoveForward(float Value)
 {
+	Value = FilterInputAxis(GetFrameInput().MoveForward, Value);
+
 	AddMovementInput(GetActorForwardVector() * Value);
 }
 
 
 void ASCharacter::MoveRight(float Value)
 {
+	Value = FilterInputAxis(GetFrameInput().MoveRight, Value);
+
 	AddMovementInput(GetActorRightVector() * Value);
 }
 
 
 void ASCharacter::LookUp(float value)
 {
+	value = FilterInputAxis(GetFrameInput().LookUp, value);
+
 	//This is the since that is value times the set mouse Y sens by the player
 	float MainSens = value * MouseYSens;
 
@@ -174,6 +240,8 @@ void ASCharacter::LookUp(float value)
 
 void ASCharacter::Turn(float value)
 {
+	value = FilterInputAxis(GetFrameInput().Turn, value);
+
 	//This is the since that is value times the set mouse X sens by the player
 	float MainSens = value * MouseXSens;
 
@@ -192,32 +260,44 @@ void ASCharacter::Turn(float value)
 
 void ASCharacter::BeginCrouch()
 {
+	RecordInputButton(ECoopInputButton::Crouch, true);
+
 	Crouch();
 }
 
 
 void ASCharacter::EndCrouch()
 {
+	RecordInputButton(ECoopInputButton::Crouch, false);
+
 	UnCrouch();
 }
 
 
 void ASCharacter::BeginZoom()
 {
+	RecordInputButton(ECoopInputButton::Zoom, true);
+
 	bWantsToZoom = true;
 	CurrentWeapon->IsAiming = true;
+	MoveComp->SetWantsToAim(true);
 }
 
 
 void ASCharacter::EndZoom()
 {
+	RecordInputButton(ECoopInputButton::Zoom, false);
+
 	bWantsToZoom = false;
 	CurrentWeapon->IsAiming = false;
+	MoveComp->SetWantsToAim(false);
 }
 
 
 void ASCharacter::StartFire()
 {
+	RecordInputButton(ECoopInputButton::Fire, true);
+
 	if (CurrentWeapon)
 	{
 		CurrentWeapon->StartFire();
@@ -227,6 +307,8 @@ void ASCharacter::StartFire()
 
 void ASCharacter::StopFire()
 {
+	RecordInputButton(ECoopInputButton::Fire, false);
+
 	if (CurrentWeapon)
 	{
 		CurrentWeapon->StopFire();
@@ -236,9 +318,159 @@ void ASCharacter::StopFire()
 
 void ASCharacter::Reload()
 {
+	RecordInputButton(ECoopInputButton::Reload, true);
+
 	CurrentWeapon->StartReload();
 }
 
+
+void ASCharacter::BeginJump()
+{
+	RecordInputButton(ECoopInputButton::Jump, true);
+
+	Jump();
+}
+
+
+void ASCharacter::BeginSprint()
+{
+	RecordInputButton(ECoopInputButton::Sprint, true);
+
+	MoveComp->SetWantsToSprint(true);
+}
+
+
+void ASCharacter::EndSprint()
+{
+	RecordInputButton(ECoopInputButton::Sprint, false);
+
+	MoveComp->SetWantsToSprint(false);
+}
+
+
+ASWeapon* ASCharacter::GetCurrentWeapon() const
+{
+	return CurrentWeapon;
+}
+
+
+const TSoftClassPtr<ASWeapon>& ASCharacter::GetStarterWeaponClass() const
+{
+	return StarterWeaponClass;
+}
+
+
+FSInputFrame& ASCharacter::GetFrameInput()
+{
+	const int32 Frame = FSDeterminism::GetMatchFrame(GetWorld());
+	if (Frame != FrameInputNumber)
+	{
+		FrameInputNumber = Frame;
+
+		if (FSDeterminism::IsReplayingInput())
+		{
+			FSDeterminism::GetReplayInputFrame(Frame, FrameInput);
+		}
+		else
+		{
+			//Held buttons carry over, edges and axes start fresh every frame
+			const uint8 HeldButtons = FrameInput.Buttons & (ECoopInputButton::Fire | ECoopInputButton::Zoom | ECoopInputButton::Crouch | ECoopInputButton::Sprint);
+
+			FrameInput = FSInputFrame();
+			FrameInput.Buttons = HeldButtons;
+		}
+	}
+
+	return FrameInput;
+}
+
+
+float ASCharacter::FilterInputAxis(float& FrameValue, float LiveValue) const
+{
+	if (FSDeterminism::IsReplayingInput())
+	{
+		return FrameValue;
+	}
+
+	FrameValue = LiveValue;
+	return LiveValue;
+}
+
+
+void ASCharacter::RecordInputButton(uint8 Button, bool bPressed)
+{
+	if (!FSDeterminism::IsRecordingInput())
+	{
+		return;
+	}
+
+	FSInputFrame& Input = GetFrameInput();
+	if (bPressed)
+	{
+		Input.Buttons |= Button;
+	}
+	else
+	{
+		Input.Buttons &= ~Button;
+	}
+}
+
+
+void ASCharacter::ApplyReplayedButtons()
+{
+	const uint8 Buttons = GetFrameInput().Buttons;
+	const uint8 Pressed = Buttons & ~ReplayedButtons;
+	const uint8 Released = ReplayedButtons & ~Buttons;
+
+	//Edges aren't held, so they never count as released
+	ReplayedButtons = Buttons & ~(ECoopInputButton::Jump | ECoopInputButton::Reload);
+
+	if (Pressed & ECoopInputButton::Crouch)
+	{
+		BeginCrouch();
+	}
+	if (Released & ECoopInputButton::Crouch)
+	{
+		EndCrouch();
+	}
+
+	if (Pressed & ECoopInputButton::Sprint)
+	{
+		BeginSprint();
+	}
+	if (Released & ECoopInputButton::Sprint)
+	{
+		EndSprint();
+	}
+
+	if (Pressed & ECoopInputButton::Zoom)
+	{
+		BeginZoom();
+	}
+	if (Released & ECoopInputButton::Zoom)
+	{
+		EndZoom();
+	}
+
+	if (Pressed & ECoopInputButton::Fire)
+	{
+		StartFire();
+	}
+	if (Released & ECoopInputButton::Fire)
+	{
+		StopFire();
+	}
+
+	if (Pressed & ECoopInputButton::Jump)
+	{
+		BeginJump();
+	}
+	if (Pressed & ECoopInputButton::Reload)
+	{
+		Reload();
+	}
+}
+
 // ------- FUNCTIONS ------- \\
 
 void ASCharacter::OnHealthChanged(USHealthComponent* OwningHealthComp, float Health, float HealthDelta, const class UDamageType* DamageType,
@@ -292,6 +524,14 @@ FVector ASCharacter::GetPawnViewLocation() const
 }
 
 
+// Movement RPCs come from the movement component through here too
+bool ASCharacter::CallRemoteFunction(UFunction* Function, void* Parameters, FOutParmRec* OutParms, FFrame* Stack)
+{
+	FSNetAccounting::FRpcScope RpcScope(Function);
+	return Super::CallRemoteFunction(Function, Parameters, OutParms, Stack);
+}
+
+
 void ASCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
@@ -1,9 +1,21 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "SGameMode.h"
+#include "CoopGame.h"
 #include "SHealthComponent.h"
 #include "SGameState.h"
 #include "SPlayerState.h"
+#include "SPlayerController.h"
+#include "SWaveDirectorComponent.h"
+#include "SSpawnPointCacheComponent.h"
+#include "SLoadGovernorComponent.h"
+#include "SSimulatedPlayerController.h"
+#include "SBenchmarkRunner.h"
+#include "SPerfCounters.h"
+#include "SDeterminism.h"
+#include "STelemetry.h"
+#include "SMetrics.h"
+#include "STickBudget.h"
 #include "TimerManager.h"
 
 
@@ -13,8 +25,24 @@ ASGameMode::ASGameMode()
 	//The amoun tof time to wait before the next wave starts
 	TimeBetweenWaves = 2.0f;
 
+	//No simulated players unless asked for
+	NumSimulatedPlayers = 0;
+	SimulatedPlayerClass = ASSimulatedPlayerController::StaticClass();
+	SimulatedPlayerSeed = 1337;
+	SimulatedMaxWaves = 0;
+
+	bIsBenchmarking = false;
+	bHadPlayer = false;
+
 	GameStateClass = ASGameState::StaticClass();
 	PlayerStateClass = ASPlayerState::StaticClass();
+	PlayerControllerClass = ASPlayerController::StaticClass();
+
+	WaveDirector = CreateDefaultSubobject<USWaveDirectorComponent>(TEXT("WaveDirector"));
+
+	SpawnPointCache = CreateDefaultSubobject<USSpawnPointCacheComponent>(TEXT("SpawnPointCache"));
+
+	LoadGovernor = CreateDefaultSubobject<USLoadGovernorComponent>(TEXT("LoadGovernor"));
 
 	//Event tick exists
 	PrimaryActorTick.bCanEverTick = true;
@@ -27,15 +55,28 @@ void ASGameMode::StartWave()
 {
 	//Increase the wave every time we start a new wave
 	WaveCount++;
+	FSMetrics::Get().AddCount(ECoopCounter::WavesStarted);
+
+	//Change the state of the wave before spawning, the director can release its first batch right away
+	SetWaveState(EWaveState::WaveInProgress);
+
+	//Data driven waves, the director spawns in batches against its per-frame budget
+	if (WaveDirector->HasWaveTable())
+	{
+		NrOfBotsToSpawn = 0;
+
+		if (WaveDirector->BeginWave(WaveCount) == 0)
+		{
+			EndWave();
+		}
+		return;
+	}
 
 	//Spawn the amount of bots that it 2 times the wave count
 	NrOfBotsToSpawn = 2 * WaveCount;
 
 	//Spawn elay so we dont spawn all the bots at the same time since its not suddle and can cause lag
 	GetWorldTimerManager().SetTimer(TimerHandle_BotSpawner, this, &ASGameMode::SpawnBotTimerElapsed, 1.0f, true, 0.0f);
-
-	//Change the state of the wave
-	SetWaveState(EWaveState::WaveInProgress);
 }
 
 
@@ -44,19 +85,44 @@ void ASGameMode::EndWave()
 	//Clear the bot timer so we can recreate when the new wave starts
 	GetWorldTimerManager().ClearTimer(TimerHandle_BotSpawner);
 
+	//Drop whatever the director hasn't spawned yet (eg. on game over)
+	WaveDirector->AbortWave();
+
 	//Change the wave state
 	SetWaveState(EWaveState::WaitingToComplete);
 }
 
 
+void ASGameMode::OnWaveSpawningFinished()
+{
+	EndWave();
+}
+
+
 void ASGameMode::PrepareForNextWave()
 {
+	//Stop simulated runs once they played the waves they were asked to
+	if (SimulatedPlayers.Num() > 0 && SimulatedMaxWaves > 0 && WaveCount >= SimulatedMaxWaves)
+	{
+		FinishSimulatedRun(TEXT("completed all waves"));
+		return;
+	}
+
 	//Make a timer to set a delay between the waves
 	GetWorldTimerManager().SetTimer(TimerHandle_NextWaveStart, this, &ASGameMode::StartWave, TimeBetweenWaves, false);
 
 	//Change the wave state
 	SetWaveState(EWaveState::WaitingToStart);
 
+	//Let everyone load the bots of the next wave during the break
+	ASGameState* GS = GetGameState<ASGameState>();
+	if (GS)
+	{
+		TArray<TSoftClassPtr<APawn>> NextBotClasses;
+		WaveDirector->GetWaveBotClasses(WaveCount + 1, NextBotClasses);
+		GS->SetUpcomingBotClasses(NextBotClasses);
+	}
+
 	//Respawn any players that died during the wave
 	RestartDeadPlayers();
 }
@@ -64,11 +130,13 @@ void ASGameMode::PrepareForNextWave()
 
 void ASGameMode::CheckWaveState()
 {
+	COOP_SCOPE_STAT(GameModeWaveState);
+
 	//See if the wave delay timer still existes to see if we are in a wave or ready for the next one
 	bool bIsPreparingForWave = GetWorldTimerManager().IsTimerActive(TimerHandle_NextWaveStart);
 
 	//Only run if we still have to spawn bots or are currently preparing for a wave
-	if (NrOfBotsToSpawn > 0 || bIsPreparingForWave)
+	if (NrOfBotsToSpawn > 0 || WaveDirector->IsSpawning() || bIsPreparingForWave)
 	{
 		//Return early so the rest of the code isn't run
 		return;
@@ -81,7 +149,7 @@ void ASGameMode::CheckWaveState()
 	for (FConstPawnIterator It = GetWorld()->GetPawnIterator(); It; ++It)
 	{
 		APawn* TestPawn = It->Get();
-		if (TestPawn == nullptr || TestPawn->IsPlayerControlled())
+		if (TestPawn == nullptr || IsPlayer(TestPawn->GetController()))
 		{
 			continue;
 		}
@@ -108,11 +176,15 @@ void ASGameMode::CheckWaveState()
 
 void ASGameMode::CheckAnyPlayerAlive()
 {
-	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	COOP_SCOPE_STAT(GameModePlayersAlive);
+
+	for (FConstControllerIterator It = GetWorld()->GetControllerIterator(); It; ++It)
 	{
-		APlayerController* PC = It->Get();
-		if (PC && PC->GetPawn())
+		AController* PC = It->Get();
+		if (IsPlayer(PC) && PC->GetPawn())
 		{
+			bHadPlayer = true;
+
 			APawn* MyPawn = PC->GetPawn();
 			USHealthComponent* HealthComp = Cast<USHealthComponent>(MyPawn->GetComponentByClass(USHealthComponent::StaticClass()));
 			if (ensure(HealthComp) && HealthComp->GetHealth() > 0.0f)
@@ -123,25 +195,45 @@ void ASGameMode::CheckAnyPlayerAlive()
 		}
 	}
 
-	// No player alive
-	GameOver();
+	// No player alive, or none joined yet
+	if (bHadPlayer)
+	{
+		GameOver();
+	}
 }
 
 
 void ASGameMode::GameOver()
 {
+	//Called on every tick while nobody is alive, only the first call ends the match
+	const ASGameState* GS = GetGameState<ASGameState>();
+	const bool bWasGameOver = GS && GS->GetWaveState() == EWaveState::GameOver;
+
 	EndWave();
 
 	// @TODO: Finish up the match, present 'game over' to players.
 
 	SetWaveState(EWaveState::GameOver);
 
+	if (bWasGameOver)
+	{
+		return;
+	}
+
 	UE_LOG(LogTemp, Log, TEXT("GAME OVER! Players Died"));
+	FSMetrics::Get().AddCount(ECoopCounter::GamesOver);
+
+	if (SimulatedPlayers.Num() > 0)
+	{
+		FinishSimulatedRun(TEXT("game over"));
+	}
 }
 
 
 void ASGameMode::SetWaveState(EWaveState NewState)
 {
+	COOP_TELEMETRY(WaveState, this, nullptr, (float)WaveCount, (int32)NewState);
+
 	ASGameState* GS = GetGameState<ASGameState>();
 	if (ensureAlways(GS))
 	{
@@ -152,10 +244,10 @@ void ASGameMode::SetWaveState(EWaveState NewState)
 
 void ASGameMode::RestartDeadPlayers()
 {
-	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	for (FConstControllerIterator It = GetWorld()->GetControllerIterator(); It; ++It)
 	{
-		APlayerController* PC = It->Get();
-		if (PC && PC->GetPawn() == nullptr)
+		AController* PC = It->Get();
+		if (IsPlayer(PC) && PC->GetPawn() == nullptr)
 		{
 			RestartPlayer(PC);
 		}
@@ -163,10 +255,102 @@ void ASGameMode::RestartDeadPlayers()
 }
 
 
+bool ASGameMode::IsPlayer(const AController* Controller)
+{
+	return Controller && (Controller->IsPlayerController() || Controller->IsA<ASSimulatedPlayerController>());
+}
+
+
+USLoadGovernorComponent* ASGameMode::GetLoadGovernor() const
+{
+	return LoadGovernor;
+}
+
+
+int32 ASGameMode::GetWaveCount() const
+{
+	return WaveCount;
+}
+
+
+void ASGameMode::SpawnSimulatedPlayers()
+{
+	//Deterministic runs derive everything from the seed of the match
+	if (FSDeterminism::IsEnabled())
+	{
+		SimulatedPlayerSeed = FSDeterminism::GetStream(this, ECoopRandomStream::AI).RandHelper(MAX_int32);
+	}
+
+	//Command line wins so the same build can run different load tests
+	FParse::Value(FCommandLine::Get(), TEXT("SimPlayers="), NumSimulatedPlayers);
+	FParse::Value(FCommandLine::Get(), TEXT("SimSeed="), SimulatedPlayerSeed);
+	FParse::Value(FCommandLine::Get(), TEXT("SimWaves="), SimulatedMaxWaves);
+
+	if (NumSimulatedPlayers <= 0 || SimulatedPlayerClass == nullptr)
+	{
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	for (int32 i = 0; i < NumSimulatedPlayers; i++)
+	{
+		ASSimulatedPlayerController* SimPlayer = GetWorld()->SpawnActor<ASSimulatedPlayerController>(SimulatedPlayerClass, SpawnParams);
+		if (SimPlayer)
+		{
+			//Every simulated player gets its own stream, derived from the run seed
+			SimPlayer->SetRandomSeed(SimulatedPlayerSeed + i);
+			SimulatedPlayers.Add(SimPlayer);
+
+			RestartPlayer(SimPlayer);
+		}
+	}
+
+	UE_LOG(LogCoopGame, Log, TEXT("Spawned %d simulated players (seed %d, waves %d)"), SimulatedPlayers.Num(), SimulatedPlayerSeed, SimulatedMaxWaves);
+}
+
+
+void ASGameMode::FinishSimulatedRun(const TCHAR* Reason)
+{
+	UE_LOG(LogCoopGame, Log, TEXT("Simulated run finished (%s) after %d waves, seed %d"), Reason, WaveCount, SimulatedPlayerSeed);
+
+	if (SimulatedMaxWaves > 0)
+	{
+		FGenericPlatformMisc::RequestExit(false);
+	}
+}
+
+
 void ASGameMode::StartPlay()
 {
+	//Restart the random streams before any actor begins play, so every match of a deterministic run plays out the same
+	FSDeterminism::BeginMatch(GetWorld());
+
 	Super::StartPlay();
 
+	WaveDirector->OnSpawningFinished.AddUObject(this, &ASGameMode::OnWaveSpawningFinished);
+
+	FSTickBudget::Get().Register(this, ECoopTickClass::GameMode);
+
+	//Benchmark runs replace the match entirely
+	if (FParse::Param(FCommandLine::Get(), TEXT("CoopBenchmark")))
+	{
+		bIsBenchmarking = true;
+
+		//Measurements have to see the full load, not a throttled one
+		LoadGovernor->SetComponentTickEnabled(false);
+
+		ASBenchmarkRunner* Runner = GetWorld()->SpawnActor<ASBenchmarkRunner>();
+		if (Runner)
+		{
+			Runner->bExitWhenDone = true;
+		}
+		return;
+	}
+
+	SpawnSimulatedPlayers();
+
 	PrepareForNextWave();
 }
 
@@ -175,14 +359,49 @@ void ASGameMode::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
+	COOP_SCOPE_TIME(GameMode);
+
+	FSTickBudget::Get().CountTick(ECoopTickClass::GameMode);
+
+	if (bIsBenchmarking)
+	{
+		return;
+	}
+
 	CheckWaveState();
 	CheckAnyPlayerAlive();
 }
 
-void ASGameMode::SpawnBotTimerElapsed()
+APawn* ASGameMode::SpawnBlueprintBot()
 {
+	//The hook returns nothing, so catch the first pawn it spawns to hand it to the load governor
+	APawn* SpawnedBot = nullptr;
+	FDelegateHandle SpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateLambda([&SpawnedBot](AActor* Actor)
+	{
+		if (SpawnedBot == nullptr)
+		{
+			SpawnedBot = Cast<APawn>(Actor);
+		}
+	}));
+
 	SpawnNewBot();
 
+	GetWorld()->RemoveOnActorSpawnedHandler(SpawnedHandle);
+
+	return SpawnedBot;
+}
+
+
+void ASGameMode::SpawnBotTimerElapsed()
+{
+	//Hold the spawn while the server is throttled to fewer live bots, the next timer tick tries again
+	if (!LoadGovernor->CanSpawnBot())
+	{
+		return;
+	}
+
+	LoadGovernor->OnBotSpawned(SpawnBlueprintBot());
+
 	NrOfBotsToSpawn--;
 
 	if (NrOfBotsToSpawn <= 0)
@@ -1,13 +1,123 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "SGameState.h"
+#include "SStatusEffectComponent.h"
+#include "SAssetStreamer.h"
+#include "SNetAccounting.h"
+#include "SMemoryTracker.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "STrackerBot.h"
+#include "GameFramework/GameModeBase.h"
 #include "Net/UnrealNetwork.h"
 
 
+ASGameState::ASGameState()
+{
+	StatusEffectComp = CreateDefaultSubobject<USStatusEffectComponent>(TEXT("StatusEffectComp"));
+}
+
+
+void ASGameState::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FSAssetStreamer::Get().BeginMatch(GetWorld());
+
+	FSNetAccounting::Get().BeginMatch(GetWorld());
+
+	// Players can't play before their weapon is in, on clients as much as on the server
+	const AGameModeBase* GameModeCDO = GetDefaultGameMode();
+	const ASCharacter* PawnCDO = GameModeCDO ? Cast<ASCharacter>(GameModeCDO->DefaultPawnClass.GetDefaultObject()) : nullptr;
+	if (PawnCDO)
+	{
+		PreloadWeapon(PawnCDO->GetStarterWeaponClass(), true);
+	}
+}
+
+
+void ASGameState::PreloadWeapon(const TSoftClassPtr<ASWeapon>& WeaponClass, bool bNeededToPlay)
+{
+	if (WeaponClass.IsNull())
+	{
+		return;
+	}
+
+	TArray<FSoftObjectPath> Assets;
+	Assets.Add(WeaponClass.ToSoftObjectPath());
+
+	FSAssetStreamer::Get().Preload(FName(*WeaponClass.ToString()), Assets, false, bNeededToPlay ? GetWorld() : nullptr,
+		FSimpleDelegate::CreateUObject(this, &ASGameState::OnWeaponClassLoaded, WeaponClass, bNeededToPlay));
+}
+
+
+void ASGameState::OnWeaponClassLoaded(TSoftClassPtr<ASWeapon> WeaponClass, bool bNeededToPlay)
+{
+	UClass* LoadedClass = WeaponClass.Get();
+	const ASWeapon* WeaponCDO = LoadedClass ? Cast<ASWeapon>(LoadedClass->GetDefaultObject()) : nullptr;
+	if (WeaponCDO == nullptr)
+	{
+		return;
+	}
+
+	// Same group the weapon requests when it spawns, whoever comes first loads it
+	TArray<FSoftObjectPath> CosmeticAssets;
+	WeaponCDO->GetCosmeticAssets(CosmeticAssets);
+	FSAssetStreamer::Get().Preload(LoadedClass->GetFName(), CosmeticAssets, true, bNeededToPlay ? GetWorld() : nullptr);
+}
+
+
+void ASGameState::OnRep_UpcomingBotClasses()
+{
+	for (const TSoftClassPtr<APawn>& BotClass : UpcomingBotClasses)
+	{
+		TArray<FSoftObjectPath> Assets;
+		Assets.Add(BotClass.ToSoftObjectPath());
+
+		FSAssetStreamer::Get().Preload(FName(*BotClass.ToString()), Assets, false, nullptr,
+			FSimpleDelegate::CreateUObject(this, &ASGameState::OnBotClassLoaded, BotClass));
+	}
+}
+
+
+void ASGameState::OnBotClassLoaded(TSoftClassPtr<APawn> BotClass)
+{
+	UClass* LoadedClass = BotClass.Get();
+	if (LoadedClass == nullptr)
+	{
+		return;
+	}
+
+	const ASTrackerBot* TrackerBotCDO = Cast<ASTrackerBot>(LoadedClass->GetDefaultObject());
+	if (TrackerBotCDO)
+	{
+		TArray<FSoftObjectPath> CosmeticAssets;
+		TrackerBotCDO->GetCosmeticAssets(CosmeticAssets);
+		FSAssetStreamer::Get().Preload(LoadedClass->GetFName(), CosmeticAssets, true, nullptr);
+	}
+
+	// AI characters carry a weapon of their own
+	const ASCharacter* CharacterCDO = Cast<ASCharacter>(LoadedClass->GetDefaultObject());
+	if (CharacterCDO)
+	{
+		PreloadWeapon(CharacterCDO->GetStarterWeaponClass(), false);
+	}
+}
 
 
 void ASGameState::OnRep_WaveState(EWaveState OldState)
 {
+	if (WaveState == EWaveState::WaveInProgress && OldState != EWaveState::WaveInProgress)
+	{
+		FSNetAccounting::Get().BeginWave(GetWorld());
+
+		// Clients replicate the same wave, their game state would close it a second time
+		if (Role == ROLE_Authority)
+		{
+			FSMemoryTracker::Get().BeginWave(GetWorld());
+		}
+	}
+
 	WaveStateChanged(WaveState, OldState);
 }
 
@@ -24,9 +134,28 @@ void ASGameState::SetWaveState(EWaveState NewState)
 	}
 }
 
+
+void ASGameState::SetUpcomingBotClasses(const TArray<TSoftClassPtr<APawn>>& BotClasses)
+{
+	if (Role == ROLE_Authority)
+	{
+		UpcomingBotClasses = BotClasses;
+		// Call on server
+		OnRep_UpcomingBotClasses();
+	}
+}
+
+
+USStatusEffectComponent* ASGameState::GetStatusEffects() const
+{
+	return StatusEffectComp;
+}
+
+
 void ASGameState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
 	DOREPLIFETIME(ASGameState, WaveState);
+	DOREPLIFETIME(ASGameState, UpcomingBotClasses);
 }
\ No newline at end of file
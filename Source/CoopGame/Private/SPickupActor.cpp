@@ -5,6 +5,8 @@
 #include "Components/DecalComponent.h"
 #include "SPowerupActor.h"
 #include "TimerManager.h"
+#include "SPerfCounters.h"
+#include "SMemoryTracker.h"
 
 
 // Sets default values
@@ -28,6 +30,8 @@ ASPickupActor::ASPickupActor()
 void ASPickupActor::BeginPlay()
 {
 	Super::BeginPlay();
+
+	FSMemoryTracker::Get().TrackActor(this, ECoopMemCategory::Pickups);
 	
 	if (Role == ROLE_Authority)
 	{
@@ -36,8 +40,24 @@ void ASPickupActor::BeginPlay()
 }
 
 
+void ASPickupActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Don't leave an unclaimed powerup floating around when the pickup goes away
+	if (PowerUpInstance)
+	{
+		PowerUpInstance->Destroy();
+		PowerUpInstance = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+
 void ASPickupActor::Respawn()
 {
+	COOP_SCOPE_TIME(Pickups);
+	COOP_SCOPE_STAT(PickupRespawn);
+
 	if (PowerUpClass == nullptr)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("PowerUpClass is nullptr in %s. Please update your Blueprint"), *GetName());
@@ -47,7 +67,10 @@ void ASPickupActor::Respawn()
 	FActorSpawnParameters SpawnParams;
 	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 
+	COOP_LLM_SCOPE(ECoopMemCategory::Pickups);
 	PowerUpInstance = GetWorld()->SpawnActor<ASPowerupActor>(PowerUpClass, GetTransform(), SpawnParams);
+	FSMemoryTracker::Get().TrackActor(PowerUpInstance, ECoopMemCategory::Pickups);
+	COOP_COUNT(PickupRespawns, 1);
 }
 
 
@@ -0,0 +1,11 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SPlayerController.h"
+#include "SNetAccounting.h"
+
+
+bool ASPlayerController::CallRemoteFunction(UFunction* Function, void* Parameters, FOutParmRec* OutParms, FFrame* Stack)
+{
+	FSNetAccounting::FRpcScope RpcScope(Function);
+	return Super::CallRemoteFunction(Function, Parameters, OutParms, Stack);
+}
@@ -1,6 +1,11 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "SPowerupActor.h"
+#include "SGameState.h"
+#include "CoopGame.h"
+#include "SCosmeticPolicy.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
 #include "Net/UnrealNetwork.h"
 
 
@@ -10,54 +15,83 @@ ASPowerupActor::ASPowerupActor()
 	PowerupInterval = 0.0f;
 	TotalNrOfTicks = 0;
 
+	EffectType = EStatusEffectType::Custom;
+	EffectMagnitude = 0.0f;
+	EffectId = INDEX_NONE;
+
 	bIsPowerupActive = false;
 
 	SetReplicates(true);
 }
 
 
-void ASPowerupActor::OnTickPowerup()
+void ASPowerupActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	TicksProcessed++;
+	ASGameState* GS = GetWorld()->GetGameState<ASGameState>();
+	if (EffectId != INDEX_NONE && GS)
+	{
+		GS->GetStatusEffects()->RemoveEffect(EffectId);
+		EffectId = INDEX_NONE;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
 
+
+void ASPowerupActor::OnTickPowerup(int32 TickIndex, bool bExpired)
+{
 	OnPowerupTicked();
 
-	if (TicksProcessed >= TotalNrOfTicks)
+	if (bExpired)
 	{
+		EffectId = INDEX_NONE;
+
 		OnExpired();
 
 		bIsPowerupActive = false;
 		OnRep_PowerupActive();
-
-		// Delete timer
-		GetWorldTimerManager().ClearTimer(TimerHandle_PowerupTick);
 	}
 }
 
 
 void ASPowerupActor::OnRep_PowerupActive()
 {
-	OnPowerupStateChanged(bIsPowerupActive);
+	// Only shows or hides the pickup's mesh and light
+#if COOP_WITH_COSMETICS
+	if (FSCosmeticPolicy::Get().ShouldPlay(this, ECoopCosmetic::State, TEXT("ASPowerupActor::StateChanged")))
+	{
+		OnPowerupStateChanged(bIsPowerupActive);
+	}
+#endif
 }
 
 
 void ASPowerupActor::ActivatePowerup(AActor* ActiveFor)
 {
+	ASGameState* GS = GetWorld()->GetGameState<ASGameState>();
+	if (GS == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s needs an ASGameState to run its effect"), *GetName());
+		return;
+	}
+
 	OnActivated(ActiveFor);
 
 	bIsPowerupActive = true;
 	OnRep_PowerupActive();
 
-	if (PowerupInterval > 0.0f)
-	{
-		GetWorldTimerManager().SetTimer(TimerHandle_PowerupTick, this, &ASPowerupActor::OnTickPowerup, PowerupInterval, true);
-	}
-	else
-	{
-		OnTickPowerup();
-	}
+	FSStatusEffectSpec Spec;
+	Spec.Type = EffectType;
+	Spec.Magnitude = EffectMagnitude;
+	Spec.Interval = PowerupInterval;
+	Spec.NrOfTicks = TotalNrOfTicks;
+
+	APawn* ActivePawn = Cast<APawn>(ActiveFor);
+	EffectId = GS->GetStatusEffects()->AddEffect(Spec, ActiveFor, ActivePawn ? ActivePawn->GetController() : nullptr, this,
+		FSStatusEffectTickDelegate::CreateUObject(this, &ASPowerupActor::OnTickPowerup));
 }
 
+
 void ASPowerupActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
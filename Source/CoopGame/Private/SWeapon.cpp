@@ -11,6 +11,16 @@
 #include "TimerManager.h"
 #include "Net/UnrealNetwork.h"
 #include "SCharacter.h"
+#include "SPerfCounters.h"
+#include "SDeterminism.h"
+#include "STelemetry.h"
+#include "SGameMode.h"
+#include "SLoadGovernorComponent.h"
+#include "SAssetStreamer.h"
+#include "SCosmeticPolicy.h"
+#include "SMemoryTracker.h"
+#include "SNetAccounting.h"
+#include "Camera/PlayerCameraManager.h"
 
 static int32 DebugWeaponDrawing = 0;
 FAutoConsoleVariableRef CVARDebugWeaponDrawing(
@@ -39,6 +49,7 @@ ASWeapon::ASWeapon()
 	BaseDamage = 20.0f;
 	BulletSpread = 2.0f;
 	BulletSpreadWhileAiming = 0.0f;
+	RecoilKick = 0.0f;
 	RateOfFire = 600;
 	HeadshotMultiplier = 4.0f;
 
@@ -61,12 +72,24 @@ void ASWeapon::BeginPlay()
 	Super::BeginPlay();
 
 	TimeBetweenShots = 60 / RateOfFire;
+
+	FSMemoryTracker::Get().TrackActor(this, ECoopMemCategory::Weapons);
+
+#if COOP_WITH_COSMETICS
+	// Every instance of the class shares the group, so only the first one spawned requests it
+	TArray<FSoftObjectPath> CosmeticAssets;
+	GetCosmeticAssets(CosmeticAssets);
+	FSAssetStreamer::Get().Preload(GetClass()->GetFName(), CosmeticAssets, true, nullptr);
+#endif
 }
 
 // ------- FUNCTIONS ------- \\
 
 void ASWeapon::Fire()
 {
+	COOP_SCOPE_TIME(Weapons);
+	COOP_SCOPE_STAT(WeaponFire);
+
 	// Trace the world, from pawn eyes to crosshair location
 
 	if (Role < ROLE_Authority)
@@ -78,6 +101,8 @@ void ASWeapon::Fire()
 	AActor* MyOwner = GetOwner();
 	if (MyOwner && CurrentAmmo > 0)
 	{
+		COOP_COUNT(ShotsFired, 1);
+
 		FVector EyeLocation;
 		FRotator EyeRotation;
 		//Get owner's (player) eyes position
@@ -99,7 +124,7 @@ void ASWeapon::Fire()
 			}
 		}
 		
-		ShotDirection = FMath::VRandCone(ShotDirection, HalfRad, HalfRad);
+		ShotDirection = FSDeterminism::GetStream(this, ECoopRandomStream::Weapons).VRandCone(ShotDirection, HalfRad, HalfRad);
 
 		//Find the end of the trace
 		FVector TraceEnd = EyeLocation + (ShotDirection * 10000);
@@ -153,12 +178,26 @@ void ASWeapon::Fire()
 
 		//Play the fire effects at the tracer end point
 		PlayFireEffects(TracerEndPoint);
+
+		//The shooter's own machine predicts the shot, so the feedback never has to come from the server
+		APawn* OwnerPawn = Cast<APawn>(MyOwner);
+		if (OwnerPawn && OwnerPawn->IsLocallyControlled())
+		{
+			PlayLocalFireFeedback();
+		}
 		
 		//Only run this if we are the server
 		if (Role == ROLE_Authority)
 		{
-			HitScanTrace.TraceTo = TracerEndPoint;
-			HitScanTrace.SurfaceType = SurfaceType;
+			//Tracers of other players are cosmetic, a throttled server replicates only some of them
+			ASGameMode* GM = GetWorld()->GetAuthGameMode<ASGameMode>();
+			if (GM == nullptr || GM->GetLoadGovernor()->ShouldReplicateCosmetic())
+			{
+				HitScanTrace.TraceTo = TracerEndPoint;
+				HitScanTrace.SurfaceType = SurfaceType;
+			}
+
+			COOP_TELEMETRY(Shot, MyOwner, Hit.GetActor(), (TracerEndPoint - EyeLocation).Size(), (int32)SurfaceType);
 		}
 		
 		//Make sure that you dont spam click to shoot the weapon faster
@@ -244,47 +283,114 @@ void ASWeapon::StartReload()
 }
 
 
+void ASWeapon::GetCosmeticAssets(TArray<FSoftObjectPath>& OutAssets) const
+{
+#if COOP_WITH_COSMETICS
+	OutAssets.Add(MuzzleEffect.ToSoftObjectPath());
+	OutAssets.Add(DefaultImpactEffect.ToSoftObjectPath());
+	OutAssets.Add(FleshImpactEffect.ToSoftObjectPath());
+	OutAssets.Add(TracerEffect.ToSoftObjectPath());
+	OutAssets.Add(FireCamShake.ToSoftObjectPath());
+#endif
+}
+
+
+void ASWeapon::Serialize(FArchive& Ar)
+{
+	// Every soft reference of the weapon is cosmetic
+	FSAssetStreamer::FCosmeticReferenceScope CosmeticScope(Ar);
+
+	Super::Serialize(Ar);
+}
+
+
 void ASWeapon::PlayFireEffects(FVector TraceEnd)
 {
-	if (MuzzleEffect)
+#if COOP_WITH_COSMETICS
+	if (FSCosmeticPolicy::Get().ShouldPlay(this, ECoopCosmetic::Effect, TEXT("ASWeapon::FireEffects")))
 	{
-		UGameplayStatics::SpawnEmitterAttached(MuzzleEffect, MeshComp, MuzzleSocketName);
+		PlayMuzzleAndTracer(TraceEnd);
 	}
+#endif
+}
 
-	if (TracerEffect)
+
+void ASWeapon::PlayLocalFireFeedback()
+{
+	APawn* MyOwner = Cast<APawn>(GetOwner());
+	APlayerController* PC = MyOwner ? Cast<APlayerController>(MyOwner->GetController()) : nullptr;
+	if (PC == nullptr || !PC->IsLocalController())
 	{
-		FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
+		return;
+	}
 
-		UParticleSystemComponent* TracerComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), TracerEffect, MuzzleLocation);
-		if (TracerComp)
+	//Recoil moves the aim, so it applies wherever the shot is simulated locally, not only where it is drawn
+	if (RecoilKick > 0.0f)
+	{
+		PC->SetControlRotation(PC->GetControlRotation() + FRotator(RecoilKick, 0.0f, 0.0f));
+	}
+
+#if COOP_WITH_COSMETICS
+	//Straight on the camera manager, ClientPlayCameraShake is an RPC whenever the controller isn't local
+	if (PC->PlayerCameraManager && FSCosmeticPolicy::Get().ShouldPlayCameraShake(PC, TEXT("ASWeapon::FireCamShake")))
+	{
+		TSubclassOf<UCameraShake> LoadedFireCamShake = FSAssetStreamer::Get().GetClassIfLoaded(FireCamShake, TEXT("ASWeapon::FireCamShake"));
+		if (LoadedFireCamShake)
 		{
-			TracerComp->SetVectorParameter(TracerTargetName, TraceEnd);
+			PC->PlayerCameraManager->PlayCameraShake(LoadedFireCamShake);
 		}
 	}
+#endif
+}
 
-	APawn* MyOwner = Cast<APawn>(GetOwner());
-	if (MyOwner)
+
+void ASWeapon::PlayMuzzleAndTracer(FVector TraceEnd)
+{
+#if COOP_WITH_COSMETICS
+	FSAssetStreamer& Streamer = FSAssetStreamer::Get();
+	FSMemoryTracker& MemoryTracker = FSMemoryTracker::Get();
+
+	COOP_LLM_SCOPE(ECoopMemCategory::FX);
+
+	UParticleSystem* LoadedMuzzleEffect = Streamer.GetIfLoaded(MuzzleEffect, TEXT("ASWeapon::MuzzleEffect"));
+	if (LoadedMuzzleEffect)
 	{
-		APlayerController* PC = Cast<APlayerController>(MyOwner->GetController());
-		if (PC)
+		MemoryTracker.TrackObject(UGameplayStatics::SpawnEmitterAttached(LoadedMuzzleEffect, MeshComp, MuzzleSocketName), ECoopMemCategory::FX, ECoopMemKind::Component);
+	}
+
+	UParticleSystem* LoadedTracerEffect = Streamer.GetIfLoaded(TracerEffect, TEXT("ASWeapon::TracerEffect"));
+	if (LoadedTracerEffect)
+	{
+		FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
+
+		UParticleSystemComponent* TracerComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), LoadedTracerEffect, MuzzleLocation);
+		MemoryTracker.TrackObject(TracerComp, ECoopMemCategory::FX, ECoopMemKind::Component);
+		if (TracerComp)
 		{
-			PC->ClientPlayCameraShake(FireCamShake);
+			TracerComp->SetVectorParameter(TracerTargetName, TraceEnd);
 		}
 	}
+#endif
 }
 
 
 void ASWeapon::PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoint)
 {
+#if COOP_WITH_COSMETICS
+	if (!FSCosmeticPolicy::Get().ShouldPlayAt(GetWorld(), ImpactPoint, ECoopCosmetic::Effect, TEXT("ASWeapon::ImpactEffect")))
+	{
+		return;
+	}
+
 	UParticleSystem* SelectedEffect = nullptr;
 	switch (SurfaceType)
 	{
 	case SURFACE_FLESHDEFAULT:
 	case SURFACE_FLESHVULNERABLE:
-		SelectedEffect = FleshImpactEffect;
+		SelectedEffect = FSAssetStreamer::Get().GetIfLoaded(FleshImpactEffect, TEXT("ASWeapon::FleshImpactEffect"));
 		break;
 	default:
-		SelectedEffect = DefaultImpactEffect;
+		SelectedEffect = FSAssetStreamer::Get().GetIfLoaded(DefaultImpactEffect, TEXT("ASWeapon::DefaultImpactEffect"));
 		break;
 	}
 
@@ -295,12 +401,22 @@ void ASWeapon::PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoi
 		FVector ShotDirection = ImpactPoint - MuzzleLocation;
 		ShotDirection.Normalize();
 
-		UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), SelectedEffect, ImpactPoint, ShotDirection.Rotation());
+		COOP_LLM_SCOPE(ECoopMemCategory::FX);
+		UParticleSystemComponent* ImpactComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), SelectedEffect, ImpactPoint, ShotDirection.Rotation());
+		FSMemoryTracker::Get().TrackObject(ImpactComp, ECoopMemCategory::FX, ECoopMemKind::Component);
 	}
+#endif
 }
 
 // ------- ONLINE ------- \\
 
+bool ASWeapon::CallRemoteFunction(UFunction* Function, void* Parameters, FOutParmRec* OutParms, FFrame* Stack)
+{
+	FSNetAccounting::FRpcScope RpcScope(Function);
+	return Super::CallRemoteFunction(Function, Parameters, OutParms, Stack);
+}
+
+
 void ASWeapon::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
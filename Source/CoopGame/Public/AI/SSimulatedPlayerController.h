@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "SSimulatedPlayerController.generated.h"
+
+class ASCharacter;
+
+
+UENUM(BlueprintType)
+enum class ESimulatedPlayerPolicy : uint8
+{
+	// Chase the nearest enemy and shoot it
+	Hunt,
+
+	// Stay where we spawned and shoot anything in range
+	HoldPosition,
+
+	// Walk the target points tagged PatrolTag in order, shooting anything in range on the way
+	Patrol,
+};
+
+
+/**
+ * Stands in for a human player when load testing waves, eg. on a headless dedicated server (-nullrhi).
+ * Drives an ASCharacter the same way input does: movement, view rotation and StartFire/StopFire.
+ * The game mode spawns these from -SimPlayers=N, all decisions come from a seeded random stream.
+ */
+UCLASS()
+class COOPGAME_API ASSimulatedPlayerController : public AAIController
+{
+	GENERATED_BODY()
+
+public:
+
+	ASSimulatedPlayerController();
+
+	void SetPolicy(ESimulatedPlayerPolicy NewPolicy);
+
+	void SetRandomSeed(int32 Seed);
+
+protected:
+
+	virtual void OnPossess(APawn* InPawn) override;
+
+	virtual void OnUnPossess() override;
+
+// ------- VARIABLES ------- \\
+
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayer")
+	ESimulatedPlayerPolicy Policy;
+
+	/* Seconds between two decisions, the character keeps its last orders in between */
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayer", meta = (ClampMin = 0.05f))
+	float DecisionInterval;
+
+	/* Enemies closer than this are shot at (if in sight) */
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayer")
+	float EngageRange;
+
+	/* Back off from enemies closer than this, tracker bots explode on contact */
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayer")
+	float KeepAwayDistance;
+
+	/* Radius of random moves when there is nothing to chase */
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayer")
+	float WanderRadius;
+
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayer")
+	FName PatrolTag;
+
+	FTimerHandle TimerHandle_Decide;
+
+	FRandomStream RandomStream;
+
+	// Patrol route, gathered when we first possess a pawn
+	TArray<FVector> PatrolPoints;
+
+	int32 PatrolIndex;
+
+	bool bIsFiring;
+
+// ------- FUNCTIONS ------- \\
+
+	void Decide();
+
+	AActor* FindNearestEnemy(float& OutDistance) const;
+
+	void Engage(AActor* Target, float Distance);
+
+	void MoveWithoutTarget();
+
+	void SetFiring(bool bNewFiring);
+
+	ASCharacter* GetSimulatedCharacter() const;
+};
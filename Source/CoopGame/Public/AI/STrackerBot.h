@@ -53,10 +53,13 @@ protected:
 	// Dynamic material to pulse on damage
 	UMaterialInstanceDynamic* MatInst;
 
+	/* Creates MatInst the first time presentation needs it */
+	UMaterialInstanceDynamic* GetMaterialInstance();
+
 	void SelfDestruct();
 
 	UPROPERTY(EditDefaultsOnly, Category = "TrackerBot")
-	UParticleSystem* ExplosionEffect;
+	TSoftObjectPtr<UParticleSystem> ExplosionEffect;
 
 	bool bExploded;
 
@@ -72,15 +75,18 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "TrackerBot")
 	float SelfDamageInterval;
 
+	// Set by the load governor when fewer bots are allowed alive
+	float DamageScale;
+
 	FTimerHandle TimerHandle_SelfDamage;
 
 	void DamageSelf();
 
 	UPROPERTY(EditDefaultsOnly, Category = "TrackerBot")
-	USoundCue* SelfDestructSound;
+	TSoftObjectPtr<USoundCue> SelfDestructSound;
 
 	UPROPERTY(EditDefaultsOnly, Category = "TrackerBot")
-	USoundCue* ExplodeSound;
+	TSoftObjectPtr<USoundCue> ExplodeSound;
 
 public:	
 	// Called every frame
@@ -88,6 +94,14 @@ public:
 
 	virtual void NotifyActorBeginOverlap(AActor* OtherActor) override;
 
+	void SetDamageScale(float Scale);
+
+	/* Explosion effect and sounds, preloaded together with the wave that spawns the bot */
+	void GetCosmeticAssets(TArray<FSoftObjectPath>& OutAssets) const;
+
+	/* Keeps the cosmetic assets out of the dedicated server cook */
+	virtual void Serialize(FArchive& Ar) override;
+
 protected:
 
 	// CHALLENGE CODE	
@@ -22,8 +22,13 @@ public:
 	// Sets default values for this actor's properties
 	ASExplosiveBarrel();
 
+	/* Keeps the explosion effect and material out of the dedicated server cook */
+	virtual void Serialize(FArchive& Ar) override;
+
 protected:
 
+	virtual void BeginPlay() override;
+
 	UPROPERTY(VisibleAnywhere, Category = "Components")
 	USHealthComponent* HealthComp;
 
@@ -49,10 +54,10 @@ protected:
 	
 	/* Particle to play when health reached zero */
 	UPROPERTY(EditDefaultsOnly, Category = "FX")
-	UParticleSystem* ExplosionEffect;
+	TSoftObjectPtr<UParticleSystem> ExplosionEffect;
 
 	/* The material to replace the original on the mesh once exploded (a blackened version) */
 	UPROPERTY(EditDefaultsOnly, Category = "FX")
-	UMaterialInterface* ExplodedMaterial;
+	TSoftObjectPtr<UMaterialInterface> ExplodedMaterial;
 
 };
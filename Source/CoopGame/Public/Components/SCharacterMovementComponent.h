@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "SCharacterMovementComponent.generated.h"
+
+
+/**
+ * Character movement with sprint and aim as part of the predicted move.
+ * Both travel as custom flags in the compressed flags byte every move already carries, so the server simulates
+ * the same speeds as the client without extra RPCs or corrections. Moves with steady input combine more eagerly.
+ * SpeedBoost status effects (the speed powerup) scale walking on both sides from the replicated effect list.
+ * The server counts how many client moves it had to correct.
+ */
+UCLASS( ClassGroup=(COOP) )
+class COOPGAME_API USCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	USCharacterMovementComponent();
+
+	virtual float GetMaxSpeed() const override;
+
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+	void SetWantsToSprint(bool bNewWantsToSprint);
+
+	void SetWantsToAim(bool bNewWantsToAim);
+
+	bool WantsToAim() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Movement")
+	bool IsSprinting() const;
+
+	/* Server only, client moves checked and corrected since the pawn spawned */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Movement")
+	int32 GetNumCheckedMoves() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Movement")
+	int32 GetNumCorrections() const;
+
+	/* Sprinting only speeds up walking, aiming overrides it */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Movement", meta = (ClampMin = 1.0f))
+	float SprintSpeedMultiplier;
+
+	/* 1 leaves aiming a FOV change only */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Movement", meta = (ClampMin = 0.1f, ClampMax = 1.0f))
+	float AimSpeedMultiplier;
+
+protected:
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+
+	virtual bool ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientLoc, const FVector& RelativeClientLocation,
+		UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+
+	uint8 bWantsToSprint : 1;
+
+	uint8 bWantsToAim : 1;
+
+	int32 NrOfCheckedMoves;
+
+	int32 NrOfCorrections;
+
+	float MaxCorrectionError;
+
+	friend class FSSavedMove_Character;
+};
+
+
+// Saved move that remembers sprint and aim, so they are replayed and combined like any other input
+class FSSavedMove_Character : public FSavedMove_Character
+{
+public:
+
+	typedef FSavedMove_Character Super;
+
+	FSSavedMove_Character();
+
+	virtual void Clear() override;
+
+	virtual uint8 GetCompressedFlags() const override;
+
+	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+
+	virtual void SetMoveFor(ACharacter* Character, float InDeltaTime, FVector const& NewAccel, class FNetworkPredictionData_Client_Character& ClientData) override;
+
+	virtual void PrepMoveFor(ACharacter* Character) override;
+
+	uint8 bSavedWantsToSprint : 1;
+
+	uint8 bSavedWantsToAim : 1;
+};
+
+
+class FSNetworkPredictionData_Client_Character : public FNetworkPredictionData_Client_Character
+{
+public:
+
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	explicit FSNetworkPredictionData_Client_Character(const UCharacterMovementComponent& ClientMovement);
+
+	virtual FSavedMovePtr AllocateNewMove() override;
+};
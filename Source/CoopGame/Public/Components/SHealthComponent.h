@@ -6,6 +6,17 @@
 #include "Components/ActorComponent.h"
 #include "SHealthComponent.generated.h"
 
+// Coarse health as other players see it
+UENUM(BlueprintType)
+enum class EHealthState : uint8
+{
+	Healthy,
+	Damaged,
+	Critical,
+	Dead
+};
+
+
 // OnHealthChanged event
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_SixParams(FOnHealthChangedSignature, USHealthComponent*, OwningHealthComp, float, Health, float, HealthDelta, const class UDamageType*, DamageType, class AController*, InstigatedBy, AActor*, DamageCauser);
 
@@ -21,34 +32,101 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "HealthComponent")
 	uint8 TeamNum;
 
+	/* Other clients only need to know healthy, damaged, critical or dead (eg. props without a health bar) */
+	UPROPERTY(EditDefaultsOnly, Category = "HealthComponent")
+	bool bReplicateStateOnly;
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
 	bool bIsDead;
 
-	UPROPERTY(ReplicatedUsing=OnRep_Health, BlueprintReadOnly, Category = "HealthComponent")
+	/* Exact on the server and the owner, rebuilt from HealthBucket on other clients */
+	UPROPERTY(BlueprintReadOnly, Category = "HealthComponent")
 	float Health;
 
-	UFUNCTION()
-	void OnRep_Health(float OldHealth);
-
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HealthComponent")
 	float DefaultHealth;
 
+	/* Health in tenths, only replicated to the owner */
+	UPROPERTY(ReplicatedUsing=OnRep_QuantizedHealth)
+	uint16 QuantizedHealth;
+
+	/* What everybody else gets, 0 is dead and 1 to NrOfHealthBuckets is the fraction of DefaultHealth rounded up.
+	   With bReplicateStateOnly it holds an EHealthState instead */
+	UPROPERTY(ReplicatedUsing=OnRep_HealthBucket)
+	uint8 HealthBucket;
+
+	/* Resolution of the health bars other players see */
+	UPROPERTY(EditDefaultsOnly, Category = "HealthComponent", meta = (ClampMin = 1, ClampMax = 250))
+	uint8 NrOfHealthBuckets;
+
+	/* Fraction of DefaultHealth at or below which the state is critical */
+	UPROPERTY(EditDefaultsOnly, Category = "HealthComponent", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+	float CriticalHealthFraction;
+
+	// Replicated health can arrive before BeginPlay, which must not reset it
+	bool bReceivedReplicatedHealth;
+
+	UFUNCTION()
+	void OnRep_QuantizedHealth();
+
+	UFUNCTION()
+	void OnRep_HealthBucket();
+
+	/* Server only, refreshes the replicated values and pushes them out when they changed */
+	void UpdateReplicatedHealth();
+
+	/* Client side, applies health rebuilt from the replicated values */
+	void SetReplicatedHealth(float NewHealth);
+
 	UFUNCTION()
 	void HandleTakeAnyDamage(AActor* DamagedActor, float Damage, const class UDamageType* DamageType, class AController* InstigatedBy, AActor* DamageCauser);
+
+	/* Broadcast OnHealthChanged for every single hit and heal, for Blueprints that need to react to each one.
+	   Otherwise changes within a frame are coalesced into one broadcast with the summed delta and the last cause,
+	   sent at the end of the same frame, or right away for the hit that kills */
+	UPROPERTY(EditDefaultsOnly, Category = "HealthComponent")
+	bool bBroadcastEveryHit;
+
+	// Health change not broadcast yet
+	float PendingHealthDelta;
+
+	UPROPERTY()
+	const UDamageType* PendingDamageType;
+
+	UPROPERTY()
+	AController* PendingInstigatedBy;
+
+	UPROPERTY()
+	AActor* PendingDamageCauser;
+
+	bool bHealthChangePending;
+
+	/* Only enabled while a health change is pending, runs late in the frame to send it */
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	void QueueHealthChanged(float HealthDelta, const UDamageType* DamageType, AController* InstigatedBy, AActor* DamageCauser);
+
+	void BroadcastPendingHealthChange();
 	
 public:
 
 	float GetHealth() const;
 
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "HealthComponent")
+	EHealthState GetHealthState() const;
+
 	UPROPERTY(BlueprintAssignable, Category = "Events")
 	FOnHealthChangedSignature OnHealthChanged;
 
 	UFUNCTION(BlueprintCallable, Category = "HealthComponent")
 	void Heal(float HealAmount);
 
+	/* Multiplies max and current health, used to toughen up bots spawned while the server is throttled */
+	void ScaleMaxHealth(float Scale);
+
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "HealthComponent")
 	static bool IsFriendly(AActor* ActorA, AActor* ActorB);
 };
@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SLoadGovernorComponent.generated.h"
+
+class APawn;
+
+
+// What the governor does at one throttle level
+USTRUCT(BlueprintType)
+struct FSGovernorLevel
+{
+	GENERATED_BODY()
+
+public:
+
+	/* Fraction of MaxLiveBots allowed alive at the same time, level 0 doesn't cap */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Governor", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+	float LiveBotScale;
+
+	/* Stretches the time between spawns (2 = half the spawn rate) */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Governor", meta = (ClampMin = 1.0f))
+	float SpawnIntervalScale;
+
+	/* Fraction of cosmetic-only state (eg. remote tracers) that still gets replicated */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Governor", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+	float CosmeticReplicationRatio;
+
+	/* Fewer bots hit harder and last longer, so the wave stays as difficult */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Governor", meta = (ClampMin = 0.1f))
+	float BotHealthScale;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Governor", meta = (ClampMin = 0.1f))
+	float BotDamageScale;
+
+	FSGovernorLevel()
+		: LiveBotScale(1.0f)
+		, SpawnIntervalScale(1.0f)
+		, CosmeticReplicationRatio(1.0f)
+		, BotHealthScale(1.0f)
+		, BotDamageScale(1.0f)
+	{
+	}
+
+	FSGovernorLevel(float InLiveBotScale, float InSpawnIntervalScale, float InCosmeticReplicationRatio, float InBotHealthScale, float InBotDamageScale)
+		: LiveBotScale(InLiveBotScale)
+		, SpawnIntervalScale(InSpawnIntervalScale)
+		, CosmeticReplicationRatio(InCosmeticReplicationRatio)
+		, BotHealthScale(InBotHealthScale)
+		, BotDamageScale(InBotDamageScale)
+	{
+	}
+};
+
+
+/**
+ * Keeps the server inside its frame budget by throttling wave intensity.
+ * Samples game thread time and net saturation, and steps through Levels (0 = unthrottled) with hysteresis.
+ * Higher levels cap live bots, slow down spawning and replicate less cosmetic state, while spawned bots get more
+ * health and damage to make up for it. Every level change is logged and recorded as telemetry.
+ */
+UCLASS( ClassGroup=(COOP), meta=(BlueprintSpawnableComponent) )
+class COOPGAME_API USLoadGovernorComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	USLoadGovernorComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/* False while the live bot cap of a throttled level is reached */
+	bool CanSpawnBot() const;
+
+	/* Counts the bot towards the cap and scales its health and damage to the current level */
+	void OnBotSpawned(APawn* Bot);
+
+	float GetSpawnIntervalScale() const;
+
+	/* Call once per cosmetic update, returns whether this one should replicate */
+	bool ShouldReplicateCosmetic();
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Governor")
+	int32 GetThrottleLevel() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Governor")
+	int32 GetLiveBotCap() const;
+
+protected:
+
+	virtual void BeginPlay() override;
+
+// ------- VARIABLES ------- \\
+
+	/* Throttle levels, index 0 is normal play */
+	UPROPERTY(EditDefaultsOnly, Category = "Governor")
+	TArray<FSGovernorLevel> Levels;
+
+	/* Live bots the throttled levels scale down from, level 0 leaves the waves as they are */
+	UPROPERTY(EditDefaultsOnly, Category = "Governor", meta = (ClampMin = 1))
+	int32 MaxLiveBots;
+
+	/* Game thread budget. 0 derives it from the server tick rate and BudgetFraction */
+	UPROPERTY(EditDefaultsOnly, Category = "Governor", meta = (ClampMin = 0.0f))
+	float TargetFrameMs;
+
+	/* Share of the server tick the game thread may use when TargetFrameMs is 0 */
+	UPROPERTY(EditDefaultsOnly, Category = "Governor", meta = (ClampMin = 0.1f, ClampMax = 1.0f))
+	float BudgetFraction;
+
+	/* Outgoing bandwidth of the busiest connection relative to its net speed that counts as saturated */
+	UPROPERTY(EditDefaultsOnly, Category = "Governor", meta = (ClampMin = 0.1f, ClampMax = 1.0f))
+	float TargetNetSaturation;
+
+	/* Pressure (load / target) below this for long enough steps a level down */
+	UPROPERTY(EditDefaultsOnly, Category = "Governor", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+	float RelaxPressure;
+
+	/* Consecutive samples over budget before stepping up, and under RelaxPressure before stepping down */
+	UPROPERTY(EditDefaultsOnly, Category = "Governor", meta = (ClampMin = 1))
+	int32 SamplesToThrottle;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Governor", meta = (ClampMin = 1))
+	int32 SamplesToRelax;
+
+	int32 ThrottleLevel;
+
+	int32 SamplesOverBudget;
+
+	int32 SamplesUnderBudget;
+
+	// Counted at the last sample, plus bots spawned since
+	int32 LiveBots;
+
+	uint64 LastSampleFrame;
+
+	float CosmeticAccumulator;
+
+// ------- FUNCTIONS ------- \\
+
+	float GetTargetFrameMs() const;
+
+	float SampleGameThreadMs();
+
+	float SampleNetSaturation() const;
+
+	int32 CountLiveBots() const;
+
+	void SetThrottleLevel(int32 NewLevel, float Pressure, float GameThreadMs, float NetSaturation);
+};
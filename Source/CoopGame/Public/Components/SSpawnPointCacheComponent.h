@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SSpawnPointCacheComponent.generated.h"
+
+
+// How a spawn point relates to the players right now, spawns prefer the lowest value
+UENUM(BlueprintType)
+enum class ESpawnPointBucket : uint8
+{
+	// Far enough away and out of sight of every player
+	Hidden,
+
+	// Far enough away but a player can see it
+	Visible,
+
+	// Closer than MinPlayerDistance to a player, never used for spawning
+	TooClose,
+
+	MAX UMETA(Hidden)
+};
+
+
+/**
+ * Navmesh-projected spawn points, built once when the map is loaded.
+ * Points are grouped by region (the first tag of the target point they were sampled around) and kept in
+ * distance/line-of-sight buckets that are refreshed in time slices, so picking a spawn point is O(1)
+ * and never runs a navigation query.
+ */
+UCLASS( ClassGroup=(COOP), meta=(BlueprintSpawnableComponent) )
+class COOPGAME_API USSpawnPointCacheComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	USSpawnPointCacheComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/* Random spawn point of the region, hidden points first. Region None picks from every point */
+	bool PickSpawnTransform(FName Region, FTransform& OutTransform) const;
+
+	bool IsBuilt() const;
+
+	int32 GetNumSpawnPoints() const;
+
+protected:
+
+	virtual void BeginPlay() override;
+
+	struct FSpawnPoint
+	{
+		FVector Location;
+
+		FRotator Rotation;
+
+		int32 RegionIndex;
+
+		ESpawnPointBucket Bucket;
+
+		// Position inside the bucket arrays, lets a point move buckets in O(1)
+		int32 SlotInRegion;
+
+		int32 SlotInAll;
+
+		// Refresh that last found a player close by
+		int32 NearStamp;
+	};
+
+	// Point indices per bucket
+	struct FBucketSet
+	{
+		TArray<int32> Points[(int32)ESpawnPointBucket::MAX];
+	};
+
+// ------- VARIABLES ------- \\
+
+	/* Random navmesh points sampled around every target point, on top of the target point itself */
+	UPROPERTY(EditDefaultsOnly, Category = "SpawnPoints", meta = (ClampMin = 0))
+	int32 SamplesPerTargetPoint;
+
+	/* Radius around a target point to sample reachable navmesh points in */
+	UPROPERTY(EditDefaultsOnly, Category = "SpawnPoints", meta = (ClampMin = 0.0f))
+	float SampleRadius;
+
+	/* Spawn points closer than this to a player are not used */
+	UPROPERTY(EditDefaultsOnly, Category = "SpawnPoints", meta = (ClampMin = 0.0f))
+	float MinPlayerDistance;
+
+	/* Players further away than this are ignored for line of sight checks */
+	UPROPERTY(EditDefaultsOnly, Category = "SpawnPoints", meta = (ClampMin = 0.0f))
+	float MaxVisibilityDistance;
+
+	/* Line of sight traces per refresh, the full set is refreshed over several ticks */
+	UPROPERTY(EditDefaultsOnly, Category = "SpawnPoints", meta = (ClampMin = 1))
+	int32 MaxTracesPerRefresh;
+
+	/* Size of a spatial index cell, should be around MinPlayerDistance */
+	UPROPERTY(EditDefaultsOnly, Category = "SpawnPoints", meta = (ClampMin = 100.0f))
+	float GridCellSize;
+
+	TArray<FSpawnPoint> SpawnPoints;
+
+	TArray<FName> RegionNames;
+
+	TArray<FBucketSet> RegionBuckets;
+
+	FBucketSet AllBuckets;
+
+	// Uniform grid over the spawn points, used to find the points near a player without visiting all of them
+	TMap<FIntVector, TArray<int32>> SpatialGrid;
+
+	// Next point to get a line of sight refresh
+	int32 RefreshCursor;
+
+	int32 RefreshId;
+
+	bool bIsBuilt;
+
+	// Scratch, reused every refresh
+	TArray<int32> TooCloseScratch;
+
+	TArray<FVector> PlayerViewLocations;
+
+// ------- FUNCTIONS ------- \\
+
+	void BuildCache();
+
+	void AddSpawnPoint(const FVector& Location, const FRotator& Rotation, int32 RegionIndex);
+
+	FIntVector GetGridCell(const FVector& Location) const;
+
+	void MoveToBucket(int32 PointIndex, ESpawnPointBucket NewBucket);
+
+	void RefreshBuckets();
+
+	bool IsVisibleToAnyPlayer(const FVector& Location) const;
+};
@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/NetSerialization.h"
+#include "SStatusEffectComponent.generated.h"
+
+class AController;
+class UDamageType;
+class USHealthComponent;
+class USStatusEffectComponent;
+
+
+UENUM(BlueprintType)
+enum class EStatusEffectType : uint8
+{
+	// Only calls back into whoever added it (eg. Blueprint powerups)
+	Custom,
+
+	HealOverTime,
+
+	DamageOverTime,
+
+	// Multiplies the target character's walk speed by the magnitude while active
+	SpeedBoost
+};
+
+
+// Called for every tick of an effect, bExpired is set on the last one
+DECLARE_DELEGATE_TwoParams(FSStatusEffectTickDelegate, int32 /* TickIndex */, bool /* bExpired */);
+
+// Active effects as clients see them, changes when an effect starts or ends
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnStatusEffectChangedSignature, AActor*, Target, EStatusEffectType, EffectType, bool, bActive);
+
+
+// How an effect behaves, usually filled in from the defaults of whoever applies it
+USTRUCT(BlueprintType)
+struct FSStatusEffectSpec
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "StatusEffects")
+	EStatusEffectType Type;
+
+	/* Health healed or damage dealt per tick, speed multiplier of SpeedBoost, unused for Custom effects */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "StatusEffects")
+	float Magnitude;
+
+	/* Time between ticks, 0 ticks once right away */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "StatusEffects", meta = (ClampMin = 0.0f))
+	float Interval;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "StatusEffects", meta = (ClampMin = 1))
+	int32 NrOfTicks;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "StatusEffects")
+	TSubclassOf<UDamageType> DamageType;
+
+	FSStatusEffectSpec()
+		: Type(EStatusEffectType::Custom)
+		, Magnitude(0.0f)
+		, Interval(0.0f)
+		, NrOfTicks(1)
+	{
+	}
+};
+
+
+// One active effect as replicated, only sent when it starts and ends
+USTRUCT()
+struct FSReplicatedStatusEffect : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY()
+	AActor* Target;
+
+	UPROPERTY()
+	EStatusEffectType Type;
+
+	/* Server world time, clients compare it against the game state's server time */
+	UPROPERTY()
+	float EndTime;
+
+	/* Only sent for the effects clients simulate themselves (SpeedBoost) */
+	UPROPERTY()
+	float Magnitude;
+
+	// Server side, matches the packed arrays
+	int32 EffectId;
+
+	FSReplicatedStatusEffect()
+		: Target(nullptr)
+		, Type(EStatusEffectType::Custom)
+		, EndTime(0.0f)
+		, Magnitude(0.0f)
+		, EffectId(INDEX_NONE)
+	{
+	}
+
+	void PostReplicatedAdd(const struct FSReplicatedStatusEffectArray& InArraySerializer);
+
+	void PreReplicatedRemove(const struct FSReplicatedStatusEffectArray& InArraySerializer);
+};
+
+
+USTRUCT()
+struct FSReplicatedStatusEffectArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY()
+	TArray<FSReplicatedStatusEffect> Items;
+
+	// Set by the owning component, used to tell it about replicated changes
+	USStatusEffectComponent* Owner;
+
+	FSReplicatedStatusEffectArray()
+		: Owner(nullptr)
+	{
+	}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FSReplicatedStatusEffect, FSReplicatedStatusEffectArray>(Items, DeltaParms, *this);
+	}
+};
+
+
+template<>
+struct TStructOpsTypeTraits<FSReplicatedStatusEffectArray> : public TStructOpsTypeTraitsBase2<FSReplicatedStatusEffectArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+
+/**
+ * Runs every timed effect of the match (powerups, heal and damage over time) in one pass per frame.
+ * Active effects live in packed arrays on the server. Due ticks are summed per health component and applied
+ * once per target and frame, Custom effects call back into whoever added them. Clients only receive which
+ * effects are active on which actor, as a fast array that changes when an effect starts or ends.
+ * Lives on the game state.
+ */
+UCLASS( ClassGroup=(COOP), meta=(BlueprintSpawnableComponent) )
+class COOPGAME_API USStatusEffectComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	USStatusEffectComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/* Server only, returns an id for RemoveEffect or INDEX_NONE if nothing was added */
+	int32 AddEffect(const FSStatusEffectSpec& Spec, AActor* Target, AController* InstigatedBy, AActor* Causer, FSStatusEffectTickDelegate OnTick = FSStatusEffectTickDelegate());
+
+	/* Ends the effect without a last tick */
+	void RemoveEffect(int32 EffectId);
+
+	UFUNCTION(BlueprintCallable, Category = "StatusEffects")
+	void RemoveEffectsOn(AActor* Target);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "StatusEffects")
+	bool HasActiveEffect(AActor* Target, EStatusEffectType Type) const;
+
+	int32 GetNumActiveEffects() const;
+
+	/* Product of the SpeedBoost effects on the target, from the replicated list so client prediction agrees with the server */
+	float GetSpeedMultiplier(const AActor* Target) const;
+
+	UPROPERTY(BlueprintAssignable, Category = "Events")
+	FOnStatusEffectChangedSignature OnStatusEffectChanged;
+
+protected:
+
+// ------- VARIABLES ------- \\
+
+	// Active effects, one entry per effect at the same index in every array
+	TArray<int32> EffectIds;
+
+	TArray<EStatusEffectType> Types;
+
+	TArray<float> NextTickTimes;
+
+	TArray<float> Intervals;
+
+	TArray<float> Magnitudes;
+
+	TArray<int32> NrOfTicks;
+
+	TArray<int32> TicksDone;
+
+	TArray<TWeakObjectPtr<AActor>> Targets;
+
+	TArray<TWeakObjectPtr<AController>> Instigators;
+
+	TArray<TWeakObjectPtr<AActor>> Causers;
+
+	TArray<TSubclassOf<UDamageType>> DamageTypes;
+
+	TArray<FSStatusEffectTickDelegate> TickDelegates;
+
+	int32 NextEffectId;
+
+	bool bTickingEffects;
+
+	// Ended during the current pass, removed once it's done
+	TArray<int32> EndedEffectIds;
+
+	UPROPERTY(Replicated)
+	FSReplicatedStatusEffectArray ReplicatedEffects;
+
+	// Health changes of the current pass, one per target
+	struct FPendingHealthChange
+	{
+		TWeakObjectPtr<AActor> Target;
+
+		float Heal;
+
+		float Damage;
+
+		TWeakObjectPtr<AController> InstigatedBy;
+
+		TWeakObjectPtr<AActor> Causer;
+
+		TSubclassOf<UDamageType> DamageType;
+	};
+
+	TArray<FPendingHealthChange> PendingChanges;
+
+	TMap<AActor*, int32> PendingChangeIndices;
+
+// ------- FUNCTIONS ------- \\
+
+	void TickEffect(int32 Index);
+
+	void QueueHealthChange(int32 Index);
+
+	void ApplyHealthChanges();
+
+	/* Swaps the last effect into Index */
+	void RemoveEffectAt(int32 Index);
+};
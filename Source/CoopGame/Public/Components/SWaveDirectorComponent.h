@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/DataTable.h"
+#include "SWaveDirectorComponent.generated.h"
+
+class UDataTable;
+class USSpawnPointCacheComponent;
+class USLoadGovernorComponent;
+
+// Fired once every planned spawn of the current wave has been released
+DECLARE_MULTICAST_DELEGATE(FOnWaveSpawningFinished);
+
+
+// A single bot type and how many of it a wave spawns
+USTRUCT(BlueprintType)
+struct FSWaveBotEntry
+{
+	GENERATED_BODY()
+
+public:
+
+	/* Bot to spawn natively, preloaded while the wave before it plays. Leave empty to route the spawn through the SpawnNewBot Blueprint hook */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	TSoftClassPtr<APawn> BotClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave", meta = (ClampMin = 0))
+	int32 Count;
+
+	/* Spawn region (first tag of the target points) to spawn in. None means any region */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	FName SpawnGroup;
+
+	FSWaveBotEntry()
+		: Count(1)
+	{
+	}
+};
+
+
+// One row of the wave data table, row N describes wave N (the last row repeats for later waves)
+USTRUCT(BlueprintType)
+struct FSWaveDefinition : public FTableRowBase
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	TArray<FSWaveBotEntry> Bots;
+
+	/* Seconds between two spawn batches */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave", meta = (ClampMin = 0.0f))
+	float SpawnInterval;
+
+	/* Bots planned for the same moment, they are still released against the per-frame budget */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave", meta = (ClampMin = 1))
+	int32 BatchSize;
+
+	FSWaveDefinition()
+		: SpawnInterval(1.0f)
+		, BatchSize(1)
+	{
+	}
+};
+
+
+// Planned vs. actual spawn time of a single bot, in real seconds since the wave started
+USTRUCT(BlueprintType)
+struct FSWaveSpawnRecord
+{
+	GENERATED_BODY()
+
+public:
+
+	/* Time in the wave definition */
+	UPROPERTY(BlueprintReadOnly, Category = "Wave")
+	float PlannedTime;
+
+	/* When the spawn came due, later than PlannedTime while the load governor stretches spawn intervals */
+	UPROPERTY(BlueprintReadOnly, Category = "Wave")
+	float DueTime;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Wave")
+	float ActualTime;
+
+	FSWaveSpawnRecord()
+		: PlannedTime(0.0f)
+		, DueTime(0.0f)
+		, ActualTime(0.0f)
+	{
+	}
+};
+
+
+/**
+ * Spawns the bots of a wave from a data table of wave definitions.
+ * Spawns are planned up front and released in time-sliced batches, never more than MaxSpawnsPerFrame per frame.
+ */
+UCLASS( ClassGroup=(COOP), meta=(BlueprintSpawnableComponent) )
+class COOPGAME_API USWaveDirectorComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	USWaveDirectorComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/* Plans the spawns of a wave and starts releasing them. Returns the number of bots planned */
+	int32 BeginWave(int32 WaveNumber);
+
+	/* Drops every spawn that hasn't been released yet */
+	void AbortWave();
+
+	bool HasWaveTable() const;
+
+	bool IsSpawning() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "WaveDirector")
+	int32 GetNumPendingSpawns() const;
+
+	const TArray<FSWaveSpawnRecord>& GetSpawnRecords() const;
+
+	/* Bot classes a wave will spawn natively, without loading them */
+	void GetWaveBotClasses(int32 WaveNumber, TArray<TSoftClassPtr<APawn>>& OutClasses) const;
+
+	FOnWaveSpawningFinished OnSpawningFinished;
+
+protected:
+
+	// A spawn waiting for its planned time
+	struct FPendingSpawn
+	{
+		int32 EntryIndex;
+
+		float PlannedTime;
+	};
+
+// ------- VARIABLES ------- \\
+
+	/* Rows of FSWaveDefinition. Without a table the game mode keeps using the SpawnNewBot Blueprint hook */
+	UPROPERTY(EditDefaultsOnly, Category = "WaveDirector")
+	UDataTable* WaveTable;
+
+	/* Upper bound of bots released in a single frame, keeps big batches from hitching */
+	UPROPERTY(EditDefaultsOnly, Category = "WaveDirector", meta = (ClampMin = 1))
+	int32 MaxSpawnsPerFrame;
+
+	/* Extra bots per wave past the end of the table, as a fraction of the last row (0.5 = +50% per wave) */
+	UPROPERTY(EditDefaultsOnly, Category = "WaveDirector", meta = (ClampMin = 0.0f))
+	float OverflowCountScale;
+
+	/* Spawns later than this (seconds) past their planned time are reported as late */
+	UPROPERTY(EditDefaultsOnly, Category = "WaveDirector", meta = (ClampMin = 0.0f))
+	float LateSpawnThreshold;
+
+	// Entries of the wave currently being spawned
+	TArray<FSWaveBotEntry> ActiveEntries;
+
+	// Sorted by planned time
+	TArray<FPendingSpawn> PendingSpawns;
+
+	int32 NextPendingIndex;
+
+	int32 ActiveWaveNumber;
+
+	// Seconds into the wave, runs slower while the load governor stretches spawn intervals
+	float WaveClock;
+
+	// Real seconds into the wave, what the spawn records are in
+	float WaveTime;
+
+	TArray<FSWaveSpawnRecord> SpawnRecords;
+
+	// Precomputed navmesh spawn points on the same actor
+	UPROPERTY()
+	USSpawnPointCacheComponent* SpawnPointCache;
+
+	UPROPERTY()
+	USLoadGovernorComponent* LoadGovernor;
+
+// ------- FUNCTIONS ------- \\
+
+	const FSWaveDefinition* FindWaveDefinition(int32 WaveNumber, float& OutCountScale) const;
+
+	virtual void BeginPlay() override;
+
+	bool SpawnBot(const FSWaveBotEntry& Entry);
+
+	void FinishSpawning();
+
+	void ReportSpawnTiming() const;
+};
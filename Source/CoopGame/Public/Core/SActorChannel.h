@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/ActorChannel.h"
+#include "SActorChannel.generated.h"
+
+
+/**
+ * Actor channel that reports the size of every bunch to FSNetAccounting, registered for every net driver in
+ * DefaultEngine.ini. Costs a branch per bunch while accounting is off.
+ */
+UCLASS(transient)
+class COOPGAME_API USActorChannel : public UActorChannel
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual FPacketIdRange SendBunch(FOutBunch* Bunch, bool Merge) override;
+
+protected:
+
+	virtual void ReceivedBunch(FInBunch& Bunch) override;
+};
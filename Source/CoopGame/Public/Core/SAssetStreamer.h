@@ -0,0 +1,179 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/StreamableManager.h"
+#include "Templates/SubclassOf.h"
+#include "UObject/SoftObjectPtr.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include "Misc/Optional.h"
+
+class UWorld;
+
+
+/**
+ * Loads weapon, FX and bot assets in the background instead of with the map or on first use.
+ *
+ * Gameplay code preloads named groups of soft references ahead of time (the starter weapon when a match starts,
+ * the bots of the next wave during the break, a weapon's effects when it spawns) and keeps them loaded. Cosmetic
+ * lookups that still miss skip the effect once and stream it in, spawns that can't wait load synchronously.
+ * Either way the miss is recorded, and together with the preload times and each match's time until everything it
+ * needed to play was loaded it makes up the report (COOP.AssetReport, also logged on exit). Game thread only.
+ */
+class COOPGAME_API FSAssetStreamer
+{
+public:
+
+	static FSAssetStreamer& Get();
+
+	/* Releases every loaded asset, called when the module shuts down */
+	void Shutdown();
+
+	/* Restarts the world's time to playable clock, called when a match world begins play */
+	void BeginMatch(const UWorld* World);
+
+	/**
+	 * Starts loading the assets in the background and keeps them loaded. A group is only requested once per name,
+	 * OnLoaded still fires for every caller once it is in. Cosmetic groups are skipped on dedicated servers.
+	 * Groups preloaded with a NeededToPlayIn world count towards that match's time to playable, even when an
+	 * earlier match already loaded them.
+	 */
+	void Preload(FName GroupName, const TArray<FSoftObjectPath>& Assets, bool bCosmetic, const UWorld* NeededToPlayIn, FSimpleDelegate OnLoaded = FSimpleDelegate());
+
+	/* Loaded asset, or nullptr while it streams in after a miss */
+	template<typename T>
+	T* GetIfLoaded(const TSoftObjectPtr<T>& Asset, const TCHAR* User)
+	{
+		T* Loaded = Asset.Get();
+		if (Loaded == nullptr && !Asset.IsNull())
+		{
+			RequestAfterMiss(Asset.ToSoftObjectPath(), User);
+		}
+		return Loaded;
+	}
+
+	template<typename T>
+	TSubclassOf<T> GetClassIfLoaded(const TSoftClassPtr<T>& Class, const TCHAR* User)
+	{
+		UClass* Loaded = Class.Get();
+		if (Loaded == nullptr && !Class.IsNull())
+		{
+			RequestAfterMiss(Class.ToSoftObjectPath(), User);
+		}
+		return Loaded;
+	}
+
+	/* For classes that are needed right now (eg. to spawn), loads synchronously and reports the hitch if it has to */
+	template<typename T>
+	TSubclassOf<T> LoadClassNow(const TSoftClassPtr<T>& Class, const TCHAR* User)
+	{
+		UClass* Loaded = Class.Get();
+		if (Loaded == nullptr && !Class.IsNull())
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Loaded = Class.LoadSynchronous();
+			RecordMiss(Class.ToSoftObjectPath(), User, (float)((FPlatformTime::Seconds() - StartTime) * 1000.0));
+		}
+		return Loaded;
+	}
+
+	void LogReport() const;
+
+	/**
+	 * Put on the stack while serializing an object whose soft references are all cosmetic (see ASWeapon::Serialize).
+	 * Cooks for dedicated server platforms then neither follow nor record them, so those assets stay out of the
+	 * server build. Does nothing outside the editor.
+	 */
+	class COOPGAME_API FCosmeticReferenceScope
+	{
+	public:
+
+		explicit FCosmeticReferenceScope(const FArchive& Ar);
+
+	private:
+
+		TOptional<FSoftObjectPathSerializationScope> Scope;
+	};
+
+private:
+
+	struct FGroup
+	{
+		FName Name;
+
+		int32 NrOfAssets;
+
+		double RequestTime;
+
+		float LoadMs;
+
+		bool bLoaded;
+
+		TSharedPtr<FStreamableHandle> Handle;
+
+		TArray<FSimpleDelegate> OnLoaded;
+	};
+
+	// Asset that wasn't loaded when it was first used
+	struct FMiss
+	{
+		FSoftObjectPath Path;
+
+		FString User;
+
+		// Time the synchronous load took, negative if the use was skipped instead
+		float SyncLoadMs;
+
+		float SecondsIntoMatch;
+	};
+
+	// One per match world, kept after the world is gone for the report
+	struct FMatch
+	{
+		TWeakObjectPtr<const UWorld> World;
+
+		FString WorldName;
+
+		double StartTime;
+
+		float TimeToPlayableMs;
+
+		bool bPlayable;
+
+		TArray<FName> NeededGroups;
+	};
+
+	TUniquePtr<FStreamableManager> StreamableManager;
+
+	TArray<FGroup> Groups;
+
+	TArray<FMiss> Misses;
+
+	TSet<FSoftObjectPath> MissedPaths;
+
+	// Loads started by cosmetic misses
+	TArray<TSharedPtr<FStreamableHandle>> MissHandles;
+
+	TArray<FMatch> Matches;
+
+	// Of the latest match, misses are timed against it
+	double MatchStartTime;
+
+	FSAssetStreamer();
+
+	FStreamableManager& GetStreamableManager();
+
+	void OnGroupLoaded(FName GroupName);
+
+	FMatch& FindOrAddMatch(const UWorld* World);
+
+	bool IsGroupLoaded(FName GroupName) const;
+
+	/* Marks the match playable once it needs at least one group and all of them are in */
+	void CheckPlayable(FMatch& Match);
+
+	void RequestAfterMiss(const FSoftObjectPath& Path, const TCHAR* User);
+
+	void RecordMiss(const FSoftObjectPath& Path, const TCHAR* User, float SyncLoadMs);
+};
@@ -0,0 +1,222 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/EngineBaseTypes.h"
+#include "SPerfCounters.h"
+#include "SBenchmarkRunner.generated.h"
+
+class ASBenchmarkRunner;
+class ASSimulatedPlayerController;
+class FJsonObject;
+
+
+// Second tick of the runner, marks the end of the physics step
+USTRUCT()
+struct FSBenchmarkPostPhysicsTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	ASBenchmarkRunner* Target;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FSBenchmarkPostPhysicsTickFunction> : public TStructOpsTypeTraitsBase2<FSBenchmarkPostPhysicsTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+
+// Averages of one population step
+struct FSBenchmarkStepResult
+{
+	int32 NrOfBots;
+
+	int32 NrOfBarrels;
+
+	int32 NrOfPickups;
+
+	int32 NrOfShooters;
+
+	int32 NrOfFrames;
+
+	float AvgFrameMs;
+
+	float P95FrameMs;
+
+	float MaxFrameMs;
+
+	float AvgGameThreadMs;
+
+	float AvgPhysicsMs;
+
+	float AvgOutBytesPerSecond;
+
+	// Average over the connected clients, 0 without any
+	float AvgOutBytesPerConnection;
+
+	float AvgSubsystemMs[(int32)ECoopSubsystem::Count];
+};
+
+
+/**
+ * Horde scaling benchmark. Spawns fixed populations of tracker bots, explosive barrels, pickups and firing
+ * (invulnerable) simulated players in steps, measures each step and writes the results as json to Saved/Benchmarks.
+ * A run fails when a metric is worse than the stored baseline by more than RegressionThreshold.
+ *
+ * Start with -CoopBenchmark on the command line (the game mode spawns the runner and skips waves), or COOP.Benchmark in the console.
+ */
+UCLASS(Config = Game)
+class COOPGAME_API ASBenchmarkRunner : public AActor
+{
+	GENERATED_BODY()
+
+public:
+
+	ASBenchmarkRunner();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	void OnPostPhysicsTick();
+
+	/* Quit the process once the run is done, used by the command line mode */
+	bool bExitWhenDone;
+
+protected:
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	enum class EPhase : uint8
+	{
+		Idle,
+		Warmup,
+		Measure,
+		Done,
+	};
+
+// ------- VARIABLES ------- \\
+
+	/* Number of tracker bots per step */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	TArray<int32> BotSteps;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	FSoftClassPath BotClass;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	FSoftClassPath BarrelClass;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	FSoftClassPath PickupClass;
+
+	/* Barrels, pickups and shooters per bot of the step */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	float BarrelsPerBot;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	float PickupsPerBot;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	float ShootersPerBot;
+
+	/* Radius around the runner that populations are scattered in, when the map has no spawn point cache */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	float ArenaRadius;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	float WarmupSeconds;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	float MeasureSeconds;
+
+	/* Actors spawned per frame while building up a population */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	int32 SpawnsPerFrame;
+
+	/* Allowed relative regression from the baseline (0.1 = 10% worse) before the run fails */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Benchmark")
+	float RegressionThreshold;
+
+	FSBenchmarkPostPhysicsTickFunction PostPhysicsTick;
+
+	EPhase Phase;
+
+	int32 StepIndex;
+
+	float PhaseEndTime;
+
+	UPROPERTY()
+	UClass* LoadedBotClass;
+
+	UPROPERTY()
+	UClass* LoadedBarrelClass;
+
+	UPROPERTY()
+	UClass* LoadedPickupClass;
+
+	TArray<TWeakObjectPtr<AActor>> Bots;
+
+	TArray<TWeakObjectPtr<AActor>> Barrels;
+
+	TArray<TWeakObjectPtr<AActor>> Pickups;
+
+	TArray<TWeakObjectPtr<ASSimulatedPlayerController>> Shooters;
+
+	// Per frame samples of the current step
+	TArray<float> FrameSamples;
+
+	TArray<float> GameThreadSamples;
+
+	TArray<float> PhysicsSamples;
+
+	TArray<float> OutBytesSamples;
+
+	TArray<float> OutBytesPerConnectionSamples;
+
+	float SubsystemTotals[(int32)ECoopSubsystem::Count];
+
+	double PrePhysicsTime;
+
+	TArray<FSBenchmarkStepResult> Results;
+
+// ------- FUNCTIONS ------- \\
+
+	void ParseCommandLine();
+
+	void BeginStep();
+
+	void EndStep();
+
+	void Finish();
+
+	/* Tops up the population of the current step, bots blow up and need replacing */
+	void MaintainPopulation();
+
+	int32 TopUp(TArray<TWeakObjectPtr<AActor>>& Population, UClass* ActorClass, int32 TargetCount, int32& SpawnBudget);
+
+	void TopUpShooters(int32 TargetCount, int32& SpawnBudget);
+
+	void DestroyPopulation();
+
+	FTransform PickSpawnTransform() const;
+
+	void SampleFrame();
+
+	TSharedRef<FJsonObject> ResultsToJson() const;
+
+	/* Returns false when any metric regressed beyond the threshold */
+	bool CompareToBaseline(const FString& BaselinePath) const;
+
+	int32 GetTargetCount(float PerBot, int32 NrOfBots, int32 Minimum) const;
+};
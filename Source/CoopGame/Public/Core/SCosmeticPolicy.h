@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class APlayerController;
+class UWorld;
+
+
+// Kinds of presentation work, each gated the way it can be missed
+enum class ECoopCosmetic : uint8
+{
+	// One-shot visuals (emitters, hit flashes), nobody misses them when nobody looks
+	Effect,
+
+	// Heard from off screen too, only skipped where nobody listens
+	Sound,
+
+	// Lasting change of an actor's look (eg. the exploded barrel material), has to be right whenever it comes into view
+	State,
+
+	// Feedback for the player that caused it
+	CameraShake,
+
+	Count
+};
+
+
+// Why presentation work was skipped
+enum class ECoopCosmeticSkip : uint8
+{
+	// Nobody plays on this machine
+	DedicatedServer,
+
+	// Listen server, and no local player looks at it
+	NotViewed,
+
+	// Camera shake for a player on another machine, which plays its own
+	NotLocal,
+
+	Count
+};
+
+
+/**
+ * The one place gameplay code asks whether to do presentation work: spawning emitters and sounds, creating and
+ * updating dynamic materials, shaking cameras.
+ *
+ * Dedicated servers skip all of it. Listen servers skip effects of actors none of their local players currently
+ * sees (not rendered recently, or outside the camera cone for effects at a location); their state changes still
+ * apply, effects that get updated regularly pick up again once the actor is back in view. Camera shakes only play
+ * for local players. Clients and standalone games play everything.
+ *
+ * Every call site is counted by name with what it played and skipped why, COOP.CosmeticReport logs the counts
+ * (also logged on exit). COOP.CosmeticGating 0 turns the gating off to compare against. Game thread only.
+ */
+class COOPGAME_API FSCosmeticPolicy
+{
+public:
+
+	static FSCosmeticPolicy& Get();
+
+	/* Presentation work on or of an actor */
+	bool ShouldPlay(const AActor* Actor, ECoopCosmetic Kind, FName Site);
+
+	/* Presentation work at a location in the world rather than on an actor (eg. impacts) */
+	bool ShouldPlayAt(const UWorld* World, const FVector& Location, ECoopCosmetic Kind, FName Site);
+
+	bool ShouldPlayCameraShake(const APlayerController* PC, FName Site);
+
+	void ResetCounters();
+
+	void LogReport() const;
+
+private:
+
+	struct FSiteCounters
+	{
+		ECoopCosmetic Kind;
+
+		int32 NrOfPlayed;
+
+		int32 NrOfSkipped[(int32)ECoopCosmeticSkip::Count];
+
+		FSiteCounters()
+			: Kind(ECoopCosmetic::Effect)
+			, NrOfPlayed(0)
+		{
+			FMemory::Memzero(NrOfSkipped);
+		}
+	};
+
+	TMap<FName, FSiteCounters> Sites;
+
+	FSCosmeticPolicy();
+
+	bool IsActorViewed(const AActor* Actor) const;
+
+	bool IsViewedByLocalPlayer(const UWorld* World, const FVector& Location) const;
+
+	// Counts the outcome and returns whether to play
+	bool Record(FName Site, ECoopCosmetic Kind, bool bPlay, ECoopCosmeticSkip Reason);
+};
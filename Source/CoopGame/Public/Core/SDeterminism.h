@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+
+// Independent random streams, so extra randomness in one subsystem doesn't shift the others
+enum class ECoopRandomStream : uint8
+{
+	Weapons,
+	Spawns,
+	AI,
+
+	Count
+};
+
+
+namespace ECoopInputButton
+{
+	enum Type : uint8
+	{
+		Fire	= 1 << 0,
+		Zoom	= 1 << 1,
+		Crouch	= 1 << 2,
+
+		// Edges, only set on the frame the button was pressed
+		Jump	= 1 << 3,
+		Reload	= 1 << 4,
+
+		// Held, comes after the edges so older recordings stay valid
+		Sprint	= 1 << 5,
+	};
+}
+
+
+// Input of the local player for a single frame
+struct FSInputFrame
+{
+	float MoveForward;
+
+	float MoveRight;
+
+	float Turn;
+
+	float LookUp;
+
+	// ECoopInputButton flags
+	uint8 Buttons;
+
+	FSInputFrame()
+		: MoveForward(0.0f)
+		, MoveRight(0.0f)
+		, Turn(0.0f)
+		, LookUp(0.0f)
+		, Buttons(0)
+	{
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FSInputFrame& Frame)
+	{
+		return Ar << Frame.MoveForward << Frame.MoveRight << Frame.Turn << Frame.LookUp << Frame.Buttons;
+	}
+};
+
+
+/**
+ * Deterministic simulation mode for reproducible wave runs and benchmarks.
+ *
+ * -CoopDeterministic		fixed simulation timestep and seeded random streams
+ * -CoopSeed=N				seed of the run (default 1)
+ * -CoopFixedFPS=N			simulation rate in deterministic mode (default 30)
+ * -RecordInput=File		record the local player's input per frame (implies -CoopDeterministic)
+ * -ReplayInput=File		play a recorded input stream back instead of live input (implies -CoopDeterministic)
+ *
+ * Every world has its own streams and match frame, so matches hosted side by side in one process (see USMatchHost)
+ * don't shift each other's random sequence; each of them plays out as it would alone. Outside of deterministic mode
+ * the streams are seeded from the clock, so gameplay stays as random as before.
+ */
+class COOPGAME_API FSDeterminism
+{
+public:
+
+	/* Reads the command line, called once at module startup */
+	static void Initialize();
+
+	/* Writes the input recording, if any */
+	static void Shutdown();
+
+	static bool IsEnabled();
+
+	static int32 GetSeed();
+
+	/* Stream of the world the object is in, worlds without a match yet (eg. on clients) start theirs on first use */
+	static FRandomStream& GetStream(const UObject* WorldContextObject, ECoopRandomStream Stream);
+
+	/* Reseeds the streams of the world and restarts its frame count, called when a match starts */
+	static void BeginMatch(const UWorld* World);
+
+	/* Frames since the match of the world started */
+	static int32 GetMatchFrame(const UWorld* World);
+
+	static bool IsRecordingInput();
+
+	static bool IsReplayingInput();
+
+	static void RecordInputFrame(int32 Frame, const FSInputFrame& Input);
+
+	/* False once the recording has run out */
+	static bool GetReplayInputFrame(int32 Frame, FSInputFrame& OutInput);
+};
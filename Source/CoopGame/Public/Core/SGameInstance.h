@@ -6,8 +6,13 @@
 #include "Engine/GameInstance.h"
 #include "OnlineSubsystem.h"
 #include "OnlineSessionInterface.h"
+#include "SPingProbe.h"
 #include "SGameInstance.generated.h"
 
+class USMatchHost;
+class USSessionBrowser;
+class USTravelPipeline;
+
 
 
 /**
@@ -40,6 +45,9 @@ class COOPGAME_API USGameInstance : public UGameInstance
 
 	TSharedPtr<class FOnlineSessionSettings> SessionSettings;
 
+	/* Answers the probes of clients picking a session to join, while we host one */
+	FSPingResponder PingResponder;
+
 
 	/**
 	*	Function fired when a session create request has completed
@@ -71,7 +79,7 @@ class COOPGAME_API USGameInstance : public UGameInstance
 	// ------- ONLINE - FINDING A SESSION ------- \\
 
 	/**
-	*	Find an online session
+	*	Starts browsing online sessions, the session browser keeps refreshing them in the background
 	*
 	*	@param UserId user that initiated the request
 	*	@param bIsLAN are we searching LAN matches
@@ -79,22 +87,18 @@ class COOPGAME_API USGameInstance : public UGameInstance
 	*/
 	void FindSessions(TSharedPtr<const FUniqueNetId> UserId, bool bIsLAN, bool bIsPresence);
 
-//Delegates
-
-	/** Delegate for searching for sessions */
-	FOnFindSessionsCompleteDelegate OnFindSessionsCompleteDelegate;
+	/* Cached search results, only on clients and listen servers */
+	UPROPERTY()
+	USSessionBrowser* SessionBrowser;
 
-	/** Handle to registered delegate for searching a session */
-	FDelegateHandle OnFindSessionsCompleteDelegateHandle;
+	/* Joins the best ranked session once its host was probed */
+	void JoinBestSession();
 
-	TSharedPtr<class FOnlineSessionSearch> SessionSearch;
+	// ------- TRAVEL ------- \\
 
-	/**
-	*	Delegate fired when a session search query has completed
-	*
-	*	@param bWasSuccessful true if the async action completed without error, false if there was an error
-	*/
-	void OnFindSessionsComplete(bool bWasSuccessful);
+	/* Loads maps in the background before opening them and times host/join until the pawn is controllable */
+	UPROPERTY()
+	USTravelPipeline* TravelPipeline;
 
 	// ------- ONLINE - JOINING A SESSION ------- \\
 
@@ -151,8 +155,27 @@ class COOPGAME_API USGameInstance : public UGameInstance
 	UFUNCTION(BlueprintCallable, Category = "Network|Test")
 	void JoinOnlineGame();
 
+	/* Joins a session of the session browser by its id */
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	bool JoinBrowsedSession(const FString& SessionId);
+
 	UFUNCTION(BlueprintCallable, Category = "Network|Test")
 	void DestroySessionAndLeaveGame();
+
+	// ------- MATCH HOSTING ------- \\
+
+	/* Extra match worlds of a dedicated server started with -CoopMatches */
+	UPROPERTY()
+	USMatchHost* MatchHost;
+
+public:
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Network")
+	USSessionBrowser* GetSessionBrowser() const;
+
+	virtual void OnStart() override;
+
+	virtual void Shutdown() override;
 };
 
 
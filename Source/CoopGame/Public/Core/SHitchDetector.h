@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SPerfCounters.h"
+
+class UWorld;
+
+
+/**
+ * Catches long game thread frames (wave starts, big explosions) with what was going on around them.
+ *
+ * Every frame over COOP.HitchThresholdMs is counted and logged. A capture gets the last COOP.HitchFrames frames of
+ * FSPerfCounters, the subsystems that took longest in the hitch frame, and per game world the wave state and live
+ * actor counts per class; it is written to Saved/Hitches as text. Collecting that takes a copy of the history and
+ * one pass over the actors, formatting and writing happen on a background thread. Captures are at least
+ * COOP.HitchCooldown seconds apart and at most COOP.HitchMaxCaptures per run, hitches in between only count.
+ * Frames right after a map load are expected to be long and ignored. Game thread only.
+ */
+class COOPGAME_API FSHitchDetector
+{
+public:
+
+	static FSHitchDetector& Get();
+
+	/* Starts watching, called when the module starts (after FSPerfCounters is bound) */
+	void Initialize();
+
+	void Shutdown();
+
+	void LogReport() const;
+
+private:
+
+	struct FClassCount
+	{
+		FName ClassName;
+
+		int32 NrOfActors;
+	};
+
+	struct FWorldSnapshot
+	{
+		FString WorldName;
+
+		FString WaveState;
+
+		int32 Wave;
+
+		int32 NrOfActors;
+
+		// Unsorted, the writer sorts them
+		TArray<FClassCount> Classes;
+	};
+
+	// Everything a capture writes, collected on the game thread and formatted on a background thread
+	struct FCapture
+	{
+		int32 Index;
+
+		FDateTime Time;
+
+		uint64 FrameCounter;
+
+		float GameThreadMs;
+
+		float ThresholdMs;
+
+		int32 NrOfSkippedHitches;
+
+		// Oldest first, the hitch frame is the last one
+		TArray<FSFramePerf> Frames;
+
+		TArray<FWorldSnapshot> Worlds;
+	};
+
+	int32 NrOfHitches;
+
+	int32 NrOfCaptures;
+
+	// Hitches since the last capture that weren't captured
+	int32 NrOfSkippedHitches;
+
+	float WorstGameThreadMs;
+
+	double LastCaptureTime;
+
+	double LastMapLoadTime;
+
+	FDelegateHandle EndFrameHandle;
+
+	FDelegateHandle PostLoadMapHandle;
+
+	FSHitchDetector();
+
+	void EndFrame();
+
+	void OnPostLoadMap(UWorld* World);
+
+	void CaptureHitch(const FSFramePerf& Frame, float ThresholdMs);
+
+	static void SnapshotWorld(UWorld* World, FWorldSnapshot& OutSnapshot);
+
+	static void WriteCapture(const FCapture& Capture);
+};
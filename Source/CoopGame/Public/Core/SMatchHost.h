@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Containers/Ticker.h"
+#include "SMatchHost.generated.h"
+
+class UGameInstance;
+class UWorld;
+
+
+/**
+ * Hosts several independent horde matches in one dedicated server process.
+ *
+ * The engine loads the first match as usual, every extra match gets its own world context and world with its own
+ * game mode, game state, physics scene and net driver (listening on the next port). The arena is streamed into the
+ * empty world as a level instance, so the same map can be loaded once per match while meshes, materials, sounds and
+ * blueprint classes stay loaded only once for the whole process.
+ *
+ * The engine ticks world contexts one after the other on the game thread (gameplay code isn't thread safe), so
+ * matches share the game thread; physics, animation and other task graph work still spreads over the cores.
+ * Per match tick time and memory are logged every ReportInterval seconds to show how many matches fit on a host.
+ * Memory is counted a few objects per frame, one world after the other, so measuring it doesn't hitch the matches.
+ *
+ * -CoopMatches=N			total number of matches in this process
+ * -CoopMatchMap=Package	arena for the extra matches (defaults to the map the server started with); nested
+ *							streaming levels of the arena are not loaded, so it has to be self contained
+ */
+UCLASS()
+class COOPGAME_API USMatchHost : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	USMatchHost();
+
+	/* Starts the extra matches next to the world the engine loaded */
+	void Initialize(UGameInstance* InGameInstance);
+
+	/* Tears down the extra matches */
+	void Shutdown();
+
+	int32 GetNumMatches() const;
+
+protected:
+
+	struct FMatchStats
+	{
+		double TickStartTime;
+
+		double TotalTickMs;
+
+		float MaxTickMs;
+
+		int32 NrOfTicks;
+
+		FMatchStats()
+			: TickStartTime(0.0)
+			, TotalTickMs(0.0)
+			, MaxTickMs(0.0f)
+			, NrOfTicks(0)
+		{
+		}
+	};
+
+// ------- VARIABLES ------- \\
+
+	UPROPERTY()
+	UGameInstance* GameInstance;
+
+	/* First entry is the world the engine loaded, we only own the others */
+	TArray<TWeakObjectPtr<UWorld>> MatchWorlds;
+
+	TArray<FMatchStats> MatchStats;
+
+	/* Bytes of each match's own objects as of its last finished count, 0 until then */
+	TArray<int64> MatchMemory;
+
+	// Count in progress
+	int32 MemoryMatchIndex;
+
+	TArray<TWeakObjectPtr<UObject>> MemoryObjects;
+
+	int32 NrOfCountedObjects;
+
+	int64 CountedBytes;
+
+	float ReportInterval;
+
+	FDelegateHandle PreActorTickHandle;
+
+	FDelegateHandle PostActorTickHandle;
+
+	FDelegateHandle ReportHandle;
+
+	FDelegateHandle MemoryHandle;
+
+// ------- FUNCTIONS ------- \\
+
+	UWorld* StartMatch(int32 MatchIndex, const FString& ArenaPackage, const FString& GameModePath, int32 Port);
+
+	void OnWorldPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	bool ReportStats(float DeltaTime);
+
+	/* Counts the next few objects, every frame */
+	bool CountMemory(float DeltaTime);
+
+	/* Objects in the world's own packages, shared assets aren't part of it */
+	void GetWorldObjects(UWorld* World, TArray<TWeakObjectPtr<UObject>>& OutObjects) const;
+};
@@ -0,0 +1,200 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "UObject/ObjectKey.h"
+
+class AActor;
+class UWorld;
+
+
+// What gameplay memory is for, each one its own LLM tag
+enum class ECoopMemCategory : uint8
+{
+	Bots,
+
+	Weapons,
+
+	// Particle system components of one-shot effects
+	FX,
+
+	NavPaths,
+
+	// Pickups and the powerups they spawn
+	Pickups,
+
+	Count
+};
+
+
+// What a tracked object is, so that eg. the material instances of bots show apart from their components
+enum class ECoopMemKind : uint8
+{
+	Actor,
+
+	Component,
+
+	Material,
+
+	// Counted from the primitive components that have one, not tracked themselves
+	PhysicsBody,
+
+	Object,
+
+	Count
+};
+
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+// Attributes the allocations of the enclosing scope to a category in LLM captures (-LLM)
+#define COOP_LLM_SCOPE(Category) LLM_SCOPE(FSMemoryTracker::GetLLMTag(Category))
+#else
+#define COOP_LLM_SCOPE(Category)
+#endif
+
+
+struct FSMemoryUsage
+{
+	int32 Live;
+
+	int64 Bytes;
+
+	int32 PeakLive;
+
+	int64 PeakBytes;
+
+	FSMemoryUsage()
+		: Live(0)
+		, Bytes(0)
+		, PeakLive(0)
+		, PeakBytes(0)
+	{
+	}
+};
+
+
+/**
+ * Live counts and sizes of the objects gameplay creates over and over (bots, weapons, effects, nav paths, pickups),
+ * per wave, to find what keeps growing in long sessions.
+ *
+ * The places that create them register the objects (TrackActor, TrackObject) and allocate inside COOP_LLM_SCOPE, so
+ * the same categories show as CoopGame tags in LLM captures. The tracked objects are sampled once a second: sizes
+ * are the UObject itself plus what it reports as its own resources, a physics body counts as an FBodyInstance.
+ *
+ * Waves are kept per world, so matches side by side (-CoopMatches, PIE with several clients) don't interleave. Every
+ * wave start on the server closes the world's previous wave with what of it was live at its end and the peak during
+ * it, next to the used physical memory of the process. COOP.MemReport logs them (also logged on exit). With -MemSoak
+ * (or COOP.MemSoakWaves) anything that never shrank and grew in at least half of the last 50 waves of a world is
+ * logged as a warning. Game thread only.
+ */
+class COOPGAME_API FSMemoryTracker
+{
+public:
+
+	static FSMemoryTracker& Get();
+
+	static const TCHAR* GetCategoryName(ECoopMemCategory Category);
+
+	static const TCHAR* GetKindName(ECoopMemKind Kind);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	static FORCEINLINE ELLMTag GetLLMTag(ECoopMemCategory Category)
+	{
+		return (ELLMTag)((int32)ELLMTag::ProjectTagStart + (int32)Category);
+	}
+#endif
+
+	/* Registers the LLM tags and starts sampling, called when the module starts */
+	void Initialize();
+
+	void Shutdown();
+
+	/* The actor and the components it has right now */
+	void TrackActor(AActor* Actor, ECoopMemCategory Category);
+
+	/* Null is ignored, so it can wrap the call that creates the object */
+	void TrackObject(UObject* Object, ECoopMemCategory Category, ECoopMemKind Kind);
+
+	/* Closes the world's current wave, called by the authority's game state */
+	void BeginWave(const UWorld* World);
+
+	const FSMemoryUsage& GetUsage(ECoopMemCategory Category, ECoopMemKind Kind) const;
+
+	void LogReport() const;
+
+private:
+
+	struct FTrackedObject
+	{
+		TWeakObjectPtr<UObject> Object;
+
+		// World it was created in
+		FObjectKey World;
+
+		ECoopMemCategory Category;
+
+		ECoopMemKind Kind;
+	};
+
+	// What was live when a wave ended and the peaks during it
+	struct FWaveMemory
+	{
+		FSMemoryUsage Usage[(int32)ECoopMemCategory::Count][(int32)ECoopMemKind::Count];
+
+		uint64 UsedPhysical;
+
+		uint64 PeakUsedPhysical;
+	};
+
+	struct FWorldMemory
+	{
+		FString WorldName;
+
+		// Objects of this world as of the last sample, peaks since its current wave started
+		FSMemoryUsage Current[(int32)ECoopMemCategory::Count][(int32)ECoopMemKind::Count];
+
+		uint64 PeakUsedPhysical;
+
+		// Index is the wave, 0 is before the first one
+		TArray<FWaveMemory> Waves;
+
+		// Rows the soak test flagged already, one bit per kind
+		uint32 FlaggedGrowth[(int32)ECoopMemCategory::Count];
+
+		bool bFlaggedProcessGrowth;
+
+		FWorldMemory()
+			: PeakUsedPhysical(0)
+			, bFlaggedProcessGrowth(false)
+		{
+			FMemory::Memzero(FlaggedGrowth);
+		}
+	};
+
+	TArray<FTrackedObject> Tracked;
+
+	// Every tracked object as of the last sample, peaks since the start
+	FSMemoryUsage Current[(int32)ECoopMemCategory::Count][(int32)ECoopMemKind::Count];
+
+	uint64 UsedPhysical;
+
+	uint64 PeakUsedPhysical;
+
+	// Kept after the world is gone for the report
+	TMap<FObjectKey, FWorldMemory> Worlds;
+
+	FDelegateHandle SampleHandle;
+
+	FSMemoryTracker();
+
+	bool Sample(float DeltaTime);
+
+	FWorldMemory& FindOrAddWorld(const FObjectKey& WorldKey);
+
+	void CheckForGrowth(FWorldMemory& World, int32 NrOfWaves);
+
+	static int64 GetObjectBytes(UObject* Object);
+};
@@ -0,0 +1,209 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+class FSocket;
+
+
+/**
+ * Histogram in fixed memory with the precision of HdrHistogram: values up to SubBucketCount are exact, above that
+ * every power of two is split into SubBucketCount buckets, so anything recorded is within about 3% of its value.
+ * Values are whole units (eg. microseconds), anything past the last bucket counts as the largest value.
+ */
+class COOPGAME_API FSHdrHistogram
+{
+public:
+
+	static const int32 SubBucketBits = 5;
+
+	static const int32 SubBucketCount = 1 << SubBucketBits;
+
+	// Up to 2^27 units, over two minutes in microseconds
+	static const int32 NrOfShifts = 22;
+
+	static const int32 NrOfBuckets = (NrOfShifts + 1) * SubBucketCount;
+
+	FSHdrHistogram();
+
+	void Record(uint64 Value);
+
+	void Reset();
+
+	/* Highest value the given share of the recorded values is at or below, Percentile in 0..100 */
+	uint64 GetValueAtPercentile(double Percentile) const;
+
+	uint64 GetCount() const { return TotalCount; }
+
+	uint64 GetSum() const { return Sum; }
+
+	uint64 GetMax() const { return Max; }
+
+private:
+
+	static int32 GetBucketIndex(uint64 Value);
+
+	// Highest value that lands in the bucket
+	static uint64 GetBucketValue(int32 Index);
+
+	uint32 Counts[NrOfBuckets];
+
+	uint64 TotalCount;
+
+	uint64 Sum;
+
+	uint64 Max;
+};
+
+
+// Current values the metrics report as they are, summed over the matches of the process
+enum class ECoopGauge : uint8
+{
+	// Highest wave any match is in
+	Wave,
+
+	Matches,
+
+	BotsAlive,
+
+	Players,
+
+	Connections,
+
+	InBytesPerSecond,
+
+	OutBytesPerSecond,
+
+	InPacketsLostPerSecond,
+
+	OutPacketsLostPerSecond,
+
+	Count
+};
+
+
+// Events counted since start
+enum class ECoopCounter : uint8
+{
+	WavesStarted,
+
+	GamesOver,
+
+	Scrapes,
+
+	Count
+};
+
+
+// Distributions the metrics report as quantiles
+enum class ECoopHistogram : uint8
+{
+	// Start of one frame to the start of the next
+	FrameTime,
+
+	// Work of the game thread in a frame, without the tick rate sleep (FSFramePerf::GameThreadMs)
+	GameThreadTime,
+
+	Count
+};
+
+
+/**
+ * Health of a running server for operations, in Prometheus text format: frame and game thread time as histograms,
+ * wave, bots, players, bandwidth and packet loss as gauges, waves and games over as counters. Everything lives in
+ * fixed memory.
+ *
+ * Quantiles are over the last complete window (COOP.MetricsWindow seconds), sums and counts since start. Gauges are
+ * sampled once a second from every game world of the process (see USMatchHost).
+ *
+ * -MetricsPort=N answers HTTP scrapes (any path) on 127.0.0.1:N, -MetricsFile[=Path] rewrites the text every
+ * COOP.MetricsFileInterval seconds to Path or Saved/Metrics/CoopGame-<pid>.prom, replacing it in one move so a
+ * reader never sees half of it. COOP.Metrics logs the same text. Game thread only.
+ */
+class COOPGAME_API FSMetrics
+{
+public:
+
+	static FSMetrics& Get();
+
+	/* Reads the command line and starts recording, called when the module starts */
+	void Initialize();
+
+	void Shutdown();
+
+	void AddCount(ECoopCounter Counter, uint64 Amount = 1);
+
+	/* The metrics in Prometheus text format */
+	FString Export() const;
+
+private:
+
+	// Scrape connection waiting for its request to arrive
+	struct FPendingScrape
+	{
+		FSocket* Socket;
+
+		double AcceptTime;
+
+		// Last four bytes of the request, to see where its headers end
+		uint32 RequestTail;
+
+		FPendingScrape()
+			: Socket(nullptr)
+			, AcceptTime(0.0)
+			, RequestTail(0)
+		{
+		}
+	};
+
+	static const int32 MaxPendingScrapes = 4;
+
+	double Gauges[(int32)ECoopGauge::Count];
+
+	uint64 Counters[(int32)ECoopCounter::Count];
+
+	FSHdrHistogram Lifetime[(int32)ECoopHistogram::Count];
+
+	// Current window and the last complete one, which the quantiles come from
+	FSHdrHistogram Window[(int32)ECoopHistogram::Count];
+
+	FSHdrHistogram LastWindow[(int32)ECoopHistogram::Count];
+
+	double StartTime;
+
+	double WindowStartTime;
+
+	double LastSampleTime;
+
+	double LastFileTime;
+
+	FString FilePath;
+
+	FSocket* ListenSocket;
+
+	FPendingScrape PendingScrapes[MaxPendingScrapes];
+
+	FDelegateHandle EndFrameHandle;
+
+	FDelegateHandle TickHandle;
+
+	FSMetrics();
+
+	void EndFrame();
+
+	bool Tick(float DeltaTime);
+
+	void SampleWorlds();
+
+	void WriteFile() const;
+
+	bool OpenEndpoint(int32 Port);
+
+	void CloseEndpoint();
+
+	void ServeScrapes();
+
+	void CloseScrape(FPendingScrape& Scrape);
+};
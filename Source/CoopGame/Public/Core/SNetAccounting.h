@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class AActor;
+class UActorChannel;
+class UFunction;
+class UNetConnection;
+class UProperty;
+class UWorld;
+
+
+// Payload sent or received for one entry of a table
+struct FSNetCounter
+{
+	int64 Bits;
+
+	int32 NrOfBunches;
+
+	FSNetCounter()
+		: Bits(0)
+		, NrOfBunches(0)
+	{
+	}
+};
+
+
+/**
+ * Attributes the game's network traffic to actor classes, replicated properties, RPCs and connections, per match
+ * world and wave, so matches running side by side (-CoopMatches) keep their own tables.
+ *
+ * USActorChannel (the actor channel of every net driver, see DefaultEngine.ini) reports the size of every bunch it
+ * sends or receives. Bunches sent during the net flush carry property updates, their bits are split between the
+ * replicated properties of the actor and its components that changed since its previous update, weighted by size.
+ * That is an estimate where a connection that was skipped for a while gets several changes in one update. Bunches
+ * sent outside of it are RPCs, named when they were called on one of our actors or the player controller (see
+ * FRpcScope) and per class otherwise. Only bunch payload is counted, packet headers and acks are not.
+ *
+ * Off unless COOP.NetAccounting is 1 or the game runs with -NetAccounting, eg. in headless loopback tests.
+ * COOP.NetReport logs the tables, 'COOP.NetReport file' writes them as CSV to Saved/NetAccounting, which also
+ * happens for finished matches when the next one begins and on exit. Game thread only.
+ */
+class COOPGAME_API FSNetAccounting
+{
+public:
+
+	/* Names the RPC bunches sent while it is on the stack belong to */
+	class COOPGAME_API FRpcScope
+	{
+	public:
+
+		FRpcScope(const UFunction* Function);
+
+		~FRpcScope();
+
+	private:
+
+		FName PreviousRpc;
+	};
+
+	static FSNetAccounting& Get();
+
+	/* Picks up -NetAccounting, called when the module starts */
+	void Initialize();
+
+	/* Writes what was counted, called when the module shuts down */
+	void Shutdown();
+
+	bool IsEnabled() const;
+
+	/* Writes matches whose world is gone and counts the world from "before the first wave" again */
+	void BeginMatch(const UWorld* World);
+
+	void BeginWave(const UWorld* World);
+
+	void RecordOutgoing(UActorChannel* Channel, int64 NumBits, bool bOpen);
+
+	void RecordIncoming(UActorChannel* Channel, int64 NumBits);
+
+	void LogReport() const;
+
+	/* CSV of every table of every wave of every match, returns the file or an empty string */
+	FString WriteReport() const;
+
+	void Reset();
+
+private:
+
+	struct FWaveStats
+	{
+		TMap<FName, FSNetCounter> ClassesOut;
+
+		TMap<FName, FSNetCounter> ClassesIn;
+
+		TMap<FName, FSNetCounter> Properties;
+
+		TMap<FName, FSNetCounter> Rpcs;
+
+		TMap<FString, FSNetCounter> ConnectionsOut;
+
+		TMap<FString, FSNetCounter> ConnectionsIn;
+	};
+
+	struct FMatchStats
+	{
+		FString WorldName;
+
+		// Index is the wave, 0 is before the first one
+		TArray<FWaveStats> Waves;
+	};
+
+	// Last value we saw of a replicated property, to tell which ones an update carries
+	struct FTrackedProperty
+	{
+		TWeakObjectPtr<UObject> Object;
+
+		const UProperty* Property;
+
+		FName Label;
+
+		FString LastValue;
+	};
+
+	struct FActorShadow
+	{
+		TArray<FTrackedProperty> Properties;
+
+		int32 NrOfReplicatedComponents;
+
+		// Indices into Properties of the ones that changed in LastDiffFrame
+		TArray<int32> Changed;
+
+		uint64 LastDiffFrame;
+
+		FActorShadow()
+			: NrOfReplicatedComponents(INDEX_NONE)
+			, LastDiffFrame(MAX_uint64)
+		{
+		}
+	};
+
+	// Keyed by world, kept until the next match begins after the world is gone
+	TMap<FObjectKey, FMatchStats> Matches;
+
+	TMap<FObjectKey, FActorShadow> ActorShadows;
+
+	FName CurrentRpc;
+
+	uint64 LastPruneFrame;
+
+	FSNetAccounting();
+
+	FMatchStats& FindOrAddMatch(const UWorld* World);
+
+	FWaveStats& GetCurrentWave(const UWorld* World);
+
+	static FString WriteMatches(const TArray<const FMatchStats*>& MatchesToWrite);
+
+	void AttributeToProperties(FWaveStats& Wave, AActor* Actor, int64 NumBits, bool bOpen);
+
+	void BuildShadow(AActor* Actor, FActorShadow& Shadow) const;
+
+	void DiffShadow(FActorShadow& Shadow) const;
+
+	void PruneShadows();
+
+	static FString GetConnectionName(UNetConnection* Connection);
+
+	static FString ExportValue(const FTrackedProperty& Tracked);
+
+	static int32 EstimateBits(const FTrackedProperty& Tracked);
+};
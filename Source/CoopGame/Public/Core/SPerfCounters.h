@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+
+// Gameplay areas we keep our own game thread timings for
+enum class ECoopSubsystem : uint8
+{
+	Weapons,
+	TrackerBots,
+	Health,
+	GameMode,
+	Pickups,
+	Spawning,
+	StatusEffects,
+
+	// Net flush after the actor tick, mostly property comparison and sending on the server
+	Replication,
+
+	Count
+};
+
+
+// Timings of a single frame
+struct FSFramePerf
+{
+	// Start of one frame to the start of the next
+	float FrameMs;
+
+	// Start to end of the game thread frame minus the time it slept for the tick rate limit (FApp::GetIdleTime)
+	float GameThreadMs;
+
+	float SubsystemMs[(int32)ECoopSubsystem::Count];
+};
+
+
+/**
+ * Cheap, always-on game thread timings per gameplay subsystem.
+ * Gameplay code wraps its hot paths in COOP_SCOPE_TIME, the module rolls the counters over at the end of every frame
+ * and keeps the last HistorySize frames. COOP.CostTable logs them per subsystem, which works on a headless server
+ * where 'stat' has nothing to draw on. Game thread only.
+ */
+class COOPGAME_API FSPerfCounters
+{
+public:
+
+	static const int32 HistorySize = 600;
+
+	static FSPerfCounters& Get();
+
+	static const TCHAR* GetSubsystemName(ECoopSubsystem Subsystem);
+
+	void BeginFrame();
+
+	void EndFrame();
+
+	/* Brackets the net flush of a world, from the end of its actor tick to its PostTickFlush event */
+	void BeginReplication();
+
+	void EndReplication();
+
+	/* Whether a world is flushing its net drivers right now */
+	FORCEINLINE bool IsReplicating() const
+	{
+		return ReplicationStartCycles != 0;
+	}
+
+	FORCEINLINE void AddCycles(ECoopSubsystem Subsystem, uint32 Cycles)
+	{
+		CurrentCycles[(int32)Subsystem] += Cycles;
+	}
+
+	/* Frame that finished most recently */
+	const FSFramePerf& GetLastFrame() const;
+
+	/* Up to HistorySize frames, oldest first */
+	void GetHistory(TArray<FSFramePerf>& OutFrames, int32 MaxFrames = HistorySize) const;
+
+	uint64 GetFrameCounter() const;
+
+	/* Average, 95th percentile and worst time per subsystem over the last frames */
+	void LogCostTable(int32 MaxFrames) const;
+
+private:
+
+	FSFramePerf History[HistorySize];
+
+	// Next slot in History to write
+	int32 HistoryHead;
+
+	int32 HistoryNum;
+
+	uint64 FrameCounter;
+
+	uint32 CurrentCycles[(int32)ECoopSubsystem::Count];
+
+	// 0 while no world is flushing
+	uint32 ReplicationStartCycles;
+
+	double FrameStartTime;
+
+	double PreviousFrameStartTime;
+
+	FSPerfCounters();
+};
+
+
+// Adds the cycles spent in the enclosing scope to a subsystem
+class FSScopedPerfCounter
+{
+public:
+
+	FORCEINLINE explicit FSScopedPerfCounter(ECoopSubsystem InSubsystem)
+		: Subsystem(InSubsystem)
+		, StartCycles(FPlatformTime::Cycles())
+	{
+	}
+
+	FORCEINLINE ~FSScopedPerfCounter()
+	{
+		FSPerfCounters::Get().AddCycles(Subsystem, FPlatformTime::Cycles() - StartCycles);
+	}
+
+private:
+
+	ECoopSubsystem Subsystem;
+
+	uint32 StartCycles;
+};
+
+#define COOP_SCOPE_TIME(Subsystem) FSScopedPerfCounter ANONYMOUS_VARIABLE(CoopScopeTime)(ECoopSubsystem::Subsystem)
+
+
+// ------- NAMED STATS ------- \\
+
+// Finer grained than the subsystems, shown by 'stat CoopGame' and recorded by 'csvprofile start'. Hot paths add
+// COOP_SCOPE_STAT next to (or nested in) their COOP_SCOPE_TIME, and COOP_COUNT what they did how often.
+
+DECLARE_STATS_GROUP(TEXT("CoopGame"), STATGROUP_CoopGame, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Weapon Fire"), STAT_CoopWeaponFire, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TrackerBot Tick"), STAT_CoopTrackerBotTick, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TrackerBot Path"), STAT_CoopTrackerBotPath, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TrackerBot Nearby Bots"), STAT_CoopTrackerBotNearbyBots, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TrackerBot Self Destruct"), STAT_CoopTrackerBotSelfDestruct, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Health Damage"), STAT_CoopHealthDamage, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GameMode Wave State"), STAT_CoopGameModeWaveState, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GameMode Players Alive"), STAT_CoopGameModePlayersAlive, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pickup Respawn"), STAT_CoopPickupRespawn, STATGROUP_CoopGame, COOPGAME_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Shots Fired"), STAT_CoopShotsFired, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Path Queries"), STAT_CoopPathQueries, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Nearby Bot Overlaps"), STAT_CoopNearbyBotOverlaps, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Self Destructs"), STAT_CoopSelfDestructs, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Damage Events"), STAT_CoopDamageEvents, STATGROUP_CoopGame, COOPGAME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pickup Respawns"), STAT_CoopPickupRespawns, STATGROUP_CoopGame, COOPGAME_API);
+
+// Timings of the named stats and the subsystems
+CSV_DECLARE_CATEGORY_EXTERN(CoopGame);
+
+// Per frame totals of the counters
+CSV_DECLARE_CATEGORY_EXTERN(CoopGameCounts);
+
+#define COOP_SCOPE_STAT(Stat) \
+	SCOPE_CYCLE_COUNTER(STAT_Coop##Stat); \
+	CSV_SCOPED_TIMING_STAT(CoopGame, Stat)
+
+#define COOP_COUNT(Stat, Amount) \
+	INC_DWORD_STAT_BY(STAT_Coop##Stat, Amount); \
+	CSV_CUSTOM_STAT(CoopGameCounts, Stat, (int32)(Amount), ECsvCustomStatOp::Accumulate)
@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+class FSocket;
+class FInternetAddr;
+
+
+// Round trips measured to one host
+struct FSPingProbeResult
+{
+	int32 NrOfSent;
+
+	int32 NrOfReceived;
+
+	float MeanRttMs;
+
+	// Mean difference between consecutive round trips
+	float JitterMs;
+
+	FSPingProbeResult()
+		: NrOfSent(0)
+		, NrOfReceived(0)
+		, MeanRttMs(0.0f)
+		, JitterMs(0.0f)
+	{
+	}
+
+	float GetLoss() const
+	{
+		return NrOfSent > 0 ? 1.0f - (float)NrOfReceived / NrOfSent : 0.0f;
+	}
+};
+
+
+/**
+ * Echoes probe packets on a UDP port of its own, so clients can measure their round trip to a host before joining.
+ * Only answers packets that look like probes and never with more bytes than it got.
+ * COOP.PingResponderLag and COOP.PingResponderLagVariance hold replies back to emulate latency on loopback.
+ */
+class COOPGAME_API FSPingResponder
+{
+public:
+
+	FSPingResponder();
+
+	~FSPingResponder();
+
+	/* Binds the port (0 picks a free one) and starts answering. Returns the bound port, 0 on failure */
+	int32 Start(int32 Port);
+
+	void Stop();
+
+	int32 GetPort() const;
+
+private:
+
+	struct FDelayedReply
+	{
+		TArray<uint8> Packet;
+
+		TSharedPtr<FInternetAddr> Destination;
+
+		double SendTime;
+	};
+
+	FSocket* Socket;
+
+	int32 BoundPort;
+
+	TArray<FDelayedReply> DelayedReplies;
+
+	FDelegateHandle TickHandle;
+
+	bool Tick(float DeltaTime);
+};
+
+
+/**
+ * Pings a set of hosts running FSPingResponder, all of them in parallel from a single socket.
+ * Sends NrOfProbes rounds ProbeInterval apart and reports once every probe was answered or timed out.
+ * Sockets are polled every frame, so round trips include up to a frame of polling delay; it is the same for
+ * every host, so the ranking holds.
+ */
+class COOPGAME_API FSPingProber
+{
+public:
+
+	DECLARE_DELEGATE_OneParam(FOnProbesFinished, const TArray<FSPingProbeResult>& /* Results, in the order of the targets */);
+
+	FSPingProber();
+
+	~FSPingProber();
+
+	/* Returns false if nothing could be sent, OnFinished isn't called then */
+	bool Start(const TArray<TSharedPtr<FInternetAddr>>& InTargets, int32 InNrOfProbes, float InProbeInterval, float InTimeout, FOnProbesFinished InOnFinished);
+
+	void Cancel();
+
+	bool IsRunning() const;
+
+private:
+
+	FSocket* Socket;
+
+	TArray<TSharedPtr<FInternetAddr>> Targets;
+
+	// Per target, per probe, negative until answered
+	TArray<TArray<float>> RttMs;
+
+	TArray<double> RoundSendTimes;
+
+	int32 NrOfProbes;
+
+	float ProbeInterval;
+
+	float Timeout;
+
+	// Tells our replies apart from late ones of an earlier run
+	uint32 Nonce;
+
+	FOnProbesFinished OnFinished;
+
+	FDelegateHandle TickHandle;
+
+	bool Tick(float DeltaTime);
+
+	void SendRound();
+
+	void ReceiveReplies();
+
+	bool HasAllReplies() const;
+
+	void Finish();
+
+	void CloseSocket();
+};
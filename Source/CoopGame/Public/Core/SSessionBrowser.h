@@ -0,0 +1,260 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "OnlineSessionSettings.h"
+#include "Containers/Ticker.h"
+#include "SPingProbe.h"
+#include "SSessionBrowser.generated.h"
+
+
+UENUM(BlueprintType)
+enum class ESessionSortKey : uint8
+{
+	// Lowest score first, the session JoinOnlineGame picks
+	Best,
+
+	Ping,
+
+	// Most players first
+	Players,
+
+	Name,
+};
+
+
+// A session as the browser last saw it, plus what it saw over the last refreshes
+USTRUCT(BlueprintType)
+struct FSSessionBrowserEntry
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	FString SessionId;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	FString OwningUserName;
+
+	/* Latest ping, already bucketed by the online subsystem */
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	int32 PingMs;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	float AveragePingMs;
+
+	/* Round trip we measured ourselves in the last probe, negative if the host wasn't probed or never answered */
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	float MeasuredRttMs;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	float JitterMs;
+
+	/* Fraction of the probes that got no answer, 0 if none could be sent */
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	float ProbeLoss;
+
+	/* Round trip plus penalties for jitter, loss and load, in milliseconds. Lower is better */
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	float Score;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	int32 NumPlayers;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	int32 MaxPlayers;
+
+	/* Oldest sample first, at most HistoryLength of them */
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	TArray<int32> PingHistory;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	TArray<int32> PlayerHistory;
+
+	/* Seconds since the session last showed up in a search */
+	UPROPERTY(BlueprintReadOnly, Category = "Sessions")
+	float SecondsSinceSeen;
+
+	FSSessionBrowserEntry()
+		: PingMs(0)
+		, AveragePingMs(0.0f)
+		, MeasuredRttMs(-1.0f)
+		, JitterMs(0.0f)
+		, ProbeLoss(0.0f)
+		, Score(0.0f)
+		, NumPlayers(0)
+		, MaxPlayers(0)
+		, SecondsSinceSeen(0.0f)
+	{
+	}
+};
+
+
+USTRUCT(BlueprintType)
+struct FSSessionFilter
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sessions")
+	bool bHideFull;
+
+	/* 0 shows every ping */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sessions", meta = (ClampMin = 0))
+	int32 MaxPingMs;
+
+	/* Only sessions whose owner name contains this */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sessions")
+	FString NameContains;
+
+	FSSessionFilter()
+		: bHideFull(true)
+		, MaxPingMs(0)
+	{
+	}
+};
+
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnSessionsUpdated);
+
+
+/* Session setting with the port of the host's ping responder */
+#define SETTING_COOP_PROBEPORT FName(TEXT("COOPPROBEPORT"))
+
+
+/**
+ * Keeps a list of joinable sessions up to date in the background.
+ *
+ * Searches run every RefreshInterval seconds, one at a time, and are merged into the cached list instead of
+ * replacing it: sessions found again keep their ping and player count history, sessions missing from
+ * DropAfterMissedRefreshes searches in a row are dropped. UI reads the cache (sorted and filtered on request)
+ * and never waits for a search. Works with any online subsystem, run with -nosteam to browse LAN sessions of
+ * the Null subsystem locally and COOP.Sessions to print the list.
+ *
+ * ProbeSessions pings the ping responders of all candidate hosts in parallel and ranks the sessions by measured
+ * round trip, jitter, loss and load, so joins go to the host that will actually play best.
+ */
+UCLASS()
+class COOPGAME_API USSessionBrowser : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	USSessionBrowser();
+
+	/* Searches right away and then keeps refreshing until Stop */
+	void Start(TSharedPtr<const FUniqueNetId> InUserId, bool bInIsLAN, bool bInIsPresence);
+
+	/* Stops refreshing, the cached sessions stay */
+	void Stop();
+
+	/* Starts a search unless one is already running */
+	void Refresh();
+
+	bool IsRefreshing() const;
+
+	UFUNCTION(BlueprintCallable, Category = "Sessions")
+	void GetSessions(const FSSessionFilter& Filter, ESessionSortKey SortKey, TArray<FSSessionBrowserEntry>& OutSessions) const;
+
+	/* Search result to join a cached session with */
+	bool FindSearchResult(const FString& SessionId, FOnlineSessionSearchResult& OutResult) const;
+
+	void LogSessions() const;
+
+	/* Pings every joinable session's host at once, OnFinished fires when the measurements are in the cache */
+	void ProbeSessions(FSimpleDelegate OnFinished);
+
+	bool IsProbing() const;
+
+	/* Fired on the game thread after every search was merged */
+	UPROPERTY(BlueprintAssignable, Category = "Sessions")
+	FOnSessionsUpdated OnSessionsUpdated;
+
+protected:
+
+	struct FCachedSession
+	{
+		FSSessionBrowserEntry Entry;
+
+		FOnlineSessionSearchResult Result;
+
+		double LastSeenTime;
+
+		int32 NrOfMissedRefreshes;
+	};
+
+// ------- VARIABLES ------- \\
+
+	float RefreshInterval;
+
+	int32 MaxSearchResults;
+
+	int32 PingBucketSize;
+
+	int32 HistoryLength;
+
+	int32 DropAfterMissedRefreshes;
+
+	int32 NrOfProbes;
+
+	float ProbeInterval;
+
+	float ProbeTimeout;
+
+	/* Score penalties, in milliseconds of round trip they are worth */
+	float JitterWeight;
+
+	float LossPenaltyMs;
+
+	float FullServerPenaltyMs;
+
+	// Hosts we couldn't probe are ranked by the bucketed ping of the search, which is less to go by
+	float UnprobedPenaltyMs;
+
+	TSharedPtr<const FUniqueNetId> UserId;
+
+	bool bIsLAN;
+
+	bool bIsPresence;
+
+	TArray<FCachedSession> CachedSessions;
+
+	// Search in flight, a new one is made per search since the online subsystem fills it asynchronously
+	TSharedPtr<FOnlineSessionSearch> SessionSearch;
+
+	double SearchStartTime;
+
+	FDelegateHandle OnFindSessionsCompleteDelegateHandle;
+
+	FDelegateHandle RefreshHandle;
+
+	FSPingProber Prober;
+
+	// Sessions being probed, in the order of the prober's targets
+	TArray<FString> ProbedSessionIds;
+
+	FSimpleDelegate OnProbesFinished;
+
+// ------- FUNCTIONS ------- \\
+
+	bool OnRefreshTimer(float DeltaTime);
+
+	void OnFindSessionsComplete(bool bWasSuccessful);
+
+	void MergeResults(const TArray<FOnlineSessionSearchResult>& Results);
+
+	void AddSample(TArray<int32>& History, int32 Sample) const;
+
+	TSharedPtr<FInternetAddr> GetProbeAddress(const FOnlineSessionSearchResult& Result) const;
+
+	void OnProbed(const TArray<FSPingProbeResult>& Results);
+
+	float GetScore(const FSSessionBrowserEntry& Entry) const;
+
+	virtual void BeginDestroy() override;
+};
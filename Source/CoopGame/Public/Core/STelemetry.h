@@ -0,0 +1,210 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Templates/Atomic.h"
+
+
+// Never reorder, recorded files store the raw value
+enum class ECoopTelemetryEvent : uint8
+{
+	// Written by the writer thread, Extra holds how many events were lost since the previous one
+	Dropped,
+	// Value holds the shot length, Extra the EPhysicalSurface hit
+	Shot,
+	// Value holds the damage, Extra the health left
+	Damage,
+	Kill,
+	// Value holds the wave number, Extra the new EWaveState
+	WaveState,
+	// Value holds the load pressure, Extra the new throttle level of the load governor
+	Governor,
+	// Value holds the position error of a corrected client move, Extra the pawn's corrections so far
+	Correction,
+
+	Count
+};
+
+
+// Fixed size, so recording is a single copy into the ring buffer
+struct FSTelemetryEvent
+{
+	uint64 Cycles;
+
+	uint32 Frame;
+
+	ECoopTelemetryEvent Type;
+
+	uint8 Padding[3];
+
+	// UObject unique ids, 0 when there is none
+	uint32 SourceId;
+
+	uint32 TargetId;
+
+	float Value;
+
+	int32 Extra;
+};
+
+static_assert(sizeof(FSTelemetryEvent) == 32, "Telemetry files store FSTelemetryEvent as is");
+
+
+/**
+ * Bounded lock-free ring buffer, any number of producers and a single consumer.
+ * Every slot carries a sequence number that tells producers and the consumer whose turn it is, so a push is
+ * one compare-exchange and a copy. A full buffer rejects the event instead of waiting.
+ */
+class COOPGAME_API FSTelemetryRing
+{
+public:
+
+	explicit FSTelemetryRing(uint32 CapacityPow2);
+
+	FORCEINLINE bool Push(const FSTelemetryEvent& Event)
+	{
+		uint32 Pos = EnqueuePos.Load();
+		for (;;)
+		{
+			FSlot& Slot = Slots[Pos & Mask];
+			const int32 Diff = (int32)(Slot.Sequence.Load() - Pos);
+			if (Diff == 0)
+			{
+				if (EnqueuePos.CompareExchange(Pos, Pos + 1))
+				{
+					Slot.Event = Event;
+					Slot.Sequence.Store(Pos + 1);
+					return true;
+				}
+				// CompareExchange updated Pos, retry with the new position
+			}
+			else if (Diff < 0)
+			{
+				// Consumer hasn't freed this slot yet, the buffer is full
+				return false;
+			}
+			else
+			{
+				Pos = EnqueuePos.Load();
+			}
+		}
+	}
+
+	/* Consumer only */
+	bool Pop(FSTelemetryEvent& OutEvent);
+
+private:
+
+	struct FSlot
+	{
+		TAtomic<uint32> Sequence;
+
+		FSTelemetryEvent Event;
+	};
+
+	TUniquePtr<FSlot[]> Slots;
+
+	uint32 Mask;
+
+	// Producers and consumer on separate cache lines
+	alignas(PLATFORM_CACHE_LINE_SIZE) TAtomic<uint32> EnqueuePos;
+
+	alignas(PLATFORM_CACHE_LINE_SIZE) uint32 DequeuePos;
+};
+
+
+/**
+ * Structured gameplay telemetry (shots, damage, kills, wave transitions).
+ * Recording copies a fixed size event into a lock-free ring buffer, a background thread drains it into zlib compressed
+ * blocks in rotating files under Saved/Telemetry. Events that don't fit in the buffer are counted and dropped.
+ * Decode the files with -run=STelemetryDecode.
+ *
+ * On by default on dedicated servers, -CoopTelemetry turns it on elsewhere and -NoCoopTelemetry turns it off.
+ */
+class COOPGAME_API FSTelemetry
+{
+public:
+
+	// File layout: FileHeader, then blocks of [uint32 UncompressedSize][uint32 CompressedSize][zlib data]
+	static const uint32 FileMagic = 0x4D4C5443; // "CTLM"
+
+	static const uint32 FileVersion = 1;
+
+	struct FFileHeader
+	{
+		uint32 Magic;
+
+		uint32 Version;
+
+		uint32 EventSize;
+
+		uint32 Padding;
+
+		double SecondsPerCycle;
+	};
+
+	static FSTelemetry& Get();
+
+	static const TCHAR* GetEventName(ECoopTelemetryEvent Type);
+
+	/* Reads the command line and starts the writer thread, called at module startup */
+	void Start();
+
+	/* Flushes what is left and stops the writer thread */
+	void Stop();
+
+	FORCEINLINE bool IsEnabled() const
+	{
+		return bEnabled;
+	}
+
+	FORCEINLINE void Record(ECoopTelemetryEvent Type, const UObject* Source, const UObject* Target, float Value, int32 Extra = 0)
+	{
+		if (!bEnabled)
+		{
+			return;
+		}
+
+		FSTelemetryEvent Event;
+		Event.Cycles = FPlatformTime::Cycles64();
+		Event.Frame = (uint32)GFrameCounter;
+		Event.Type = Type;
+		Event.Padding[0] = Event.Padding[1] = Event.Padding[2] = 0;
+		Event.SourceId = Source ? Source->GetUniqueID() : 0;
+		Event.TargetId = Target ? Target->GetUniqueID() : 0;
+		Event.Value = Value;
+		Event.Extra = Extra;
+
+		if (!Ring.Push(Event))
+		{
+			++NumDropped;
+		}
+	}
+
+	uint32 GetNumDropped() const;
+
+	uint64 GetNumWritten() const;
+
+private:
+
+	friend class FSTelemetryWriter;
+
+	FSTelemetry();
+
+	bool bEnabled;
+
+	FSTelemetryRing Ring;
+
+	TAtomic<uint32> NumDropped;
+
+	TAtomic<uint64> NumWritten;
+
+	class FSTelemetryWriter* Writer;
+
+	class FRunnableThread* WriterThread;
+};
+
+
+#define COOP_TELEMETRY(Type, Source, Target, Value, ...) FSTelemetry::Get().Record(ECoopTelemetryEvent::Type, Source, Target, Value, ##__VA_ARGS__)
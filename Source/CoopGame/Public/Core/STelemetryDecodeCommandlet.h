@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "STelemetryDecodeCommandlet.generated.h"
+
+/**
+ * Offline decoder for the telemetry files written by FSTelemetry.
+ *
+ * UE4Editor-Cmd CoopGame -run=STelemetryDecode -File=<.ctlm file or folder> [-Out=<csv>]
+ *
+ * Writes one csv row per event (next to the input by default) and logs a summary per event type.
+ */
+UCLASS()
+class COOPGAME_API USTelemetryDecodeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	USTelemetryDecodeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+
+	/* Appends the rows of one file, returns false if the file is unreadable */
+	bool DecodeFile(const FString& Path, uint64& BaseCycles, FString& OutCsv, int32* TypeCounts, uint64& OutDropped);
+};
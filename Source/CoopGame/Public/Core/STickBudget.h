@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class AActor;
+class UWorld;
+
+
+// Actors whose ticks the budget manages and counts
+enum class ECoopTickClass : uint8
+{
+	Characters,
+
+	TrackerBots,
+
+	// Keeps the interval it sets itself, only counted
+	GameMode,
+
+	Count
+};
+
+
+/**
+ * Spends actor ticks where players can tell the difference.
+ *
+ * Registered actors are scored every COOP.SignificanceInterval seconds of frame time: pawns a player controls (the
+ * local one on clients, every player's and simulated player's own on the server) always tick every frame, anything
+ * else fades out with the distance to the nearest player view between COOP.SignificanceNear and COOP.SignificanceFar, and counts half on machines that
+ * render but haven't drawn it lately. The score sets the actor tick interval, up to COOP.TickMaxInterval. When the
+ * registered actors would still run more than COOP.TickBudget ticks per frame, the least significant ones drop to
+ * the slowest rate until they fit.
+ *
+ * Actors report their ticks with CountTick, COOP.TickReport logs ticks run and skipped per class (also logged on
+ * exit). COOP.TickSignificance 0 puts every actor back on its own interval to compare against, so does
+ * -CoopDeterministic since the scores depend on what got rendered. Game thread only.
+ */
+class COOPGAME_API FSTickBudget
+{
+public:
+
+	static FSTickBudget& Get();
+
+	static const TCHAR* GetClassName(ECoopTickClass Class);
+
+	void Initialize();
+
+	void Shutdown();
+
+	/* Puts the actor's tick under management until it is destroyed, call from BeginPlay */
+	void Register(AActor* Actor, ECoopTickClass Class);
+
+	/* Call at the top of every managed actor's Tick */
+	void CountTick(ECoopTickClass Class) { NrOfTicks[(int32)Class]++; }
+
+	void ResetCounters();
+
+	void LogReport() const;
+
+private:
+
+	struct FManagedActor
+	{
+		TWeakObjectPtr<AActor> Actor;
+
+		ECoopTickClass Class;
+
+		// Interval the actor came with, restored when management is off
+		float DefaultInterval;
+
+		float Significance;
+
+		float Interval;
+	};
+
+	// Player views of one world, scored against
+	struct FWorldViews
+	{
+		const UWorld* World;
+
+		TArray<FVector, TInlineAllocator<4>> Locations;
+	};
+
+	TArray<FManagedActor> Actors;
+
+	int32 NrOfManaged[(int32)ECoopTickClass::Count];
+
+	// Ticks every managed actor would have run at one per frame
+	uint64 NrOfFrameTicks[(int32)ECoopTickClass::Count];
+
+	uint64 NrOfTicks[(int32)ECoopTickClass::Count];
+
+	int32 NrOfUpdates;
+
+	int32 NrOfUpdatesOverBudget;
+
+	// Actors slowed down by the budget at the last update
+	int32 NrOfBudgeted;
+
+	float AverageFrameSeconds;
+
+	// Frame time summed up since the last update
+	float TimeSinceUpdate;
+
+	FDelegateHandle TickHandle;
+
+	FSTickBudget();
+
+	bool Tick(float DeltaTime);
+
+	void Update();
+
+	void GatherViews(TArray<FWorldViews>& OutViews) const;
+
+	float GetSignificance(const FManagedActor& Managed, const TArray<FWorldViews>& Views) const;
+
+	// Expected ticks per frame of one actor at the interval
+	float GetTicksPerFrame(float Interval) const;
+
+	void ApplyInterval(FManagedActor& Managed, float Interval);
+};
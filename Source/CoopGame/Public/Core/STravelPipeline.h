@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "Containers/Ticker.h"
+#include "Engine/EngineBaseTypes.h"
+#include "STravelPipeline.generated.h"
+
+class UGameInstance;
+class UNetDriver;
+class UPackage;
+class UWorld;
+
+
+/**
+ * Gets players from "host" or "join" into a controllable pawn without blocking on the map load.
+ *
+ * The map package loads in the background while the current map (menu or match) keeps running as the transition,
+ * and the gameplay assets it needs to play (the default pawn's starter weapon) are preloaded next to it. Only then
+ * is the level opened, which finds everything in memory. Clients start loading the map of the session they join
+ * while they connect. Map names are resolved through the asset registry, which is in memory, so nothing here
+ * waits on the disk. Map changes during a session are regular (non-seamless) travels.
+ *
+ * Every phase is logged in milliseconds since the request, up to the frame the local player has a pawn.
+ */
+UCLASS()
+class COOPGAME_API USTravelPipeline : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	USTravelPipeline();
+
+	void Initialize(UGameInstance* InGameInstance);
+
+	void Shutdown();
+
+	/* Starts the clock, phases are logged relative to it */
+	void BeginMeasure(const FString& Reason);
+
+	void MarkPhase(const TCHAR* Phase);
+
+	/* Loads the map in the background and opens it once it is in, Options as for OpenLevel (eg. listen) */
+	void TravelToMap(const FString& MapName, const FString& Options);
+
+	/* Connects to a server right away and preloads the map it runs while the connection is made */
+	void TravelToServer(const FString& TravelURL, const FString& MapName);
+
+protected:
+
+// ------- VARIABLES ------- \\
+
+	UPROPERTY()
+	UGameInstance* GameInstance;
+
+	/* Held from the preload until the engine opened it or the travel failed, so the garbage collection at the start of the
+	   map load doesn't throw it away in between */
+	UPROPERTY()
+	UWorld* PreloadedWorld;
+
+	FString PendingMapName;
+
+	FString PendingOptions;
+
+	// Whether the preload opens the map itself, clients get it opened by the server
+	bool bOpenWhenLoaded;
+
+	/* Give up on the pawn after this many seconds (eg. spectators never get one) */
+	float MeasureTimeout;
+
+	FString MeasureReason;
+
+	double MeasureStartTime;
+
+	bool bMeasuring;
+
+	FDelegateHandle PostLoadMapHandle;
+
+	FDelegateHandle PollHandle;
+
+	FDelegateHandle TravelFailureHandle;
+
+	FDelegateHandle NetworkFailureHandle;
+
+// ------- FUNCTIONS ------- \\
+
+	void PreloadMap(const FString& MapName);
+
+	/* Long package name of the map, or an empty string if the asset registry doesn't know it */
+	FString ResolveMapPackage(const FString& MapName) const;
+
+	void OnMapPackageLoaded(const FName& PackageName, UPackage* Package, EAsyncLoadingResult::Type Result);
+
+	void PreloadGameplayAssets(UWorld* MapWorld);
+
+	void OpenPendingMap();
+
+	void OnPostLoadMap(UWorld* World);
+
+	void OnTravelFailure(UWorld* World, ETravelFailure::Type FailureType, const FString& Error);
+
+	void OnNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& Error);
+
+	bool PollForPawn(float DeltaTime);
+};
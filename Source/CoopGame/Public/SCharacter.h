@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "SDeterminism.h"
 #include "SCharacter.generated.h"
 
 class UCameraComponent;
@@ -11,6 +12,7 @@ class USpringArmComponent;
 class ASWeapon;
 class USHealthComponent;
 class USkeletalMeshComponent;
+class USCharacterMovementComponent;
 
 UCLASS()
 class COOPGAME_API ASCharacter : public ACharacter
@@ -19,7 +21,7 @@ class COOPGAME_API ASCharacter : public ACharacter
 
 public:
 	// Sets default values for this character's properties
-	ASCharacter();
+	ASCharacter(const FObjectInitializer& ObjectInitializer);
 
 protected:
 	// Called when the game starts or when spawned
@@ -45,6 +47,30 @@ protected:
 
 	void EndZoom();
 
+	void BeginJump();
+
+	void BeginSprint();
+
+	void EndSprint();
+
+	/* Input of the current frame, either collected for the recording or read from the replay (see FSDeterminism) */
+	FSInputFrame& GetFrameInput();
+
+	/* Returns the recorded value instead of the live one while replaying */
+	float FilterInputAxis(float& FrameValue, float LiveValue) const;
+
+	void RecordInputButton(uint8 Button, bool bPressed);
+
+	/* Presses and releases the buttons that changed in the replayed frame */
+	void ApplyReplayedButtons();
+
+	FSInputFrame FrameInput;
+
+	int32 FrameInputNumber;
+
+	/* Buttons the replay currently holds down */
+	uint8 ReplayedButtons;
+
 // ------- COMPONENTS ------- \\
 
 	UPROPERTY(VisibleDefaultsOnly, Category = Mesh)
@@ -62,6 +88,9 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 	USHealthComponent* HealthComp;
 
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+	USCharacterMovementComponent* MoveComp;
+
 // ------- VARIABLES ------- \\
 
 //Float
@@ -91,8 +120,9 @@ protected:
 	UPROPERTY(Replicated, BlueprintReadOnly)
 	ASWeapon* CurrentWeapon;
 
+	/* Preloaded by the game state when the match starts */
 	UPROPERTY(EditDefaultsOnly, Category = "Player")
-	TSubclassOf<ASWeapon> StarterWeaponClass;
+	TSoftClassPtr<ASWeapon> StarterWeaponClass;
 
 	UPROPERTY(VisibleDefaultsOnly, Category = "Player")
 	FName WeaponAttachSocketNameFPS;
@@ -122,6 +152,13 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Player")
 	void StopFire();
 
+	ASWeapon* GetCurrentWeapon() const;
+
+	const TSoftClassPtr<ASWeapon>& GetStarterWeaponClass() const;
+
+	/* Names the RPCs it sends for COOP.NetAccounting */
+	virtual bool CallRemoteFunction(UFunction* Function, void* Parameters, struct FOutParmRec* OutParms, FFrame* Stack) override;
+
 // ------- VARIABLES ------- \\
 
 	virtual FVector GetPawnViewLocation() const override;
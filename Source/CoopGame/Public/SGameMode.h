@@ -8,6 +8,10 @@
 
 
 enum class EWaveState : uint8;
+class USWaveDirectorComponent;
+class USSpawnPointCacheComponent;
+class USLoadGovernorComponent;
+class ASSimulatedPlayerController;
 
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnActorKilled, AActor*, VictimActor, AActor*, KillerActor, AController*, KillerController);
@@ -20,9 +24,23 @@ UCLASS()
 class COOPGAME_API ASGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
+
+	// Falls back to the SpawnNewBot hook (SpawnBlueprintBot) for entries without a native bot class
+	friend class USWaveDirectorComponent;
 	
 protected:
 
+// ------- COMPONENTS ------- \\
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+	USWaveDirectorComponent* WaveDirector;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+	USSpawnPointCacheComponent* SpawnPointCache;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+	USLoadGovernorComponent* LoadGovernor;
+
 // ------- VARIABLES ------- \\
 
 //Timer Handles
@@ -33,7 +51,7 @@ protected:
 
 //Int32
 
-	// Bots to spawn in current wave
+	// Bots to spawn in current wave (only used when the wave director has no wave table)
 	int32 NrOfBotsToSpawn;
 
 	UPROPERTY(BlueprintReadOnly, Category = "GameMode")
@@ -43,6 +61,34 @@ protected:
 
 	UPROPERTY(EditDefaultsOnly, Category = "GameMode")
 	float TimeBetweenWaves;
+
+//Simulated Players
+
+	/* Simulated players spawned at start of play, overridden by -SimPlayers=N */
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayers", meta = (ClampMin = 0))
+	int32 NumSimulatedPlayers;
+
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayers")
+	TSubclassOf<ASSimulatedPlayerController> SimulatedPlayerClass;
+
+	/* Base seed of the simulated players, overridden by -SimSeed=N */
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayers")
+	int32 SimulatedPlayerSeed;
+
+	/* Exit once this many waves were completed (or on game over), 0 runs forever. Overridden by -SimWaves=N */
+	UPROPERTY(EditDefaultsOnly, Category = "SimulatedPlayers", meta = (ClampMin = 0))
+	int32 SimulatedMaxWaves;
+
+	UPROPERTY()
+	TArray<ASSimulatedPlayerController*> SimulatedPlayers;
+
+//Bool
+
+	/* Started with -CoopBenchmark, the benchmark runner owns the population and waves don't run */
+	bool bIsBenchmarking;
+
+	/* Set once a player had a pawn, a match nobody joined yet isn't lost */
+	bool bHadPlayer;
 	
 protected:
 
@@ -52,6 +98,9 @@ protected:
 	UFUNCTION(BlueprintImplementableEvent, Category = "GameMode")
 	void SpawnNewBot();
 
+	/* Runs the SpawnNewBot hook and returns the pawn it spawned, if any */
+	APawn* SpawnBlueprintBot();
+
 	void SpawnBotTimerElapsed();
 
 	// Start Spawning Bots
@@ -60,6 +109,9 @@ protected:
 	// Stop Spawning Bots
 	void EndWave();
 
+	// Wave director released every bot of the wave
+	void OnWaveSpawningFinished();
+
 	// Set timer for next startwave
 	void PrepareForNextWave();
 
@@ -73,6 +125,11 @@ protected:
 
 	void RestartDeadPlayers();
 
+	void SpawnSimulatedPlayers();
+
+	// Simulated runs end the process once they are done
+	void FinishSimulatedRun(const TCHAR* Reason);
+
 public:
 
 	ASGameMode();
@@ -81,6 +138,13 @@ public:
 
 	virtual void Tick(float DeltaSeconds) override;
 
+	// True for human players and simulated players, false for bots
+	static bool IsPlayer(const AController* Controller);
+
+	USLoadGovernorComponent* GetLoadGovernor() const;
+
+	int32 GetWaveCount() const;
+
 	UPROPERTY(BlueprintAssignable, Category = "GameMode")
 	FOnActorKilled OnActorKilled;
 };
@@ -6,6 +6,8 @@
 #include "GameFramework/GameStateBase.h"
 #include "SGameState.generated.h"
 
+class USStatusEffectComponent;
+class ASWeapon;
 
 UENUM(BlueprintType)
 enum class EWaveState : uint8
@@ -32,8 +34,15 @@ class COOPGAME_API ASGameState : public AGameStateBase
 {
 	GENERATED_BODY()
 
+public:
+
+	ASGameState();
+
 protected:
 
+	UPROPERTY(VisibleDefaultsOnly, Category = "Components")
+	USStatusEffectComponent* StatusEffectComp;
+
 	UFUNCTION()
 	void OnRep_WaveState(EWaveState OldState);
 
@@ -43,8 +52,30 @@ protected:
 	UPROPERTY(BlueprintReadOnly, ReplicatedUsing = OnRep_WaveState, Category = "GameState")
 	EWaveState WaveState;
 
+	UFUNCTION()
+	void OnRep_UpcomingBotClasses();
+
+	/* Bots the next wave spawns, everyone preloads them (and their effects) during the break */
+	UPROPERTY(ReplicatedUsing = OnRep_UpcomingBotClasses)
+	TArray<TSoftClassPtr<APawn>> UpcomingBotClasses;
+
+	virtual void BeginPlay() override;
+
+	void PreloadWeapon(const TSoftClassPtr<ASWeapon>& WeaponClass, bool bNeededToPlay);
+
+	void OnWeaponClassLoaded(TSoftClassPtr<ASWeapon> WeaponClass, bool bNeededToPlay);
+
+	void OnBotClassLoaded(TSoftClassPtr<APawn> BotClass);
+
 public:
 
 	void SetWaveState(EWaveState NewState);
+
+	EWaveState GetWaveState() const { return WaveState; }
+
+	void SetUpcomingBotClasses(const TArray<TSoftClassPtr<APawn>>& BotClasses);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "GameState")
+	USStatusEffectComponent* GetStatusEffects() const;
 	
 };
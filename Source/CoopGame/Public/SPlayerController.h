@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/PlayerController.h"
+#include "SPlayerController.generated.h"
+
+/**
+ * Player controller of human players. Only here so the engine's many controller RPCs (camera shakes, client
+ * adjustments, travel) are named in COOP.NetAccounting instead of lumped together.
+ */
+UCLASS()
+class COOPGAME_API ASPlayerController : public APlayerController
+{
+	GENERATED_BODY()
+
+public:
+
+	/* Names the RPCs it sends for COOP.NetAccounting */
+	virtual bool CallRemoteFunction(UFunction* Function, void* Parameters, struct FOutParmRec* OutParms, FFrame* Stack) override;
+};
@@ -4,8 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "SStatusEffectComponent.h"
 #include "SPowerupActor.generated.h"
 
+/**
+ * Pickup-able effect. The timing runs in the game state's status effect component, this actor only supplies the
+ * settings and the Blueprint events.
+ */
 UCLASS()
 class COOPGAME_API ASPowerupActor : public AActor
 {
@@ -17,6 +22,8 @@ public:
 
 protected:
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	/* Time between powerup ticks */
 	UPROPERTY(EditDefaultsOnly, Category = "Powerups")
 	float PowerupInterval;
@@ -25,13 +32,18 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Powerups")
 	int32 TotalNrOfTicks;
 
-	FTimerHandle TimerHandle_PowerupTick;
+	/* Native part of the effect on whoever picked it up, Custom leaves it all to OnPowerupTicked */
+	UPROPERTY(EditDefaultsOnly, Category = "Powerups")
+	EStatusEffectType EffectType;
 
-	// Total number of ticks applied
-	int32 TicksProcessed;
+	/* Health healed or damage dealt per tick, or the speed multiplier of SpeedBoost */
+	UPROPERTY(EditDefaultsOnly, Category = "Powerups")
+	float EffectMagnitude;
 
-	UFUNCTION()
-	void OnTickPowerup();
+	// Running effect, INDEX_NONE when inactive
+	int32 EffectId;
+
+	void OnTickPowerup(int32 TickIndex, bool bExpired);
 
 	// Keeps state of the power-up
 	UPROPERTY(ReplicatedUsing=OnRep_PowerupActive)
@@ -59,6 +59,11 @@ protected:
 
 	void PlayFireEffects(FVector TraceEnd);
 
+	/* Camera shake and recoil for the player holding the weapon, only ever on their own machine */
+	void PlayLocalFireFeedback();
+
+	void PlayMuzzleAndTracer(FVector TraceEnd);
+
 	void PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoint);
 
 // ------- VARIABLES ------- \\
@@ -93,6 +98,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Weapon", meta = (ClampMin = 0.0f))
 	float BulletSpreadWhileAiming;
 
+	/* Degrees the aim kicks up per shot, 0 is none */
+	UPROPERTY(EditDefaultsOnly, Category = "Weapon", meta = (ClampMin = 0.0f))
+	float RecoilKick;
+
 	// Derived from RateOfFire
 	float TimeBetweenShots;
 
@@ -111,19 +120,19 @@ protected:
 	TSubclassOf<UDamageType> DamageType;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
-	UParticleSystem* MuzzleEffect;
+	TSoftObjectPtr<UParticleSystem> MuzzleEffect;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
-	UParticleSystem* DefaultImpactEffect;
+	TSoftObjectPtr<UParticleSystem> DefaultImpactEffect;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
-	UParticleSystem* FleshImpactEffect;
+	TSoftObjectPtr<UParticleSystem> FleshImpactEffect;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
-	UParticleSystem* TracerEffect;
+	TSoftObjectPtr<UParticleSystem> TracerEffect;
 
 	UPROPERTY(EditDefaultsOnly, Category = "Weapon")
-	TSubclassOf<UCameraShake> FireCamShake;
+	TSoftClassPtr<UCameraShake> FireCamShake;
 
 public:	
 
@@ -135,6 +144,15 @@ public:
 
 	void StartReload();
 
+	/* Effects and camera shake, streamed in when the weapon spawns rather than loaded with it */
+	void GetCosmeticAssets(TArray<FSoftObjectPath>& OutAssets) const;
+
+	/* Keeps the cosmetic assets out of the dedicated server cook */
+	virtual void Serialize(FArchive& Ar) override;
+
+	/* Names the RPCs it sends for COOP.NetAccounting */
+	virtual bool CallRemoteFunction(UFunction* Function, void* Parameters, struct FOutParmRec* OutParms, FFrame* Stack) override;
+
 // ------- VARIABLES ------- \\
 
 //Bool